@@ -86,6 +86,8 @@ NOTE: The script runs significantly faster when compiled
 
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include <TString.h>
 
 class RooNLLVar;
@@ -136,6 +138,8 @@ public:
    void     setMaxRetries(Int_t value);
    void     setCalculatePvalues(Bool_t value);
    void     setNumCPU(Int_t value);
+   void     setNumWorkers(Int_t value);
+   void     setWarmStart(Bool_t value);
    Bool_t   getBetterBands();
    Bool_t   getBetterNegativeBands();
    Bool_t   getProfileNegativeAtZero();
@@ -157,6 +161,8 @@ public:
    Int_t    getMaxRetries();
    Bool_t   getCalculatePvalues();
    Int_t    getNumCPU();
+   Int_t    getNumWorkers();
+   Bool_t   getWarmStart();
    void     printOptionValues();
 
 protected:
@@ -171,6 +177,13 @@ protected:
 
    void       saveSnapshot(RooNLLVar *nll, Double_t mu);
    void       loadSnapshot(RooNLLVar *nll, Double_t mu);
+   Bool_t     loadNearestSnapshot(RooNLLVar *nll, Double_t mu);
+   void       recreateNLLs();
+   void       runLimitJob(int job, const char *modelConfigName, Double_t med_limit, Double_t &limit, int &status,
+                          Double_t &obs_muhat, std::map<TString, Float_t> &np_hat_map);
+   void       runParallelLimits(const std::vector<int> &jobs, const char *modelConfigName, Double_t med_limit,
+                                std::map<int, Double_t> &limits, std::map<int, int> &status, Double_t &obs_muhat,
+                                std::map<TString, Float_t> &np_hat_map);
    void       doPredictiveFit(RooNLLVar *nll, Double_t mu1, Double_t m2, Double_t mu);
    RooNLLVar *createNLL(RooDataSet *_data);
    Double_t   getNLL(RooNLLVar *nll);
@@ -207,6 +220,8 @@ private:
    int         m_maxRetries;
    Bool_t      m_doPvals;
    Int_t       m_NumCPU;
+   Int_t       m_numWorkers;
+   Bool_t      m_warmStart;
 
    // don't touch!
    std::map<RooNLLVar *, Double_t>                     m_map_nll_muhat;
@@ -214,6 +229,7 @@ private:
    std::map<RooDataSet *, RooNLLVar *>                 m_map_data_nll;
    std::map<RooNLLVar *, std::string>                  m_map_snapshots;
    std::map<RooNLLVar *, std::map<Double_t, Double_t>> m_map_nll_mu_sigma;
+   std::map<std::string, std::set<Double_t>>           m_map_snapshot_mus;
    RooWorkspace *                                      m_w;
    RooStats::ModelConfig *                             m_mc;
    RooDataSet *                                        m_data;
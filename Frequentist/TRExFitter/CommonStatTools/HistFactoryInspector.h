@@ -34,6 +34,9 @@ public:
 
    void setDebugLevel(Int_t level);
 
+   /// Propagate the errors of all yields at once
+   void setBatchMode(Bool_t batchMode);
+
    /// Set the input
    void setInput(const char *inputFile, const char *workspaceName, const char *modelConfigName, const char *dataName,
                  TString rangeName);
@@ -73,11 +76,14 @@ protected:
                                                 Bool_t doMinos);
    std::vector<TString>          getFreeParameters();
    Double_t   getPropagatedError(RooAbsReal *var, const RooFitResult &fitResult, const Bool_t doAsym);
+   std::vector<Double_t> getPropagatedErrors(const std::vector<RooAbsReal *> &vars, const RooFitResult &fitResult,
+                                             const Bool_t doAsym);
    RooArgList getFloatParList(const RooAbsPdf &pdf, const RooArgSet &obsSet);
    void       resetError(const RooArgList &parList, const RooArgList &vetoList = RooArgList());
 
 private:
    Int_t                m_debugLevel;
+   Bool_t               m_batchMode;
    TString              m_inputFile;
    TString              m_workspaceName;
    TString              m_modelConfigName;
@@ -0,0 +1,280 @@
+#include "TRExFitter/BinnedToyMCSampler.h"
+
+#include "TRExFitter/StatusLogbook.h"
+
+#include "RooAbsPdf.h"
+#include "RooArgSet.h"
+#include "RooCatType.h"
+#include "RooCategory.h"
+#include "RooConstVar.h"
+#include "RooDataSet.h"
+#include "RooGaussian.h"
+#include "RooPoisson.h"
+#include "RooRandom.h"
+#include "RooRealVar.h"
+#include "RooSimultaneous.h"
+#include "TRandom.h"
+
+#include <cmath>
+#include <utility>
+
+namespace {
+    // maximum number of attempts to draw a global observable inside its range
+    constexpr int MAXTRIES = 1000;
+}
+
+//__________________________________________________________________________________
+//
+BinnedToyMCSampler::BinnedToyMCSampler(RooStats::TestStatistic& ts, const int ntoys) :
+    RooStats::ToyMCSampler(ts, ntoys),
+    fInitialisedPdf(nullptr),
+    fSupported(false),
+    fSimPdf(nullptr),
+    fChannelCat(nullptr),
+    fNYieldEvaluations(0)
+{
+}
+
+//__________________________________________________________________________________
+//
+RooAbsData* BinnedToyMCSampler::GenerateToyData(RooArgSet& paramPoint, double& weight, RooAbsPdf& pdf) const {
+    if (&pdf != fInitialisedPdf) {
+        fSupported = SetupModel(pdf);
+        fInitialisedPdf = &pdf;
+    }
+    if (!fSupported) {
+        return RooStats::ToyMCSampler::GenerateToyData(paramPoint, weight, pdf);
+    }
+
+    // generate at the requested point, the global observables keep their randomised values afterwards
+    std::unique_ptr<RooArgSet> allVars(pdf.getVariables());
+    std::unique_ptr<RooArgSet> saveVars(static_cast<RooArgSet*>(allVars->snapshot()));
+    allVars->assignValueOnly(paramPoint);
+
+    DrawGlobalObservables();
+    UpdateYields();
+    std::unique_ptr<RooAbsData> data = GenerateBinnedData();
+
+    RooArgSet restore(*allVars);
+    if (fGlobalObservables) {
+        restore.remove(*fGlobalObservables, true, true);
+    }
+    restore.assignValueOnly(*saveVars);
+
+    weight = 1.;
+
+    return data.release();
+}
+
+//__________________________________________________________________________________
+//
+bool BinnedToyMCSampler::SetupModel(RooAbsPdf& pdf) const {
+    fChannels.clear();
+    fConstraints.clear();
+    fParameters.clear();
+    fParameterValues.clear();
+
+    fSimPdf = dynamic_cast<RooSimultaneous*>(&pdf);
+    if (!fSimPdf || !fObservables) {
+        WriteDebugStatus("BinnedToyMCSampler::SetupModel", "The pdf is not a RooSimultaneous, using standard toy generation");
+        return false;
+    }
+    if (!fSimPdf->canBeExtended()) {
+        WriteDebugStatus("BinnedToyMCSampler::SetupModel", "The pdf is not extended, using standard toy generation");
+        return false;
+    }
+
+    fChannelCat = dynamic_cast<RooCategory*>(const_cast<RooAbsCategoryLValue*>(&fSimPdf->indexCat()));
+    if (!fChannelCat) {
+        WriteDebugStatus("BinnedToyMCSampler::SetupModel", "Cannot read the channel category, using standard toy generation");
+        return false;
+    }
+
+    std::unique_ptr<TIterator> iter(fChannelCat->typeIterator());
+    RooCatType* tt = nullptr;
+    while ((tt = static_cast<RooCatType*>(iter->Next()))) {
+        Channel channel;
+        channel.label = tt->GetName();
+        channel.pdf = fSimPdf->getPdf(tt->GetName());
+        if (!channel.pdf) continue;
+        channel.obsSet.reset(channel.pdf->getObservables(*fObservables));
+        if (channel.obsSet->getSize() != 1) {
+            WriteDebugStatus("BinnedToyMCSampler::SetupModel", "Channel " + channel.label + " does not have exactly one observable, using standard toy generation");
+            return false;
+        }
+        channel.obs = dynamic_cast<RooRealVar*>(channel.obsSet->first());
+        if (!channel.obs) return false;
+        fChannels.emplace_back(std::move(channel));
+    }
+
+    // the constraint terms of the global observables
+    if (fGlobalObservables) {
+        std::unique_ptr<RooArgSet> components(fSimPdf->getComponents());
+        for (const auto iglob : *fGlobalObservables) {
+            RooRealVar* glob = dynamic_cast<RooRealVar*>(iglob);
+            if (!glob) return false;
+
+            RooAbsPdf* constraintPdf = nullptr;
+            for (const auto icomp : *components) {
+                RooAbsPdf* comp = dynamic_cast<RooAbsPdf*>(icomp);
+                if (!comp) continue;
+                if (!comp->dependsOn(*glob)) continue;
+                // the channel pdfs depend also on the observables
+                if (comp->dependsOn(*fObservables)) continue;
+                // only independent constraints are supported
+                std::unique_ptr<RooArgSet> compGlobs(comp->getObservables(*fGlobalObservables));
+                if (compGlobs->getSize() != 1) continue;
+                constraintPdf = comp;
+                break;
+            }
+            if (!constraintPdf) {
+                WriteDebugStatus("BinnedToyMCSampler::SetupModel", "Cannot find the constraint of global observable " + std::string(glob->GetName()) + ", using standard toy generation");
+                return false;
+            }
+
+            Constraint constraint;
+            constraint.glob = glob;
+            constraint.type = ConstraintType::OTHER;
+            constraint.pdf = constraintPdf;
+            constraint.mean = nullptr;
+            constraint.sigma = nullptr;
+
+            std::vector<RooAbsReal*> servers;
+            for (const auto iserver : constraintPdf->servers()) {
+                if (iserver == glob) continue;
+                RooAbsReal* server = dynamic_cast<RooAbsReal*>(iserver);
+                if (server) servers.emplace_back(server);
+            }
+
+            if (dynamic_cast<RooGaussian*>(constraintPdf) && servers.size() == 2) {
+                // HistFactory uses constant widths
+                const bool firstIsSigma = dynamic_cast<RooConstVar*>(servers.at(0)) != nullptr;
+                const bool secondIsSigma = dynamic_cast<RooConstVar*>(servers.at(1)) != nullptr;
+                if (firstIsSigma != secondIsSigma) {
+                    constraint.type = ConstraintType::GAUSSIAN;
+                    constraint.sigma = firstIsSigma ? servers.at(0) : servers.at(1);
+                    constraint.mean = firstIsSigma ? servers.at(1) : servers.at(0);
+                }
+            } else if (dynamic_cast<RooPoisson*>(constraintPdf) && servers.size() == 1) {
+                constraint.type = ConstraintType::POISSON;
+                constraint.mean = servers.at(0);
+            }
+
+            fConstraints.emplace_back(constraint);
+        }
+    }
+
+    // parameters that the expected yields depend on
+    RooArgSet observablesAndGlobs(*fObservables);
+    if (fGlobalObservables) {
+        observablesAndGlobs.add(*fGlobalObservables, true);
+    }
+    std::unique_ptr<RooArgSet> params(fSimPdf->getParameters(observablesAndGlobs));
+    for (const auto iparam : *params) {
+        RooAbsReal* param = dynamic_cast<RooAbsReal*>(iparam);
+        if (param) fParameters.emplace_back(param);
+    }
+
+    WriteDebugStatus("BinnedToyMCSampler::SetupModel", "Using native binned toy generation for " + std::to_string(fChannels.size()) +
+        " channels and " + std::to_string(fConstraints.size()) + " global observables");
+
+    return !fChannels.empty();
+}
+
+//__________________________________________________________________________________
+//
+void BinnedToyMCSampler::DrawGlobalObservables() const {
+    TRandom* rnd = RooRandom::randomGenerator();
+    for (const auto& constraint : fConstraints) {
+        RooRealVar* glob = constraint.glob;
+        if (constraint.type == ConstraintType::OTHER) {
+            std::unique_ptr<RooDataSet> gen(constraint.pdf->generate(RooArgSet(*glob), 1));
+            if (gen && gen->numEntries() == 1) {
+                glob->setVal(gen->get(0)->getRealValue(glob->GetName()));
+            }
+            continue;
+        }
+
+        const double mean = constraint.mean->getVal();
+        for (int itry = 0; itry < MAXTRIES; ++itry) {
+            const double value = constraint.type == ConstraintType::GAUSSIAN ?
+                rnd->Gaus(mean, constraint.sigma->getVal()) :
+                static_cast<double>(rnd->Poisson(mean));
+            if (glob->inRange(value, nullptr)) {
+                glob->setVal(value);
+                break;
+            }
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+void BinnedToyMCSampler::UpdateYields() const {
+    bool changed = fParameterValues.size() != fParameters.size();
+    if (!changed) {
+        for (std::size_t i = 0; i < fParameters.size(); ++i) {
+            if (fParameters.at(i)->getVal() != fParameterValues.at(i)) {
+                changed = true;
+                break;
+            }
+        }
+    }
+    if (!changed) return;
+
+    fParameterValues.resize(fParameters.size());
+    for (std::size_t i = 0; i < fParameters.size(); ++i) {
+        fParameterValues.at(i) = fParameters.at(i)->getVal();
+    }
+
+    // same as the Asimov dataset creation: pdf value x bin width x expected events
+    for (auto& channel : fChannels) {
+        RooRealVar* obs = channel.obs;
+        const double obsValue = obs->getVal();
+        const double expectedEvents = channel.pdf->expectedEvents(*channel.obsSet);
+        channel.yields.resize(obs->numBins());
+        for (int ibin = 0; ibin < obs->numBins(); ++ibin) {
+            obs->setBin(ibin);
+            const double yield = channel.pdf->getVal(channel.obsSet.get())*obs->getBinWidth(ibin)*expectedEvents;
+            channel.yields.at(ibin) = (std::isfinite(yield) && yield > 0) ? yield : 0.;
+        }
+        obs->setVal(obsValue);
+    }
+    ++fNYieldEvaluations;
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooAbsData> BinnedToyMCSampler::GenerateBinnedData() const {
+    RooArgSet allObs(*fObservables);
+    allObs.add(*fChannelCat, true);
+    RooRealVar weightVar("weightVar", "", 1., -1e10, 1e10);
+    RooArgSet obsAndWeight(allObs);
+    obsAndWeight.add(weightVar);
+
+    std::unique_ptr<RooDataSet> data = std::make_unique<RooDataSet>("BinnedToyData",
+                                                                    "BinnedToyData",
+                                                                    obsAndWeight,
+                                                                    RooFit::WeightVar(weightVar));
+
+    TRandom* rnd = RooRandom::randomGenerator();
+    const int catIndex = fChannelCat->getIndex();
+    for (const auto& channel : fChannels) {
+        fChannelCat->setLabel(channel.label.c_str());
+        RooRealVar* obs = channel.obs;
+        const double obsValue = obs->getVal();
+        for (std::size_t ibin = 0; ibin < channel.yields.size(); ++ibin) {
+            const double yield = channel.yields.at(ibin);
+            if (yield <= 0) continue;
+            const double n = static_cast<double>(rnd->Poisson(yield));
+            // empty bins do not contribute to the likelihood
+            if (n <= 0) continue;
+            obs->setBin(ibin);
+            data->add(allObs, n);
+        }
+        obs->setVal(obsValue);
+    }
+    fChannelCat->setIndex(catIndex);
+
+    return data;
+}
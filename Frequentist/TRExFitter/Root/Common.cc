@@ -4,6 +4,7 @@
 // Framework includes
 #include "TRExFitter/FitResults.h"
 #include "TRExFitter/HistoTools.h"
+#include "TRExFitter/NtupleSkimCache.h"
 #include "TRExFitter/Region.h"
 #include "TRExFitter/StatusLogbook.h"
 #include "TRExFitter/SystematicHist.h"
@@ -17,6 +18,7 @@
 #include "TChain.h"
 #include "TDirectory.h"
 #include "TFile.h"
+#include "TFormula.h"
 #include "TGraphAsymmErrors.h"
 #include "TH1.h"
 #include "TH2.h"
@@ -28,11 +30,19 @@
 
 // c++ stuff
 #include <algorithm>
+#include <cstdint>
+#include <exception>
 #include <iostream>
 #include <iomanip>
 #include <filesystem>
 #include <fstream>
 #include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -65,6 +75,7 @@ bool TRExFitter::CORRECTNORMFORNEGATIVEINTEGRAL = false;
 bool TRExFitter::REMOVEXERRORS = false;
 double TRExFitter::CORRELATIONTHRESHOLD = -1.;
 bool TRExFitter::MERGEUNDEROVERFLOW = false;
+std::string TRExFitter::NTUPLESKIMCACHEDIR = "";
 bool TRExFitter::OPRATIO = false;
 bool TRExFitter::NORATIO = false;
 std::map <std::string,std::string> TRExFitter::SYSTMAP;
@@ -133,8 +144,14 @@ TH1D* Common::HistFromNtuple(const std::string& ntuple,
     }
     h->Sumw2();
     TString drawVariable = Form("%s>>h",variable.c_str()), drawWeight = Form("(%s)*(%s)",weight.c_str(),selection.c_str());
-    if(Nev>=0) t->Draw(drawVariable, drawWeight, "goff", Nev);
-    else       t->Draw(drawVariable, drawWeight, "goff");
+    bool filled = false;
+    if(Nev<0 && TRExFitter::NTUPLESKIMCACHEDIR!="") {
+        filled = NtupleSkimCache::Draw(TRExFitter::NTUPLESKIMCACHEDIR, t, ntuple, drawVariable.Data(), selection, weight, aliases);
+    }
+    if(!filled) {
+        if(Nev>=0) t->Draw(drawVariable, drawWeight, "goff", Nev);
+        else       t->Draw(drawVariable, drawWeight, "goff");
+    }
     if(TRExFitter::MERGEUNDEROVERFLOW) Common::MergeUnderOverFlow(h);
     delete t;
     return h;
@@ -184,8 +201,14 @@ TH1D* Common::HistFromNtupleBinArr(const std::string& ntuple,
     }
     h->Sumw2();
     TString drawVariable = Form("%s>>h",variable.c_str()), drawWeight = Form("(%s)*(%s)",weight.c_str(),selection.c_str());
-    if(Nev>=0) t->Draw(drawVariable, drawWeight, "goff", Nev);
-    else       t->Draw(drawVariable, drawWeight, "goff");
+    bool filled = false;
+    if(Nev<0 && TRExFitter::NTUPLESKIMCACHEDIR!="") {
+        filled = NtupleSkimCache::Draw(TRExFitter::NTUPLESKIMCACHEDIR, t, ntuple, drawVariable.Data(), selection, weight, aliases);
+    }
+    if(!filled) {
+        if(Nev>=0) t->Draw(drawVariable, drawWeight, "goff", Nev);
+        else       t->Draw(drawVariable, drawWeight, "goff");
+    }
     if(TRExFitter::MERGEUNDEROVERFLOW) Common::MergeUnderOverFlow(h);
     delete t;
     return h;
@@ -422,6 +445,12 @@ std::vector< std::pair < std::string,std::vector<double> > > Common::processStri
 //__________________________________________________________________________________
 // taking into account wildcards on both
 bool Common::StringsMatch(const std::string& s1, const std::string& s2){
+    // a string without wildcards only matches itself, so one pass is enough
+    const bool wild1 = (s1.find_first_of("*?") != std::string::npos);
+    const bool wild2 = (s2.find_first_of("*?") != std::string::npos);
+    if(!wild1 && !wild2) return s1 == s2;
+    if(!wild2) return Common::wildcmp(s1.c_str(),s2.c_str())>0;
+    if(!wild1) return Common::wildcmp(s2.c_str(),s1.c_str())>0;
     if(Common::wildcmp(s1.c_str(),s2.c_str())>0 || Common::wildcmp(s2.c_str(),s1.c_str())>0) return true;
     return false;
 }
@@ -465,10 +494,8 @@ int Common::wildcmp(const char *wild, const char *string) {
 int Common::FindInStringVector(const std::vector<std::string>& v,
                                const std::string& s) {
     int idx = -1;
-    std::string s1;
     for(unsigned int i=0;i<v.size();i++){
-        s1 = v[i];
-        if(Common::StringsMatch(s1,s)){
+        if(Common::StringsMatch(v[i],s)){
             idx = (int)i;
             break;
         }
@@ -482,12 +509,8 @@ int Common::FindInStringVectorOfVectors(const std::vector< std::vector<std::stri
                                         const std::string& s,
                                         const std::string& ss) {
     int idx = -1;
-    std::string s1;
-    std::string s2;
     for(unsigned int i=0;i<v.size();i++){
-        s1 = v[i][0];
-        s2 = v[i][1];
-        if(Common::StringsMatch(s1,s) && Common::StringsMatch(s2,ss)){
+        if(Common::StringsMatch(v[i][0],s) && Common::StringsMatch(v[i][1],ss)){
             idx = (int)i;
             break;
         }
@@ -1011,6 +1034,7 @@ bool Common::OptionRunsFit(const std::string& opt){
     if (opt.find("r")!=std::string::npos) return true;
     if (opt.find("i")!=std::string::npos) return true;
     if (opt.find("x")!=std::string::npos) return true;
+    if (opt.find("c")!=std::string::npos) return true;
     return false;
 }
 
@@ -1629,15 +1653,14 @@ std::vector<double> Common::CalculateExpression(const NormFactor* nf,
     for(std::size_t j = 0; j < nameS.size(); ++j){
         WriteDebugStatus("Common::CalculateExpression", "nfNominal["+std::to_string(j)+"]: "+std::to_string(nfNominalvec[j]));
     }
-    TFormula f_morph ("f_morph",formula.c_str());
-    result.emplace_back(f_morph.EvalPar(&nfNominalvec[0],nullptr));
+    TFormula* f_morph = Common::GetCompiledFormula(formula);
 
+    // collect all the parameter sets, the first one is the nominal
+    std::vector<std::vector<double> > params{nfNominalvec};
     if (isPostFit) {
-        double scaleUp = f_morph.EvalPar(&nfNominalvec[0],nullptr); // nominal value
-        double scaleDown = f_morph.EvalPar(&nfNominalvec[0],nullptr); // nominal value
         if(paramName.find("morph_") != std::string::npos){
-            scaleUp = f_morph.EvalPar(&nfUpvec[0],nullptr); // 1-parameter up variation
-            scaleDown = f_morph.EvalPar(&nfDownvec[0],nullptr); // 1-parameter down variation
+            params.emplace_back(nfUpvec); // 1-parameter up variation
+            params.emplace_back(nfDownvec); // 1-parameter down variation
         } else {
             for (int ii = 0; ii < (1 << nameS.size()); ii++) {
                 std::vector <double> exprvec;
@@ -1645,8 +1668,24 @@ std::vector<double> Common::CalculateExpression(const NormFactor* nf,
                     if(ii & (1<<j)) exprvec.push_back(nfUpvec[j]);
                     else            exprvec.push_back(nfDownvec[j]);
                 }
-                scaleUp = (f_morph.EvalPar(&exprvec[0],nullptr) > scaleUp) ? f_morph.EvalPar(&exprvec[0],nullptr) : scaleUp;
-                scaleDown = (f_morph.EvalPar(&exprvec[0],nullptr) < scaleDown) ? f_morph.EvalPar(&exprvec[0],nullptr) : scaleDown;
+                params.emplace_back(std::move(exprvec));
+            }
+        }
+    }
+    const std::vector<double> values = Common::EvaluateFormula(f_morph, params);
+    result.emplace_back(values.at(0));
+
+    if (isPostFit) {
+        double scaleUp = values.at(0); // nominal value
+        double scaleDown = values.at(0); // nominal value
+        if(paramName.find("morph_") != std::string::npos){
+            scaleUp = values.at(1);
+            scaleDown = values.at(2);
+        } else {
+            // envelope of all the corners
+            for (std::size_t i = 1; i < values.size(); ++i) {
+                scaleUp = std::max(scaleUp, values.at(i));
+                scaleDown = std::min(scaleDown, values.at(i));
             }
         }
 
@@ -1657,6 +1696,39 @@ std::vector<double> Common::CalculateExpression(const NormFactor* nf,
     return result;
 }
 
+//___________________________________________________________
+//
+TFormula* Common::GetCompiledFormula(const std::string& formula) {
+    // the compilation of a TFormula is much slower than its evaluation
+    // the cache is never deleted, to not destroy the formulas after ROOT is torn down at exit
+    static auto* cache = new std::unordered_map<std::string, std::unique_ptr<TFormula> >();
+    auto it = cache->find(formula);
+    if (it != cache->end()) return it->second.get();
+
+    const std::string name = "f_expression_" + std::to_string(cache->size());
+    std::unique_ptr<TFormula> f = std::make_unique<TFormula>(name.c_str(), formula.c_str(), false);
+    if (!f->IsValid()) {
+        WriteErrorStatus("Common::GetCompiledFormula", "Cannot compile formula: " + formula);
+        exit(EXIT_FAILURE);
+    }
+    WriteDebugStatus("Common::GetCompiledFormula", "Compiled formula: " + formula);
+    TFormula* result = f.get();
+    cache->emplace(formula, std::move(f));
+
+    return result;
+}
+
+//___________________________________________________________
+//
+std::vector<double> Common::EvaluateFormula(TFormula* formula, const std::vector<std::vector<double> >& params) {
+    std::vector<double> result;
+    result.reserve(params.size());
+    for (const auto& iparams : params) {
+        result.emplace_back(formula->EvalPar(iparams.data(), nullptr));
+    }
+    return result;
+}
+
 //___________________________________________________________
 //
 void Common::ScaleNominal(const SampleHist* const sig,
@@ -1678,3 +1750,104 @@ void Common::ScaleNominal(const SampleHist* const sig,
         }
     }
 }
+
+//___________________________________________________________
+//
+std::string Common::HashString(const std::string& s) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+
+//___________________________________________________________
+//
+std::string Common::FileVersion(const std::string& fileName) {
+    struct stat fileStat;
+    if (stat(fileName.c_str(), &fileStat) != 0) return "";
+    return std::to_string(fileStat.st_mtim.tv_sec) + "." + std::to_string(fileStat.st_mtim.tv_nsec) +
+           ":" + std::to_string(fileStat.st_size);
+}
+
+//___________________________________________________________
+//
+std::vector<std::string> Common::IncludedHeaders(const std::string& file, const std::vector<std::string>& includePaths) {
+    std::vector<std::string> headers;
+    std::vector<std::string> toRead{file};
+    while (!toRead.empty()) {
+        const std::string current = toRead.back();
+        toRead.pop_back();
+        const std::size_t slash = current.find_last_of('/');
+        std::vector<std::string> dirs{(slash == std::string::npos) ? "." : current.substr(0, slash)};
+        dirs.insert(dirs.end(), includePaths.begin(), includePaths.end());
+
+        std::ifstream in(current);
+        std::string line;
+        while (std::getline(in, line)) {
+            const std::size_t hash = line.find_first_not_of(" \t");
+            if (hash == std::string::npos || line[hash] != '#') continue;
+            const std::size_t directive = line.find_first_not_of(" \t", hash+1);
+            if (directive == std::string::npos || line.compare(directive, 7, "include") != 0) continue;
+            const std::size_t open = line.find_first_of("\"<", directive+7);
+            if (open == std::string::npos) continue;
+            const std::size_t close = line.find(line[open] == '"' ? '"' : '>', open+1);
+            if (close == std::string::npos || close == open+1) continue;
+            const std::string header = line.substr(open+1, close-open-1);
+            for (const auto& idir : dirs) {
+                const std::string path = (header.front() == '/') ? header : idir+"/"+header;
+                if (gSystem->AccessPathName(path.c_str())) continue;
+                if (path != file && std::find(headers.begin(), headers.end(), path) == headers.end()) {
+                    headers.emplace_back(path);
+                    toRead.emplace_back(path);
+                }
+                break;
+            }
+        }
+    }
+
+    return headers;
+}
+
+//___________________________________________________________
+//
+bool Common::RunInWorkers(const std::size_t nWorkers, const std::function<bool(const std::size_t)>& work) {
+    std::vector<pid_t> pids;
+    bool success = true;
+    std::cout << std::flush;
+    std::cerr << std::flush;
+    for (std::size_t iworker = 0; iworker < nWorkers; ++iworker) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            WriteWarningStatus("Common::RunInWorkers", "Cannot start worker " + std::to_string(iworker));
+            success = false;
+            break;
+        }
+        if (pid == 0) {
+            bool result = false;
+            try {
+                result = work(iworker);
+            } catch (const std::exception& e) {
+                WriteErrorStatus("Common::RunInWorkers", "Worker " + std::to_string(iworker) + " failed: " + e.what());
+            }
+            std::cout << std::flush;
+            std::cerr << std::flush;
+            _exit(result ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        pids.emplace_back(pid);
+    }
+
+    for (std::size_t iworker = 0; iworker < pids.size(); ++iworker) {
+        int status = 0;
+        waitpid(pids.at(iworker), &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            WriteWarningStatus("Common::RunInWorkers", "Worker " + std::to_string(iworker) + " failed");
+            success = false;
+        }
+    }
+
+    return success;
+}
@@ -18,6 +18,7 @@
 
 // ROOT includes
 #include "TColor.h"
+#include "TObject.h"
 #include "TSystem.h"
 
 // c++ includes
@@ -95,6 +96,9 @@ int ConfigReader::ReadFullConfig(const std::string& fileName, const std::string&
 
     sc+= PostConfig(opt);
 
+    // the Regions/Exclude lists are final now
+    fFitter->BuildMembershipIndex();
+
     return sc;
 }
 
@@ -679,6 +683,82 @@ int ConfigReader::ReadJobOptions(){
         fFitter->fUseGammaPulls = Common::StringToBoolean(param);
     }
 
+    // Set PostFitBand
+    param = confSet->Get("PostFitBand");
+    if( param != ""){
+        std::transform(param.begin(), param.end(), param.begin(), ::toupper);
+        if (param == "LINEAR") {
+            fFitter->fPostFitBandSampling = false;
+        } else if (param == "SAMPLING") {
+            fFitter->fPostFitBandSampling = true;
+        } else {
+            WriteErrorStatus("ConfigReader::ReadJobOptions", "PostFitBand is not LINEAR or SAMPLING. Please check this!");
+            ++sc;
+        }
+    }
+
+    // Set PostFitBandDraws
+    param = confSet->Get("PostFitBandDraws");
+    if( param != ""){
+        fFitter->fPostFitBandDraws = std::atoi(param.c_str());
+        if (fFitter->fPostFitBandDraws < 2) {
+            WriteErrorStatus("ConfigReader::ReadJobOptions", "PostFitBandDraws is < 2");
+            ++sc;
+        }
+    }
+
+    // Set PostFitBandSeed
+    param = confSet->Get("PostFitBandSeed");
+    if( param != ""){
+        fFitter->fPostFitBandSeed = std::atoi(param.c_str());
+    }
+
+    // Set PostFitBandThreads
+    param = confSet->Get("PostFitBandThreads");
+    if( param != ""){
+        fFitter->fPostFitBandThreads = std::atoi(param.c_str());
+        if (fFitter->fPostFitBandThreads < 1) {
+            WriteWarningStatus("ConfigReader::ReadJobOptions", "PostFitBandThreads is < 1. Setting to 1");
+            fFitter->fPostFitBandThreads = 1;
+        }
+    }
+
+    // Set PostProcessingThreads
+    param = confSet->Get("PostProcessingThreads");
+    if( param != ""){
+        fFitter->fPostProcessingThreads = std::atoi(param.c_str());
+        if (fFitter->fPostProcessingThreads < 1) {
+            WriteWarningStatus("ConfigReader::ReadJobOptions", "PostProcessingThreads is < 1. Setting to 1");
+            fFitter->fPostProcessingThreads = 1;
+        }
+    }
+
+    // Set WorkspaceWorkers
+    param = confSet->Get("WorkspaceWorkers");
+    if( param != ""){
+        fFitter->fWorkspaceWorkers = std::atoi(param.c_str());
+        if (fFitter->fWorkspaceWorkers < 1) {
+            WriteWarningStatus("ConfigReader::ReadJobOptions", "WorkspaceWorkers is < 1. Setting to 1");
+            fFitter->fWorkspaceWorkers = 1;
+        }
+    }
+
+    // Set AutoBinningWorkers
+    param = confSet->Get("AutoBinningWorkers");
+    if( param != ""){
+        fFitter->fAutoBinningWorkers = std::atoi(param.c_str());
+        if (fFitter->fAutoBinningWorkers < 1) {
+            WriteWarningStatus("ConfigReader::ReadJobOptions", "AutoBinningWorkers is < 1. Setting to 1");
+            fFitter->fAutoBinningWorkers = 1;
+        }
+    }
+
+    // Set AutoBinningCache
+    param = confSet->Get("AutoBinningCache");
+    if( param != ""){
+        fFitter->fAutoBinningCache = Common::StringToBoolean(param);
+    }
+
     // plotting options are in special function
     sc+= SetJobPlot(confSet);
 
@@ -899,6 +979,20 @@ int ConfigReader::ReadJobOptions(){
     if( param != "" ) {
       fFitter->fCustomFunctionsExecutes = Common::Vectorize(Common::RemoveQuotes(param),';');
     }
+
+    // Set CustomFunctionsCacheDir
+    param = confSet->Get("CustomFunctionsCacheDir");
+    if( param != "" ) {
+        fFitter->fCustomFunctionsCacheDir = Common::RemoveQuotes(param);
+    }
+
+    // Set NtupleSkimCache
+    param = confSet->Get("NtupleSkimCache");
+    if( param != "" && Common::StringToBoolean(param) ) {
+        TRExFitter::NTUPLESKIMCACHEDIR = fFitter->fName+"/NtupleSkimCache";
+        param = confSet->Get("NtupleSkimCacheDir");
+        if( param != "" ) TRExFitter::NTUPLESKIMCACHEDIR = Common::RemoveQuotes(param);
+    }
     
     // Add Aliases
     param = confSet->Get("AddAliases");
@@ -1140,6 +1234,31 @@ int ConfigReader::ReadJobOptions(){
         fFitter->fValidationPruning = Common::StringToBoolean(param);
     }
 
+    // Set MemoryMonitoring
+    param = confSet->Get("MemoryMonitoring");
+    if( param != "" ){
+        const bool monitor = Common::StringToBoolean(param);
+        fFitter->fMemoryMonitor.SetEnabled(monitor);
+        if (monitor) TObject::SetObjectStat(true);
+    }
+
+    // Set MemoryBudget
+    param = confSet->Get("MemoryBudget");
+    if( param != "" ){
+        const double budget = std::stod(param);
+        if (budget <= 0){
+            WriteWarningStatus("ConfigReader::ReadJobOptions", "MemoryBudget <= 0, ignoring.");
+        } else {
+            fFitter->fMemoryMonitor.SetBudget(budget);
+        }
+    }
+
+    // Set BinaryFitResults
+    param = confSet->Get("BinaryFitResults");
+    if( param != "" ){
+        fFitter->fBinaryFitResults = Common::StringToBoolean(param);
+    }
+
     // success
     return sc;
 }
@@ -1369,6 +1488,12 @@ int ConfigReader::SetJobPlot(ConfigSet *confSet){
         fFitter->fDoPieChartPlot = Common::StringToBoolean(param);
     }
 
+    // Set DoEFTPlots
+    param = confSet->Get("DoEFTPlots");
+    if( param != "" ){
+        fFitter->fDoEFTPlots = Common::StringToBoolean(param);
+    }
+
     // Set RankingPlot
     param = confSet->Get("RankingPlot");
     if( param != ""){
@@ -1534,6 +1659,18 @@ int ConfigReader::ReadFitOptions(){
         fFitter->fInjectGlobalObservables = Common::StringToBoolean(param);
     }
 
+    // Set AsimovCache
+    param = confSet->Get("AsimovCache");
+    if( param != ""){
+        fFitter->fAsimovCache = Common::StringToBoolean(param);
+    }
+
+    // Set CombinationCache
+    param = confSet->Get("CombinationCache");
+    if( param != ""){
+        fFitter->fCombinationCache = Common::StringToBoolean(param);
+    }
+
     // Set FixNPs
     param = confSet->Get("FixNPs");
     if( param != "" ){
@@ -1660,6 +1797,16 @@ int ConfigReader::ReadFitOptions(){
         fFitter->fVarNameMinos = Common::Vectorize(param,',');
     }
 
+    // Set MinosWorkers
+    param = confSet->Get("MinosWorkers");
+    if( param != "" ){
+        fFitter->fMinosWorkers = std::atoi( param.c_str());
+        if (fFitter->fMinosWorkers < 1) {
+            WriteWarningStatus("ConfigReader::ReadFitOptions", "MinosWorkers is < 1. Setting to default 1");
+            fFitter->fMinosWorkers = 1;
+        }
+    }
+
     // Set SetRandomInitialNPval
     param = confSet->Get("SetRandomInitialNPval");
     if( param != ""){
@@ -1716,6 +1863,66 @@ int ConfigReader::ReadFitOptions(){
         fFitter->fToysSeed = std::atoi( param.c_str());
     }
 
+    // Set ToysGenerator
+    param = confSet->Get("ToysGenerator");
+    if( param != "" ){
+        std::transform(param.begin(), param.end(), param.begin(), ::toupper);
+        if (param == "NATIVE"){
+            fFitter->fToysNativeGenerator = true;
+        } else if (param == "ROOFIT"){
+            fFitter->fToysNativeGenerator = false;
+        } else {
+            WriteWarningStatus("ConfigReader::ReadFitOptions", "You specified 'ToysGenerator' option but did not provide valid parameter. Using default (ROOFIT)");
+            fFitter->fToysNativeGenerator = false;
+        }
+    }
+
+    // Set MCMCChains
+    param = confSet->Get("MCMCChains");
+    if( param != "" ){
+        fFitter->fMCMCChains = std::atoi( param.c_str());
+        if (fFitter->fMCMCChains < 1) {
+            WriteWarningStatus("ConfigReader::ReadFitOptions", "MCMCChains is < 1. Setting to default 4");
+            fFitter->fMCMCChains = 4;
+        }
+    }
+
+    // Set MCMCSteps
+    param = confSet->Get("MCMCSteps");
+    if( param != "" ){
+        fFitter->fMCMCSteps = std::atoi( param.c_str());
+        if (fFitter->fMCMCSteps < 1) {
+            WriteErrorStatus("ConfigReader::ReadFitOptions", "MCMCSteps is < 1");
+            ++sc;
+        }
+    }
+
+    // Set MCMCBurnIn
+    param = confSet->Get("MCMCBurnIn");
+    if( param != "" ){
+        fFitter->fMCMCBurnIn = std::atoi( param.c_str());
+        if (fFitter->fMCMCBurnIn < 0) {
+            WriteWarningStatus("ConfigReader::ReadFitOptions", "MCMCBurnIn is < 0. Setting to 0");
+            fFitter->fMCMCBurnIn = 0;
+        }
+    }
+
+    // Set MCMCSeed
+    param = confSet->Get("MCMCSeed");
+    if( param != "" ){
+        fFitter->fMCMCSeed = std::atoi( param.c_str());
+    }
+
+    // Set MCMCWorkers
+    param = confSet->Get("MCMCWorkers");
+    if( param != "" ){
+        fFitter->fMCMCWorkers = std::atoi( param.c_str());
+        if (fFitter->fMCMCWorkers < 1) {
+            WriteWarningStatus("ConfigReader::ReadFitOptions", "MCMCWorkers is < 1. Setting to default 1");
+            fFitter->fMCMCWorkers = 1;
+        }
+    }
+
     // Set ToysHistoNbins
     param = confSet->Get("ToysHistoNbins");
     if( param != "" ){
@@ -1889,6 +2096,30 @@ int ConfigReader::ReadLimitOptions(){
         fFitter->fLimitsConfidence = conf;
     }
 
+    param = confSet->Get("AsymptoticWorkers");
+    if( param != "" ) {
+        if (fFitter->fLimitType == TRExFit::LimitType::TOYS) {
+            WriteWarningStatus("ConfigReader::ReadLimitOptions", "AsymptoticWorkers is available only when ASYMPTOTIC is used");
+        } else {
+            const int workers = std::stoi(param);
+            if (workers < 1) {
+                WriteWarningStatus("ConfigReader::ReadLimitOptions", "AsymptoticWorkers is < 1. Setting to default 1");
+                fFitter->fLimitAsymptoticWorkers = 1;
+            } else {
+                fFitter->fLimitAsymptoticWorkers = workers;
+            }
+        }
+    }
+
+    param = confSet->Get("AsymptoticWarmStart");
+    if( param != "" ) {
+        if (fFitter->fLimitType == TRExFit::LimitType::TOYS) {
+            WriteWarningStatus("ConfigReader::ReadLimitOptions", "AsymptoticWarmStart is available only when ASYMPTOTIC is used");
+        } else {
+            fFitter->fLimitAsymptoticWarmStart = Common::StringToBoolean(param);
+        }
+    }
+
     param = confSet->Get("SplusBToys");
     if( param != "" ) {
         if (fFitter->fLimitType == TRExFit::LimitType::ASYMPTOTIC) {
@@ -1943,6 +2174,21 @@ int ConfigReader::ReadLimitOptions(){
         }
     }
 
+    param = confSet->Get("ToysWorkers");
+    if( param != "" ) {
+        if (fFitter->fLimitType == TRExFit::LimitType::ASYMPTOTIC) {
+            WriteWarningStatus("ConfigReader::ReadLimitOptions", "ToysWorkers is available only when TOYS are used");
+        } else {
+            const int workers = std::stoi(param);
+            if (workers < 1) {
+                WriteWarningStatus("ConfigReader::ReadLimitOptions", "ToysWorkers is < 1. Setting to default 1");
+                fFitter->fLimitToysWorkers = 1;
+            } else {
+                fFitter->fLimitToysWorkers = workers;
+            }
+        }
+    }
+
 
     param = confSet->Get("LimitPlot");
     if( param != "" ) {
@@ -2402,6 +2648,29 @@ int ConfigReader::ReadRegionOptions(const std::string& opt){
             reg->fNormalizeMigrationMatrix = Common::StringToBoolean(param);
         }
 
+        // Reco side of the unfolding inputs built from ntuples
+        param = confSet->Get("RecoVariable");
+        if (param != "") {
+            reg->fUnfoldingRecoVariable = Common::RemoveQuotes(param);
+        }
+
+        param = confSet->Get("RecoBinning");
+        if (param != "") {
+            reg->fUnfoldingRecoBins.clear();
+            for (const auto& ibin : Common::Vectorize(param, ',')) {
+                reg->fUnfoldingRecoBins.emplace_back(std::stod(ibin));
+            }
+            if (static_cast<int>(reg->fUnfoldingRecoBins.size()) != reg->fNumberUnfoldingRecoBins+1) {
+                WriteErrorStatus("ConfigReader::ReadRegionOptions", "RecoBinning needs NumberOfRecoBins+1 bin edges in region " + reg->fName);
+                ++sc;
+            }
+        }
+
+        param = confSet->Get("RecoSelection");
+        if (param != "") {
+            reg->fUnfoldingRecoSelection = Common::RemoveQuotes(param);
+        }
+
         // Setting based on input type
         if (fFitter->fInputType == 0){
             sc+= SetRegionHIST(reg, confSet);
@@ -5511,6 +5780,54 @@ int ConfigReader::ReadUnfoldingOptions() {
         fFitter->fUnfoldNormXSecBinN = std::stoi(param);
     }
 
+    param = confSet->Get("ResponseMatrixPdf");
+    if (param != "") {
+        fFitter->fUnfoldingResponseMatrixPdf = Common::StringToBoolean(param);
+    }
+
+    param = confSet->Get("InputsFromNtuples");
+    if (param != "") {
+        fFitter->fUnfoldingInputsFromNtuples = Common::StringToBoolean(param);
+    }
+
+    param = confSet->Get("TruthVariable");
+    if (param != "") {
+        fFitter->fUnfoldingTruthVariable = Common::RemoveQuotes(param);
+    }
+
+    param = confSet->Get("TruthBinning");
+    if (param != "") {
+        fFitter->fUnfoldingTruthBins.clear();
+        for (const auto& ibin : Common::Vectorize(param, ',')) {
+            fFitter->fUnfoldingTruthBins.emplace_back(std::stod(ibin));
+        }
+    }
+
+    param = confSet->Get("TruthSelection");
+    if (param != "") {
+        fFitter->fUnfoldingTruthSelection = Common::RemoveQuotes(param);
+    }
+
+    param = confSet->Get("MatchingIndex");
+    if (param != "") {
+        fFitter->fUnfoldingMatchingIndex = Common::Vectorize(param, ',');
+    }
+
+    if (fFitter->fUnfoldingInputsFromNtuples) {
+        if (fFitter->fUnfoldingTruthVariable == "") {
+            WriteErrorStatus("ConfigReader::ReadUnfoldingOptions", "InputsFromNtuples is set, you need to set TruthVariable!");
+            ++sc;
+        }
+        if (static_cast<int>(fFitter->fUnfoldingTruthBins.size()) != fFitter->fNumberUnfoldingTruthBins+1) {
+            WriteErrorStatus("ConfigReader::ReadUnfoldingOptions", "InputsFromNtuples is set, TruthBinning needs NumberOfTruthBins+1 bin edges!");
+            ++sc;
+        }
+        if (fFitter->fUnfoldingMatchingIndex.empty() || fFitter->fUnfoldingMatchingIndex.size() > 2) {
+            WriteErrorStatus("ConfigReader::ReadUnfoldingOptions", "InputsFromNtuples is set, MatchingIndex needs one or two expressions!");
+            ++sc;
+        }
+    }
+
     param = confSet->Get("DivideByBinWidth");
     if (param != "") {
         fFitter->fUnfoldingDivideByBinWidth = Common::StringToBoolean(param);
@@ -5985,6 +6302,54 @@ int ConfigReader::ReadUnfoldingSampleOptions() {
             }
         }
 
+        // Ntuples for the inputs built from ntuples
+        param = confSet->Get("NtupleFile");
+        if (param != "") {
+            sample->fNtupleFiles.clear();
+            sample->fNtupleFiles.emplace_back(Common::RemoveQuotes(param));
+        }
+
+        param = confSet->Get("NtupleFiles");
+        if (param != "") {
+            sample->fNtupleFiles = Common::Vectorize(param, ',');
+        }
+
+        param = confSet->Get("NtuplePath");
+        if (param != "") {
+            sample->fNtuplePaths.clear();
+            sample->fNtuplePaths.emplace_back(Common::RemoveQuotes(param));
+        }
+
+        param = confSet->Get("NtuplePaths");
+        if (param != "") {
+            sample->fNtuplePaths = Common::Vectorize(param, ',');
+        }
+
+        param = confSet->Get("RecoNtupleName");
+        if (param != "") {
+            sample->SetRecoNtupleName(Common::RemoveQuotes(param));
+        }
+
+        param = confSet->Get("TruthNtupleName");
+        if (param != "") {
+            sample->SetTruthNtupleName(Common::RemoveQuotes(param));
+        }
+
+        param = confSet->Get("RecoWeight");
+        if (param != "") {
+            sample->SetRecoWeight(Common::RemoveQuotes(param));
+        }
+
+        param = confSet->Get("TruthWeight");
+        if (param != "") {
+            sample->SetTruthWeight(Common::RemoveQuotes(param));
+        }
+
+        if (!sample->fNtupleFiles.empty() && (sample->GetRecoNtupleName() == "" || sample->GetTruthNtupleName() == "")) {
+            WriteErrorStatus("ConfigReader::ReadUnfoldingSampleOptions", "NtupleFiles set for UnfoldingSample " + sample->GetName() + ", you need to set RecoNtupleName and TruthNtupleName!");
+            ++sc;
+        }
+
         fFitter->fUnfoldingSamples.emplace_back(std::move(sample));
 
     }
@@ -6752,6 +7117,51 @@ int ConfigReader::ReadUnfoldingSystematicOptions() {
             hasDown = true;
         }
 
+        param = confSet->Get("RecoWeightSufUp");
+        if (param != "") {
+            syst->fRecoWeightSufUp = Common::RemoveQuotes(param);
+            hasUp = true;
+        }
+
+        param = confSet->Get("RecoWeightSufDown");
+        if (param != "") {
+            syst->fRecoWeightSufDown = Common::RemoveQuotes(param);
+            hasDown = true;
+        }
+
+        param = confSet->Get("TruthWeightSufUp");
+        if (param != "") {
+            syst->fTruthWeightSufUp = Common::RemoveQuotes(param);
+            hasUp = true;
+        }
+
+        param = confSet->Get("TruthWeightSufDown");
+        if (param != "") {
+            syst->fTruthWeightSufDown = Common::RemoveQuotes(param);
+            hasDown = true;
+        }
+
+        // the inputs of the weight variations are stored next to the nominal ones by default, with the variation as name suffix
+        auto DefaultNameSuff = [](std::vector<std::string>& nameSuffs, const std::vector<std::vector<std::string> >& others, const std::string& suff) {
+            if (!nameSuffs.empty()) return;
+            for (const auto& iother : others) {
+                if (!iother.empty()) return;
+            }
+            nameSuffs.emplace_back(suff);
+        };
+        if (syst->fRecoWeightSufUp != "" || syst->fTruthWeightSufUp != "") {
+            const std::string suff = "_" + syst->GetName() + "_Up";
+            DefaultNameSuff(syst->fMigrationNameSuffsUp, {syst->fMigrationPathsUp, syst->fMigrationFilesUp, syst->fMigrationNamesUp, syst->fMigrationPathSuffsUp, syst->fMigrationFileSuffsUp}, suff);
+            DefaultNameSuff(syst->fSelectionEffNameSuffsUp, {syst->fSelectionEffPathsUp, syst->fSelectionEffFilesUp, syst->fSelectionEffNamesUp, syst->fSelectionEffPathSuffsUp, syst->fSelectionEffFileSuffsUp}, suff);
+            DefaultNameSuff(syst->fAcceptanceNameSuffsUp, {syst->fAcceptancePathsUp, syst->fAcceptanceFilesUp, syst->fAcceptanceNamesUp, syst->fAcceptancePathSuffsUp, syst->fAcceptanceFileSuffsUp}, suff);
+        }
+        if (syst->fRecoWeightSufDown != "" || syst->fTruthWeightSufDown != "") {
+            const std::string suff = "_" + syst->GetName() + "_Down";
+            DefaultNameSuff(syst->fMigrationNameSuffsDown, {syst->fMigrationPathsDown, syst->fMigrationFilesDown, syst->fMigrationNamesDown, syst->fMigrationPathSuffsDown, syst->fMigrationFileSuffsDown}, suff);
+            DefaultNameSuff(syst->fSelectionEffNameSuffsDown, {syst->fSelectionEffPathsDown, syst->fSelectionEffFilesDown, syst->fSelectionEffNamesDown, syst->fSelectionEffPathSuffsDown, syst->fSelectionEffFileSuffsDown}, suff);
+            DefaultNameSuff(syst->fAcceptanceNameSuffsDown, {syst->fAcceptancePathsDown, syst->fAcceptanceFilesDown, syst->fAcceptanceNamesDown, syst->fAcceptancePathSuffsDown, syst->fAcceptanceFileSuffsDown}, suff);
+        }
+
         syst->fHasUpVariation = hasUp;
         syst->fHasDownVariation = hasDown;
 
@@ -6979,6 +7389,12 @@ int ConfigReader::ProcessUnfoldingSamples() {
 
             // Convert the UnfoldingSample to sample and adjust the paths
             const std::vector<std::shared_ptr<Sample> > samples = isample->ConvertToSample(ireg, fFitter->fNumberUnfoldingTruthBins, fFitter->fName);
+            // with ResponseMatrixPdf the truth bins share the gammas of the response sample of the region
+            if (fFitter->fUnfoldingResponseMatrixPdf) {
+                for (const auto& isub : samples) {
+                    if (isub->fSeparateGammas) isub->fCorrelateGammasWithSample = ireg->fName + "_Truth_response";
+                }
+            }
             // set regions to newly created sub-samples
             if (isample->fSubSampleRegions.size()>0) {
                 for (unsigned int i_bin=1;i_bin<samples.size()+1;i_bin++) {
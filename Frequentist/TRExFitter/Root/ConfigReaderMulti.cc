@@ -378,6 +378,10 @@ int ConfigReaderMulti::ReadJobOptions() {
     param = confSet->Get("FitResultsFile");
     if( param != "" ) fMultiFitter->fFitResultsFile = Common::RemoveQuotes(param);
 
+    // Set BinaryFitResults
+    param = confSet->Get("BinaryFitResults");
+    if( param != "" ) fMultiFitter->fBinaryFitResults = Common::StringToBoolean(param);
+
     // Set LimitsFile
     param = confSet->Get("LimitsFile");
     if( param != "" ) fMultiFitter->fLimitsFile = Common::RemoveQuotes(param);
@@ -671,6 +675,30 @@ int ConfigReaderMulti::ReadLimitOptions(){
         fMultiFitter->fLimitsConfidence = conf;
     }
 
+    param = confSet->Get("AsymptoticWorkers");
+    if( param != "" ) {
+        if (fMultiFitter->fLimitType == TRExFit::LimitType::TOYS) {
+            WriteWarningStatus("ConfigReaderMulti::ReadLimitOptions", "AsymptoticWorkers is available only when ASYMPTOTIC is used");
+        } else {
+            const int workers = std::stoi(param);
+            if (workers < 1) {
+                WriteWarningStatus("ConfigReaderMulti::ReadLimitOptions", "AsymptoticWorkers is < 1. Setting to default 1");
+                fMultiFitter->fLimitAsymptoticWorkers = 1;
+            } else {
+                fMultiFitter->fLimitAsymptoticWorkers = workers;
+            }
+        }
+    }
+
+    param = confSet->Get("AsymptoticWarmStart");
+    if( param != "" ) {
+        if (fMultiFitter->fLimitType == TRExFit::LimitType::TOYS) {
+            WriteWarningStatus("ConfigReaderMulti::ReadLimitOptions", "AsymptoticWarmStart is available only when ASYMPTOTIC is used");
+        } else {
+            fMultiFitter->fLimitAsymptoticWarmStart = Common::StringToBoolean(param);
+        }
+    }
+
     param = confSet->Get("SplusBToys");
     if( param != "" ) {
         if (fMultiFitter->fLimitType == TRExFit::LimitType::ASYMPTOTIC) {
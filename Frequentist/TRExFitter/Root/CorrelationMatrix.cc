@@ -16,11 +16,17 @@
 // ATLAS stuff
 #include "AtlasUtils/AtlasLabels.h"
 
+// c++ includes
+#include <algorithm>
+
 //__________________________________________________________________________________
 //
 CorrelationMatrix::CorrelationMatrix() :
     fOutFolder(""),
-    fAtlasLabel("") {
+    fAtlasLabel(""),
+    fExternalMatrix(nullptr),
+    fExternalSize(0),
+    fExternalOwner(nullptr) {
 }
 
 //__________________________________________________________________________________
@@ -34,6 +40,7 @@ void CorrelationMatrix::AddNuisPar(const std::string& p){
 //__________________________________________________________________________________
 //
 void CorrelationMatrix::Resize(const int size) {
+    CopyExternalMatrix();
     fMatrix.resize(size);
     for (auto& i : fMatrix) {
         i.resize(size);
@@ -45,9 +52,32 @@ void CorrelationMatrix::Resize(const int size) {
 void CorrelationMatrix::SetCorrelation(const std::string& p0, const std::string& p1, double corr){
     const std::size_t idx0 = fNuisParIdx[p0];
     const std::size_t idx1 = fNuisParIdx[p1];
+    CopyExternalMatrix();
     fMatrix[idx0][idx1] = corr;
 }
 
+//__________________________________________________________________________________
+//
+void CorrelationMatrix::SetExternalMatrix(const double* data, const std::size_t size, const std::shared_ptr<const void>& owner){
+    fMatrix.clear();
+    fExternalMatrix = data;
+    fExternalSize = size;
+    fExternalOwner = owner;
+}
+
+//__________________________________________________________________________________
+//
+void CorrelationMatrix::CopyExternalMatrix(){
+    if (!fExternalMatrix) return;
+    fMatrix.assign(fExternalSize, std::vector<double>(fExternalSize));
+    for (std::size_t i = 0; i < fExternalSize; ++i) {
+        std::copy(fExternalMatrix + i*fExternalSize, fExternalMatrix + (i+1)*fExternalSize, fMatrix[i].begin());
+    }
+    fExternalMatrix = nullptr;
+    fExternalSize = 0;
+    fExternalOwner.reset();
+}
+
 //__________________________________________________________________________________
 //
 double CorrelationMatrix::GetCorrelation(const std::string& p0, const std::string& p1){
@@ -68,6 +98,7 @@ double CorrelationMatrix::GetCorrelation(const std::string& p0, const std::strin
     }
     int idx0 = fNuisParIdx[p0];
     int idx1 = fNuisParIdx[p1];
+    if (fExternalMatrix) return fExternalMatrix[idx0*fExternalSize + idx1];
     return fMatrix[idx0][idx1];
 }
 
@@ -15,6 +15,7 @@
 #include "TH1.h"
 #include "TGraph.h"
 #include "TGraphErrors.h"
+#include "TF1.h"
 #include "TAxis.h"
 #include "TGaxis.h"
 #include "TLatex.h"
@@ -27,13 +28,20 @@
 // c++ includes
 #include <memory>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 
 using namespace std;
 
+namespace {
+    // the quadratic fits are cheap, only use threads for many bins
+    constexpr std::size_t MINFITSPERTHREAD = 256;
+}
+
 
 // -------------------------------------------------------------------------------------------------
 // SampleHist
@@ -179,20 +187,17 @@ void EFTProcessor::DrawEFTInputs(std::vector < Region* > Regions) const {
 
 //_____________________________________________________________________________
 // this fits the EFT quadratic bin-by-bin
-void EFTProcessor::FitEFTInputs(std::vector < Region* > Regions, const std::string& fileName) {
-
-    // Open file for quadratic fit result output
-    std::ofstream NFTXTFile(fileName.c_str());
-    NFTXTFile << "NORMFACTORS\n";
+void EFTProcessor::FitEFTInputs(std::vector < Region* > Regions, const std::string& fileName, const bool drawFits) {
 
+    ////////////////////////
+    // Collect the relative EFT yields for each bin of each region
+    std::vector<EFTBinFit> fits;
     for(const auto& ireg : Regions) {
         const std::string rname = ireg->fName;
         WriteDebugStatus("EFTProcessor::FitEFTInputs", " Region: " + rname);
 
         for (const auto& imap : fRefMap) {
             WriteDebugStatus("EFTProcessor::FitEFTInputs", "    SM Ref: " + imap.first);
-            ////////////////////////
-            // Get and draw SMRef and EFT histograms
 
             // Get SM Reference sample
             std::shared_ptr<SampleHist> SM_sh = ireg->GetSampleHist(imap.first);
@@ -204,178 +209,296 @@ void EFTProcessor::FitEFTInputs(std::vector < Region* > Regions, const std::stri
             // Make output dir
             gSystem->mkdir((SM_sh->fFitName+"/EFT").c_str());
 
-            std::unique_ptr<TH1> SM_hist(static_cast<TH1*>(SM_sh->fHist->Clone(TString::Format("tmp_%s",imap.first.c_str()))));
-            const std::string SMRef = imap.first;
+            const TH1* SM_hist = SM_sh->fHist.get();
+            fExtrapMap[imap.first]->nBins=SM_hist->GetNbinsX();
 
-            double max_rel_eft=-999;
-            double min_c=999;
-            double max_c=-999;
-
-            ////////////////////////
-            // Fitting quadratic for each bin
-
-            double canv_x = std::min((SM_hist->GetNbinsX()+1)*200,2000);
-            TCanvas b1("b1","b1",canv_x,400);
-            b1.Divide(SM_hist->GetNbinsX()+1,1,0,0);
-
-            b1.cd(1);
-            // Global EFT param, Region and Sample labels
-            TLatex btex{};
-            btex.SetNDC();
-            btex.SetTextSize(20);
-            btex.DrawLatex(0.17,0.9,fTitle.c_str());
-            btex.DrawLatex(0.17,0.79,SMRef.c_str());
-            btex.DrawLatex(0.17,0.72,rname.c_str());
-
-            // Draw legend (need some dummy objects)
-            TH1D hleg("", "", 1, 0, 1);
-            hleg.SetLineColor(kRed);
-            hleg.SetLineWidth(2);
-            TGraph gleg{};
-            gleg.SetTitle("");
-            gleg.SetMarkerStyle(8);
-            gleg.SetMarkerSize(1);
-
-            TLegend bleg (0.1,0.2,0.9,0.5);
-            bleg.SetBorderSize(0);
-            bleg.SetTextSize(18);
-            bleg.AddEntry(&gleg,TString::Format("#frac{#sigma(%s)}{#sigma(SM)}",fTitle.c_str()),"p");
-            bleg.AddEntry(&hleg,"Fit","l");
-            bleg.Draw();
-
-            fExtrapMap[SMRef]->nBins=SM_hist->GetNbinsX();
-            double bottom_margin=0.3;
-
-
-            // Build TGraph per Region bin and fit it
             for(int b=0; b<SM_hist->GetNbinsX(); b++){
-                b1.cd(b+2);
-
-                std::vector<double> x;
-                std::vector<double> x_err;
-                std::vector<double> y;
-                std::vector<double> y_err;
-
-                const std::string NFname = Form("Expression_muEFT_%s_%s_bin%d_%s",imap.first.c_str(),rname.c_str(),b,fName.c_str());
+                EFTBinFit fit;
+                fit.region = ireg;
+                fit.fitName = SM_sh->fFitName;
+                fit.SMRef = imap.first;
+                fit.bin = b;
+                fit.NFname = Form("Expression_muEFT_%s_%s_bin%d_%s",imap.first.c_str(),rname.c_str(),b,fName.c_str());
+                fit.p0 = 1.;
+                fit.p1 = 0.;
+                fit.p2 = 0.;
+                fit.isFitted = false;
 
                 // Skip empty bins
-                if(SM_hist->GetBinContent(b+1) <= 1e-6){
-                    fExtrapMap[SMRef]->p0s.emplace_back(1.);
-                    fExtrapMap[SMRef]->p1s.emplace_back(0);
-                    fExtrapMap[SMRef]->p2s.emplace_back(0);
+                fit.isEmpty = SM_hist->GetBinContent(b+1) <= 1e-6;
+                if(fit.isEmpty){
+                    fits.emplace_back(std::move(fit));
                     continue;
                 }
 
                 // Set SM point
-                x.emplace_back(0.);
-                x_err.emplace_back(0.);
-                y.emplace_back(1.);
-                if (SM_hist->GetBinContent(b+1) != 0) {
-                    y_err.emplace_back(SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1));
-                } else {
-                    y_err.emplace_back(9999999);
-                }
+                fit.x.emplace_back(0.);
+                fit.y.emplace_back(1.);
+                fit.y_err.emplace_back(SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1));
 
                 // Cycle through all EFT variations to get yields and extract relative changes
                 for(const auto& EFT_name : imap.second){
-
                     std::shared_ptr<SampleHist> EFT_sh = ireg->GetSampleHist(EFT_name);
+                    if(!EFT_sh) continue;
+                    const TH1* EFT_hist = EFT_sh->fHist.get();
 
-                    std::unique_ptr<TH1> EFT_hist(static_cast<TH1*>(EFT_sh->fHist->Clone()));
-                    EFT_hist->SetDirectory(nullptr);
+                    const double rel_eft=EFT_hist->GetBinContent(b+1)/SM_hist->GetBinContent(b+1);
+                    const double rel_eft_err=rel_eft*std::sqrt(((EFT_hist->GetBinError(b+1)/EFT_hist->GetBinContent(b+1))*(EFT_hist->GetBinError(b+1)/EFT_hist->GetBinContent(b+1))) +
+                                                               ((SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1))*(SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1))) );
 
-                    if(EFT_sh->GetSample()->fEFTValue>0)EFT_hist->SetLineStyle(kDashed);
-                    else EFT_hist->SetLineStyle(kDotted);
-
-                    double rel_eft=EFT_hist->GetBinContent(b+1)/SM_hist->GetBinContent(b+1);
-                    double rel_eft_err=rel_eft*std::sqrt(((EFT_hist->GetBinError(b+1)/EFT_hist->GetBinContent(b+1))*(EFT_hist->GetBinError(b+1)/EFT_hist->GetBinContent(b+1))) +
-                      				 ((SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1))*(SM_hist->GetBinError(b+1)/SM_hist->GetBinContent(b+1))) );
-
-                    if(rel_eft > max_rel_eft) max_rel_eft = rel_eft;
-
-
-                    if(EFT_sh->GetSample()->fEFTValue > max_c) max_c=EFT_sh->GetSample()->fEFTValue;
-                    if(EFT_sh->GetSample()->fEFTValue < min_c) min_c=EFT_sh->GetSample()->fEFTValue;
-
-                    x.emplace_back(EFT_sh->GetSample()->fEFTValue);
-                    x_err.emplace_back(0.);
-                    y.emplace_back(rel_eft);
-                    y_err.emplace_back(rel_eft_err);
-                }
-
-                //Plot graph
-                TGraphErrors g(imap.second.size()+1, &(x[0]), &(y[0]), &(x_err[0]), &(y_err[0]));
-                g.SetTitle("");
-                g.Fit("pol2");
-                TF1* fit = g.GetFunction("pol2");
-                if (!fit) {
-                    WriteErrorStatus("EFTProcessor::FitEFTInputs", "Cannot retrieve function!");
-                    continue;
+                    fit.x.emplace_back(EFT_sh->GetSample()->fEFTValue);
+                    fit.y.emplace_back(rel_eft);
+                    fit.y_err.emplace_back(rel_eft_err);
                 }
-                Double_t p0 = fit->GetParameter(0);
-                Double_t p1 = fit->GetParameter(1);
-                Double_t p2 = fit->GetParameter(2);
-
-                // Write results to file
-                NFTXTFile << NFname << "  " << p0 << " " << p1 << " " << p2 << "\n";
+                fits.emplace_back(std::move(fit));
+            }
+        }
+    }
 
-                // Save fitter quadratic coeffs to be added to NF later
-                fExtrapMap[SMRef]->p0s.push_back(p0);
-                fExtrapMap[SMRef]->p1s.push_back(p1);
-                fExtrapMap[SMRef]->p2s.push_back(p2);
+    ////////////////////////
+    // Closed-form quadratic fits of all bins, in parallel
+    const std::size_t nThreads = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                       (fits.size() + MINFITSPERTHREAD - 1)/MINFITSPERTHREAD);
+    if (nThreads <= 1) {
+        FitQuadratics(&fits, 0, fits.size());
+    } else {
+        WriteDebugStatus("EFTProcessor::FitEFTInputs", " Fitting " + std::to_string(fits.size()) + " bins with " + std::to_string(nThreads) + " threads");
+        std::vector<std::thread> threads;
+        const std::size_t chunk = (fits.size() + nThreads - 1)/nThreads;
+        for (std::size_t ithread = 0; ithread < nThreads; ++ithread) {
+            const std::size_t first = ithread*chunk;
+            const std::size_t last = std::min(fits.size(), first+chunk);
+            if (first >= last) break;
+            threads.emplace_back(&EFTProcessor::FitQuadratics, &fits, first, last);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
 
-                fit->SetLineColor(kRed);
-                fit->SetLineWidth(2);
+    ////////////////////////
+    // Store the results
 
-                g.SetMarkerStyle(8);
-                g.SetMarkerSize(1);
+    // Open file for quadratic fit result output
+    std::ofstream NFTXTFile(fileName.c_str());
+    NFTXTFile << "NORMFACTORS\n";
 
-                // Plot the fit for this bin
-                TH1 *frame = gPad->DrawFrame(min_c-(0.2*std::abs(min_c)),0.8,max_c+(0.2*std::abs(max_c)),1.1*max_rel_eft,TString::Format("frame%d",b+2));
-                frame->GetXaxis()->SetTitle(fTitle.c_str());
-                bottom_margin=gPad->GetBottomMargin();
+    for(const auto& fit : fits){
+        if(!fit.isEmpty && !fit.isFitted){
+            WriteErrorStatus("EFTProcessor::FitEFTInputs", "Cannot fit the quadratic dependence for " + fit.NFname + ", need at least three different EFT values");
+        }
+        // Write results to file, also for the bins which are not fitted (with the SM values p0=1, p1=p2=0)
+        // since ReadEFTFitResults expects one line per bin
+        NFTXTFile << fit.NFname << "  " << fit.p0 << " " << fit.p1 << " " << fit.p2 << "\n";
+
+        // Save fitter quadratic coeffs to be added to NF later
+        fExtrapMap[fit.SMRef]->p0s.push_back(fit.p0);
+        fExtrapMap[fit.SMRef]->p1s.push_back(fit.p1);
+        fExtrapMap[fit.SMRef]->p2s.push_back(fit.p2);
+    }
 
-                g.Draw("P");
+    NFTXTFile << "\n";
+    NFTXTFile.close();
 
-                // Also draw the fitted equation
-                TLatex gtex{};
-                gtex.SetNDC();
-                gtex.SetTextSize(14);
-                gtex.DrawLatex(0.17,0.90,TString::Format(ireg->fVariableTitle.c_str()));
-                gtex.DrawLatex(0.17,0.85,TString::Format("Bin%d",b));
-                gtex.SetTextSize(13);
-                gtex.DrawLatex(0.17,0.80,TString::Format("y=%.2fx^{2} +",p2));
-                gtex.DrawLatex(0.17,0.76,TString::Format("    %.2fx +",p1));
-                gtex.DrawLatex(0.17,0.72,TString::Format("      %.2f",p0));
+    ////////////////////////
+    // Plot the fits
+    if(drawFits) DrawEFTFits(fits);
+}
 
+//_____________________________________________________________________________
+// weighted least-squares fit of y = p0 + p1*x + p2*x^2, solving the normal equations
+void EFTProcessor::FitQuadratics(std::vector<EFTBinFit>* fits, const std::size_t first, const std::size_t last) {
+    for(std::size_t ifit = first; ifit < last; ++ifit){
+        EFTBinFit& fit = fits->at(ifit);
+        if(fit.isEmpty) continue;
+
+        // points without a valid uncertainty do not enter the fit, unless none of them has one
+        bool hasErrors = false;
+        for(std::size_t i = 0; i < fit.x.size(); ++i){
+            if(std::isfinite(fit.y[i]) && std::isfinite(fit.y_err[i]) && fit.y_err[i] > 0) hasErrors = true;
+        }
 
+        // sums of w*x^k and w*x^k*y
+        double s[5] = {0., 0., 0., 0., 0.};
+        double t[3] = {0., 0., 0.};
+        for(std::size_t i = 0; i < fit.x.size(); ++i){
+            if(!std::isfinite(fit.y[i])) continue;
+            double w = 1.;
+            if(hasErrors){
+                if(!std::isfinite(fit.y_err[i]) || fit.y_err[i] <= 0) continue;
+                w = 1./(fit.y_err[i]*fit.y_err[i]);
             }
+            double xk = w;
+            for(int k = 0; k < 5; ++k){
+                s[k] += xk;
+                if(k < 3) t[k] += xk*fit.y[i];
+                xk *= fit.x[i];
+            }
+        }
 
-            // Need this hack to get y-axis shown in a nice way
-            b1.cd(1);
-            gPad->Range(-10,-1,10,1);
-            TGaxis yaxis(10,(-1+2*bottom_margin),10,1.,0.8,1.1*max_rel_eft,512,"");
-            yaxis.SetTitle(TString::Format("#sigma(%s)/#sigma(SM)",fTitle.c_str()));
-            yaxis.SetTitleSize(0.08);
-            yaxis.SetLabelSize(0.07);
-            yaxis.Draw();
-
-            // Go back and fix all y-axis ranges to same value
-            for(int ip=2;ip<=SM_hist->GetNbinsX()+1;ip++){
-                b1.cd(ip);
-                TH1* tmp = static_cast<TH1*>(gPad->GetPrimitive("hframe"));
-                tmp->SetMaximum(1.1*max_rel_eft);
-                gPad->RedrawAxis();
+        // Gaussian elimination with partial pivoting on the 3x3 system
+        double a[3][4] = {{s[0], s[1], s[2], t[0]},
+                          {s[1], s[2], s[3], t[1]},
+                          {s[2], s[3], s[4], t[2]}};
+        double scale = 0.;
+        for(int i = 0; i < 3; ++i){
+            for(int j = 0; j < 3; ++j) scale = std::max(scale, std::abs(a[i][j]));
+        }
+        bool isSingular = !(scale > 0);
+        for(int col = 0; col < 3 && !isSingular; ++col){
+            int pivot = col;
+            for(int row = col+1; row < 3; ++row){
+                if(std::abs(a[row][col]) > std::abs(a[pivot][col])) pivot = row;
+            }
+            if(std::abs(a[pivot][col]) <= 1e-12*scale){
+                isSingular = true;
+                break;
             }
+            for(int j = 0; j < 4; ++j) std::swap(a[col][j], a[pivot][j]);
+            for(int row = 0; row < 3; ++row){
+                if(row == col) continue;
+                const double factor = a[row][col]/a[col][col];
+                for(int j = col; j < 4; ++j) a[row][j] -= factor*a[col][j];
+            }
+        }
+        if(isSingular) continue;
 
-            for(const auto& format : TRExFitter::IMAGEFORMAT) {
-                b1.SaveAs(TString::Format("%s/EFT/QuadFits_%s_%s_%s.%s",SM_sh->fFitName.c_str(),rname.c_str(),fName.c_str(),SMRef.c_str(),format.c_str()));
+        fit.p0 = a[0][3]/a[0][0];
+        fit.p1 = a[1][3]/a[1][1];
+        fit.p2 = a[2][3]/a[2][2];
+        fit.isFitted = true;
+    }
+}
+
+//_____________________________________________________________________________
+// draws the quadratic fits, one canvas per region and SM reference
+void EFTProcessor::DrawEFTFits(const std::vector<EFTBinFit>& fits) const {
+    std::size_t ifirst = 0;
+    while(ifirst < fits.size()){
+        // the bins of one region and SM reference are consecutive
+        std::size_t ilast = ifirst+1;
+        while(ilast < fits.size() && fits[ilast].region == fits[ifirst].region && fits[ilast].SMRef == fits[ifirst].SMRef) ++ilast;
+
+        const Region* reg = fits[ifirst].region;
+        const std::string rname = reg->fName;
+        const std::string SMRef = fits[ifirst].SMRef;
+        const int nBins = static_cast<int>(ilast-ifirst);
+
+        double max_rel_eft=-999;
+        double min_c=999;
+        double max_c=-999;
+        for(std::size_t ifit = ifirst; ifit < ilast; ++ifit){
+            if(fits[ifit].isEmpty) continue;
+            // the first point is the SM one
+            for(std::size_t i = 1; i < fits[ifit].x.size(); ++i){
+                if(fits[ifit].y[i] > max_rel_eft) max_rel_eft = fits[ifit].y[i];
+                if(fits[ifit].x[i] > max_c) max_c = fits[ifit].x[i];
+                if(fits[ifit].x[i] < min_c) min_c = fits[ifit].x[i];
             }
-        }// SM ref loop
-    }// region loop
+        }
 
-    NFTXTFile << "\n";
-    NFTXTFile.close();
+        double canv_x = std::min((nBins+1)*200,2000);
+        TCanvas b1("b1","b1",canv_x,400);
+        b1.Divide(nBins+1,1,0,0);
+
+        b1.cd(1);
+        // Global EFT param, Region and Sample labels
+        TLatex btex{};
+        btex.SetNDC();
+        btex.SetTextSize(20);
+        btex.DrawLatex(0.17,0.9,fTitle.c_str());
+        btex.DrawLatex(0.17,0.79,SMRef.c_str());
+        btex.DrawLatex(0.17,0.72,rname.c_str());
+
+        // Draw legend (need some dummy objects)
+        TH1D hleg("", "", 1, 0, 1);
+        hleg.SetLineColor(kRed);
+        hleg.SetLineWidth(2);
+        TGraph gleg{};
+        gleg.SetTitle("");
+        gleg.SetMarkerStyle(8);
+        gleg.SetMarkerSize(1);
+
+        TLegend bleg (0.1,0.2,0.9,0.5);
+        bleg.SetBorderSize(0);
+        bleg.SetTextSize(18);
+        bleg.AddEntry(&gleg,TString::Format("#frac{#sigma(%s)}{#sigma(SM)}",fTitle.c_str()),"p");
+        bleg.AddEntry(&hleg,"Fit","l");
+        bleg.Draw();
+
+        double bottom_margin=0.3;
+        const double xmin = min_c-(0.2*std::abs(min_c));
+        const double xmax = max_c+(0.2*std::abs(max_c));
+
+        // the pads keep pointers to the drawn objects until the canvas is saved
+        std::vector<std::unique_ptr<TGraphErrors> > graphs;
+        std::vector<std::unique_ptr<TF1> > functions;
+        std::vector<std::unique_ptr<TLatex> > texts;
+        for(std::size_t ifit = ifirst; ifit < ilast; ++ifit){
+            const EFTBinFit& fit = fits[ifit];
+            if(!fit.isFitted) continue;
+            const int b = fit.bin;
+            b1.cd(b+2);
+
+            //Plot graph
+            const std::vector<double> x_err(fit.x.size(), 0.);
+            graphs.emplace_back(new TGraphErrors(fit.x.size(), fit.x.data(), fit.y.data(), x_err.data(), fit.y_err.data()));
+            TGraphErrors* g = graphs.back().get();
+            g->SetTitle("");
+            g->SetMarkerStyle(8);
+            g->SetMarkerSize(1);
+
+            functions.emplace_back(new TF1(TString::Format("quad_%s_%s_%d",rname.c_str(),SMRef.c_str(),b),"pol2",xmin,xmax));
+            TF1* f = functions.back().get();
+            f->SetParameters(fit.p0,fit.p1,fit.p2);
+            f->SetLineColor(kRed);
+            f->SetLineWidth(2);
+
+            // Plot the fit for this bin
+            TH1 *frame = gPad->DrawFrame(xmin,0.8,xmax,1.1*max_rel_eft,TString::Format("frame%d",b+2));
+            frame->GetXaxis()->SetTitle(fTitle.c_str());
+            bottom_margin=gPad->GetBottomMargin();
+
+            g->Draw("P");
+            f->Draw("same");
+
+            // Also draw the fitted equation
+            texts.emplace_back(new TLatex());
+            TLatex* gtex = texts.back().get();
+            gtex->SetNDC();
+            gtex->SetTextSize(14);
+            gtex->DrawLatex(0.17,0.90,TString::Format(reg->fVariableTitle.c_str()));
+            gtex->DrawLatex(0.17,0.85,TString::Format("Bin%d",b));
+            gtex->SetTextSize(13);
+            gtex->DrawLatex(0.17,0.80,TString::Format("y=%.2fx^{2} +",fit.p2));
+            gtex->DrawLatex(0.17,0.76,TString::Format("    %.2fx +",fit.p1));
+            gtex->DrawLatex(0.17,0.72,TString::Format("      %.2f",fit.p0));
+        }
+
+        // Need this hack to get y-axis shown in a nice way
+        b1.cd(1);
+        gPad->Range(-10,-1,10,1);
+        TGaxis yaxis(10,(-1+2*bottom_margin),10,1.,0.8,1.1*max_rel_eft,512,"");
+        yaxis.SetTitle(TString::Format("#sigma(%s)/#sigma(SM)",fTitle.c_str()));
+        yaxis.SetTitleSize(0.08);
+        yaxis.SetLabelSize(0.07);
+        yaxis.Draw();
+
+        // Go back and fix all y-axis ranges to same value
+        for(int ip=2;ip<=nBins+1;ip++){
+            b1.cd(ip);
+            TH1* tmp = static_cast<TH1*>(gPad->GetPrimitive("hframe"));
+            if(!tmp) continue;
+            tmp->SetMaximum(1.1*max_rel_eft);
+            gPad->RedrawAxis();
+        }
+
+        for(const auto& format : TRExFitter::IMAGEFORMAT) {
+            b1.SaveAs(TString::Format("%s/EFT/QuadFits_%s_%s_%s.%s",fits[ifirst].fitName.c_str(),rname.c_str(),fName.c_str(),SMRef.c_str(),format.c_str()));
+        }
+
+        ifirst = ilast;
+    }
 }
 
 
@@ -23,10 +23,40 @@
 
 //c++ includes
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // layout of the binary file (native byte order):
+    //   magic, version, number of parameters, NLL
+    //   for each parameter: name length, name, value, up error, down error
+    //   padding to 8 bytes, then the dense row-major correlation matrix
+    constexpr char BINARYMAGIC[8] = {'T','R','E','x','F','I','T','R'};
+    constexpr std::uint32_t BINARYVERSION = 2;
+
+    template<typename T>
+    bool ReadValue(const char* data, const std::size_t size, std::size_t& offset, T& value) {
+        if (offset + sizeof(T) > size) return false;
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    void WriteValue(std::ofstream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
 //__________________________________________________________________________________
 //
 FitResults::FitResults() :
@@ -210,6 +240,182 @@ void FitResults::ReadFromTXT(const std::string& fileName, const std::vector<std:
     WriteDebugStatus("FitResults::ReadFromTXT", "Negative Log-Likelihood value NLL = " + std::to_string(fNLL));
 }
 
+//__________________________________________________________________________________
+//
+void FitResults::ReadFromFile(const std::string& fileName, const std::vector<std::string>& blinded, const bool useBinary){
+    if (!useBinary) {
+        ReadFromTXT(fileName, blinded);
+        return;
+    }
+    const std::string binName = GetBinaryFileName(fileName);
+    struct stat txtStat;
+    struct stat binStat;
+    const bool hasTxt = (stat(fileName.c_str(), &txtStat) == 0);
+    const bool hasBin = (stat(binName.c_str(), &binStat) == 0);
+    if (hasBin && (!hasTxt || binStat.st_mtime >= txtStat.st_mtime)) {
+        if (ReadFromBinary(binName, blinded)) return;
+        WriteWarningStatus("FitResults::ReadFromFile", "Could not read the binary fit results \"" + binName + "\", reading the text file instead");
+    }
+    ReadFromTXT(fileName, blinded);
+}
+
+//__________________________________________________________________________________
+//
+bool FitResults::ReadFromBinary(const std::string& fileName, const std::vector<std::string>& blinded){
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        WriteWarningStatus("FitResults::ReadFromBinary","Could not open the file \"" + fileName + "\"");
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    const std::size_t size = fileStat.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        WriteWarningStatus("FitResults::ReadFromBinary","Could not map the file \"" + fileName + "\"");
+        return false;
+    }
+    // the mapping lives as long as the correlation matrix using it
+    std::shared_ptr<const void> mapping(address, [size](const void* p){ munmap(const_cast<void*>(p), size); });
+    const char* data = static_cast<const char*>(address);
+
+    std::size_t offset = 0;
+    char magic[sizeof(BINARYMAGIC)];
+    std::uint32_t version = 0;
+    std::uint32_t nPars = 0;
+    double nll = 0;
+    if (!ReadValue(data, size, offset, magic) || std::memcmp(magic, BINARYMAGIC, sizeof(BINARYMAGIC)) != 0 ||
+        !ReadValue(data, size, offset, version) || version != BINARYVERSION ||
+        !ReadValue(data, size, offset, nPars) ||
+        !ReadValue(data, size, offset, nll)) {
+        WriteWarningStatus("FitResults::ReadFromBinary","The file \"" + fileName + "\" is not a valid binary fit result");
+        return false;
+    }
+
+    std::vector<std::string> names(nPars);
+    std::vector<double> values(nPars);
+    std::vector<double> up(nPars);
+    std::vector<double> down(nPars);
+    for (std::uint32_t i = 0; i < nPars; ++i) {
+        std::uint32_t length = 0;
+        if (!ReadValue(data, size, offset, length) || offset + length > size) return false;
+        names[i].assign(data + offset, length);
+        offset += length;
+        std::uint8_t isBlinded = 0;
+        if (!ReadValue(data, size, offset, isBlinded)) return false;
+        if (isBlinded) {
+            std::uint32_t hexLength = 0;
+            if (!ReadValue(data, size, offset, hexLength) || offset + hexLength > size) return false;
+            values[i] = Common::HexToDouble(std::string(data + offset, hexLength));
+            offset += hexLength;
+        } else if (!ReadValue(data, size, offset, values[i])) {
+            return false;
+        }
+        if (!ReadValue(data, size, offset, up[i]) ||
+            !ReadValue(data, size, offset, down[i])) return false;
+    }
+    offset = (offset + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+    if (offset + static_cast<std::size_t>(nPars)*nPars*sizeof(double) > size) {
+        WriteWarningStatus("FitResults::ReadFromBinary","The file \"" + fileName + "\" is truncated");
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < nPars; ++i) {
+        // clean the syst name, as for the text file
+        std::string name = names[i];
+        while(name.find("\\")!=std::string::npos) name = name.replace(name.find("\\"),1,"");
+        name = Common::ReplaceString(name,"alpha_","");
+        name = Common::ReplaceString(name,"gamma_","");
+        AddNuisPar(new NuisParameter(name));
+        NuisParameter *np = fNuisPar[fNuisParIdx[name]].get();
+        np->fFitValue = values[i];
+        np->fPostFitUp = up[i];
+        np->fPostFitDown = down[i];
+        if (std::find(blinded.begin(), blinded.end(), name) == blinded.end()) {
+            WriteVerboseStatus("FitResults::ReadFromBinary", name + ": " + std::to_string(values[i]) + " +" + std::to_string(up[i]) + " " + std::to_string(down[i]));
+        }
+    }
+
+    std::unique_ptr<CorrelationMatrix> matrix(new CorrelationMatrix());
+    for(const auto& npName : fNuisParNames) matrix->AddNuisPar(npName);
+    matrix->SetExternalMatrix(reinterpret_cast<const double*>(data + offset), nPars, mapping);
+    fCorrMatrix = std::move(matrix);
+    fNLL = nll;
+
+    WriteDebugStatus("FitResults::ReadFromBinary", "Found " + std::to_string(nPars) + " systematics.");
+    WriteDebugStatus("FitResults::ReadFromBinary", "Negative Log-Likelihood value NLL = " + std::to_string(fNLL));
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+bool FitResults::WriteBinary(const std::string& fileName,
+                             const std::vector<std::string>& names,
+                             const std::vector<double>& values,
+                             const std::vector<double>& up,
+                             const std::vector<double>& down,
+                             const std::vector<double>& corr,
+                             const double nll,
+                             const std::vector<std::string>& blinded){
+    const std::size_t nPars = names.size();
+    if (values.size() != nPars || up.size() != nPars || down.size() != nPars || corr.size() != nPars*nPars) {
+        WriteWarningStatus("FitResults::WriteBinary","Inconsistent inputs, not writing \"" + fileName + "\"");
+        return false;
+    }
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        WriteWarningStatus("FitResults::WriteBinary","Could not open the file \"" + fileName + "\"");
+        return false;
+    }
+
+    out.write(BINARYMAGIC, sizeof(BINARYMAGIC));
+    WriteValue(out, BINARYVERSION);
+    WriteValue(out, static_cast<std::uint32_t>(nPars));
+    WriteValue(out, nll);
+    std::size_t offset = sizeof(BINARYMAGIC) + 2*sizeof(std::uint32_t) + sizeof(double);
+    for (std::size_t i = 0; i < nPars; ++i) {
+        WriteValue(out, static_cast<std::uint32_t>(names[i].size()));
+        out.write(names[i].data(), names[i].size());
+        offset += sizeof(std::uint32_t) + names[i].size();
+        // the values of the blinded parameters are only stored obfuscated, as in the text file
+        const bool isBlinded = std::find(blinded.begin(), blinded.end(), names[i]) != blinded.end();
+        WriteValue(out, static_cast<std::uint8_t>(isBlinded));
+        offset += sizeof(std::uint8_t);
+        if (isBlinded) {
+            const std::string hex = Common::DoubleToPseudoHex(values[i]);
+            WriteValue(out, static_cast<std::uint32_t>(hex.size()));
+            out.write(hex.data(), hex.size());
+            offset += sizeof(std::uint32_t) + hex.size();
+        } else {
+            WriteValue(out, values[i]);
+            offset += sizeof(double);
+        }
+        WriteValue(out, up[i]);
+        WriteValue(out, down[i]);
+        offset += 2*sizeof(double);
+    }
+    // align the matrix so that it can be used directly from the mapped file
+    static const char padding[sizeof(double)] = {0};
+    out.write(padding, (sizeof(double) - offset % sizeof(double)) % sizeof(double));
+    out.write(reinterpret_cast<const char*>(corr.data()), corr.size()*sizeof(double));
+
+    return out.good();
+}
+
+//__________________________________________________________________________________
+//
+std::string FitResults::GetBinaryFileName(const std::string& fileName){
+    static const std::string ext = ".txt";
+    if (fileName.size() >= ext.size() && fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0) {
+        return fileName.substr(0, fileName.size() - ext.size()) + ".fitres";
+    }
+    return fileName + ".fitres";
+}
+
 //__________________________________________________________________________________
 //
 void FitResults::DrawNormFactors( const std::string &path,
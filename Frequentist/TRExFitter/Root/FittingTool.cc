@@ -3,6 +3,7 @@
 
 //Framework includes
 #include "TRExFitter/Common.h"
+#include "TRExFitter/FitResults.h"
 #include "TRExFitter/FitUtils.h"
 #include "TRExFitter/StatusLogbook.h"
 #include "TRExFitter/YamlConverter.h"
@@ -12,6 +13,8 @@
 #include "TH2.h"
 #include "TRandom3.h"
 #include "TFile.h"
+#include "TMatrixDSym.h"
+#include "TSystem.h"
 
 //Roostats includes
 #include "Math/MinimizerOptions.h"
@@ -27,6 +30,7 @@
 
 //c++ includes
 #include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -38,6 +42,7 @@ using namespace std;
 FittingTool::FittingTool():
     m_CPU(1),
     m_useMinos(false),
+    m_minosWorkers(1),
     m_constPOI(false),
     m_fitResult(nullptr),
     m_noGammas(false),
@@ -392,10 +397,14 @@ double FittingTool::FitPDF( RooStats::ModelConfig* model, RooAbsPdf* fitpdf, Roo
                     }
                     if (!isthere) SliceNPs->remove(*var, true, true);
                 }
-                minim.minos(*SliceNPs);
+                if (!RunParallelMinos(&minim, *SliceNPs)) {
+                    minim.minos(*SliceNPs);
+                }
             }
             else {
-                minim.minos();
+                if (!RunParallelMinos(&minim, *SliceNPs)) {
+                    minim.minos();
+                }
             }
         }
     }//end useMinos
@@ -438,6 +447,89 @@ double FittingTool::FitPDF( RooStats::ModelConfig* model, RooAbsPdf* fitpdf, Roo
     return nllval;
 }
 
+//____________________________________________________________________________________
+//
+bool FittingTool::RunParallelMinos(RooMinimizer* minim, const RooArgSet& params) const {
+    if (m_minosWorkers < 2) return false;
+    if (m_CPU > 1) {
+        WriteWarningStatus("FittingTool::RunParallelMinos", "Parallel MINOS cannot be combined with NumCPU > 1, running MINOS sequentially");
+        return false;
+    }
+
+    std::vector<RooRealVar*> vars;
+    for (auto var_tmp : params) {
+        RooRealVar* var = dynamic_cast<RooRealVar*>(var_tmp);
+        if (!var || var->isConstant()) continue;
+        vars.emplace_back(var);
+    }
+    if (vars.size() < 2) return false;
+
+    const std::size_t nWorkers = std::min(static_cast<std::size_t>(m_minosWorkers), vars.size());
+    WriteInfoStatus("FittingTool::RunParallelMinos", "Running MINOS for " + std::to_string(vars.size()) + " parameters using " + std::to_string(nWorkers) + " workers");
+
+    std::vector<std::string> files;
+    for (std::size_t iworker = 0; iworker < nWorkers; ++iworker) {
+        TString fileName("TRExFitterMinos");
+        FILE* tmp = gSystem->TempFileName(fileName);
+        if (!tmp) {
+            WriteWarningStatus("FittingTool::RunParallelMinos", "Cannot create temporary file, running MINOS sequentially");
+            for (const auto& file : files) std::remove(file.c_str());
+            return false;
+        }
+        fclose(tmp);
+        files.emplace_back(fileName.Data());
+    }
+
+    // every worker starts from the same minimum
+    const bool success = Common::RunInWorkers(nWorkers, [&](const std::size_t iworker){
+        RooArgSet workerSet;
+        for (std::size_t ivar = iworker; ivar < vars.size(); ivar += nWorkers) {
+            workerSet.add(*vars.at(ivar));
+        }
+        minim->minos(workerSet);
+        std::ofstream out(files.at(iworker));
+        out << std::setprecision(17);
+        for (std::size_t ivar = iworker; ivar < vars.size(); ivar += nWorkers) {
+            const RooRealVar* var = vars.at(ivar);
+            if (!var->hasAsymError()) continue;
+            out << var->GetName() << " " << var->getAsymErrorLo() << " " << var->getAsymErrorHi() << "\n";
+        }
+        out.close();
+        return !out.fail();
+    });
+
+    std::map<std::string, std::pair<double, double> > errors;
+    for (const auto& file : files) {
+        if (success) {
+            std::ifstream in(file);
+            std::string name;
+            double lo;
+            double hi;
+            while (in >> name >> lo >> hi) {
+                errors[name] = std::make_pair(lo, hi);
+            }
+        }
+        std::remove(file.c_str());
+    }
+
+    if (!success) {
+        WriteWarningStatus("FittingTool::RunParallelMinos", "One of the MINOS workers failed, running MINOS sequentially");
+        return false;
+    }
+
+    // only the asymmetric errors are taken from the workers, the minimum stays the one of the nominal fit
+    for (auto var : vars) {
+        auto it = errors.find(var->GetName());
+        if (it == errors.end()) {
+            WriteWarningStatus("FittingTool::RunParallelMinos", "No MINOS error found for " + std::string(var->GetName()));
+            continue;
+        }
+        var->setAsymError(it->second.first, it->second.second);
+    }
+
+    return true;
+}
+
 //____________________________________________________________________________________
 //
 void FittingTool::SaveFitResult( const std::string &fileName )
@@ -527,6 +619,29 @@ void FittingTool::ExportFitResultInTextFile( const std::string &fileName, const
     //
     nuisParAndCorr << "\n";
     nuisParAndCorr.close();
+
+    //
+    // Same content in the binary format, faster to read back for large fits
+    //
+    const RooArgList& floatPars = m_fitResult->floatParsFinal();
+    const TMatrixDSym& corrMatrix = m_fitResult->correlationMatrix();
+    const int nPars = floatPars.getSize();
+    std::vector<std::string> names;
+    std::vector<double> values;
+    std::vector<double> up;
+    std::vector<double> down;
+    std::vector<double> corr(static_cast<std::size_t>(nPars)*nPars);
+    for (int i = 0; i < nPars; ++i) {
+        const RooRealVar* var = static_cast<const RooRealVar*>(floatPars.at(i));
+        names.emplace_back(Common::ReplaceString(var->GetName(),"alpha_",""));
+        values.emplace_back(var->getVal());
+        up.emplace_back(std::fabs(var->getErrorHi()));
+        down.emplace_back(-std::fabs(var->getErrorLo()));
+        for (int j = 0; j < nPars; ++j) {
+            corr[static_cast<std::size_t>(i)*nPars+j] = corrMatrix(i,j);
+        }
+    }
+    FitResults::WriteBinary(FitResults::GetBinaryFileName(fileName), names, values, up, down, corr, m_minNll, blinded);
 }
 
 //____________________________________________________________________________________
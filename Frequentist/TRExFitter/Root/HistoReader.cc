@@ -387,7 +387,7 @@ void HistoReader::ReadTRExProducedHistograms() {
             //
             // eventually skip sample / region combination
             //
-            if(Common::FindInStringVector(isample->fRegions,regionName)<0 && isample->fName.find("customAsimov_")==std::string::npos ) continue;
+            if(!fFitter->fMembershipIndex.SampleInRegion(isample.get(),fFitter->fRegions[i_ch]) && isample->fName.find("customAsimov_")==std::string::npos ) continue;
             //
             const std::string sampleName = isample->fName;
             WriteDebugStatus("HistoReader::ReadTRExProducedHistograms", "    Reading sample " + sampleName);
@@ -435,8 +435,7 @@ void HistoReader::ReadTRExProducedHistograms() {
             for(const auto& inorm : isample->fNormFactors) {
                 //
                 // eventually skip norm factor / region combination
-                if(inorm->fRegions.size()>0 && Common::FindInStringVector(inorm->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if(inorm->fExclude.size()>0 && Common::FindInStringVector(inorm->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
+                if(!fFitter->fMembershipIndex.NormFactorInRegion(inorm.get(),fFitter->fRegions[i_ch]) ) continue;
                 //
                 const std::string normName = inorm->fName;
                 WriteDebugStatus("HistoReader::ReadTRExProducedHistograms", "      Reading norm " + normName);
@@ -448,8 +447,7 @@ void HistoReader::ReadTRExProducedHistograms() {
             for(const auto& ishape : isample->fShapeFactors) {
                 //
                 // eventually skip shape factor / region combination
-                if(ishape->fRegions.size()>0 && Common::FindInStringVector(ishape->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if(ishape->fExclude.size()>0 && Common::FindInStringVector(ishape->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
+                if(!fFitter->fMembershipIndex.ShapeFactorInRegion(ishape.get(),fFitter->fRegions[i_ch]) ) continue;
                 //
                 const std::string shapeName = ishape->fName;
                 WriteDebugStatus("HistoReader::ReadTRExProducedHistograms", "      Reading shape " + shapeName);
@@ -461,9 +459,7 @@ void HistoReader::ReadTRExProducedHistograms() {
             for(std::size_t i_syst = 0; i_syst< isample->fSystematics.size(); ++i_syst) {
                 //
                 // eventually skip systematic / region combination
-                if(isample->fSystematics[i_syst]->fRegions.size()>0 && Common::FindInStringVector(isample->fSystematics[i_syst]->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if(isample->fSystematics[i_syst]->fExclude.size()>0 && Common::FindInStringVector(isample->fSystematics[i_syst]->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
-                if(isample->fSystematics[i_syst]->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(isample->fSystematics[i_syst]->fExcludeRegionSample,fFitter->fRegions[i_ch]->fName, isample->fName)>=0 ) continue;
+                if(!fFitter->fMembershipIndex.SystematicInRegion(isample->fSystematics[i_syst].get(),fFitter->fRegions[i_ch],isample.get()) ) continue;
                 //
                 const std::string systName       = isample->fSystematics[i_syst]->fName;
                 const std::string systStoredName = isample->fSystematics[i_syst]->fStoredName; // if no StoredName specified in the config, this should be == fName
@@ -582,7 +578,7 @@ void HistoReader::ReadOneRegion(const int i_ch, const bool is_data) {
         //
         // eventually skip sample / region combination
         //
-        if(Common::FindInStringVector(ismp->fRegions,fFitter->fRegions[i_ch]->fName)<0) continue;
+        if(!fFitter->fMembershipIndex.SampleInRegion(ismp.get(),fFitter->fRegions[i_ch])) continue;
         //
         // read nominal
         //
@@ -619,14 +615,7 @@ void HistoReader::ReadOneRegion(const int i_ch, const bool is_data) {
                 (!syst->fSubtractRefSampleVar || syst->fReferenceSample != ismp->fName)) continue;
 
             // eventually skip systematic / region combination
-            if(syst->fRegions.size()>0 && 
-               Common::FindInStringVector(syst->fRegions,fFitter->fRegions[i_ch]->fName)<0 ) continue;
-            if(syst->fExclude.size()>0 &&
-               Common::FindInStringVector(syst->fExclude,fFitter->fRegions[i_ch]->fName)>=0) continue;
-            if(syst->fExcludeRegionSample.size()>0 &&
-                Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,
-                                                    fFitter->fRegions[i_ch]->fName,
-                                                    ismp->fName)>=0) continue;
+            if(!fFitter->fMembershipIndex.SystematicInRegion(syst,fFitter->fRegions[i_ch],ismp.get())) continue;
             
             WriteDebugStatus("HistoReader::ReadHistograms", "Adding syst " + syst->fName);
             
@@ -665,8 +654,7 @@ void HistoReader::ReadNormShape(SampleHist* sh,
     // read norm factors
     for(const auto& inorm : smp->fNormFactors) {
         // eventually skip systematic / region combination
-        if(inorm->fRegions.size()>0 && Common::FindInStringVector(inorm->fRegions,fFitter->fRegions[i_ch]->fName)<0) continue;
-        if(inorm->fExclude.size()>0 && Common::FindInStringVector(inorm->fExclude,fFitter->fRegions[i_ch]->fName)>=0) continue;
+        if(!fFitter->fMembershipIndex.NormFactorInRegion(inorm.get(),fFitter->fRegions[i_ch])) continue;
 
         WriteDebugStatus("HistoReader::ReadNormShape", "Adding norm " + inorm->fName);
 
@@ -677,8 +665,7 @@ void HistoReader::ReadNormShape(SampleHist* sh,
     for(const auto& ishape : smp->fShapeFactors) {
 
         // eventually skip systematic / region combination
-        if(ishape->fRegions.size()>0 && Common::FindInStringVector(ishape->fRegions,fFitter->fRegions[i_ch]->fName)<0) continue;
-        if(ishape->fExclude.size()>0 && Common::FindInStringVector(ishape->fExclude,fFitter->fRegions[i_ch]->fName)>=0) continue;
+        if(!fFitter->fMembershipIndex.ShapeFactorInRegion(ishape.get(),fFitter->fRegions[i_ch])) continue;
 
         WriteDebugStatus("HistoReader::ReadNormShape", "Adding shape " + ishape->fName);
 
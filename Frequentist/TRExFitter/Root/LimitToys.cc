@@ -1,4 +1,5 @@
 #include "TRExFitter/LimitToys.h"
+#include "TRExFitter/BinnedToyMCSampler.h"
 #include "TRExFitter/Common.h"
 #include "TRExFitter/StatusLogbook.h"
 
@@ -19,8 +20,11 @@
 
 #include "RooStats/SamplingDistPlot.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <memory>
+#include <utility>
 
 LimitToys::LimitToys() :
     fNtoysSplusB(1000),
@@ -32,7 +36,9 @@ LimitToys::LimitToys() :
     fToysSeed(1234),
     fPlot(true),
     fFile(true),
-    fOutputPath("")
+    fOutputPath(""),
+    fNWorkers(1),
+    fNativeGenerator(false)
 {    
 }
 
@@ -46,42 +52,40 @@ void LimitToys::RunToys(RooAbsData* data,
         return;
     }
 
-    RooRandom::randomGenerator()->SetSeed(fToysSeed);
-
     RooRealVar* poi = static_cast<RooRealVar*>(mcB->GetParametersOfInterest()->first());
     mcB->SetSnapshot(*poi);
 
-    RooStats::FrequentistCalculator freqCalc(*data, *mcB, *mcSplusb);
-    
-    std::unique_ptr<RooStats::ProfileLikelihoodTestStat> plr = std::make_unique<RooStats::ProfileLikelihoodTestStat>(*mcSplusb->GetPdf());
-    plr->SetOneSided(true);
+    std::unique_ptr<RooStats::HypoTestInverterResult> result(nullptr);
+    if (fNWorkers > 1) {
+        result = RunParallel(data, mcSplusb, mcB);
+        if (!result) {
+            WriteErrorStatus("LimitToys::RunToys", "Parallel toys for limits failed!");
+            return;
+        }
+    } else {
+        RooRandom::randomGenerator()->SetSeed(fToysSeed);
 
-    const RooArgSet* glbObs = mcSplusb->GetGlobalObservables();
-    RooStats::ToyMCSampler *toymcs = static_cast<RooStats::ToyMCSampler*>(freqCalc.GetTestStatSampler());
-    if (glbObs) {
-        toymcs->SetGlobalObservables(*glbObs);
-    }
-    toymcs->SetTestStatistic(plr.get());
+        std::unique_ptr<RooStats::ProfileLikelihoodTestStat> plr = std::make_unique<RooStats::ProfileLikelihoodTestStat>(*mcSplusb->GetPdf());
+        std::unique_ptr<RooStats::ToyMCSampler> sampler = CreateSampler(plr.get());
+        RooStats::FrequentistCalculator freqCalc(*data, *mcB, *mcSplusb, sampler.get());
+        ConfigureCalculator(&freqCalc, plr.get(), mcSplusb);
 
-    if (!mcSplusb->GetPdf()->canBeExtended()) {
-        toymcs->SetNEventsPerToy(1);
-    }
+        freqCalc.SetToys(fNtoysSplusB, fNtoysB);
 
-    freqCalc.SetToys(fNtoysSplusB, fNtoysB);
+        RooStats::HypoTestInverter inverter(freqCalc);
+        inverter.SetConfidenceLevel(fLimit);
+        inverter.UseCLs(true);
+        inverter.SetVerbose(false);
+        inverter.SetFixedScan(fScanSteps,fScanMin,fScanMax);
 
-    RooStats::HypoTestInverter inverter(freqCalc);
-    inverter.SetConfidenceLevel(fLimit);
-    inverter.UseCLs(true);
-    inverter.SetVerbose(false);
-    inverter.SetFixedScan(fScanSteps,fScanMin,fScanMax);
-    
-    WriteInfoStatus("LimitToys::RunToys","Running " + std::to_string(fNtoysSplusB) + "/" + std::to_string(fNtoysB) + " toys for limits.");
-    RooStats::HypoTestInverterResult* result = inverter.GetInterval();
+        WriteInfoStatus("LimitToys::RunToys","Running " + std::to_string(fNtoysSplusB) + "/" + std::to_string(fNtoysB) + " toys for limits.");
+        result.reset(inverter.GetInterval());
+    }
 
     WriteInfoStatus("LimitToys::RunToys", "----------------------------------------------------");
     WriteInfoStatus("LimitToys::RunToys", "Results of the toys for limits");
     WriteInfoStatus("LimitToys::RunToys", "----------------------------------------------------");
-    WriteInfoStatus("LimitToys::RunToys",std::to_string(100*inverter.ConfidenceLevel()) + "%  upper limit : " + std::to_string(result->UpperLimit()));
+    WriteInfoStatus("LimitToys::RunToys",std::to_string(100*result->ConfidenceLevel()) + "%  upper limit : " + std::to_string(result->UpperLimit()));
     WriteInfoStatus("LimitToys::RunToys","Expected upper limits, using the B (alternate) model : ");
     WriteInfoStatus("LimitToys::RunToys"," expected limit (median) " + std::to_string(result->GetExpectedUpperLimit(0)));
     WriteInfoStatus("LimitToys::RunToys"," expected limit (-1 sig) " + std::to_string(result->GetExpectedUpperLimit(-1)));
@@ -93,7 +97,7 @@ void LimitToys::RunToys(RooAbsData* data,
     if (fPlot) {
         WriteInfoStatus("LimitToys::RunToys", "Printing output plot to " + fOutputPath);
         TCanvas c{};
-        auto plot = std::make_unique<RooStats::HypoTestInverterPlot>("HTI_Result_Plot","Limits from toys",result);
+        auto plot = std::make_unique<RooStats::HypoTestInverterPlot>("HTI_Result_Plot","Limits from toys",result.get());
         plot->Draw("CLb 2CL");
         c.Draw();
         for(const auto& format : TRExFitter::IMAGEFORMAT) {
@@ -121,8 +125,150 @@ void LimitToys::RunToys(RooAbsData* data,
     }
 
     if (fFile) {
-        RootOutput(result);
+        RootOutput(result.get());
+    }
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooStats::ToyMCSampler> LimitToys::CreateSampler(RooStats::ProfileLikelihoodTestStat* plr) const {
+    if (fNativeGenerator) {
+        return std::make_unique<BinnedToyMCSampler>(*plr, fNtoysSplusB);
+    }
+    return std::make_unique<RooStats::ToyMCSampler>(*plr, fNtoysSplusB);
+}
+
+//__________________________________________________________________________________
+//
+void LimitToys::ConfigureCalculator(RooStats::FrequentistCalculator* calc,
+                                    RooStats::ProfileLikelihoodTestStat* plr,
+                                    RooStats::ModelConfig* mcSplusb) const {
+    plr->SetOneSided(true);
+
+    const RooArgSet* glbObs = mcSplusb->GetGlobalObservables();
+    RooStats::ToyMCSampler *toymcs = static_cast<RooStats::ToyMCSampler*>(calc->GetTestStatSampler());
+    if (glbObs) {
+        toymcs->SetGlobalObservables(*glbObs);
+    }
+    toymcs->SetTestStatistic(plr);
+
+    if (!mcSplusb->GetPdf()->canBeExtended()) {
+        toymcs->SetNEventsPerToy(1);
+    }
+}
+
+//__________________________________________________________________________________
+//
+std::vector<LimitToys::ScanTask> LimitToys::MakeScanTasks() const {
+    std::vector<ScanTask> tasks;
+    if (fScanSteps < 1) return tasks;
+
+    // split the toys of each point into batches when there are fewer points than workers
+    const int nBatches = std::max(1, std::min((fNWorkers + fScanSteps - 1)/fScanSteps, std::min(fNtoysSplusB, fNtoysB)));
+
+    for (int istep = 0; istep < fScanSteps; ++istep) {
+        const double x = fScanSteps > 1 ? fScanMin + istep*(fScanMax - fScanMin)/(fScanSteps - 1) : fScanMin;
+        for (int ibatch = 0; ibatch < nBatches; ++ibatch) {
+            ScanTask task;
+            task.x = x;
+            task.nSplusB = fNtoysSplusB/nBatches + (ibatch < fNtoysSplusB % nBatches ? 1 : 0);
+            task.nB = fNtoysB/nBatches + (ibatch < fNtoysB % nBatches ? 1 : 0);
+            task.seed = fToysSeed + static_cast<int>(tasks.size()) + 1;
+            tasks.emplace_back(task);
+        }
+    }
+
+    return tasks;
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooStats::HypoTestInverterResult> LimitToys::RunTasks(RooAbsData* data,
+                                                                      RooStats::ModelConfig* mcSplusb,
+                                                                      RooStats::ModelConfig* mcB,
+                                                                      const std::vector<ScanTask>& tasks) const {
+    std::unique_ptr<RooStats::ProfileLikelihoodTestStat> plr = std::make_unique<RooStats::ProfileLikelihoodTestStat>(*mcSplusb->GetPdf());
+    std::unique_ptr<RooStats::ToyMCSampler> sampler = CreateSampler(plr.get());
+    RooStats::FrequentistCalculator freqCalc(*data, *mcB, *mcSplusb, sampler.get());
+    ConfigureCalculator(&freqCalc, plr.get(), mcSplusb);
+
+    RooStats::HypoTestInverter inverter(freqCalc);
+    inverter.SetConfidenceLevel(fLimit);
+    inverter.UseCLs(true);
+    inverter.SetVerbose(false);
+
+    for (const auto& task : tasks) {
+        // every batch has its own random stream, independent of the worker running it
+        RooRandom::randomGenerator()->SetSeed(task.seed);
+        freqCalc.SetToys(task.nSplusB, task.nB);
+        // results for the same point are appended by the inverter
+        if (!inverter.RunOnePoint(task.x)) {
+            WriteErrorStatus("LimitToys::RunTasks", "Failed to run toys at POI = " + std::to_string(task.x));
+            return nullptr;
+        }
+    }
+
+    return std::unique_ptr<RooStats::HypoTestInverterResult>(inverter.GetInterval());
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooStats::HypoTestInverterResult> LimitToys::RunParallel(RooAbsData* data,
+                                                                         RooStats::ModelConfig* mcSplusb,
+                                                                         RooStats::ModelConfig* mcB) const {
+    const std::vector<ScanTask> tasks = MakeScanTasks();
+    if (tasks.empty()) {
+        WriteErrorStatus("LimitToys::RunParallel", "No scan points to process!");
+        return nullptr;
+    }
+    const int nWorkers = std::min(fNWorkers, static_cast<int>(tasks.size()));
+
+    WriteInfoStatus("LimitToys::RunParallel", "Running " + std::to_string(fNtoysSplusB) + "/" + std::to_string(fNtoysB) +
+        " toys for limits in " + std::to_string(tasks.size()) + " batches using " + std::to_string(nWorkers) + " workers.");
+
+    // the workers write their partial results to disk
+    std::vector<std::string> partialFiles;
+    for (int iworker = 0; iworker < nWorkers; ++iworker) {
+        partialFiles.emplace_back(fOutputPath + "/LimitToys_worker" + std::to_string(iworker) + ".root");
+    }
+    bool success = Common::RunInWorkers(nWorkers, [&](const std::size_t iworker){
+        // contiguous blocks keep the merged points ordered in the scan variable
+        const std::size_t first = (tasks.size()*iworker)/nWorkers;
+        const std::size_t last = (tasks.size()*(iworker+1))/nWorkers;
+        const std::vector<ScanTask> workerTasks(tasks.begin() + first, tasks.begin() + last);
+        std::unique_ptr<RooStats::HypoTestInverterResult> partial = RunTasks(data, mcSplusb, mcB, workerTasks);
+        if (!partial) return false;
+        std::unique_ptr<TFile> file(TFile::Open(partialFiles.at(iworker).c_str(), "RECREATE"));
+        if (!file || file->IsZombie()) return false;
+        partial->Write("result");
+        file->Close();
+        return true;
+    });
+    if (!success) {
+        WriteErrorStatus("LimitToys::RunParallel", "One of the workers failed!");
+    }
+
+    std::unique_ptr<RooStats::HypoTestInverterResult> result(nullptr);
+    for (const auto& partialFile : partialFiles) {
+        if (success) {
+            std::unique_ptr<TFile> file(TFile::Open(partialFile.c_str(), "READ"));
+            std::unique_ptr<RooStats::HypoTestInverterResult> partial(file ? dynamic_cast<RooStats::HypoTestInverterResult*>(file->Get("result")) : nullptr);
+            if (!partial) {
+                WriteErrorStatus("LimitToys::RunParallel", "Cannot read partial result from: " + partialFile);
+                success = false;
+            } else if (!result) {
+                result = std::move(partial);
+            } else {
+                result->Add(*partial);
+            }
+            if (file) file->Close();
+        }
+        std::remove(partialFile.c_str());
     }
+
+    if (!success) return nullptr;
+
+    return result;
 }
 
 void LimitToys::RootOutput(RooStats::HypoTestInverterResult* result) const {
@@ -0,0 +1,12 @@
+#include "TRExFitter/RooResponseMatrixFunc.h"
+
+#ifdef __CINT__
+
+#pragma link off all globals;
+#pragma link off all classes;
+#pragma link off all functions;
+#pragma link C++ nestedclass;
+
+#pragma link C++ class RooResponseMatrixFunc+;
+
+#endif
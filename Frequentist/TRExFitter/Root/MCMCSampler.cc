@@ -0,0 +1,516 @@
+#include "TRExFitter/MCMCSampler.h"
+
+#include "TRExFitter/Common.h"
+#include "TRExFitter/StatusLogbook.h"
+
+#include "RooAbsPdf.h"
+#include "RooAbsReal.h"
+#include "RooArgSet.h"
+#include "RooDataSet.h"
+#include "RooGlobalFunc.h"
+#include "RooRealVar.h"
+#include "RooWorkspace.h"
+#include "RooStats/ModelConfig.h"
+#include "TFile.h"
+#include "TRandom3.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace {
+    // number of burn-in steps between two updates of the proposal
+    constexpr int ADAPTINTERVAL = 100;
+    // maximum number of attempts to draw a starting point inside the parameter ranges
+    constexpr int MAXTRIES = 1000;
+    // relative regularisation of the adapted covariance
+    constexpr double COVEPSILON = 1e-6;
+
+    std::size_t TriangleIndex(const std::size_t i, const std::size_t j) {
+        return i*(i+1)/2 + j;
+    }
+
+    double Quantile(const std::vector<double>& sorted, const double q) {
+        if (sorted.empty()) return 0;
+        const double pos = q*(sorted.size() - 1);
+        const std::size_t low = static_cast<std::size_t>(pos);
+        const std::size_t high = std::min(low + 1, sorted.size() - 1);
+        return sorted.at(low) + (pos - low)*(sorted.at(high) - sorted.at(low));
+    }
+}
+
+//__________________________________________________________________________________
+//
+MCMCSampler::MCMCSampler(RooWorkspace* ws, RooDataSet* data) :
+    fWs(ws),
+    fData(data),
+    fNChains(4),
+    fNSteps(10000),
+    fNBurnIn(2000),
+    fSeed(1234),
+    fNWorkers(1)
+{
+    if (!fWs || !fData) return;
+    RooStats::ModelConfig* mc = dynamic_cast<RooStats::ModelConfig*>(fWs->obj("ModelConfig"));
+    if (!mc) return;
+
+    const RooArgSet* globs = mc->GetGlobalObservables();
+    std::unique_ptr<RooArgSet> params(mc->GetPdf()->getParameters(*fData));
+    for (const auto iparam : *params) {
+        RooRealVar* var = dynamic_cast<RooRealVar*>(iparam);
+        if (!var || var->isConstant()) continue;
+        if (globs && globs->find(*var)) continue;
+
+        // the post-fit uncertainty is the initial proposal width
+        double width = var->getError();
+        if (!(width > 0) || !std::isfinite(width)) {
+            width = (var->hasMin() && var->hasMax()) ? 0.01*(var->getMax() - var->getMin()) : 0.1;
+        }
+        fParameters.emplace_back(var);
+        fStart.emplace_back(var->getVal());
+        fWidth.emplace_back(width);
+    }
+}
+
+//__________________________________________________________________________________
+//
+bool MCMCSampler::Run() {
+    if (fParameters.empty()) {
+        WriteErrorStatus("MCMCSampler::Run", "No floating parameters to sample!");
+        return false;
+    }
+    if (fNChains < 1 || fNSteps < 1) {
+        WriteErrorStatus("MCMCSampler::Run", "Number of chains and number of steps need to be positive!");
+        return false;
+    }
+
+    WriteInfoStatus("MCMCSampler::Run", "Sampling " + std::to_string(fParameters.size()) + " parameters with " +
+        std::to_string(fNChains) + " chains of " + std::to_string(fNSteps) + " steps (+ " + std::to_string(fNBurnIn) + " burn-in steps)");
+
+    fSamples.assign(fNChains, std::vector<float>());
+    fNLLValues.assign(fNChains, std::vector<float>());
+    fAcceptance.assign(fNChains, -1.);
+
+    bool success = true;
+    if (fNWorkers > 1 && fNChains > 1) {
+        success = RunParallel();
+    } else {
+        std::unique_ptr<RooAbsReal> nll = CreateNLL();
+        for (int ichain = 0; ichain < fNChains; ++ichain) {
+            fAcceptance.at(ichain) = RunChain(nll.get(), ichain, fSamples.at(ichain), fNLLValues.at(ichain));
+            if (fAcceptance.at(ichain) < 0) success = false;
+        }
+    }
+
+    for (std::size_t ipar = 0; ipar < fParameters.size(); ++ipar) {
+        fParameters.at(ipar)->setVal(fStart.at(ipar));
+    }
+
+    for (int ichain = 0; ichain < fNChains; ++ichain) {
+        if (fAcceptance.at(ichain) < 0) {
+            WriteErrorStatus("MCMCSampler::Run", "Chain " + std::to_string(ichain) + " failed");
+            continue;
+        }
+        WriteInfoStatus("MCMCSampler::Run", "Chain " + std::to_string(ichain) + ": acceptance rate " + std::to_string(fAcceptance.at(ichain)));
+        if (fAcceptance.at(ichain) < 0.05) {
+            WriteWarningStatus("MCMCSampler::Run", "Low acceptance rate in chain " + std::to_string(ichain) + ", consider increasing the number of burn-in steps");
+        }
+    }
+
+    return success;
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooAbsReal> MCMCSampler::CreateNLL() const {
+    RooStats::ModelConfig* mc = static_cast<RooStats::ModelConfig*>(fWs->obj("ModelConfig"));
+    RooAbsPdf* pdf = mc->GetPdf();
+
+    RooArgSet constrainedParams;
+    if (mc->GetNuisanceParameters()) constrainedParams.add(*mc->GetNuisanceParameters());
+    RooArgSet globs;
+    if (mc->GetGlobalObservables()) globs.add(*mc->GetGlobalObservables());
+
+    const RooArgSet* externalConstraints = nullptr;
+    if (pdf->getStringAttribute("externalConstraints")) {
+        externalConstraints = fWs->set(pdf->getStringAttribute("externalConstraints"));
+    }
+
+    if (externalConstraints) {
+        return std::unique_ptr<RooAbsReal>(pdf->createNLL(*fData,
+                                                          RooFit::Constrain(constrainedParams),
+                                                          RooFit::GlobalObservables(globs),
+                                                          RooFit::Offset(1),
+                                                          RooFit::Optimize(kTRUE),
+                                                          RooFit::ExternalConstraints(*externalConstraints)));
+    }
+
+    return std::unique_ptr<RooAbsReal>(pdf->createNLL(*fData,
+                                                      RooFit::Constrain(constrainedParams),
+                                                      RooFit::GlobalObservables(globs),
+                                                      RooFit::Offset(1),
+                                                      RooFit::Optimize(kTRUE)));
+}
+
+//__________________________________________________________________________________
+//
+double MCMCSampler::RunChain(RooAbsReal* nll, const int ichain, std::vector<float>& samples, std::vector<float>& nllValues) const {
+    const std::size_t npar = fParameters.size();
+    TRandom3 rnd(fSeed + ichain + 1);
+
+    // start around the best fit, spread over the chains
+    std::vector<double> x(fStart);
+    for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+        RooRealVar* var = fParameters.at(ipar);
+        for (int itry = 0; itry < MAXTRIES; ++itry) {
+            const double value = fStart.at(ipar) + 0.5*fWidth.at(ipar)*rnd.Gaus();
+            if (var->inRange(value, nullptr)) {
+                x.at(ipar) = value;
+                break;
+            }
+        }
+        var->setVal(x.at(ipar));
+    }
+    double nllX = nll->getVal();
+    if (!std::isfinite(nllX)) {
+        WriteErrorStatus("MCMCSampler::RunChain", "The NLL is not finite at the starting point of chain " + std::to_string(ichain));
+        return -1;
+    }
+
+    // initial proposal from the post-fit uncertainties, scaled for the dimension
+    std::vector<double> cov(npar*(npar+1)/2, 0.);
+    for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+        cov.at(TriangleIndex(ipar, ipar)) = fWidth.at(ipar)*fWidth.at(ipar);
+    }
+    double scale = 2.38*2.38/npar;
+    std::vector<double> chol;
+    UpdateProposal(cov, scale, chol);
+    if (chol.empty()) return -1;
+
+    // running mean and covariance of the burn-in states
+    std::vector<double> mean(x);
+    std::vector<double> sumSq(cov.size(), 0.);
+    long int nAdapt = 1;
+
+    samples.clear();
+    nllValues.clear();
+    samples.reserve(static_cast<std::size_t>(fNSteps)*npar);
+    nllValues.reserve(fNSteps);
+
+    std::vector<double> y(npar);
+    std::vector<double> z(npar);
+    int acceptedWindow = 0;
+    int accepted = 0;
+    for (int istep = 0; istep < fNBurnIn + fNSteps; ++istep) {
+        for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+            z.at(ipar) = rnd.Gaus();
+        }
+        bool inRange = true;
+        for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+            double shift = 0;
+            for (std::size_t jpar = 0; jpar <= ipar; ++jpar) {
+                shift += chol.at(TriangleIndex(ipar, jpar))*z.at(jpar);
+            }
+            y.at(ipar) = x.at(ipar) + shift;
+            if (!fParameters.at(ipar)->inRange(y.at(ipar), nullptr)) {
+                inRange = false;
+                break;
+            }
+        }
+
+        // flat priors: the proposals outside of the ranges are rejected
+        if (inRange) {
+            for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+                fParameters.at(ipar)->setVal(y.at(ipar));
+            }
+            const double nllY = nll->getVal();
+            if (std::isfinite(nllY) && std::log(rnd.Rndm()) < nllX - nllY) {
+                x.swap(y);
+                nllX = nllY;
+                ++acceptedWindow;
+                if (istep >= fNBurnIn) ++accepted;
+            }
+        }
+
+        if (istep < fNBurnIn) {
+            ++nAdapt;
+            for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+                const double delta = x.at(ipar) - mean.at(ipar);
+                mean.at(ipar) += delta/nAdapt;
+                for (std::size_t jpar = 0; jpar <= ipar; ++jpar) {
+                    sumSq.at(TriangleIndex(ipar, jpar)) += delta*(x.at(jpar) - mean.at(jpar));
+                }
+            }
+            if ((istep + 1) % ADAPTINTERVAL == 0) {
+                // keep the acceptance rate close to the optimal ~0.25
+                const double rate = static_cast<double>(acceptedWindow)/ADAPTINTERVAL;
+                if (rate < 0.15) scale *= 0.7;
+                else if (rate > 0.35) scale *= 1.4;
+                acceptedWindow = 0;
+                if (nAdapt > static_cast<long int>(2*npar)) {
+                    for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+                        for (std::size_t jpar = 0; jpar <= ipar; ++jpar) {
+                            cov.at(TriangleIndex(ipar, jpar)) = sumSq.at(TriangleIndex(ipar, jpar))/(nAdapt - 1);
+                        }
+                        cov.at(TriangleIndex(ipar, ipar)) += COVEPSILON*fWidth.at(ipar)*fWidth.at(ipar);
+                    }
+                }
+                UpdateProposal(cov, scale, chol);
+            }
+            continue;
+        }
+
+        for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+            samples.emplace_back(static_cast<float>(x.at(ipar)));
+        }
+        nllValues.emplace_back(static_cast<float>(nllX));
+    }
+
+    return static_cast<double>(accepted)/fNSteps;
+}
+
+//__________________________________________________________________________________
+//
+void MCMCSampler::UpdateProposal(const std::vector<double>& cov, const double scale, std::vector<double>& chol) const {
+    const std::size_t npar = fParameters.size();
+    std::vector<double> result(cov.size(), 0.);
+    for (std::size_t i = 0; i < npar; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+            double sum = scale*cov.at(TriangleIndex(i, j));
+            for (std::size_t k = 0; k < j; ++k) {
+                sum -= result.at(TriangleIndex(i, k))*result.at(TriangleIndex(j, k));
+            }
+            if (i == j) {
+                if (!(sum > 0)) {
+                    WriteDebugStatus("MCMCSampler::UpdateProposal", "Covariance is not positive definite, keeping the previous proposal");
+                    return;
+                }
+                result.at(TriangleIndex(i, i)) = std::sqrt(sum);
+            } else {
+                result.at(TriangleIndex(i, j)) = sum/result.at(TriangleIndex(j, j));
+            }
+        }
+    }
+    chol.swap(result);
+}
+
+//__________________________________________________________________________________
+//
+bool MCMCSampler::RunParallel() {
+    const int nWorkers = std::min(fNWorkers, fNChains);
+    WriteInfoStatus("MCMCSampler::RunParallel", "Running " + std::to_string(fNChains) + " chains using " + std::to_string(nWorkers) + " workers.");
+
+    // the workers write their chains to disk
+    std::vector<std::string> chainFiles;
+    for (int ichain = 0; ichain < fNChains; ++ichain) {
+        TString fileName("TRExMCMC");
+        FILE* tmp = gSystem->TempFileName(fileName);
+        if (!tmp) {
+            WriteErrorStatus("MCMCSampler::RunParallel", "Cannot create temporary file");
+            for (const auto& ifile : chainFiles) gSystem->Unlink(ifile.c_str());
+            return false;
+        }
+        fclose(tmp);
+        chainFiles.emplace_back(fileName.Data());
+    }
+
+    const bool allWorkers = Common::RunInWorkers(nWorkers, [&](const std::size_t iworker){
+        // every worker needs its own NLL
+        std::unique_ptr<RooAbsReal> nll = CreateNLL();
+        for (int ichain = static_cast<int>(iworker); ichain < fNChains; ichain += nWorkers) {
+            std::vector<float> samples;
+            std::vector<float> nllValues;
+            const double acceptance = RunChain(nll.get(), ichain, samples, nllValues);
+            if (acceptance < 0) return false;
+            std::ofstream out(chainFiles.at(ichain), std::ios::binary);
+            const int nSteps = static_cast<int>(nllValues.size());
+            out.write(reinterpret_cast<const char*>(&acceptance), sizeof(acceptance));
+            out.write(reinterpret_cast<const char*>(&nSteps), sizeof(nSteps));
+            out.write(reinterpret_cast<const char*>(samples.data()), samples.size()*sizeof(float));
+            out.write(reinterpret_cast<const char*>(nllValues.data()), nllValues.size()*sizeof(float));
+            out.close();
+            if (out.fail()) return false;
+        }
+        return true;
+    });
+    if (!allWorkers) {
+        WriteWarningStatus("MCMCSampler::RunParallel", "A worker failed, its chains will run sequentially");
+    }
+
+    const std::size_t npar = fParameters.size();
+    std::unique_ptr<RooAbsReal> nll(nullptr);
+    bool success = true;
+    for (int ichain = 0; ichain < fNChains; ++ichain) {
+        std::ifstream in(chainFiles.at(ichain), std::ios::binary);
+        double acceptance = -1;
+        int nSteps = 0;
+        in.read(reinterpret_cast<char*>(&acceptance), sizeof(acceptance));
+        in.read(reinterpret_cast<char*>(&nSteps), sizeof(nSteps));
+        if (in && nSteps == fNSteps && acceptance >= 0) {
+            fSamples.at(ichain).resize(static_cast<std::size_t>(nSteps)*npar);
+            fNLLValues.at(ichain).resize(nSteps);
+            in.read(reinterpret_cast<char*>(fSamples.at(ichain).data()), fSamples.at(ichain).size()*sizeof(float));
+            in.read(reinterpret_cast<char*>(fNLLValues.at(ichain).data()), fNLLValues.at(ichain).size()*sizeof(float));
+        }
+        const bool valid = in && nSteps == fNSteps && acceptance >= 0;
+        in.close();
+        gSystem->Unlink(chainFiles.at(ichain).c_str());
+
+        if (valid) {
+            fAcceptance.at(ichain) = acceptance;
+            continue;
+        }
+
+        // rerun the chains of a failed worker in this process
+        if (!nll) nll = CreateNLL();
+        fAcceptance.at(ichain) = RunChain(nll.get(), ichain, fSamples.at(ichain), fNLLValues.at(ichain));
+        if (fAcceptance.at(ichain) < 0) success = false;
+    }
+
+    return success;
+}
+
+//__________________________________________________________________________________
+//
+std::vector<MCMCSampler::Summary> MCMCSampler::GetSummaries() const {
+    std::vector<Summary> result;
+    const std::size_t npar = fParameters.size();
+    for (const auto& iname : fSummaryNames) {
+        std::size_t index = npar;
+        for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+            if (iname == fParameters.at(ipar)->GetName()) {
+                index = ipar;
+                break;
+            }
+        }
+        if (index == npar) {
+            WriteWarningStatus("MCMCSampler::GetSummaries", "Parameter " + iname + " is not sampled, skipping");
+            continue;
+        }
+
+        std::vector<double> values;
+        std::vector<double> chainMeans;
+        std::vector<double> chainVariances;
+        for (int ichain = 0; ichain < fNChains; ++ichain) {
+            if (fAcceptance.empty() || fAcceptance.at(ichain) < 0) continue;
+            const std::size_t nSteps = fNLLValues.at(ichain).size();
+            if (nSteps < 2) continue;
+            double sum = 0;
+            double sum2 = 0;
+            for (std::size_t istep = 0; istep < nSteps; ++istep) {
+                const double value = fSamples.at(ichain).at(istep*npar + index);
+                values.emplace_back(value);
+                sum += value;
+                sum2 += value*value;
+            }
+            const double chainMean = sum/nSteps;
+            chainMeans.emplace_back(chainMean);
+            chainVariances.emplace_back((sum2 - nSteps*chainMean*chainMean)/(nSteps - 1));
+        }
+        if (values.empty()) continue;
+
+        Summary summary;
+        summary.name = iname;
+        summary.mean = std::accumulate(values.begin(), values.end(), 0.)/values.size();
+        double var = 0;
+        for (const double value : values) {
+            var += (value - summary.mean)*(value - summary.mean);
+        }
+        summary.sigma = values.size() > 1 ? std::sqrt(var/(values.size() - 1)) : 0.;
+
+        std::sort(values.begin(), values.end());
+        summary.median = Quantile(values, 0.5);
+        summary.low68 = Quantile(values, 0.158655);
+        summary.high68 = Quantile(values, 0.841345);
+        summary.low95 = Quantile(values, 0.025);
+        summary.high95 = Quantile(values, 0.975);
+
+        // Gelman-Rubin convergence diagnostic
+        summary.rhat = 1.;
+        const std::size_t nChains = chainMeans.size();
+        if (nChains > 1) {
+            const double n = static_cast<double>(values.size())/nChains;
+            const double w = std::accumulate(chainVariances.begin(), chainVariances.end(), 0.)/nChains;
+            const double meanOfMeans = std::accumulate(chainMeans.begin(), chainMeans.end(), 0.)/nChains;
+            double b = 0;
+            for (const double chainMean : chainMeans) {
+                b += (chainMean - meanOfMeans)*(chainMean - meanOfMeans);
+            }
+            b *= n/(nChains - 1);
+            if (w > 0) summary.rhat = std::sqrt(((n - 1)/n*w + b/n)/w);
+        }
+
+        result.emplace_back(summary);
+    }
+
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+void MCMCSampler::WriteSamples(const std::string& fileName) const {
+    std::unique_ptr<TFile> file(TFile::Open(fileName.c_str(), "RECREATE"));
+    if (!file || file->IsZombie()) {
+        WriteErrorStatus("MCMCSampler::WriteSamples", "Cannot open file " + fileName);
+        return;
+    }
+
+    const std::size_t npar = fParameters.size();
+    int chain = 0;
+    float nllValue = 0;
+    std::vector<float> values(npar);
+
+    TTree tree("posterior", "posterior");
+    tree.SetDirectory(file.get());
+    tree.Branch("chain", &chain, "chain/I");
+    tree.Branch("nll", &nllValue, "nll/F");
+    for (std::size_t ipar = 0; ipar < npar; ++ipar) {
+        const std::string name = fParameters.at(ipar)->GetName();
+        tree.Branch(name.c_str(), &values.at(ipar), (name + "/F").c_str());
+    }
+
+    for (int ichain = 0; ichain < fNChains; ++ichain) {
+        if (fAcceptance.empty() || fAcceptance.at(ichain) < 0) continue;
+        chain = ichain;
+        const std::size_t nSteps = fNLLValues.at(ichain).size();
+        for (std::size_t istep = 0; istep < nSteps; ++istep) {
+            std::copy(fSamples.at(ichain).begin() + istep*npar,
+                      fSamples.at(ichain).begin() + (istep + 1)*npar,
+                      values.begin());
+            nllValue = fNLLValues.at(ichain).at(istep);
+            tree.Fill();
+        }
+    }
+
+    file->cd();
+    tree.Write();
+    file->Close();
+    WriteInfoStatus("MCMCSampler::WriteSamples", "Posterior samples written to " + fileName);
+}
+
+//__________________________________________________________________________________
+//
+void MCMCSampler::WriteSummary(const std::string& fileName) const {
+    std::ofstream out(fileName);
+    if (!out.is_open()) {
+        WriteErrorStatus("MCMCSampler::WriteSummary", "Cannot open file " + fileName);
+        return;
+    }
+
+    out << "POSTERIOR\n";
+    out << "# name  median +up68 -down68  mean  sigma  low95  high95  rhat\n";
+    for (const auto& summary : GetSummaries()) {
+        out << summary.name << "  " << summary.median << " +" << summary.high68 - summary.median << " -" << summary.median - summary.low68
+            << "  " << summary.mean << "  " << summary.sigma << "  " << summary.low95 << "  " << summary.high95 << "  " << summary.rhat << "\n";
+        WriteInfoStatus("MCMCSampler::WriteSummary", summary.name + " = " + std::to_string(summary.median) +
+            " +" + std::to_string(summary.high68 - summary.median) + " -" + std::to_string(summary.median - summary.low68) +
+            " (R = " + std::to_string(summary.rhat) + ")");
+    }
+    out.close();
+}
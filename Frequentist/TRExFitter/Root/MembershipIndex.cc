@@ -0,0 +1,232 @@
+// Class include
+#include "TRExFitter/MembershipIndex.h"
+
+// framework includes
+#include "TRExFitter/Common.h"
+#include "TRExFitter/NormFactor.h"
+#include "TRExFitter/Region.h"
+#include "TRExFitter/Sample.h"
+#include "TRExFitter/ShapeFactor.h"
+#include "TRExFitter/StatusLogbook.h"
+#include "TRExFitter/Systematic.h"
+
+namespace {
+    bool HasWildcard(const std::string& s) {
+        return s.find_first_of("*?") != std::string::npos;
+    }
+
+    // compare a part without '*' to the string starting at s, which has at least part.size() characters
+    bool MatchPart(const char* s, const std::string& part) {
+        for (std::size_t i = 0; i < part.size(); ++i) {
+            if (part[i] != '?' && part[i] != s[i]) return false;
+        }
+        return true;
+    }
+}
+
+//__________________________________________________________________________________
+//
+PatternList::PatternList(const std::vector<std::string>& patterns) :
+    fPatterns(patterns)
+{
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+        const std::string& pattern = patterns[i];
+        if (!HasWildcard(pattern)) {
+            // keep the first occurrence, as the linear search does
+            fExact.emplace(pattern, i);
+            continue;
+        }
+        Glob glob;
+        glob.index = i;
+        glob.hasStar = (pattern.find('*') != std::string::npos);
+        std::size_t start = 0;
+        while (true) {
+            const std::size_t star = pattern.find('*', start);
+            glob.parts.emplace_back(pattern.substr(start, star == std::string::npos ? std::string::npos : star - start));
+            if (star == std::string::npos) break;
+            start = star + 1;
+        }
+        fGlobs.emplace_back(std::move(glob));
+    }
+}
+
+//__________________________________________________________________________________
+//
+bool PatternList::Glob::Match(const std::string& s) const {
+    const std::string& first = parts.front();
+    if (!hasStar) {
+        return s.size() == first.size() && MatchPart(s.data(), first);
+    }
+    const std::string& last = parts.back();
+    if (s.size() < first.size() + last.size()) return false;
+    if (!MatchPart(s.data(), first)) return false;
+    if (!MatchPart(s.data() + s.size() - last.size(), last)) return false;
+
+    // the parts between two '*' are matched as early as possible
+    std::size_t pos = first.size();
+    const std::size_t end = s.size() - last.size();
+    for (std::size_t i = 1; i + 1 < parts.size(); ++i) {
+        const std::string& part = parts[i];
+        if (part.empty()) continue;
+        bool found = false;
+        for (; pos + part.size() <= end; ++pos) {
+            if (MatchPart(s.data() + pos, part)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+        pos += part.size();
+    }
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+int PatternList::Find(const std::string& s) const {
+    // wildcards on both sides are rare, use the generic matching
+    if (HasWildcard(s)) return Common::FindInStringVector(fPatterns, s);
+
+    int idx = -1;
+    auto it = fExact.find(s);
+    if (it != fExact.end()) idx = it->second;
+    for (const auto& glob : fGlobs) {
+        if (idx >= 0 && glob.index > idx) break;
+        if (glob.Match(s)) return glob.index;
+    }
+    return idx;
+}
+
+//__________________________________________________________________________________
+//
+std::vector<bool> MembershipIndex::ResolveRegions(const std::vector<std::string>& regions, const std::vector<std::string>& exclude) const {
+    const PatternList regionList(regions);
+    const PatternList excludeList(exclude);
+    std::vector<bool> result(fRegionNames.size());
+    for (std::size_t i_reg = 0; i_reg < fRegionNames.size(); ++i_reg) {
+        result[i_reg] = (regionList.Empty() || regionList.Find(fRegionNames[i_reg]) >= 0) &&
+                        excludeList.Find(fRegionNames[i_reg]) < 0;
+    }
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+void MembershipIndex::Build(const std::vector<Region*>& regions,
+                            const std::vector<std::shared_ptr<Sample> >& samples,
+                            const std::vector<std::shared_ptr<Systematic> >& systematics,
+                            const std::vector<std::shared_ptr<NormFactor> >& normFactors,
+                            const std::vector<std::shared_ptr<ShapeFactor> >& shapeFactors){
+    fRegionNames.clear();
+    fSampleNames.clear();
+    fRegionIdx.clear();
+    fSampleIdx.clear();
+    fSamples.clear();
+    fSystematics.clear();
+    fSystematicsExcluded.clear();
+    fNormFactors.clear();
+    fShapeFactors.clear();
+
+    for (const auto& reg : regions) {
+        fRegionIdx[reg] = fRegionNames.size();
+        fRegionNames.emplace_back(reg->fName);
+    }
+    for (const auto& smp : samples) {
+        fSampleIdx[smp.get()] = fSampleNames.size();
+        fSampleNames.emplace_back(smp->fName);
+    }
+
+    auto addSystematic = [this](const Systematic* syst) {
+        if (fSystematics.find(syst) != fSystematics.end()) return;
+        fSystematics[syst] = ResolveRegions(syst->fRegions, syst->fExclude);
+        if (syst->fExcludeRegionSample.empty()) return;
+        std::vector<bool>& excluded = fSystematicsExcluded[syst];
+        excluded.resize(fRegionNames.size()*fSampleNames.size());
+        for (std::size_t i_reg = 0; i_reg < fRegionNames.size(); ++i_reg) {
+            for (std::size_t i_smp = 0; i_smp < fSampleNames.size(); ++i_smp) {
+                excluded[i_reg*fSampleNames.size() + i_smp] =
+                    Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample, fRegionNames[i_reg], fSampleNames[i_smp]) >= 0;
+            }
+        }
+    };
+    auto addNormFactor = [this](const NormFactor* nf) {
+        if (fNormFactors.find(nf) != fNormFactors.end()) return;
+        fNormFactors[nf] = ResolveRegions(nf->fRegions, nf->fExclude);
+    };
+    auto addShapeFactor = [this](const ShapeFactor* sf) {
+        if (fShapeFactors.find(sf) != fShapeFactors.end()) return;
+        fShapeFactors[sf] = ResolveRegions(sf->fRegions, sf->fExclude);
+    };
+
+    for (const auto& syst : systematics) addSystematic(syst.get());
+    for (const auto& nf : normFactors) addNormFactor(nf.get());
+    for (const auto& sf : shapeFactors) addShapeFactor(sf.get());
+    for (const auto& smp : samples) {
+        const PatternList regionList(smp->fRegions);
+        std::vector<bool>& inRegion = fSamples[smp.get()];
+        inRegion.resize(fRegionNames.size());
+        for (std::size_t i_reg = 0; i_reg < fRegionNames.size(); ++i_reg) {
+            inRegion[i_reg] = regionList.Find(fRegionNames[i_reg]) >= 0;
+        }
+        for (const auto& syst : smp->fSystematics) addSystematic(syst.get());
+        for (const auto& nf : smp->fNormFactors) addNormFactor(nf.get());
+        for (const auto& sf : smp->fShapeFactors) addShapeFactor(sf.get());
+    }
+
+    WriteDebugStatus("MembershipIndex::Build", "Indexed " + std::to_string(fSamples.size()) + " samples, " +
+        std::to_string(fSystematics.size()) + " systematics, " + std::to_string(fNormFactors.size()) + " norm factors and " +
+        std::to_string(fShapeFactors.size()) + " shape factors in " + std::to_string(fRegionNames.size()) + " regions");
+}
+
+//__________________________________________________________________________________
+//
+bool MembershipIndex::SampleInRegion(const Sample* smp, const Region* reg) const {
+    auto itReg = fRegionIdx.find(reg);
+    auto itSmp = fSamples.find(smp);
+    if (itReg == fRegionIdx.end() || itSmp == fSamples.end()) {
+        return Common::FindInStringVector(smp->fRegions, reg->fName) >= 0;
+    }
+    return itSmp->second[itReg->second];
+}
+
+//__________________________________________________________________________________
+//
+bool MembershipIndex::SystematicInRegion(const Systematic* syst, const Region* reg, const Sample* smp) const {
+    auto itReg = fRegionIdx.find(reg);
+    auto itSyst = fSystematics.find(syst);
+    auto itSmp = fSampleIdx.find(smp);
+    if (itReg == fRegionIdx.end() || itSyst == fSystematics.end() || itSmp == fSampleIdx.end()) {
+        if (syst->fRegions.size() > 0 && Common::FindInStringVector(syst->fRegions, reg->fName) < 0) return false;
+        if (syst->fExclude.size() > 0 && Common::FindInStringVector(syst->fExclude, reg->fName) >= 0) return false;
+        if (syst->fExcludeRegionSample.size() > 0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample, reg->fName, smp->fName) >= 0) return false;
+        return true;
+    }
+    if (!itSyst->second[itReg->second]) return false;
+    auto itExcluded = fSystematicsExcluded.find(syst);
+    if (itExcluded == fSystematicsExcluded.end()) return true;
+    return !itExcluded->second[itReg->second*fSampleNames.size() + itSmp->second];
+}
+
+//__________________________________________________________________________________
+//
+bool MembershipIndex::NormFactorInRegion(const NormFactor* nf, const Region* reg) const {
+    auto itReg = fRegionIdx.find(reg);
+    auto itNf = fNormFactors.find(nf);
+    if (itReg == fRegionIdx.end() || itNf == fNormFactors.end()) {
+        if (nf->fRegions.size() > 0 && Common::FindInStringVector(nf->fRegions, reg->fName) < 0) return false;
+        return Common::FindInStringVector(nf->fExclude, reg->fName) < 0;
+    }
+    return itNf->second[itReg->second];
+}
+
+//__________________________________________________________________________________
+//
+bool MembershipIndex::ShapeFactorInRegion(const ShapeFactor* sf, const Region* reg) const {
+    auto itReg = fRegionIdx.find(reg);
+    auto itSf = fShapeFactors.find(sf);
+    if (itReg == fRegionIdx.end() || itSf == fShapeFactors.end()) {
+        if (sf->fRegions.size() > 0 && Common::FindInStringVector(sf->fRegions, reg->fName) < 0) return false;
+        return Common::FindInStringVector(sf->fExclude, reg->fName) < 0;
+    }
+    return itSf->second[itReg->second];
+}
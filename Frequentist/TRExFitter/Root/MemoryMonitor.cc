@@ -0,0 +1,107 @@
+// Class include
+#include "TRExFitter/MemoryMonitor.h"
+
+// Framework includes
+#include "TRExFitter/Common.h"
+#include "TRExFitter/StatusLogbook.h"
+
+// ROOT includes
+#include "TObject.h"
+#include "TObjectTable.h"
+#include "TSystem.h"
+
+// c++ includes
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// POSIX includes
+#include <sys/resource.h>
+
+//__________________________________________________________________________________
+//
+MemoryMonitor::MemoryMonitor() :
+    fEnabled(false),
+    fBudget(-1)
+{
+}
+
+//__________________________________________________________________________________
+//
+MemoryMonitor::~MemoryMonitor() {
+}
+
+//__________________________________________________________________________________
+//
+double MemoryMonitor::GetResidentMemory() {
+    ProcInfo_t info;
+    if (gSystem->GetProcInfo(&info) < 0) return -1;
+    return info.fMemResident/1024.;
+}
+
+//__________________________________________________________________________________
+//
+double MemoryMonitor::GetPeakMemory() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss/(1024.*1024.);
+#else
+    return usage.ru_maxrss/1024.;
+#endif
+}
+
+//__________________________________________________________________________________
+//
+long int MemoryMonitor::GetROOTObjectCount() {
+    if (!TObject::GetObjectStat() || !gObjectTable) return -1;
+    return gObjectTable->Instances();
+}
+
+//__________________________________________________________________________________
+//
+const MemoryMonitor::Record& MemoryMonitor::Checkpoint(const std::string& stage, const long int histos) {
+    Record record;
+    record.stage = stage;
+    record.resident = GetResidentMemory();
+    record.peak = GetPeakMemory();
+    record.objects = GetROOTObjectCount();
+    record.histos = histos;
+    record.files = TRExFitter::TFILEMAP.size();
+    fRecords.emplace_back(record);
+
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(1) << "Stage " << stage << ": resident memory " << record.resident
+      << " MB, peak " << record.peak << " MB";
+    if (record.histos >= 0) s << ", histograms in memory " << record.histos;
+    if (record.objects >= 0) s << ", ROOT objects " << record.objects;
+    s << ", open files " << record.files;
+    WriteInfoStatus("MemoryMonitor::Checkpoint", s.str());
+
+    return fRecords.back();
+}
+
+//__________________________________________________________________________________
+//
+bool MemoryMonitor::BudgetExceeded() const {
+    if (fBudget <= 0) return false;
+    return GetResidentMemory() > fBudget;
+}
+
+//__________________________________________________________________________________
+//
+void MemoryMonitor::WriteToFile(const std::string& fileName) const {
+    std::ofstream out(fileName);
+    if (!out.good() || !out.is_open()) {
+        WriteWarningStatus("MemoryMonitor::WriteToFile", "Cannot open file: " + fileName);
+        return;
+    }
+    out << "# stage  resident[MB]  peak[MB]  histograms  ROOTobjects  files\n";
+    for (const auto& irecord : fRecords) {
+        out << irecord.stage << " " << std::fixed << std::setprecision(1) << irecord.resident << " "
+            << irecord.peak << " " << irecord.histos << " " << irecord.objects << " " << irecord.files << "\n";
+    }
+    if (fBudget > 0) {
+        out << "# budget[MB] " << fBudget << "\n";
+    }
+}
@@ -101,6 +101,7 @@ MultiFit::MultiFit(const string& name) :
     fPlotSoverB(false),
     fSignalTitle("signal"),
     fFitResultsFile(""),
+    fBinaryFitResults(false),
     fLimitsFile(""),
     fBonlySuffix(""),
     fShowSystForPOI(false),
@@ -124,6 +125,8 @@ MultiFit::MultiFit(const string& name) :
     fLimitParamValue(0),
     fLimitOutputPrefixName("myLimit"),
     fLimitsConfidence(0.95),
+    fLimitAsymptoticWorkers(1),
+    fLimitAsymptoticWarmStart(false),
     fSignificanceIsBlind(false),
     fSignificanceDoInj(false),
     fSignificancePOIAsimov(0),
@@ -615,7 +618,7 @@ void MultiFit::GetCombinedLimit(string inputData){
 
         int sigDebug = 3 - TRExFitter::DEBUGLEVEL;
         if (sigDebug < 0) sigDebug = 0;
-        runAsymptoticsCLs(wsFileName.c_str(), "combWS_withoutSaturated", "ModelConfig", inputData.c_str(), fLimitParamName.c_str(), fLimitParamValue, fLimitOutputPrefixName.c_str(), (fOutDir+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug);
+        runAsymptoticsCLs(wsFileName.c_str(), "combWS_withoutSaturated", "ModelConfig", inputData.c_str(), fLimitParamName.c_str(), fLimitParamValue, fLimitOutputPrefixName.c_str(), (fOutDir+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug, fLimitAsymptoticWorkers, fLimitAsymptoticWarmStart);
     } else if (fLimitType == TRExFit::LimitType::TOYS) {
         std::unique_ptr<TFile> f(TFile::Open(wsFileName.c_str()));
         RooAbsData* data_tmp = dynamic_cast<RooAbsData*>(f->Get(inputData.c_str()));
@@ -1278,8 +1281,8 @@ void MultiFit::ComparePulls(string category) const{
         if(fCombine && i_fit==N-1){
             fitRes = new FitResults();
             std::vector<std::string> s;
-            if(fFitResultsFile!="") fitRes->ReadFromTXT(fFitResultsFile, s);
-            else                    fitRes->ReadFromTXT(fOutDir+"/Fits/"+fName+fSaveSuf+".txt", s);
+            if(fFitResultsFile!="") fitRes->ReadFromFile(fFitResultsFile, s, fBinaryFitResults);
+            else                    fitRes->ReadFromFile(fOutDir+"/Fits/"+fName+fSaveSuf+".txt", s, fBinaryFitResults);
         }
         else{
             fitRes = fFitList[i_fit]->fFitResults;
@@ -1534,8 +1537,8 @@ void MultiFit::CompareNormFactors(string category) const{
         if(fCombine && i_fit==N-1){
             fitRes = new FitResults();
             std::vector<std::string> s;
-            if(fFitResultsFile!="") fitRes->ReadFromTXT(fFitResultsFile, s);
-            else                    fitRes->ReadFromTXT(fOutDir+"/Fits/"+fName+fSaveSuf+".txt", s);
+            if(fFitResultsFile!="") fitRes->ReadFromFile(fFitResultsFile, s, fBinaryFitResults);
+            else                    fitRes->ReadFromFile(fOutDir+"/Fits/"+fName+fSaveSuf+".txt", s, fBinaryFitResults);
         }
         else{
             fitRes = fFitList[i_fit]->fFitResults;
@@ -8,7 +8,15 @@
 #include "TRExFitter/TRExFit.h"
 
 #include "TChain.h"
+#include "TInterpreter.h"
 #include "TROOT.h"
+#include "TSystem.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/file.h>
+#include <unistd.h>
 
 NtupleReader::NtupleReader(TRExFit* fitter) :
     fFitter(fitter)
@@ -37,13 +45,17 @@ void NtupleReader::ReadNtuples(){
     }
     for(const auto& file : fFitter->fCustomFunctions){
         WriteInfoStatus("NtupleReader::ReadNtuples", "  Loading function from " + file + " ...");
-        gROOT->ProcessLineSync((".L "+file+"+").c_str());
+        LoadCustomFunctions(file);
     }
     for(const auto& line : fFitter->fCustomFunctionsExecutes){
       WriteInfoStatus("NtupleReader::ReadNtuples", "  Executing function line: " + line + " ...");
       gROOT->ProcessLine(line.c_str());
     }
     //
+    // Fill the histograms for the automatic binning of all the regions at once
+    //
+    fFitter->FillFineHistogramsInParallel();
+    //
     // Loop on regions
     //
     for(std::size_t i_ch = 0; i_ch < fFitter->fRegions.size(); ++i_ch) {
@@ -72,7 +84,7 @@ void NtupleReader::ReadNtuples(){
             //
             // eventually skip sample / region combination
             //
-            if( Common::FindInStringVector(fFitter->fSamples[i_smp]->fRegions,fFitter->fRegions[i_ch]->fName)<0 ) continue;
+            if( !fFitter->fMembershipIndex.SampleInRegion(fFitter->fSamples[i_smp].get(),fFitter->fRegions[i_ch]) ) continue;
             //
             // read nominal
             //
@@ -164,8 +176,7 @@ void NtupleReader::ReadNtuples(){
             for(const auto& inorm : fFitter->fSamples[i_smp]->fNormFactors) {
                 //
                 // eventually skip norm factor / region combination
-                if(inorm->fRegions.size()>0 && Common::FindInStringVector(inorm->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if(inorm->fExclude.size()>0 && Common::FindInStringVector(inorm->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
+                if( !fFitter->fMembershipIndex.NormFactorInRegion(inorm.get(),fFitter->fRegions[i_ch]) ) continue;
                 //
                 WriteDebugStatus("NtupleReader::ReadNtuples", "Adding norm " + inorm->fName);
                 //
@@ -179,8 +190,7 @@ void NtupleReader::ReadNtuples(){
             for(const auto& ishape : fFitter->fSamples[i_smp]->fShapeFactors) {
                 //
                 // eventually skip shape factor / region combination
-                if(ishape->fRegions.size()>0 && Common::FindInStringVector(ishape->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if(ishape->fExclude.size()>0 && Common::FindInStringVector(ishape->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
+                if( !fFitter->fMembershipIndex.ShapeFactorInRegion(ishape.get(),fFitter->fRegions[i_ch]) ) continue;
                 //
                 WriteDebugStatus("NtupleReader::ReadNtuples", "Adding shape " + ishape->fName);
                 //
@@ -195,11 +205,7 @@ void NtupleReader::ReadNtuples(){
                 Systematic * syst = isyst.get();
                 //
                 // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,fFitter->fRegions[i_ch]->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,fFitter->fRegions[i_ch]->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,
-                                                                                       fFitter->fRegions[i_ch]->fName,
-                                                                                       fFitter->fSamples[i_smp]->fName)>=0 ) continue;
+                if( !fFitter->fMembershipIndex.SystematicInRegion(syst,fFitter->fRegions[i_ch],fFitter->fSamples[i_smp].get()) ) continue;
                 //
                 WriteDebugStatus("NtupleReader::ReadNtuples", "Adding syst " + syst->fName);
                 //
@@ -470,6 +476,10 @@ void NtupleReader::ReadNtuples(){
                         syh->fScaleDown *= isyst->fScaleDownRegions[reg->fName];
             }
         }
+        //
+        // check the memory budget after each region, so that the region where it is exceeded is reported before the end of the step
+        //
+        fFitter->CheckMemoryBudget("n_" + fFitter->fRegions[i_ch]->fName);
     }
 }
 
@@ -487,7 +497,7 @@ void NtupleReader::DefineVariable(int regIter){
     for(std::size_t i_smp = 0; i_smp < fFitter->fSamples.size(); ++i_smp) {
         WriteDebugStatus("NtupleReader::DefineVariable", "Processing sample : " + fFitter->fSamples[i_smp]->fName);
         if(fFitter->fSamples[i_smp]->fType==Sample::DATA) continue;
-        if(Common::FindInStringVector(fFitter->fSamples[i_smp]->fRegions,fFitter->fRegions[regIter]->fName)<0 ) continue;
+        if(!fFitter->fMembershipIndex.SampleInRegion(fFitter->fSamples[i_smp].get(),fFitter->fRegions[regIter]) ) continue;
         WriteDebugStatus("NtupleReader::DefineVariable", " -> is used in the considered region");
         //
         // set selection, weight and paths (no variables)
@@ -531,3 +541,77 @@ void NtupleReader::DefineVariable(int regIter){
     delete h1;
     delete h2;
 }
+
+void NtupleReader::LoadCustomFunctions(const std::string& file) const {
+    const std::string& cacheDir = fFitter->fCustomFunctionsCacheDir;
+    std::ifstream in(file);
+    if(cacheDir == "" || cacheDir == "NONE" || !in.good()) {
+        gROOT->ProcessLineSync((".L "+file+"+").c_str());
+        return;
+    }
+
+    const std::size_t slash = file.find_last_of('/');
+    const std::string fileDir = (slash == std::string::npos) ? "." : file.substr(0, slash);
+
+    // everything that changes the library: name, directory and content of the file, content of the headers
+    // it includes, ROOT version and include paths
+    std::ostringstream key;
+    key << file.substr(slash+1) << "\n" << fileDir << "\n" << in.rdbuf() << "\n" << gROOT->GetVersion() << "\n";
+    key << gInterpreter->GetIncludePath() << "\n" << gSystem->GetIncludePath() << "\n" << gSystem->GetFlagsOpt();
+    in.close();
+    for(const auto& header : Common::IncludedHeaders(file, fFitter->fCustomIncludePaths)) {
+        std::ifstream headerIn(header);
+        key << "\n" << header << "\n" << headerIn.rdbuf();
+    }
+    const std::string buildDir = cacheDir+"/"+Common::HashString(key.str());
+
+    // the library is built by ACLiC from a copy of the file in the build directory, so that it does not depend
+    // on the modification time of the file
+    const std::string baseName = file.substr(slash == std::string::npos ? 0 : slash+1);
+    const std::size_t dot = baseName.find_last_of('.');
+    const std::string libName = buildDir+"/"+(dot == std::string::npos ? baseName : baseName.substr(0, dot)+"_"+baseName.substr(dot+1))+
+                                "."+gSystem->GetSoExt();
+    if(!gSystem->AccessPathName(libName.c_str())) {
+        WriteDebugStatus("NtupleReader::LoadCustomFunctions", "  Loading library " + libName);
+        if(gSystem->Load(libName.c_str()) >= 0) return;
+        WriteWarningStatus("NtupleReader::LoadCustomFunctions", "Cannot load the library " + libName + ", compiling " + file);
+        gROOT->ProcessLineSync((".L "+file+"+").c_str());
+        return;
+    }
+
+    // the first job builds the library, the jobs running in parallel wait for it and only load it
+    gSystem->mkdir(buildDir.c_str(), true);
+    const int lock = open((buildDir+"/.lock").c_str(), O_CREAT | O_RDWR, 0644);
+    if(lock >= 0) flock(lock, LOCK_EX);
+    if(!gSystem->AccessPathName(libName.c_str()) && gSystem->Load(libName.c_str()) >= 0) {
+        WriteDebugStatus("NtupleReader::LoadCustomFunctions", "  Loading library " + libName);
+    } else {
+        WriteDebugStatus("NtupleReader::LoadCustomFunctions", "  Building library " + libName);
+        const std::string copy = buildDir+"/"+baseName;
+        {
+            std::ifstream source(file, std::ios::binary);
+            std::ofstream target(copy, std::ios::binary | std::ios::trunc);
+            target << source.rdbuf();
+        }
+        // the headers included by the file are still found next to the original
+        const std::string oldIncludePath = gSystem->GetIncludePath();
+        gSystem->AddIncludePath(("-I"+fileDir).c_str());
+        int error = 0;
+        gROOT->ProcessLineSync((".L "+copy+"+").c_str(), &error);
+        gSystem->SetIncludePath(oldIncludePath.c_str());
+        // a failed build must not be left for the jobs waiting for the lock
+        if(error != 0 || gSystem->AccessPathName(libName.c_str())) {
+            gSystem->Unlink(libName.c_str());
+            if(lock >= 0) {
+                flock(lock, LOCK_UN);
+                close(lock);
+            }
+            WriteErrorStatus("NtupleReader::LoadCustomFunctions", "Cannot build the library " + libName + " from " + file);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(lock >= 0) {
+        flock(lock, LOCK_UN);
+        close(lock);
+    }
+}
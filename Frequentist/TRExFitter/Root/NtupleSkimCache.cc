@@ -0,0 +1,205 @@
+// Class include
+#include "TRExFitter/NtupleSkimCache.h"
+
+// framework includes
+#include "TRExFitter/Common.h"
+#include "TRExFitter/StatusLogbook.h"
+
+// ROOT includes
+#include "TChain.h"
+#include "TDirectory.h"
+#include "TBranch.h"
+#include "TFile.h"
+#include "TLeaf.h"
+#include "TNamed.h"
+#include "TObjArray.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+// c++ includes
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <set>
+#include <sstream>
+
+namespace {
+    bool IsNameChar(const char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // true if the name appears in the expression as a whole identifier (also as name.member or name[i])
+    bool UsesName(const std::string& expression, const std::string& name) {
+        std::size_t pos = expression.find(name);
+        while (pos != std::string::npos) {
+            const std::size_t end = pos + name.size();
+            if ((pos == 0 || !IsNameChar(expression[pos-1])) && (end == expression.size() || !IsNameChar(expression[end]))) {
+                return true;
+            }
+            pos = expression.find(name, pos + 1);
+        }
+        return false;
+    }
+
+    // true if the branch is used by its name (without the trailing dot of split objects), or by the name of one of its leaves
+    // or sub-branches, e.g. "jets." used as jets.pt
+    bool UsesBranch(const std::string& expression, TBranch* branch) {
+        std::string name = branch->GetName();
+        if (!name.empty() && name.back() == '.') name.pop_back();
+        if (!name.empty() && UsesName(expression, name)) return true;
+        const TObjArray* leaves = branch->GetListOfLeaves();
+        if (leaves) {
+            for (int i = 0; i < leaves->GetEntriesFast(); ++i) {
+                const std::string leafName = leaves->At(i)->GetName();
+                if (leafName != branch->GetName() && UsesName(expression, leafName)) return true;
+            }
+        }
+        const TObjArray* subBranches = branch->GetListOfBranches();
+        if (subBranches) {
+            for (int i = 0; i < subBranches->GetEntriesFast(); ++i) {
+                if (UsesBranch(expression, static_cast<TBranch*>(subBranches->At(i)))) return true;
+            }
+        }
+        return false;
+    }
+
+    // names, modification times and sizes of the input files, empty if one of them cannot be checked
+    std::string InputFilesKey(TChain* chain) {
+        std::ostringstream key;
+        TIter next(chain->GetListOfFiles());
+        TObject* element = nullptr;
+        while ((element = next())) {
+            const std::string fileName = element->GetTitle();
+            FileStat_t fileStat;
+            if (gSystem->GetPathInfo(fileName.c_str(), fileStat) != 0) return "";
+            key << "file:" << fileName << "@" << fileStat.fMtime << ":" << fileStat.fSize << ";";
+        }
+        return key.str();
+    }
+
+    // opens a skim, nullptr if it does not exist or was built for another key
+    std::unique_ptr<TFile> OpenSkim(const std::string& fileName, const std::string& key, std::set<std::string>& branches) {
+        branches.clear();
+        if (gSystem->AccessPathName(fileName.c_str())) return nullptr;
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(), "READ"));
+        if (dir) dir->cd();
+        if (!f || f->IsZombie()) return nullptr;
+        std::unique_ptr<TNamed> storedKey(static_cast<TNamed*>(f->Get("key")));
+        std::unique_ptr<TNamed> storedBranches(static_cast<TNamed*>(f->Get("branches")));
+        if (!storedKey || !storedBranches || key != storedKey->GetTitle()) return nullptr;
+        for (const auto& branch : Common::Vectorize(storedBranches->GetTitle(), ',')) {
+            branches.insert(branch);
+        }
+        return f;
+    }
+
+    // writes the events passing the selection, with only the given branches
+    bool WriteSkim(const std::string& fileName, const std::string& key, TChain* chain, const std::string& selection,
+                   const std::set<std::string>& branches) {
+        gSystem->mkdir(fileName.substr(0, fileName.find_last_of('/')).c_str(), true);
+
+        // write to a temporary file first, so that parallel jobs never read a partially written file
+        const std::string tmpName = fileName+Form(".%d.tmp", gSystem->GetPid());
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(tmpName.c_str(), "RECREATE"));
+        if (!f || f->IsZombie()) {
+            WriteWarningStatus("NtupleSkimCache::WriteSkim", "Cannot create file " + tmpName + ", the ntuple will be read directly");
+            if (dir) dir->cd();
+            return false;
+        }
+        chain->SetBranchStatus("*", 0);
+        std::string branchList;
+        for (const auto& branch : branches) {
+            chain->SetBranchStatus(branch.c_str(), 1);
+            if (branch.back() == '.') chain->SetBranchStatus((branch+"*").c_str(), 1);
+            branchList += (branchList == "" ? "" : ",") + branch;
+        }
+        TTree* skim = chain->CopyTree(selection.c_str());
+        chain->SetBranchStatus("*", 1);
+        if (!skim) {
+            f->Close();
+            if (dir) dir->cd();
+            gSystem->Unlink(tmpName.c_str());
+            return false;
+        }
+        skim->Write("skim");
+        TNamed storedKey("key", key.c_str());
+        storedKey.Write();
+        TNamed storedBranches("branches", branchList.c_str());
+        storedBranches.Write();
+        f->Close();
+        if (dir) dir->cd();
+
+        if (gSystem->Rename(tmpName.c_str(), fileName.c_str()) != 0) {
+            gSystem->Unlink(tmpName.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+//__________________________________________________________________________________
+//
+bool NtupleSkimCache::Draw(const std::string& cacheDir,
+                           TChain* chain,
+                           const std::string& ntuple,
+                           const std::string& drawVariable,
+                           const std::string& selection,
+                           const std::string& weight,
+                           const std::vector<std::string>& aliases) {
+    if (!chain || chain->GetNtrees() == 0) return false;
+    const std::string filesKey = InputFilesKey(chain);
+    if (filesKey == "") return false;
+
+    std::ostringstream key;
+    key << "ntuple:" << ntuple << ";" << filesKey << "selection:" << selection << ";";
+    for (const auto& alias : aliases) {
+        key << "alias:" << alias << ";";
+    }
+    const std::string fileName = cacheDir + "/" + Common::HashString(key.str()) + ".root";
+
+    // branches used by the expressions and by the aliases; branches read only inside CustomFunctions are not seen here,
+    // in that case the formula does not compile on the skim and the full ntuple is read instead
+    const TObjArray* branchArray = chain->GetListOfBranches();
+    if (!branchArray) return false;
+    std::string expressions = drawVariable + ";" + selection + ";" + weight;
+    for (const auto& alias : aliases) {
+        expressions += ";" + alias;
+    }
+    std::set<std::string> branches;
+    for (int i = 0; i < branchArray->GetEntriesFast(); ++i) {
+        TBranch* branch = static_cast<TBranch*>(branchArray->At(i));
+        if (UsesBranch(expressions, branch)) branches.insert(branch->GetName());
+    }
+
+    // the skim is built again (with the branches it had as well) if a branch is missing or the inputs changed
+    std::set<std::string> stored;
+    std::unique_ptr<TFile> f = OpenSkim(fileName, key.str(), stored);
+    if (!f || !std::includes(stored.begin(), stored.end(), branches.begin(), branches.end())) {
+        f.reset();
+        branches.insert(stored.begin(), stored.end());
+        WriteInfoStatus("NtupleSkimCache::Draw", "    Skimming " + ntuple + " into " + fileName + " ...");
+        if (!WriteSkim(fileName, key.str(), chain, selection, branches)) return false;
+        f = OpenSkim(fileName, key.str(), stored);
+        if (!f) return false;
+    } else {
+        WriteVerboseStatus("NtupleSkimCache::Draw", "    Reading " + ntuple + " from " + fileName);
+    }
+
+    TTree* skim = static_cast<TTree*>(f->Get("skim"));
+    if (!skim) return false;
+    for (const auto& alias : aliases) {
+        const auto sub_str = alias.find_first_of(":");
+        const std::string str_alias = alias.substr(0,sub_str);
+        const std::string str_formula = alias.substr(sub_str+1);
+        if (str_alias != str_formula) skim->SetAlias(str_alias.c_str(),str_formula.c_str());
+    }
+    // the histogram is filled in the current directory, as for the full ntuple
+    if (skim->Draw(drawVariable.c_str(), ("("+weight+")*("+selection+")").c_str(), "goff") < 0) {
+        WriteWarningStatus("NtupleSkimCache::Draw", "    Cannot draw " + drawVariable + " from the skim of " + ntuple + ", the ntuple will be read directly");
+        return false;
+    }
+
+    return true;
+}
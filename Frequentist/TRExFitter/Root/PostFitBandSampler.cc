@@ -0,0 +1,254 @@
+#include "TRExFitter/PostFitBandSampler.h"
+
+#include "TRExFitter/CorrelationMatrix.h"
+#include "TRExFitter/FitResults.h"
+#include "TRExFitter/Region.h"
+#include "TRExFitter/StatusLogbook.h"
+
+#include "TGraphAsymmErrors.h"
+#include "TH1.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <thread>
+
+namespace {
+    // quantiles of the central 68% interval
+    constexpr double QLOW = 0.158655;
+    constexpr double QHIGH = 0.841345;
+
+    double Quantile(const std::vector<double>& sorted, const double q) {
+        if (sorted.empty()) return 0.;
+        const double pos = q*(sorted.size()-1);
+        const std::size_t i = static_cast<std::size_t>(pos);
+        if (i+1 >= sorted.size()) return sorted.back();
+        return sorted.at(i) + (pos-i)*(sorted.at(i+1)-sorted.at(i));
+    }
+}
+
+//__________________________________________________________________________________
+//
+PostFitBandSampler::PostFitBandSampler(FitResults* fitRes) :
+    fFitRes(fitRes),
+    fNDraws(1000),
+    fSeed(1234),
+    fNThreads(1)
+{
+}
+
+//__________________________________________________________________________________
+//
+int PostFitBandSampler::AddParameter(const std::string& name) {
+    auto it = fParIdx.find(name);
+    if (it != fParIdx.end()) return it->second;
+    if (!fFitRes->fNuisParIsThere[name]) return -1;
+
+    fParIdx[name] = fParNames.size();
+    fParNames.emplace_back(name);
+    fValues.emplace_back(fFitRes->GetNuisParValue(name));
+    fErrUp.emplace_back(std::abs(fFitRes->GetNuisParErrUp(name)));
+    fErrDown.emplace_back(std::abs(fFitRes->GetNuisParErrDown(name)));
+
+    return fParNames.size()-1;
+}
+
+//__________________________________________________________________________________
+//
+std::size_t PostFitBandSampler::AddYield(const Yield& yield) {
+    fYields.emplace_back(yield);
+    return fYields.size()-1;
+}
+
+//__________________________________________________________________________________
+//
+std::size_t PostFitBandSampler::AddOutput(const std::vector<std::size_t>& yields) {
+    fOutputs.emplace_back(yields);
+    return fOutputs.size()-1;
+}
+
+//__________________________________________________________________________________
+//
+double PostFitBandSampler::EvaluateYield(const Yield& yield, const std::vector<double>& pars) const {
+    double multNorm(1.);
+    double multShape(0.);
+    for (const auto& term : yield.overall) {
+        multNorm *= GetDeltaN(pars[term.par], 1., term.up, term.down, yield.intCodeOverall);
+    }
+    for (const auto& term : yield.shape) {
+        multShape += GetDeltaN(pars[term.par], yield.preFit, term.up, term.down, yield.intCodeShape) - 1.;
+    }
+    return multNorm*(multShape+1.);
+}
+
+//__________________________________________________________________________________
+//
+std::vector<double> PostFitBandSampler::GetCholesky() const {
+    const std::size_t n = fParNames.size();
+    std::vector<double> corr(n*(n+1)/2, 0.);
+    CorrelationMatrix* matrix = fFitRes->fCorrMatrix.get();
+    if (!matrix) {
+        WriteWarningStatus("PostFitBandSampler::GetCholesky", "No correlation matrix available, the parameters are drawn uncorrelated");
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+            if (i == j) corr[i*(i+1)/2+j] = 1.;
+            else if (matrix) corr[i*(i+1)/2+j] = matrix->GetCorrelation(fParNames[i], fParNames[j]);
+        }
+    }
+
+    std::vector<double> chol(n*(n+1)/2, 0.);
+    bool isDegenerate = false;
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+            double sum = corr[i*(i+1)/2+j];
+            for (std::size_t k = 0; k < j; ++k) {
+                sum -= chol[i*(i+1)/2+k]*chol[j*(j+1)/2+k];
+            }
+            if (i == j) {
+                // a parameter fully determined by the previous ones does not get a new random component
+                if (sum <= 1e-12) {
+                    isDegenerate = true;
+                    chol[i*(i+1)/2+i] = 0.;
+                } else {
+                    chol[i*(i+1)/2+i] = std::sqrt(sum);
+                }
+            } else {
+                const double diag = chol[j*(j+1)/2+j];
+                chol[i*(i+1)/2+j] = diag > 0 ? sum/diag : 0.;
+            }
+        }
+    }
+    if (isDegenerate) {
+        WriteWarningStatus("PostFitBandSampler::GetCholesky", "The correlation matrix is not positive definite, the degenerate directions are not sampled");
+    }
+
+    return chol;
+}
+
+//__________________________________________________________________________________
+//
+void PostFitBandSampler::RunDraws(const std::vector<double>& chol, const int first, const int last, std::vector<double>* values) const {
+    const std::size_t n = fParNames.size();
+    std::vector<double> z(n);
+    std::vector<double> pars(n);
+    std::vector<double> yieldValues(fYields.size());
+    std::normal_distribution<double> gaus(0., 1.);
+    for (int idraw = first; idraw < last; ++idraw) {
+        // one generator per draw, so the result does not depend on the number of threads
+        std::seed_seq seq{fSeed, idraw};
+        std::mt19937_64 gen(seq);
+        gaus.reset();
+        for (std::size_t i = 0; i < n; ++i) {
+            z[i] = gaus(gen);
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            double x(0.);
+            for (std::size_t k = 0; k <= i; ++k) {
+                x += chol[i*(i+1)/2+k]*z[k];
+            }
+            pars[i] = fValues[i] + x*(x > 0 ? fErrUp[i] : fErrDown[i]);
+        }
+
+        // the yields can enter several outputs, evaluate them only once
+        for (std::size_t iyield = 0; iyield < fYields.size(); ++iyield) {
+            const Yield& yield = fYields[iyield];
+            double value = yield.postFit;
+            if (std::abs(fMultNominal[iyield]) > 1e-9) {
+                value *= EvaluateYield(yield, pars)/fMultNominal[iyield];
+            }
+            for (const std::size_t ipar : yield.scale) {
+                if (fValues[ipar] == 0) continue;
+                value *= pars[ipar]/fValues[ipar];
+            }
+            yieldValues[iyield] = value;
+        }
+
+        for (std::size_t iout = 0; iout < fOutputs.size(); ++iout) {
+            double sum(0.);
+            for (const std::size_t iyield : fOutputs[iout]) {
+                sum += yieldValues[iyield];
+            }
+            (*values)[idraw*fOutputs.size()+iout] = sum;
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+void PostFitBandSampler::Run() {
+    WriteInfoStatus("PostFitBandSampler::Run", "Sampling " + std::to_string(fParNames.size()) + " parameters with " +
+        std::to_string(fNDraws) + " draws for " + std::to_string(fOutputs.size()) + " outputs");
+
+    fMultNominal.resize(fYields.size());
+    for (std::size_t i = 0; i < fYields.size(); ++i) {
+        fMultNominal[i] = EvaluateYield(fYields[i], fValues);
+    }
+
+    const std::vector<double> chol = GetCholesky();
+
+    std::vector<double> values(static_cast<std::size_t>(fNDraws)*fOutputs.size(), 0.);
+    const int nThreads = std::max(1, std::min(fNThreads, fNDraws));
+    if (nThreads == 1) {
+        RunDraws(chol, 0, fNDraws, &values);
+    } else {
+        std::vector<std::thread> threads;
+        const int chunk = (fNDraws + nThreads - 1)/nThreads;
+        for (int ithread = 0; ithread < nThreads; ++ithread) {
+            const int first = ithread*chunk;
+            const int last = std::min(fNDraws, first+chunk);
+            if (first >= last) break;
+            threads.emplace_back(&PostFitBandSampler::RunDraws, this, std::cref(chol), first, last, &values);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    fCentral.assign(fOutputs.size(), 0.);
+    fLow.assign(fOutputs.size(), 0.);
+    fHigh.assign(fOutputs.size(), 0.);
+    std::vector<double> column(fNDraws);
+    for (std::size_t iout = 0; iout < fOutputs.size(); ++iout) {
+        for (const std::size_t iyield : fOutputs[iout]) {
+            fCentral[iout] += fYields[iyield].postFit;
+        }
+        for (int idraw = 0; idraw < fNDraws; ++idraw) {
+            column[idraw] = values[idraw*fOutputs.size()+iout];
+        }
+        std::sort(column.begin(), column.end());
+        fLow[iout] = Quantile(column, QLOW);
+        fHigh[iout] = Quantile(column, QHIGH);
+    }
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<TGraphAsymmErrors> PostFitBandSampler::GetBand(const TH1* const h_nominal, const std::vector<std::size_t>& outputs) const {
+    if (!h_nominal) {
+        WriteErrorStatus("PostFitBandSampler::GetBand", "h_nominal not defined.");
+        exit(EXIT_FAILURE);
+    }
+    if (static_cast<int>(outputs.size()) != h_nominal->GetNbinsX()) {
+        WriteErrorStatus("PostFitBandSampler::GetBand", "Number of outputs does not match the number of bins.");
+        exit(EXIT_FAILURE);
+    }
+    if (fCentral.size() != fOutputs.size()) {
+        WriteErrorStatus("PostFitBandSampler::GetBand", "The sampling was not run.");
+        exit(EXIT_FAILURE);
+    }
+
+    auto g_totErr = std::make_unique<TGraphAsymmErrors>(h_nominal);
+    for (int i_bin = 1; i_bin < h_nominal->GetNbinsX()+1; ++i_bin) {
+        const std::size_t iout = outputs.at(i_bin-1);
+        const double errUp = std::max(0., fHigh.at(iout) - fCentral.at(iout));
+        const double errDown = std::max(0., fCentral.at(iout) - fLow.at(iout));
+        const double stat = h_nominal->GetBinError(i_bin);
+        g_totErr->SetPointEYhigh(i_bin-1, std::hypot(errUp, stat));
+        g_totErr->SetPointEYlow( i_bin-1, std::hypot(errDown, stat));
+    }
+
+    return g_totErr;
+}
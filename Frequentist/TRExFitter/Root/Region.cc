@@ -6,6 +6,7 @@
 #include "TRExFitter/CorrelationMatrix.h"
 #include "TRExFitter/FitResults.h"
 #include "TRExFitter/NormFactor.h"
+#include "TRExFitter/PostFitBandSampler.h"
 #include "TRExFitter/Sample.h"
 #include "TRExFitter/SampleHist.h"
 #include "TRExFitter/ShapeFactor.h"
@@ -108,6 +109,10 @@ Region::Region(const string& name) :
     fNDF(-1),
     fChi2prob(-1),
     fUseGammaPulls(false),
+    fPostFitBandSampling(false),
+    fPostFitBandDraws(1000),
+    fPostFitBandSeed(1234),
+    fPostFitBandThreads(1),
     fLabelX(-1),
     fLabelY(-1),
     fLegendX1(-1),
@@ -117,6 +122,8 @@ Region::Region(const string& name) :
     fNumberUnfoldingRecoBins(0),
     fNormalizeMigrationMatrix(true),
     fHasAcceptance(false),
+    fUnfoldingRecoVariable(""),
+    fUnfoldingRecoSelection(""),
     fFolder(""),
     fHEPDataFormat(false),
     fAutomaticDropBins(false) {
@@ -948,7 +955,7 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
             for(int i_bin=1;i_bin<fTot_postFit->GetNbinsX()+1;i_bin++){
                 std::string gammaName = Form("stat_%s_bin_%d",fName.c_str(),i_bin-1);
                 if(isample->fSample->fSeparateGammas) {
-                    gammaName = Form("shape_stat_%s_%s_bin_%d",isample->fSample->fName.c_str(),fName.c_str(),i_bin-1);
+                    gammaName = Form("shape_stat_%s_%s_bin_%d",isample->fSample->SeparateGammasSample().c_str(),fName.c_str(),i_bin-1);
                 }
                 if(!systIsThere[gammaName] && (fitRes->GetNuisParValue(gammaName)>0)){
                     fSystNames.push_back(gammaName);
@@ -1041,6 +1048,9 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
                 }
             }
 
+            // the morphing/expression scales do not depend on the bin, they are computed only once
+            std::vector<double> exprScales;
+
             // - loop on bins
             for(int i_bin=1;i_bin<fTot_postFit->GetNbinsX()+1;i_bin++){
                 double diffUp(0.);
@@ -1057,7 +1067,7 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
 
                 const size_t posTmp = systName.find("_bin_");
                 const std::string gammaName      = Form("stat_%s_bin_%d",fName.c_str(),i_bin-1);
-                const std::string gammaNameShape = Form("shape_stat_%s_%s_bin_%d",fSampleHists[i]->fSample->fName.c_str(),fName.c_str(),i_bin-1);
+                const std::string gammaNameShape = Form("shape_stat_%s_%s_bin_%d",fSampleHists[i]->fSample->SeparateGammasSample().c_str(),fName.c_str(),i_bin-1);
                 //
                 // if it's a gamma
                 if(gammaName==fSystNames[i_syst] && fSampleHists[i]->fSample->fUseMCStat && !fSampleHists[i]->fSample->fSeparateGammas){
@@ -1104,13 +1114,15 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
                     // if this norm factor is a morphing one
                     if(fSystNames[i_syst].find("morph_")!=string::npos || fSampleHists[i]->GetNormFactor(fSystNames[i_syst])->fExpression.first!=""){
 
-                        const std::vector<double> scales = Common::CalculateExpression(nullptr, fSystNames[i_syst], true, fSampleHists[i].get(), fitRes);
-                        if (scales.size() != 3) {
-                            WriteErrorStatus("Region::BuildPostFitErrorHist", "Scales size is not 3");
-                            exit(EXIT_FAILURE);
+                        if (exprScales.empty()) {
+                            exprScales = Common::CalculateExpression(nullptr, fSystNames[i_syst], true, fSampleHists[i].get(), fitRes);
+                            if (exprScales.size() != 3) {
+                                WriteErrorStatus("Region::BuildPostFitErrorHist", "Scales size is not 3");
+                                exit(EXIT_FAILURE);
+                            }
                         }
-                        morph_syst_up.at(i_bin-1)   += yieldNominal*scales.at(1);
-                        morph_syst_down.at(i_bin-1) += yieldNominal*scales.at(2);
+                        morph_syst_up.at(i_bin-1)   += yieldNominal*exprScales.at(1);
+                        morph_syst_down.at(i_bin-1) += yieldNominal*exprScales.at(2);
                     }
                     else{
                         diffUp   += yieldNominal_postFit*systErrUp/systValue;
@@ -1270,7 +1282,29 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
         h_down.emplace_back(fTotDown_postFit[i_syst]);
         systNuisPars.push_back(TRExFitter::NPMAP[fSystNames[i_syst]]);
     }
-    fErr_postFit = BuildTotError( fTot_postFit.get(), h_up, h_down, systNuisPars, fitRes->fCorrMatrix.get());
+    if(fPostFitBandSampling){
+        PostFitBandSampler sampler(fitRes);
+        sampler.SetNDraws(fPostFitBandDraws);
+        sampler.SetSeed(fPostFitBandSeed);
+        sampler.SetNThreads(fPostFitBandThreads);
+        const std::vector<std::vector<std::size_t> > yieldIdx = AddPostFitYieldsToSampler(fitRes, &sampler);
+        // same samples as in fTot_postFit
+        std::vector<std::size_t> outputs;
+        for(int i_bin=1;i_bin<fTot_postFit->GetNbinsX()+1;i_bin++){
+            std::vector<std::size_t> binYields;
+            for(std::size_t i = 0; i < fSampleHists.size(); ++i) {
+                if(yieldIdx[i].empty()) continue;
+                if(fSampleHists[i]->fSample->fType==Sample::SIGNAL && !(TRExFitter::SHOWSTACKSIG && TRExFitter::ADDSTACKSIG)) continue;
+                binYields.emplace_back(yieldIdx[i][i_bin-1]);
+            }
+            outputs.emplace_back(sampler.AddOutput(binYields));
+        }
+        sampler.Run();
+        fErr_postFit = sampler.GetBand(fTot_postFit.get(), outputs);
+    }
+    else{
+        fErr_postFit = BuildTotError( fTot_postFit.get(), h_up, h_down, systNuisPars, fitRes->fCorrMatrix.get());
+    }
     fErr_postFit->SetName("g_totErr_postFit");
     // at this point fTot and fErr _postFit should be ready
 
@@ -1303,6 +1337,114 @@ void Region::BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::st
 
 }
 
+//__________________________________________________________________________________
+//
+std::vector<std::vector<std::size_t> > Region::AddPostFitYieldsToSampler(FitResults* fitRes, PostFitBandSampler* sampler) const{
+    std::vector<std::vector<std::size_t> > result(fSampleHists.size());
+    for(std::size_t i = 0; i < fSampleHists.size(); ++i) {
+        const SampleHist* sh = fSampleHists[i].get();
+        if(sh->fSample->fType==Sample::DATA) continue;
+        if(sh->fSample->fType==Sample::GHOST) continue;
+        if(sh->fSample->fType==Sample::EFT) continue;
+        if(!sh->fHist || !sh->fHist_postFit) continue;
+
+        //
+        // Norm factors, the same for all bins
+        //
+        std::vector<std::size_t> scalePars;
+        for(const auto& inorm : sh->fSample->fNormFactors) {
+            if(inorm->fConst) continue;
+            if(inorm->fName.find("morph_")!=std::string::npos || inorm->fExpression.first!=""){
+                WriteWarningStatus("Region::AddPostFitYieldsToSampler", "Norm factor " + inorm->fName + " in sample " + sh->fName + " is kept at its post-fit value in the sampled band");
+                continue;
+            }
+            const int ipar = sampler->AddParameter(inorm->fName);
+            if(ipar>=0) scalePars.emplace_back(ipar);
+        }
+
+        //
+        // Systematics, same logic as in GetMultFactors
+        //
+        std::vector<std::pair<int,const SystematicHist*> > overall;
+        std::vector<std::pair<int,const SystematicHist*> > shape;
+        for(const auto& syh : sh->fSyst){
+            std::string systName = syh->fName;
+            bool isOverall = syh->fIsOverall && !syh->fNormPruned;
+            bool isShape   = syh->fIsShape && !syh->fShapePruned;
+            std::shared_ptr<Systematic> syst = syh->fSystematic;
+            if(syst){
+                if(syst->fType==Systematic::SHAPE) continue;
+                systName = syst->fNuisanceParameter;
+                if(syst->fIsShapeOnly) isOverall = false;
+                if(syst->fIsNormOnly)  isShape   = false;
+            }
+            // the dummy variations added for the post-fit plots have no effect
+            if(syh->fNormUp==0 && syh->fNormDown==0) isOverall = false;
+            if(!isOverall && !isShape) continue;
+            // the parameters not in the fit results are fixed
+            const int ipar = sampler->AddParameter(systName);
+            if(ipar<0) continue;
+            if(isOverall) overall.emplace_back(ipar, syh.get());
+            if(isShape)   shape.emplace_back(ipar, syh.get());
+        }
+
+        const int nbins = sh->fHist_postFit->GetNbinsX();
+        result[i].resize(nbins);
+        for(int i_bin=1;i_bin<=nbins;i_bin++){
+            PostFitBandSampler::Yield yield;
+            yield.postFit = sh->fHist_postFit->GetBinContent(i_bin);
+            yield.preFit  = sh->fHist->GetBinContent(i_bin);
+            yield.intCodeOverall = fIntCode_overall;
+            yield.intCodeShape   = fIntCode_shape;
+            yield.scale = scalePars;
+            for(const auto& iover : overall){
+                yield.overall.push_back({static_cast<std::size_t>(iover.first), iover.second->fNormUp+1, iover.second->fNormDown+1});
+            }
+            if(yield.preFit>0){
+                for(const auto& ishape : shape){
+                    const double up   = ishape.second->fHistShapeUp->GetBinContent(i_bin);
+                    const double down = ishape.second->fHistShapeDown->GetBinContent(i_bin);
+                    if(up==yield.preFit && down==yield.preFit) continue;
+                    yield.shape.push_back({static_cast<std::size_t>(ishape.first), up, down});
+                }
+            }
+
+            //
+            // Shape factors
+            //
+            for(const auto& ishape : sh->fSample->fShapeFactors) {
+                const int ipar = sampler->AddParameter(ishape->fName + "_bin_" + std::to_string(i_bin-1));
+                if(ipar>=0) yield.scale.emplace_back(ipar);
+            }
+
+            //
+            // Gammas of the SHAPE systematics
+            //
+            for(const auto& syh : sh->fSyst){
+                if(!syh->fSystematic || syh->fSystematic->fType!=Systematic::SHAPE) continue;
+                const int ipar = sampler->AddParameter(Form("shape_%s_%s_bin_%d",syh->fSystematic->fName.c_str(),fName.c_str(),i_bin-1));
+                if(ipar>=0) yield.scale.emplace_back(ipar);
+            }
+
+            //
+            // Stat gammas, otherwise the MC stat. uncertainty is in the bin errors
+            //
+            if(fUseGammaPulls && (sh->fSample->fUseMCStat || sh->fSample->fSeparateGammas)){
+                std::string gammaName = Form("stat_%s_bin_%d",fName.c_str(),i_bin-1);
+                if(sh->fSample->fSeparateGammas) {
+                    gammaName = Form("shape_stat_%s_%s_bin_%d",sh->fSample->SeparateGammasSample().c_str(),fName.c_str(),i_bin-1);
+                }
+                const int ipar = sampler->AddParameter(gammaName);
+                if(ipar>=0 && fitRes->GetNuisParValue(gammaName)>0) yield.scale.emplace_back(ipar);
+            }
+
+            result[i][i_bin-1] = sampler->AddYield(yield);
+        }
+    }
+
+    return result;
+}
+
 //__________________________________________________________________________________
 //
 std::shared_ptr<TRExPlot> Region::DrawPostFit(FitResults* fitRes,
@@ -1408,7 +1550,7 @@ std::shared_ptr<TRExPlot> Region::DrawPostFit(FitResults* fitRes,
                 // find the gamma for this bin of this distribution in the fit results
                 std::string gammaName = Form("stat_%s_bin_%d",fName.c_str(),i_bin-1);
                 if(fSampleHists[i]->fSample->fSeparateGammas) {
-                    gammaName = Form("shape_stat_%s_%s_bin_%d",fSampleHists[i]->fSample->fName.c_str(),fName.c_str(),i_bin-1);
+                    gammaName = Form("shape_stat_%s_%s_bin_%d",fSampleHists[i]->fSample->SeparateGammasSample().c_str(),fName.c_str(),i_bin-1);
                 }
                 WriteDebugStatus("Region::DrawPostFit", "Looking for gamma " + gammaName);
                 const double gammaValue = fitRes->GetNuisParValue(gammaName);
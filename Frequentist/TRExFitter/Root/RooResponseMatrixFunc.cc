@@ -0,0 +1,296 @@
+// Class include
+#include "TRExFitter/RooResponseMatrixFunc.h"
+
+// framework includes
+#include "TRExFitter/StatusLogbook.h"
+
+// ROOT includes
+#include "RooAbsRealLValue.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
+
+// c++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+ClassImp(RooResponseMatrixFunc)
+
+namespace {
+    // full recomputation of the cached shapes and normalisations after this many incremental updates,
+    // so that the rounding errors do not accumulate during a long minimisation
+    constexpr int kMaxIncrementalUpdates = 100;
+
+    // shape variation of PiecewiseInterpolation with interpolation code 4:
+    // 6th order polynomial for |alpha| < 1, linear extrapolation outside
+    double ShapeDelta(const double alpha, const double down, const double up) {
+        if (alpha > 1) return alpha*up;
+        if (alpha < -1) return alpha*down;
+        const double S = 0.5*(up + down);
+        const double A = 0.0625*(up - down);
+        return alpha*(S + alpha*A*(15 + alpha*alpha*(-10 + alpha*alpha*3)));
+    }
+
+    // normalisation factor of FlexibleInterpVar with interpolation code 4:
+    // 6th order polynomial for |alpha| < 1, exponential extrapolation outside
+    double NormFactor(const double alpha, const double down, const double up) {
+        if (alpha >= 1) return std::pow(up, alpha);
+        if (alpha <= -1) return std::pow(down, -alpha);
+        if (alpha == 0) return 1.;
+        const double logUp = std::log(up);
+        const double logDown = std::log(down);
+        const double powUpLog = up <= 0 ? 0 : up*logUp;
+        const double powDownLog = down <= 0 ? 0 : -down*logDown;
+        const double powUpLog2 = up <= 0 ? 0 : powUpLog*logUp;
+        const double powDownLog2 = down <= 0 ? 0 : -powDownLog*logDown;
+        const double S0 = 0.5*(up + down);
+        const double A0 = 0.5*(up - down);
+        const double S1 = 0.5*(powUpLog + powDownLog);
+        const double A1 = 0.5*(powUpLog - powDownLog);
+        const double S2 = 0.5*(powUpLog2 + powDownLog2);
+        const double A2 = 0.5*(powUpLog2 - powDownLog2);
+        const double a = 1./8*(15*A0 - 7*S1 + A2);
+        const double b = 1./8*(-24 + 24*S0 - 9*A1 + S2);
+        const double c = 1./4*(-5*A0 + 5*S1 - A2);
+        const double d = 1./4*(12 - 12*S0 + 7*A1 - S2);
+        const double e = 1./8*(3*A0 - 3*S1 + A2);
+        const double f = 1./8*(-8 + 8*S0 - 5*A1 + S2);
+        return 1. + alpha*(a + alpha*(b + alpha*(c + alpha*(d + alpha*(e + alpha*f)))));
+    }
+}
+
+//__________________________________________________________________________________
+//
+RooResponseMatrixFunc::RooResponseMatrixFunc() :
+    fNormOffset(1, 0),
+    fShapeOffset(1, 0),
+    fCacheValid(false),
+    fCacheUpdates(0)
+{
+}
+
+//__________________________________________________________________________________
+//
+RooResponseMatrixFunc::RooResponseMatrixFunc(const char* name,
+                                             const char* title,
+                                             RooAbsRealLValue& obs,
+                                             const RooArgList& coefs,
+                                             const std::vector<double>& edges,
+                                             const std::vector<double>& nominal) :
+    RooAbsReal(name, title),
+    fObs("obs", "observable", this, obs),
+    fCoefs("coefs", "coefficients of the truth bins", this),
+    fParams("params", "nuisance parameters", this),
+    fEdges(edges),
+    fNominal(nominal),
+    fNormOffset(1, 0),
+    fShapeOffset(1, 0),
+    fCacheValid(false),
+    fCacheUpdates(0)
+{
+    fCoefs.add(coefs);
+    if (fEdges.size() < 2 || fNominal.size() != NRecoBins()*NTruthBins()) {
+        WriteErrorStatus("RooResponseMatrixFunc::RooResponseMatrixFunc", "The response matrix of " + std::string(GetName()) + " does not match the binning and the number of coefficients");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//__________________________________________________________________________________
+//
+RooResponseMatrixFunc::RooResponseMatrixFunc(const RooResponseMatrixFunc& other, const char* name) :
+    RooAbsReal(other, name),
+    fObs("obs", this, other.fObs),
+    fCoefs("coefs", this, other.fCoefs),
+    fParams("params", this, other.fParams),
+    fEdges(other.fEdges),
+    fNominal(other.fNominal),
+    fNormOffset(other.fNormOffset),
+    fNormBin(other.fNormBin),
+    fNormDown(other.fNormDown),
+    fNormUp(other.fNormUp),
+    fShapeOffset(other.fShapeOffset),
+    fShapeCell(other.fShapeCell),
+    fShapeDown(other.fShapeDown),
+    fShapeUp(other.fShapeUp),
+    fCacheValid(false),
+    fCacheUpdates(0)
+{
+}
+
+//__________________________________________________________________________________
+//
+void RooResponseMatrixFunc::AddSystematic(RooAbsReal& param,
+                                          const std::vector<double>& normDown,
+                                          const std::vector<double>& normUp,
+                                          const std::vector<double>& shapeDown,
+                                          const std::vector<double>& shapeUp) {
+    if (normDown.size() != NTruthBins() || normUp.size() != NTruthBins() ||
+        shapeDown.size() != shapeUp.size() || (!shapeUp.empty() && shapeUp.size() != fNominal.size())) {
+        WriteErrorStatus("RooResponseMatrixFunc::AddSystematic", "The variations of " + std::string(param.GetName()) + " do not match the response matrix of " + GetName());
+        exit(EXIT_FAILURE);
+    }
+
+    fParams.add(param);
+    for (std::size_t i_truth = 0; i_truth < normUp.size(); ++i_truth) {
+        if (normDown[i_truth] == 1 && normUp[i_truth] == 1) continue;
+        fNormBin.emplace_back(i_truth);
+        fNormDown.emplace_back(normDown[i_truth]);
+        fNormUp.emplace_back(normUp[i_truth]);
+    }
+    fNormOffset.emplace_back(fNormBin.size());
+    for (std::size_t i_cell = 0; i_cell < shapeUp.size(); ++i_cell) {
+        if (shapeDown[i_cell] == fNominal[i_cell] && shapeUp[i_cell] == fNominal[i_cell]) continue;
+        fShapeCell.emplace_back(i_cell);
+        fShapeDown.emplace_back(fNominal[i_cell] - shapeDown[i_cell]);
+        fShapeUp.emplace_back(shapeUp[i_cell] - fNominal[i_cell]);
+    }
+    fShapeOffset.emplace_back(fShapeCell.size());
+    fCacheValid = false;
+}
+
+//__________________________________________________________________________________
+//
+Double_t RooResponseMatrixFunc::evaluate() const {
+    const double x = fObs;
+    if (x < fEdges.front() || x > fEdges.back()) return 0;
+    const std::size_t bin = std::min(static_cast<std::size_t>(std::upper_bound(fEdges.begin(), fEdges.end(), x) - fEdges.begin()) - 1,
+                                     NRecoBins() - 1);
+    UpdateCache();
+    return fCacheValues[bin];
+}
+
+//__________________________________________________________________________________
+//
+void RooResponseMatrixFunc::UpdateCache() const {
+    const std::size_t nParams = fParams.getSize();
+    const std::size_t nTruth = NTruthBins();
+    const std::size_t nReco = NRecoBins();
+
+    // the function is evaluated once per reco bin with the same parameters, only recompute if one of them changed
+    bool coefsChanged = !fCacheValid;
+    fCacheCoefs.resize(nTruth);
+    for (std::size_t i_truth = 0; i_truth < nTruth; ++i_truth) {
+        const double coef = static_cast<RooAbsReal*>(fCoefs.at(i_truth))->getVal();
+        if (coef != fCacheCoefs[i_truth]) coefsChanged = true;
+        fCacheCoefs[i_truth] = coef;
+    }
+    std::vector<std::size_t> changed;
+    if (fCacheValid) {
+        for (std::size_t i_par = 0; i_par < nParams; ++i_par) {
+            const double alpha = static_cast<RooAbsReal*>(fParams.at(i_par))->getVal();
+            if (alpha != fCacheParams[i_par]) changed.emplace_back(i_par);
+        }
+        if (changed.empty() && !coefsChanged) return;
+    }
+
+    if (!fCacheValid || changed.size() > 1 || (changed.size() == 1 && fCacheUpdates >= kMaxIncrementalUpdates)) {
+        fCacheParams.resize(nParams);
+        for (std::size_t i_par = 0; i_par < nParams; ++i_par) {
+            fCacheParams[i_par] = static_cast<RooAbsReal*>(fParams.at(i_par))->getVal();
+        }
+        ComputeShapes();
+    } else if (changed.size() == 1) {
+        // only the terms of this parameter change
+        const std::size_t i_par = changed.front();
+        const double oldAlpha = fCacheParams[i_par];
+        const double newAlpha = static_cast<RooAbsReal*>(fParams.at(i_par))->getVal();
+        fCacheParams[i_par] = newAlpha;
+        for (int i = fShapeOffset[i_par]; i < fShapeOffset[i_par+1]; ++i) {
+            fCacheShapes[fShapeCell[i]] += ShapeDelta(newAlpha, fShapeDown[i], fShapeUp[i]) -
+                                           ShapeDelta(oldAlpha, fShapeDown[i], fShapeUp[i]);
+        }
+        ++fCacheUpdates;
+        for (int i = fNormOffset[i_par]; i < fNormOffset[i_par+1]; ++i) {
+            const double oldFactor = NormFactor(oldAlpha, fNormDown[i], fNormUp[i]);
+            if (oldFactor == 0 || !std::isfinite(oldFactor)) {
+                ComputeShapes();
+                break;
+            }
+            fCacheNorms[fNormBin[i]] *= NormFactor(newAlpha, fNormDown[i], fNormUp[i])/oldFactor;
+        }
+    }
+
+    fCacheValues.assign(nReco, 0.);
+    for (std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+        const double* shapes = &fCacheShapes[i_reco*nTruth];
+        double value = 0;
+        for (std::size_t i_truth = 0; i_truth < nTruth; ++i_truth) {
+            // positive definite, as the PiecewiseInterpolation of the HistFactory samples,
+            // and FlexibleInterpVar does not return non-positive factors
+            if (shapes[i_truth] > 0) {
+                value += fCacheCoefs[i_truth]*std::max(fCacheNorms[i_truth], std::numeric_limits<double>::min())*shapes[i_truth];
+            }
+        }
+        fCacheValues[i_reco] = value;
+    }
+    fCacheValid = true;
+}
+
+//__________________________________________________________________________________
+//
+void RooResponseMatrixFunc::ComputeShapes() const {
+    fCacheUpdates = 0;
+    fCacheShapes = fNominal;
+    fCacheNorms.assign(NTruthBins(), 1.);
+    for (std::size_t i_par = 0; i_par < fCacheParams.size(); ++i_par) {
+        const double alpha = fCacheParams[i_par];
+        if (alpha == 0) continue;
+        for (int i = fShapeOffset[i_par]; i < fShapeOffset[i_par+1]; ++i) {
+            fCacheShapes[fShapeCell[i]] += ShapeDelta(alpha, fShapeDown[i], fShapeUp[i]);
+        }
+        for (int i = fNormOffset[i_par]; i < fNormOffset[i_par+1]; ++i) {
+            fCacheNorms[fNormBin[i]] *= NormFactor(alpha, fNormDown[i], fNormUp[i]);
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+Int_t RooResponseMatrixFunc::getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars, const char* /*rangeName*/) const {
+    if (matchArgs(allVars, analVars, fObs)) return 1;
+    return 0;
+}
+
+//__________________________________________________________________________________
+//
+Double_t RooResponseMatrixFunc::analyticalIntegral(Int_t code, const char* rangeName) const {
+    R__ASSERT(code == 1);
+    const double xmin = fObs.min(rangeName);
+    const double xmax = fObs.max(rangeName);
+    UpdateCache();
+    double result = 0;
+    for (std::size_t i_reco = 0; i_reco < NRecoBins(); ++i_reco) {
+        const double low = std::max(fEdges[i_reco], xmin);
+        const double high = std::min(fEdges[i_reco+1], xmax);
+        if (high > low) result += fCacheValues[i_reco]*(high - low);
+    }
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+std::list<Double_t>* RooResponseMatrixFunc::binBoundaries(RooAbsRealLValue& obs, Double_t xlo, Double_t xhi) const {
+    if (!fObs.arg().dependsOn(obs)) return nullptr;
+    std::list<Double_t>* result = new std::list<Double_t>;
+    for (const double edge : fEdges) {
+        if (edge >= xlo && edge <= xhi) result->push_back(edge);
+    }
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+std::list<Double_t>* RooResponseMatrixFunc::plotSamplingHint(RooAbsRealLValue& obs, Double_t xlo, Double_t xhi) const {
+    if (!fObs.arg().dependsOn(obs)) return nullptr;
+    // points just before and after each edge, to draw the steps
+    const double delta = (xhi - xlo)*1e-8;
+    std::list<Double_t>* result = new std::list<Double_t>;
+    for (const double edge : fEdges) {
+        if (edge < xlo || edge > xhi) continue;
+        result->push_back(edge - delta);
+        result->push_back(edge + delta);
+    }
+    return result;
+}
@@ -165,6 +165,13 @@ bool Sample::HasNuisanceParameter(const std::string& name) const{
     return false;
 }
 
+//__________________________________________________________________________________
+//
+const std::string& Sample::SeparateGammasSample() const{
+    if(fCorrelateGammasWithSample != "") return fCorrelateGammasWithSample;
+    return fName;
+}
+
 //__________________________________________________________________________________
 //
 bool Sample::HasNormFactor(const std::string& name) const{
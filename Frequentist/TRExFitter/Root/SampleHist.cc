@@ -1721,3 +1721,36 @@ std::vector<double> SampleHist::GetDataScales() const {
 
     return result;
 }
+
+//_____________________________________________________________________________
+//
+long int SampleHist::CountHistograms() const {
+    long int n = 0;
+    if (fHist)           ++n;
+    if (fHist_orig)      ++n;
+    if (fHist_regBin)    ++n;
+    if (fHist_preSmooth) ++n;
+    if (fHist_postFit)   ++n;
+    for (const auto& isyst : fSyst) {
+        if (!isyst) continue;
+        for (const TH1* h : {isyst->fHistUp.get(), isyst->fHistUp_orig.get(), isyst->fHistUp_preSmooth.get(),
+                             isyst->fHistShapeUp.get(), isyst->fHistUp_postFit.get(),
+                             isyst->fHistDown.get(), isyst->fHistDown_orig.get(), isyst->fHistDown_preSmooth.get(),
+                             isyst->fHistShapeDown.get(), isyst->fHistDown_postFit.get()}) {
+            if (h) ++n;
+        }
+    }
+    return n;
+}
+
+//_____________________________________________________________________________
+//
+void SampleHist::ReleaseIntermediateHistos() {
+    fHist_regBin.reset(nullptr);
+    fHist_preSmooth.reset(nullptr);
+    for (auto& isyst : fSyst) {
+        if (!isyst) continue;
+        isyst->fHistUp_preSmooth.reset(nullptr);
+        isyst->fHistDown_preSmooth.reset(nullptr);
+    }
+}
@@ -2,6 +2,7 @@
 #include "TRExFitter/TRExFit.h"
 
 // Framework includes
+#include "TRExFitter/BinnedToyMCSampler.h"
 #include "TRExFitter/ConfigParser.h"
 #include "TRExFitter/ConfigReader.h"
 #include "TRExFitter/CorrelationMatrix.h"
@@ -12,8 +13,10 @@
 #include "TRExFitter/HistoTools.h"
 #include "TRExFitter/LikelihoodScanManager.h"
 #include "TRExFitter/LimitToys.h"
+#include "TRExFitter/MCMCSampler.h"
 #include "TRExFitter/NormFactor.h"
 #include "TRExFitter/NuisParameter.h"
+#include "TRExFitter/PostFitBandSampler.h"
 #include "TRExFitter/Sample.h"
 #include "TRExFitter/SampleHist.h"
 #include "TRExFitter/ShapeFactor.h"
@@ -22,8 +25,11 @@
 #include "TRExFitter/TRExPlot.h"
 #include "TRExFitter/RankingManager.h"
 #include "TRExFitter/Region.h"
+#include "TRExFitter/RooResponseMatrixFunc.h"
 #include "TRExFitter/PruningUtil.h"
 #include "TRExFitter/TruthSample.h"
+#include "TRExFitter/UnfoldingInputBuilder.h"
+#include "TRExFitter/UnfoldingInputCache.h"
 #include "TRExFitter/UnfoldingSample.h"
 #include "TRExFitter/UnfoldingSystematic.h"
 #include "TRExFitter/YamlConverter.h"
@@ -42,12 +48,15 @@
 #include "RooRealSumPdf.h"
 #include "RooDataHist.h"
 #include "RooFormulaVar.h"
+#include "RooHistFunc.h"
 #include "RooHistPdf.h"
 #include "RooArgSet.h"
 #include "RooConstVar.h"
 #include "RooAddPdf.h"
 #include "RooGaussian.h"
 #include "RooPoisson.h"
+#include "RooProduct.h"
+#include "RooRealVar.h"
 #include "RooMinimizer.h"
 #include "RooFitResult.h"
 #include "RooTFnBinding.h"
@@ -88,9 +97,16 @@
 
 // c++ includes
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdio>
 #include <iomanip>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace RooFit;
 
@@ -109,6 +125,14 @@ TRExFit::TRExFit(std::string name) :
     fUseStatErr(false),
     fStatErrThres(0.05),
     fUseGammaPulls(false),
+    fPostFitBandSampling(false),
+    fPostFitBandDraws(1000),
+    fPostFitBandSeed(1234),
+    fPostFitBandThreads(1),
+    fPostProcessingThreads(1),
+    fWorkspaceWorkers(1),
+    fAutoBinningWorkers(1),
+    fAutoBinningCache(false),
     fLumi(1.),
     fLumiScale(1.),
     fLumiErr(0.000001),
@@ -153,12 +177,15 @@ TRExFit::TRExFit(std::string name) :
     fDoTables(true),
     fDoSignalRegionsPlot(true),
     fDoPieChartPlot(true),
+    fDoEFTPlots(true),
     fGroupedImpactCategory("all"),
     fSummaryPrefix(""),
     fFitType(UNDEFINED),
     fFitRegion(CRSR),
     fFitNPValuesFromFitResults(""),
     fInjectGlobalObservables(false),
+    fAsimovCache(false),
+    fCombinationCache(false),
     fFitIsBlind(false),
     fUseRnd(false),
     fRndRange(0.1),
@@ -181,6 +208,8 @@ TRExFit::TRExFit(std::string name) :
     fLimitParamValue(0),
     fLimitOutputPrefixName("myLimit"),
     fLimitsConfidence(0.95),
+    fLimitAsymptoticWorkers(1),
+    fLimitAsymptoticWarmStart(false),
     fSignificanceIsBlind(false),
     fSignificanceDoInjection(false),
     fSignificancePOIAsimov(0),
@@ -196,6 +225,7 @@ TRExFit::TRExFit(std::string name) :
     fGetChi2(0), // 0: no, 1: stat-only, 2: with syst
     fSmoothOption(HistoTools::SmoothOption::MAXVARIATION),
     fSuppressNegativeBinWarnings(false),
+    fCustomFunctionsCacheDir(""),
     fTemplateInterpolationOption(TRExFit::LINEAR),
     fBootstrap(""),
     fBootstrapSyst(""),
@@ -243,6 +273,7 @@ TRExFit::TRExFit(std::string name) :
     fDoSystNormalizationPlots(true),
     fDebugNev(-1),
     fCPU(1),
+    fMinosWorkers(1),
     fMatrixOrientation(FoldingManager::MATRIXORIENTATION::TRUTHONHORIZONTALAXIS),
     fTruthDistributionPath(""),
     fTruthDistributionFile(""),
@@ -293,6 +324,10 @@ TRExFit::TRExFit(std::string name) :
     fValidationPruning(false),
     fUnfoldNormXSec(false),
     fUnfoldNormXSecBinN(-1),
+    fUnfoldingResponseMatrixPdf(false),
+    fUnfoldingInputsFromNtuples(false),
+    fUnfoldingTruthVariable(""),
+    fUnfoldingTruthSelection(""),
     fUsePOISinRanking(false),
     fUseHesseBeforeMigrad(false),
     fUseNllInLHscan(true),
@@ -302,10 +337,19 @@ TRExFit::TRExFit(std::string name) :
     fLimitToysScanMin(0.),
     fLimitToysScanMax(10.),
     fToysSeed(1234),
+    fToysNativeGenerator(false),
+    fMCMCChains(4),
+    fMCMCSteps(10000),
+    fMCMCBurnIn(2000),
+    fMCMCSeed(1234),
+    fMCMCWorkers(1),
     fLimitToysSeed(1234),
+    fLimitToysWorkers(1),
     fLimitPlot(true),
     fLimitFile(true),
-    fDataWeighted(false)
+    fDataWeighted(false),
+    fBinaryFitResults(false),
+    fMemoryBudgetWarned(false)
 {
     TRExFitter::IMAGEFORMAT.emplace_back("png");
     // increase operator limit to be able to handle very long expressions (cuts/weights)
@@ -407,6 +451,10 @@ Region* TRExFit::NewRegion(const std::string& name){
     fRegions.back()->fPOIs = fPOIs;
     fRegions.back()->fIntCode_overall = fIntCode_overall;
     fRegions.back()->fIntCode_shape   = fIntCode_shape;
+    fRegions.back()->fPostFitBandSampling = fPostFitBandSampling;
+    fRegions.back()->fPostFitBandDraws    = fPostFitBandDraws;
+    fRegions.back()->fPostFitBandSeed     = fPostFitBandSeed;
+    fRegions.back()->fPostFitBandThreads  = fPostFitBandThreads;
     fRegions.back()->fLumiScale = fLumiScale;
     fRegions.back()->fBlindingThreshold = fBlindingThreshold;
     fRegions.back()->fBlindingType = fBlindingType;
@@ -427,6 +475,12 @@ Region* TRExFit::NewRegion(const std::string& name){
     return fRegions.back();
 }
 
+//__________________________________________________________________________________
+//
+void TRExFit::BuildMembershipIndex(){
+    fMembershipIndex.Build(fRegions, fSamples, fSystematics, fNormFactors, fShapeFactors);
+}
+
 //__________________________________________________________________________________
 //
 void TRExFit::AddNtuplePath(const std::string& path){
@@ -640,56 +694,95 @@ void TRExFit::CreateRootFiles(){
 //__________________________________________________________________________________
 // fill files with all the histograms
 void TRExFit::WriteHistos(bool reWriteOrig) const{
+    for(std::size_t i_ch = 0; i_ch < fRegions.size(); ++i_ch) {
+        WriteRegionHistos(i_ch, reWriteOrig);
+    }
+    WriteInfoStatus("TRExFit::WriteHistos","-------------------------------------------");
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::WriteRegionHistos(const std::size_t i_ch, const bool reWriteOrig) const{
     bool singleOutputFile = !TRExFitter::SPLITHISTOFILES;
     std::string fileName;
-    for(std::size_t i_ch = 0; i_ch < fRegions.size(); ++i_ch) {
-        //
-        if(singleOutputFile) fileName = fFiles[0]   ->GetName();
-        else                 fileName = fFiles[i_ch]->GetName();
-        WriteInfoStatus("TRExFit::WriteHistos","-------------------------------------------");
-        WriteInfoStatus("TRExFit::WriteHistos","Writing histograms to file " + fileName + " ...");
-
-        // find data and get scales per bin if data are weighted
-        std::vector<double> binScales;
-        if (fDataWeighted) {
-            for (const auto& isample : fSamples) {
-                if (isample->fType != Sample::SampleType::DATA) continue;
-                const std::shared_ptr<SampleHist>& sh = fRegions[i_ch]->GetSampleHist(isample->fName);
-                binScales = sh->GetDataScales();
-                break;
-            }
+    if(singleOutputFile) fileName = fFiles[0]   ->GetName();
+    else                 fileName = fFiles[i_ch]->GetName();
+    WriteInfoStatus("TRExFit::WriteHistos","-------------------------------------------");
+    WriteInfoStatus("TRExFit::WriteHistos","Writing histograms to file " + fileName + " ...");
+
+    // find data and get scales per bin if data are weighted
+    std::vector<double> binScales;
+    if (fDataWeighted) {
+        for (const auto& isample : fSamples) {
+            if (isample->fType != Sample::SampleType::DATA) continue;
+            const std::shared_ptr<SampleHist>& sh = fRegions[i_ch]->GetSampleHist(isample->fName);
+            binScales = sh->GetDataScales();
+            break;
         }
+    }
 
-        for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
-            std::shared_ptr<SampleHist> sh = fRegions[i_ch]->GetSampleHist(fSamples[i_smp]->fName);
-            if(!sh){
-                WriteDebugStatus("TRExFit::WriteHistos", "SampleHist[" + std::to_string(i_smp) + "] for sample " + fSamples[i_smp]->fName + " not there.");
-                continue;
+    for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
+        std::shared_ptr<SampleHist> sh = fRegions[i_ch]->GetSampleHist(fSamples[i_smp]->fName);
+        if(!sh){
+            WriteDebugStatus("TRExFit::WriteHistos", "SampleHist[" + std::to_string(i_smp) + "] for sample " + fSamples[i_smp]->fName + " not there.");
+            continue;
+        }
+        // set file and histo names for nominal
+        sh->fHistoName = sh->fHist->GetName();
+        sh->fFileName = fileName;
+        // set file and histo names for systematics
+        for(std::size_t i_syst=0;i_syst<sh->fSyst.size();i_syst++){
+            if(sh->fSyst[i_syst]->fHistUp  ==nullptr) continue;
+            if(sh->fSyst[i_syst]->fHistDown==nullptr) continue;
+            sh->fSyst[i_syst]->fFileNameUp    = fileName;
+            sh->fSyst[i_syst]->fHistoNameUp   = sh->fSyst[i_syst]->fHistUp->GetName();
+            sh->fSyst[i_syst]->fFileNameDown  = fileName;
+            sh->fSyst[i_syst]->fHistoNameDown = sh->fSyst[i_syst]->fHistDown->GetName();
+            if(sh->fSyst[i_syst]->fIsShape){
+                sh->fSyst[i_syst]->fFileNameShapeUp    = fileName;
+                sh->fSyst[i_syst]->fHistoNameShapeUp   = sh->fSyst[i_syst]->fHistShapeUp->GetName();
+                sh->fSyst[i_syst]->fFileNameShapeDown  = fileName;
+                sh->fSyst[i_syst]->fHistoNameShapeDown = sh->fSyst[i_syst]->fHistShapeDown->GetName();
+            }
+        }
+        const std::vector<int>& blindedBins = fRegions[i_ch]->GetAutomaticDropBins() ?
+                Common::GetBlindedBins(fRegions[i_ch],fBlindingType,fBlindingThreshold) : fRegions[i_ch]->fDropBins;
+        const double threshold = fUseStatErr ? fStatErrThres : -1; 
+        if(singleOutputFile) sh->WriteToFile(blindedBins, binScales, threshold, fFiles[0]   , reWriteOrig);
+        else                 sh->WriteToFile(blindedBins, binScales, threshold, fFiles[i_ch], reWriteOrig);
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::WriteHistosAndSystPlots(bool reWriteOrig){
+    if(fMemoryMonitor.GetBudget() <= 0){
+        WriteHistos(reWriteOrig);
+        if(TRExFitter::SYSTCONTROLPLOTS) DrawSystPlots();
+        if(TRExFitter::SYSTDATAPLOT)     DrawSystPlotsSumSamples();
+        return;
+    }
+
+    // with a memory budget the regions are written and plotted one at a time, so that the intermediate histograms
+    // of a region can be released as soon as they are not needed any more
+    if(TRExFitter::SYSTDATAPLOT){
+        WriteInfoStatus("TRExFit::WriteHistosAndSystPlots", "Drawing combined plots of syst effects on data after each region...");
+    }
+    std::unique_ptr<TH1> h_dataCopy(nullptr);
+    for(std::size_t i_ch = 0; i_ch < fRegions.size(); ++i_ch){
+        WriteRegionHistos(i_ch, reWriteOrig);
+        if(TRExFitter::SYSTCONTROLPLOTS){
+            for(const auto& isample : fRegions[i_ch]->fSampleHists) {
+                isample->DrawSystPlot("all");
             }
-            // set file and histo names for nominal
-            sh->fHistoName = sh->fHist->GetName();
-            sh->fFileName = fileName;
-            // set file and histo names for systematics
-            for(std::size_t i_syst=0;i_syst<sh->fSyst.size();i_syst++){
-                if(sh->fSyst[i_syst]->fHistUp  ==nullptr) continue;
-                if(sh->fSyst[i_syst]->fHistDown==nullptr) continue;
-                sh->fSyst[i_syst]->fFileNameUp    = fileName;
-                sh->fSyst[i_syst]->fHistoNameUp   = sh->fSyst[i_syst]->fHistUp->GetName();
-                sh->fSyst[i_syst]->fFileNameDown  = fileName;
-                sh->fSyst[i_syst]->fHistoNameDown = sh->fSyst[i_syst]->fHistDown->GetName();
-                if(sh->fSyst[i_syst]->fIsShape){
-                    sh->fSyst[i_syst]->fFileNameShapeUp    = fileName;
-                    sh->fSyst[i_syst]->fHistoNameShapeUp   = sh->fSyst[i_syst]->fHistShapeUp->GetName();
-                    sh->fSyst[i_syst]->fFileNameShapeDown  = fileName;
-                    sh->fSyst[i_syst]->fHistoNameShapeDown = sh->fSyst[i_syst]->fHistShapeDown->GetName();
-                }
-            }
-            const std::vector<int>& blindedBins = fRegions[i_ch]->GetAutomaticDropBins() ?
-                    Common::GetBlindedBins(fRegions[i_ch],fBlindingType,fBlindingThreshold) : fRegions[i_ch]->fDropBins;
-            const double threshold = fUseStatErr ? fStatErrThres : -1; 
-            if(singleOutputFile) sh->WriteToFile(blindedBins, binScales, threshold, fFiles[0]   , reWriteOrig);
-            else                 sh->WriteToFile(blindedBins, binScales, threshold, fFiles[i_ch], reWriteOrig);
         }
+        if(TRExFitter::SYSTDATAPLOT) DrawRegionSystPlotsSumSamples(fRegions[i_ch], h_dataCopy);
+        if(!fMemoryMonitor.BudgetExceeded()) continue;
+        for(auto& ish : fRegions[i_ch]->fSampleHists){
+            if(!ish) continue;
+            ish->ReleaseIntermediateHistos();
+        }
+        WriteDebugStatus("TRExFit::WriteHistosAndSystPlots", "Memory budget exceeded, released the intermediate histograms of region " + fRegions[i_ch]->fName);
     }
     WriteInfoStatus("TRExFit::WriteHistos","-------------------------------------------");
 }
@@ -767,466 +860,134 @@ void TRExFit::DrawSystPlotsSumSamples() const{
     WriteInfoStatus("TRExFit::DrawSystPlotsSumSamples", "Drawing combined plots of syst effects on data...");
     std::unique_ptr<TH1> h_dataCopy(nullptr);
     for(const auto& reg : fRegions){
-        SampleHist hist{};
-        bool empty = true;
-        std::set<std::string> systNames;
-        for(const auto& isample : reg->fSampleHists) {
-            for(std::size_t i_smSyst=0; i_smSyst < isample->fSyst.size(); i_smSyst++){
-                systNames.insert(isample->fSyst[i_smSyst]->fName);
-            }
-        }
-        for(const auto& isample : reg->fSampleHists){
-            if(isample->fSample->fType==Sample::DATA) h_dataCopy=std::unique_ptr<TH1>(static_cast<TH1*>(isample->fHist->Clone()));
-            else if(isample->fSample->fType==Sample::GHOST) continue;
-            else if(isample->fSample->fType==Sample::EFT) continue;
-            else {
-                double scale = Common::GetNominalMorphScale(isample.get());
-                if(empty){
-                    hist.CloneSampleHist(isample.get(),systNames, scale);
-                    hist.fName = reg->fName + "_Combined";
-                    empty=false;
-                } else {
-                    hist.SampleHistAdd(isample.get(), scale);
-                }
+        DrawRegionSystPlotsSumSamples(reg, h_dataCopy);
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::DrawRegionSystPlotsSumSamples(const Region* reg, std::unique_ptr<TH1>& h_dataCopy) const{
+    SampleHist hist{};
+    bool empty = true;
+    std::set<std::string> systNames;
+    for(const auto& isample : reg->fSampleHists) {
+        for(std::size_t i_smSyst=0; i_smSyst < isample->fSyst.size(); i_smSyst++){
+            systNames.insert(isample->fSyst[i_smSyst]->fName);
+        }
+    }
+    for(const auto& isample : reg->fSampleHists){
+        if(isample->fSample->fType==Sample::DATA) h_dataCopy=std::unique_ptr<TH1>(static_cast<TH1*>(isample->fHist->Clone()));
+        else if(isample->fSample->fType==Sample::GHOST) continue;
+        else if(isample->fSample->fType==Sample::EFT) continue;
+        else {
+            double scale = Common::GetNominalMorphScale(isample.get());
+            if(empty){
+                hist.CloneSampleHist(isample.get(),systNames, scale);
+                hist.fName = reg->fName + "_Combined";
+                empty=false;
+            } else {
+                hist.SampleHistAdd(isample.get(), scale);
             }
         }
-        hist.DrawSystPlot("all", h_dataCopy.get(), true, fSystDataPlot_upFrame);
     }
+    hist.DrawSystPlot("all", h_dataCopy.get(), true, fSystDataPlot_upFrame);
 }
 
 //__________________________________________________________________________________
 // this method takes care of rebinning, smoothing, fixing
 void TRExFit::CorrectHistograms(){
     //
-    // loop on regions, and then perform a set of operations for each of them
-    for(auto reg : fRegions){
-        //
-        // 1. Reset histograms to the ones save as "_orig" (both for nominal and systematics
-        for(auto smp : fSamples){
-            //
-            // eventually skip sample / region combination
-            if( Common::FindInStringVector(smp->fRegions,reg->fName)<0 ) continue;
-            //
-            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-            if(sh==nullptr) continue;
-            if(sh->fHist==nullptr) continue;
-            int fillcolor = sh->fHist->GetFillColor();
-            int linecolor = sh->fHist->GetLineColor();
-            TH1* h_orig = sh->fHist_orig.get();
-            TH1* h = nullptr;
-            if(h_orig!=nullptr) h = (TH1*)h_orig->Clone(sh->fHist->GetName());
-            sh->fHist = std::unique_ptr<TH1>(h);
-            if(sh->fHist==nullptr) continue;
-            sh->fHist->SetLineColor(linecolor);
-            sh->fHist->SetFillColor(fillcolor);
-
-            // Scale MC stat
-            Common::ScaleMCstatInHist(sh->fHist.get(), smp->fMCstatScale);
+    // The regions are independent between the steps that combine several regions (morphing, inter-region smoothing),
+    // so the steps in between are run as one task per region (in parallel if PostProcessingThreads > 1).
+    // Combining samples may add systematics to the samples, which are shared by all regions:
+    // in this case the first pass is run one region at a time, in the config order.
+    const int randomizeSeed = TRExFitter::OPTION["RandomizeMC"];
+    const bool hasMorphing = fMorphParams.size() > 0;
+    const bool propagateMorphing = hasMorphing && fPropagateSystsForMorphing;
+    const bool independentRegions = RegionsAreIndependent();
+    if(!independentRegions && fPostProcessingThreads > 1){
+        WriteInfoStatus("TRExFit::CorrectHistograms", "Combining samples adds systematics to the samples, the histograms of the regions are corrected one region at a time");
+    }
 
-            // loop on systematics
-            for(auto& syst : smp->fSystematics){
-                //
-                // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,reg->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,reg->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,reg->fName, smp->fName)>=0 ) continue;
-                //
-                // skip also separate gamma systs
-                if(syst->fName.find("stat_")!=std::string::npos) continue;
-                //
-                // get the original syst histograms & reset the syst histograms
-                std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
-                //
-                if(syh==nullptr) continue;
-                TH1* hUp_orig   = syh->fHistUp_orig.get();
-                TH1* hDown_orig = syh->fHistDown_orig.get();
-                //
-                // if Overall only => fill SystematicHist
-                if(syst->fType==Systematic::OVERALL){
-                    for(int i_bin=1;i_bin<=h->GetNbinsX();i_bin++){
-                        if(hUp_orig!=nullptr)   hUp_orig  ->SetBinContent(i_bin,h_orig->GetBinContent(i_bin)*(1.+syst->fOverallUp));
-                        if(hDown_orig!=nullptr) hDown_orig->SetBinContent(i_bin,h_orig->GetBinContent(i_bin)*(1.+syst->fOverallDown));
-                    }
-                }
-                //
-                TH1* hUp   = nullptr;
-                TH1* hDown = nullptr;
-                if(hUp_orig!=nullptr)   hUp   = static_cast<TH1*>(hUp_orig->Clone( syh->fHistUp->GetName()));
-                if(hDown_orig!=nullptr) hDown = static_cast<TH1*>(hDown_orig->Clone(syh->fHistDown->GetName()));
-                syh->fHistUp.reset(hUp);
-                syh->fHistDown.reset(hDown);
-            }
-        }
-        //
-        // 2. Rebin
-        for(auto smp : fSamples){
-            //
-            // eventually skip sample / region combination
-            if( Common::FindInStringVector(smp->fRegions,reg->fName)<0 ) continue;
-            //
-            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-            if(sh==nullptr) continue;
-            if(sh->fHist==nullptr) continue;
-            //
-            // Rebinning (FIXME: better to introduce a method Region::Rebin() ?)
-            if(reg->fHistoNBinsRebinPost>0){
-                WriteDebugStatus("TRExFit::CorrectHistograms", "rebinning " + smp->fName + " to " + std::to_string(reg->fHistoNBinsRebinPost) + " bins.");
-                sh->fHist = std::unique_ptr<TH1>(sh->fHist->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
-                for(auto& syh : sh->fSyst){
-                    WriteDebugStatus("TRExFit::CorrectHistograms", "  systematic " + syh->fName + " to " + std::to_string(reg->fHistoNBinsRebinPost) + " bins.");
-                    if(syh==nullptr) continue;
-                    if(syh->fSystematic->fSampleUp==""   && syh->fSystematic->fHasUpVariation   && syh->fHistUp!=nullptr)   syh->fHistUp.reset(syh->fHistUp  ->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
-                    else                                                                                                    syh->fHistUp.reset(static_cast<TH1*>(sh->fHist->Clone(syh->fHistUp->GetName())));
-                    if(syh->fSystematic->fSampleDown=="" && syh->fSystematic->fHasDownVariation && syh->fHistDown!=nullptr) syh->fHistDown.reset(syh->fHistDown->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
-                    else                                                                                                    syh->fHistDown.reset(static_cast<TH1*>(sh->fHist->Clone(syh->fHistDown->GetName())));
-                }
-                //
-                // rebin also separate-gamma hists!
-                if(smp->fSeparateGammas){
-                    std::shared_ptr<SystematicHist> syh = sh->GetSystematic( "stat_"+smp->fName );
-                    if(syh==nullptr) continue;
-                    if(syh->fHistUp!=nullptr)   syh->fHistUp  ->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]);
-                    if(syh->fHistDown!=nullptr) syh->fHistDown->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]);
-                }
-            }
+    //
+    // RandomizeMC draws from gRandom, seeded again for each region. When the regions run in parallel each one gets
+    // its own generator, and gRandom is left in the state of the last region afterwards, so that the following
+    // draws (e.g. PoissonizeData without seed) are the same as for the serial processing
+    const bool parallel = independentRegions && fPostProcessingThreads > 1 && fRegions.size() > 1;
+    std::map<const Region*, std::unique_ptr<TRandom3> > generators;
+    if(randomizeSeed!=0 && parallel){
+        for(const auto reg : fRegions){
+            generators[reg] = std::make_unique<TRandom3>(randomizeSeed);
         }
+    }
 
-        // Randomize MC (before add/multiply/scale)
-        if(TRExFitter::OPTION["RandomizeMC"]!=0){
-            gRandom->SetSeed(TRExFitter::OPTION["RandomizeMC"]);
-            for(auto smp : fSamples){
-                //
-                // eventually skip sample / region combination
-                if( Common::FindInStringVector(smp->fRegions,reg->fName)<0 ) continue;
-                //
-                std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-                if(sh==nullptr) continue;
-                if(sh->fHist==nullptr) continue;
-                //
-                if(smp->fUseMCStat){
-                    TH1* hTmp = sh->fHist.get();
-                    for(int i_bin=1;i_bin<=hTmp->GetNbinsX();i_bin++){
-                        hTmp->SetBinContent(i_bin,gRandom->Poisson( hTmp->GetBinContent(i_bin) ));
-                    }
-                    for(auto& syh : sh->fSyst){
-                        for(int i_ud=0;i_ud<2;i_ud++){
-                            if(i_ud==0) hTmp = syh->fHistUp.get();
-                            else        hTmp = syh->fHistDown.get();
-                            for(int i_bin=1;i_bin<=hTmp->GetNbinsX();i_bin++){
-                                hTmp->SetBinContent(i_bin,gRandom->Poisson( hTmp->GetBinContent(i_bin) ));
-                            }
-                        }
-                    }
-                }
+    //
+    // loop on regions, and then perform a set of operations for each of them
+    // (without morphing, the normalisation and shape of the systematics are dropped in the same task)
+    RunForRegions([this,randomizeSeed,hasMorphing,parallel,&generators](Region* reg){
+        TRandom* random = nullptr;
+        if(randomizeSeed!=0){
+            if(parallel){
+                random = generators.at(reg).get();
+            } else {
+                gRandom->SetSeed(randomizeSeed);
+                random = gRandom;
             }
         }
+        CorrectRegionHistograms(reg,random);
+        if(!hasMorphing) DropSystNormAndShape(reg);
+    }, independentRegions);
+    TRandom3* globalRandom = dynamic_cast<TRandom3*>(gRandom);
+    if(!generators.empty() && globalRandom){
+        *globalRandom = *generators.at(fRegions.back());
+    }
 
-        // 3. Add/Multiply/Scale
-        for(auto smp : fSamples){
-            //
-            // eventually skip sample / region combination
-            if( Common::FindInStringVector(smp->fRegions,reg->fName)<0 ) continue;
-            //
-            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-            if(sh==nullptr) continue;
-            if(sh->fHist==nullptr) continue;
-            int fillcolor = sh->fHist->GetFillColor();
-            int linecolor = sh->fHist->GetLineColor();
-            //
-            // Subtraction / Addition of sample
-            for(auto sample : smp->fSubtractSamples){
-                WriteDebugStatus("TRExFit::CorrectHistograms"," subtracting sample " + sample + " from sample " + smp->fName);
-                std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(sample);
-                if(smph0!=nullptr) sh->Add(smph0.get(),-1);
-                else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+sample+" not found ...");
-            }
-            for(auto sample : smp->fAddSamples){
-                WriteDebugStatus("TRExFit::CorrectHistograms", "adding sample " + sample + " to sample " + smp->fName);
-                std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(sample);
-                if(smph0!=nullptr) sh->Add(smph0.get());
-                else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+sample+" not found ...");
-            }
-            // Division & Multiplication by other samples
-            if(smp->fMultiplyBy!=""){
-                WriteDebugStatus("TRExFit::CorrectHistograms", "multiplying " + smp->fName  + " by sample " + smp->fMultiplyBy);
-                std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fMultiplyBy);
-                if(smph0!=nullptr) sh->Multiply(smph0.get());
-                else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fMultiplyBy+" not found ...");
-            }
-            if(smp->fDivideBy!=""){
-                WriteDebugStatus("TRExFit::CorrectHistograms", "dividing " + smp->fName  + " by sample " + smp->fDivideBy + " from sample " + smp->fName);
-                std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fDivideBy);
-                if(smph0!=nullptr) sh->Divide(smph0.get());
-                else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fDivideBy+" not found ...");
-            }
-            // Norm to sample
-            if(smp->fNormToSample!=""){
-                WriteDebugStatus("TRExFit::CorrectHistograms", "normalizing " + smp->fName  + " to sample " + smp->fNormToSample);
-                std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fNormToSample);
-                if(smph0!=nullptr) sh->Scale(smph0->fHist->Integral()/sh->fHist->Integral());
-                else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fNormToSample+" not found ...");
-            }
-
-            //
-            // For SampleUp / SampleDown
-            for(auto& syst : smp->fSystematics){
-                //
-                // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,reg->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,reg->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,reg->fName, smp->fName)>=0 ) continue;
-                //
-                // get the original syst histograms & reset the syst histograms
-                std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
-                //
-                // if syst defined with SampleUp / SampleDown
-                if( syst->fSampleUp != "" || syst->fSampleDown != "" ){
-                    WriteDebugStatus("TRExFit::CorrectHistograms", "SampleUp/SampleDown set for systematic " + syst->fName + ".");
-                    bool isDummy = ( syst->fDummyForSamples.size()>0 && Common::FindInStringVector(syst->fDummyForSamples,smp->fName)>=0 );
-                    std::unique_ptr<TH1> h_up = nullptr;
-                    if(syst->fSampleUp   !="" && !isDummy){
-                        if(reg->GetSampleHist(syst->fSampleUp  )){
-                            h_up.reset(static_cast<TH1*>(reg->GetSampleHist(syst->fSampleUp  )->fHist->Clone("h_tmp_up")));
-                        }
-                    }
-                    else{
-                        h_up.reset(static_cast<TH1*>(sh->fHist->Clone("h_tmp_up")));
-                    }
-                    std::unique_ptr<TH1> h_down = nullptr;
-                    if(syst->fSampleDown !="" && !isDummy){
-                        if(reg->GetSampleHist(syst->fSampleDown)){
-                            h_down.reset(static_cast<TH1*>(reg->GetSampleHist(syst->fSampleDown)->fHist.get()->Clone("h_tmp_down")));
-                        }
-                    }
-                    else{
-                        h_down.reset(static_cast<TH1*>(sh->fHist.get()->Clone("h_tmp_down")));
-                    }
-                    //
-                    // if systematic also uses ReferenceSample, produce syst variations according to the refefence sample instead of nominal
-                    if(syst->fReferenceSample!=""){
-                        WriteDebugStatus("TRExFit::CorrectHistograms", "ReferenceSample set for a systematic with SampleUp/SampleDown. Building proper systematic variation.");
-                        std::shared_ptr<SampleHist> refSh = reg->GetSampleHist(syst->fReferenceSample);
-                        if(refSh!=nullptr){
-                            if(syst->fSampleUp != ""){
-                                h_up->Divide(refSh->fHist.get());
-                                h_up->Multiply(sh->fHist.get());
-                            }
-                            if(syst->fSampleDown != ""){
-                                h_down->Divide(refSh->fHist.get());
-                                h_down->Multiply(sh->fHist.get());
-                            }
-                        }
-                        else{
-                            WriteWarningStatus("TRExFit::CorrectHistograms","ReferenceSample for systematc " + syst->fName + " set but no corresponding sample found. Ignoring.");
-                        }
-                    }
-                    syh = sh->AddHistoSyst(syst->fName,syst->fStoredName,h_up.get(),h_down.get());
-                    syh->fSystematic = syst;
-                }
-            }
-
-            //
-            // Save to _preSmooth histograms (to be shown in syst plots) at this point
-            sh->fHist_preSmooth.reset(static_cast<TH1*>(sh->fHist->Clone(Form("%s_preSmooth",sh->fHist->GetName()))));
-            sh->fHist_preSmooth->SetDirectory(nullptr);
-            for(auto& syh : sh->fSyst){
-                if(syh!=nullptr){
-                    if(syh->fHistUp!=nullptr)   syh->fHistUp_preSmooth.reset(static_cast<TH1*>(syh->fHistUp->Clone(Form("%s_preSmooth",syh->fHistUp->GetName()))));
-                    else                        syh->fHistUp_preSmooth.reset(static_cast<TH1*>(sh->fHist_preSmooth->Clone()));
-                    syh->fHistUp_preSmooth->SetDirectory(nullptr);
-                    if(syh->fHistDown!=nullptr) syh->fHistDown_preSmooth.reset(static_cast<TH1*>(syh->fHistDown->Clone(Form("%s_preSmooth",syh->fHistDown->GetName()))));
-                    else                        syh->fHistDown_preSmooth.reset(static_cast<TH1*>(sh->fHist_preSmooth->Clone()));
-                    syh->fHistDown_preSmooth->SetDirectory(nullptr);
-                }
-            }
-
-            //
-            // Fix empty bins
-            if(smp->fType!=Sample::DATA && smp->fType!=Sample::SIGNAL){
-                sh->FixEmptyBins(fSuppressNegativeBinWarnings);
-            }
-
-            //
-            // Eventually smooth nominal histogram  (use with caution...)
-            TH1* h_correction = nullptr;
-            bool isFlat = false;
-            if(smp->fSmooth && !reg->fSkipSmoothing){
-                h_correction = (TH1*)sh->fHist->Clone( Form("%s_corr",sh->fHist->GetName()) );
-                TH1* h0 = (TH1*)sh->fHist->Clone( Form("%s_orig0",sh->fHist->GetName()) );
-                if (fSmoothOption == HistoTools::TTBARRESONANCE) {
-                    isFlat = false;
-                    Common::SmoothHistogramTtres( sh->fHist.get() );
-                } else {
-                    isFlat = Common::SmoothHistogram( sh->fHist.get() );
-                }
-                h_correction->Divide( h0 );
-            }
-
-            //
-            // Systematics
-            for(auto& syst : smp->fSystematics){
-                if(syst==nullptr) continue;
-                //
-                // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,reg->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,reg->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,reg->fName, smp->fName)>=0 ) continue;
-                //
-                std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
-                if(syh==nullptr) continue;
-                TH1* hUp   = syh->fHistUp.get();
-                TH1* hDown = syh->fHistDown.get();
-                //
-                // if Overall only, re-create it if smoothing was applied
-                if(syst->fType==Systematic::OVERALL){
-                    if(h_correction!=nullptr && smp->fSmooth){
-                        for(int i_bin=1;i_bin<=sh->fHist->GetNbinsX();i_bin++){
-                            hUp  ->SetBinContent(i_bin,sh->fHist->GetBinContent(i_bin)*(1.+syst->fOverallUp));
-                            hDown->SetBinContent(i_bin,sh->fHist->GetBinContent(i_bin)*(1.+syst->fOverallDown));
-                        }
-                    }
-                    continue;
-                }
-                //
-                // correct according to the sample nominal smoothing
-                if(h_correction!=nullptr && smp->fSmooth){
-                    if(hUp!=nullptr  ) Common::SmoothHistogram( hUp  , isFlat );
-                    if(hDown!=nullptr) Common::SmoothHistogram( hDown, isFlat );
-                }
-
-                //
-                // Histogram smoothing, Symmetrisation, Massaging...
-                if(!reg->fSkipSmoothing) syh -> fSmoothType = syst -> fSmoothType;
-                else                                syh -> fSmoothType = 0;
-                syh -> fSymmetrisationType = syst -> fSymmetrisationType;
-
-            }  // end syst loop
-            //
-            // Histograms checking
-            for(auto& syst : smp->fSystematics){
-                //
-                // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,reg->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,reg->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,reg->fName, smp->fName)>=0 ) continue;
-                if( sh->GetSystematic( syst->fName )==nullptr ) continue;
-                //
-                HistoTools::CheckHistograms( reg->GetSampleHist(smp->fName)->fHist.get() /*nominal*/,
-                                            sh->GetSystematic( syst->fName ).get() /*systematic*/,
-                                            smp->fType!=Sample::SIGNAL/*check bins with content=0*/,
-                                            TRExFitter::HISTOCHECKCRASH /*cause crash if problem*/);
-            }
-
-            // set the fill color
-            sh->fHist->SetFillColor(fillcolor);
-            sh->fHist->SetLineColor(linecolor);
-        } // end sample loop
+    if(hasMorphing){
         //
-    } // end region loop
-
-    //
-    // Morph smoothing
-    if(fSmoothMorphingTemplates!=""){
-        for(auto par : fMorphParams){
-            WriteInfoStatus("TRExFit::CorrectHistograms","Smoothing morphing templates for parameter "+par);
-            if(fSmoothMorphingTemplates=="TRUE") SmoothMorphTemplates(par);
-            else SmoothMorphTemplates(par,fSmoothMorphingTemplates);
-            // to add: possibility to set initial values of parameters
+        // Morph smoothing
+        if(fSmoothMorphingTemplates!=""){
+            for(auto par : fMorphParams){
+                WriteInfoStatus("TRExFit::CorrectHistograms","Smoothing morphing templates for parameter "+par);
+                if(fSmoothMorphingTemplates=="TRUE") SmoothMorphTemplates(par);
+                else SmoothMorphTemplates(par,fSmoothMorphingTemplates);
+                // to add: possibility to set initial values of parameters
+            }
         }
-    }
 
-    //
-    // Plot Morphing templates
-    if (fMorphParams.size() > 0){
+        //
+        // Plot Morphing templates
         gSystem->mkdir((fName+"/Morphing").c_str());
         for(const auto& par : fMorphParams){
             DrawMorphingPlots(par);
         }
-    }
-
-    // drop normalisation part of systematic according to fDropNormIn
-    for(auto reg : fRegions){
-        for(auto& sh : reg->fSampleHists){
-            if(sh->fHist==nullptr) continue;
-            for(auto syst : fSystematics){
-                if(  Common::FindInStringVector(syst->fDropNormIn, reg->fName)>=0
-                  || Common::FindInStringVector(syst->fDropNormIn, sh->fSample->fName)>=0
-                  || Common::FindInStringVector(syst->fDropNormIn, "all")>=0
-                  ){
-                    std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
-                    if(syh==nullptr) continue;
-                    if(sh->fHist->Integral()!=0){
-                        WriteDebugStatus("TRExFit::CorrectHistograms", "  Normalising syst " + syst->fName + " for sample " + sh->fSample->fName);
-                        Common::DropNorm(syh->fHistUp.get(), syh->fHistDown.get(), sh->fHist.get());
-                    }
-                }
-            }
-        }
-    }
 
-    // drop shape part of systematic according to fDropShapeIn
-    for(auto reg : fRegions){
-        for(auto& sh : reg->fSampleHists){
-            if(sh->fHist==nullptr) continue;
-            for(auto syst : fSystematics){
-                if(  Common::FindInStringVector(syst->fDropShapeIn, reg->fName)>=0
-                  || Common::FindInStringVector(syst->fDropShapeIn, sh->fSample->fName)>=0
-                  || Common::FindInStringVector(syst->fDropShapeIn, "all")>=0
-                  ){
-                    std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
-                    if(syh==nullptr) continue;
-                    WriteDebugStatus("TRExFit::CorrectHistograms", "  Removing shape component of syst " + syst->fName + " for sample " + sh->fSample->fName);
-                    Common::DropShape(syh->fHistUp.get(), syh->fHistDown.get(), sh->fHist.get());
-                }
-            }
-        }
+        RunForRegions([this](Region* reg){ DropSystNormAndShape(reg); }, true);
     }
 
     //
-    // Smooth systematics
+    // Smooth systematics (not in parallel: the inter-region smoothing uses the previous regions)
     SmoothSystematics("all");
 
     //
-    // Artifificially set all systematics not to affect overall normalisation for sample or set of samples
-    // (the form should be KeepNormForSamples: ttlight+ttc+ttb,wjets
-    //
-    for(auto reg : fRegions){
-        for(auto syst : fSystematics){
-            if(syst->fKeepNormForSamples.size()==0) continue;
-            for(unsigned int ii=0;ii<syst->fKeepNormForSamples.size();ii++){
-                std::vector<std::string> subSamples = Common::Vectorize(syst->fKeepNormForSamples[ii],'+');
-                // get nominal yield and syst yields for this sum of samples
-                double yieldNominal = 0.;
-                double yieldUp = 0.;
-                double yieldDown = 0.;
-                for(auto smp : fSamples){
-                    if(Common::FindInStringVector(subSamples,smp->fName)<0) continue;
-                    std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-                    if(sh==nullptr) continue;
-                    std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
-                    if(syh==nullptr) continue;
-                    yieldNominal += sh ->fHist    ->Integral();
-                    yieldUp      += syh->fHistUp  ->Integral();
-                    yieldDown    += syh->fHistDown->Integral();
-                }
-                // scale each syst variation
-                for(auto smp : fSamples){
-                    if(Common::FindInStringVector(subSamples,smp->fName)<0) continue;
-                    std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-                    if(sh==nullptr) continue;
-                    std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
-                    if(syh==nullptr) continue;
-                    WriteDebugStatus("TRExFit::CorrectHistograms", "  Normalising syst " + syst->fName + " for sample " + smp->fName);
-                    WriteDebugStatus("TRExFit::CorrectHistograms", "scaling by " + std::to_string(yieldNominal/yieldUp) + " (up), " + std::to_string(yieldNominal/yieldDown) + " (down)");
-                    syh->fHistUp  ->Scale(yieldNominal/yieldUp);
-                    syh->fHistDown->Scale(yieldNominal/yieldDown);
-                }
-            }
+    // the samples taking the systematics from another sample use the systematics
+    for(const auto& smp : fSamples){
+        if(smp->fSystFromSample == "") continue;
+        for(const auto& reg : fRegions){
+            if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+            if(reg->GetSampleHist(smp->fName)==nullptr) continue;
+            smp->fUseSystematics = true;
+            break;
         }
     }
 
+    RunForRegions([this,propagateMorphing](Region* reg){
+        KeepNormForSamples(reg);
+        if(!propagateMorphing) PropagateSystFromSample(reg);
+    }, true);
+
     // Systematics for morphing samples inherited from nominal sample
-    if (fPropagateSystsForMorphing){
+    // (one region at a time: fIsMorph and fMorphValue of the shared samples are filled when accessed)
+    if (propagateMorphing){
         for(auto par : fMorphParams){
             for(auto reg : fRegions){
                 // find nominal morphing sample Hist
@@ -1253,13 +1014,13 @@ void TRExFit::CorrectHistograms(){
                                 syhNew->fSystematic = syst;
                             }
                             else{
-                                TH1* hUpNew   = (TH1*)syh->fHistUp->Clone();
-                                TH1* hDownNew = (TH1*)syh->fHistDown->Clone();
+                                std::unique_ptr<TH1> hUpNew  (static_cast<TH1*>(syh->fHistUp->Clone()));
+                                std::unique_ptr<TH1> hDownNew(static_cast<TH1*>(syh->fHistDown->Clone()));
                                 hUpNew->Divide(shNominal->fHist.get());
                                 hUpNew->Multiply(sh->fHist.get());
                                 hDownNew->Divide(shNominal->fHist.get());
                                 hDownNew->Multiply(sh->fHist.get());
-                                std::shared_ptr<SystematicHist> syhNew = sh->AddHistoSyst(syst->fName,syst->fStoredName,hUpNew,hDownNew);
+                                std::shared_ptr<SystematicHist> syhNew = sh->AddHistoSyst(syst->fName,syst->fStoredName,hUpNew.get(),hDownNew.get());
                                 syhNew->fSystematic = syst;
                                 sh->fSample->fUseSystematics = true;
                             }
@@ -1268,38 +1029,7 @@ void TRExFit::CorrectHistograms(){
                 }
             }
         }
-    }
-
-    // Propagate all systematics from another sample
-    for(auto reg : fRegions){
-        for(auto smp : fSamples){
-            if(smp->fSystFromSample != ""){
-                // eventually skip sample / region combination
-                if( Common::FindInStringVector(smp->fRegions,reg->fName)<0 ) continue;
-                std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
-                if(sh==nullptr) continue;
-                sh->fSample->fUseSystematics = true;
-                //
-                std::shared_ptr<SampleHist> shReference = reg->GetSampleHist(smp->fSystFromSample);
-                for(auto& syh : shReference->fSyst){
-                    std::shared_ptr<Systematic> syst = syh->fSystematic;
-                    if(syst->fIsNormOnly){
-                        std::shared_ptr<SystematicHist> syhNew = sh->AddOverallSyst(syst->fName,syst->fStoredName,syst->fOverallUp,syst->fOverallDown);
-                        syhNew->fSystematic = syst;
-                    }
-                    else{
-                        TH1* hUpNew   = (TH1*)syh->fHistUp->Clone();
-                        TH1* hDownNew = (TH1*)syh->fHistDown->Clone();
-                        hUpNew->Divide(shReference->fHist.get());
-                        hUpNew->Multiply(sh->fHist.get());
-                        hDownNew->Divide(shReference->fHist.get());
-                        hDownNew->Multiply(sh->fHist.get());
-                        std::shared_ptr<SystematicHist> syhNew = sh->AddHistoSyst(syst->fName,syst->fStoredName,hUpNew,hDownNew);
-                        syhNew->fSystematic = syst;
-                    }
-                }
-            }
-        }
+        RunForRegions([this](Region* reg){ PropagateSystFromSample(reg); }, true);
     }
 
     //
@@ -1337,24 +1067,575 @@ void TRExFit::CorrectHistograms(){
 
 //__________________________________________________________________________________
 //
-void TRExFit::CloseInputFiles(){
+void TRExFit::CorrectRegionHistograms(Region* reg, TRandom* random){
     //
-    // Close all input files
-    for(auto& it : TRExFitter::TFILEMAP){
-        TDirectory *dir = gDirectory;
-        std::shared_ptr<TFile> f = it.second;
-        if(f) {
-            dir->cd();
-            f->Close();
+    // 1. Reset histograms to the ones save as "_orig" (both for nominal and systematics
+    for(auto smp : fSamples){
+        //
+        // eventually skip sample / region combination
+        if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+        //
+        std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+        if(sh==nullptr) continue;
+        if(sh->fHist==nullptr) continue;
+        int fillcolor = sh->fHist->GetFillColor();
+        int linecolor = sh->fHist->GetLineColor();
+        TH1* h_orig = sh->fHist_orig.get();
+        TH1* h = nullptr;
+        if(h_orig!=nullptr) h = (TH1*)h_orig->Clone(sh->fHist->GetName());
+        sh->fHist = std::unique_ptr<TH1>(h);
+        if(sh->fHist==nullptr) continue;
+        sh->fHist->SetLineColor(linecolor);
+        sh->fHist->SetFillColor(fillcolor);
+
+        // Scale MC stat
+        Common::ScaleMCstatInHist(sh->fHist.get(), smp->fMCstatScale);
+
+        // loop on systematics
+        for(auto& syst : smp->fSystematics){
+            //
+            // eventually skip systematic / region combination
+            if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,smp.get()) ) continue;
+            //
+            // skip also separate gamma systs
+            if(syst->fName.find("stat_")!=std::string::npos) continue;
+            //
+            // get the original syst histograms & reset the syst histograms
+            std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
+            //
+            if(syh==nullptr) continue;
+            TH1* hUp_orig   = syh->fHistUp_orig.get();
+            TH1* hDown_orig = syh->fHistDown_orig.get();
+            //
+            // if Overall only => fill SystematicHist
+            if(syst->fType==Systematic::OVERALL){
+                for(int i_bin=1;i_bin<=h->GetNbinsX();i_bin++){
+                    if(hUp_orig!=nullptr)   hUp_orig  ->SetBinContent(i_bin,h_orig->GetBinContent(i_bin)*(1.+syst->fOverallUp));
+                    if(hDown_orig!=nullptr) hDown_orig->SetBinContent(i_bin,h_orig->GetBinContent(i_bin)*(1.+syst->fOverallDown));
+                }
+            }
+            //
+            TH1* hUp   = nullptr;
+            TH1* hDown = nullptr;
+            if(hUp_orig!=nullptr)   hUp   = static_cast<TH1*>(hUp_orig->Clone( syh->fHistUp->GetName()));
+            if(hDown_orig!=nullptr) hDown = static_cast<TH1*>(hDown_orig->Clone(syh->fHistDown->GetName()));
+            syh->fHistUp.reset(hUp);
+            syh->fHistDown.reset(hDown);
         }
     }
-    TRExFitter::TFILEMAP.clear();
-}
-
-//__________________________________________________________________________________
-//
-void TRExFit::DrawAndSaveAll(std::string opt){
-    bool isPostFit = opt.find("post")!=std::string::npos;
+    //
+    // 2. Rebin
+    for(auto smp : fSamples){
+        //
+        // eventually skip sample / region combination
+        if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+        //
+        std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+        if(sh==nullptr) continue;
+        if(sh->fHist==nullptr) continue;
+        //
+        // Rebinning (FIXME: better to introduce a method Region::Rebin() ?)
+        if(reg->fHistoNBinsRebinPost>0){
+            WriteDebugStatus("TRExFit::CorrectHistograms", "rebinning " + smp->fName + " to " + std::to_string(reg->fHistoNBinsRebinPost) + " bins.");
+            sh->fHist = std::unique_ptr<TH1>(sh->fHist->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
+            for(auto& syh : sh->fSyst){
+                WriteDebugStatus("TRExFit::CorrectHistograms", "  systematic " + syh->fName + " to " + std::to_string(reg->fHistoNBinsRebinPost) + " bins.");
+                if(syh==nullptr) continue;
+                if(syh->fSystematic->fSampleUp==""   && syh->fSystematic->fHasUpVariation   && syh->fHistUp!=nullptr)   syh->fHistUp.reset(syh->fHistUp  ->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
+                else                                                                                                    syh->fHistUp.reset(static_cast<TH1*>(sh->fHist->Clone(syh->fHistUp->GetName())));
+                if(syh->fSystematic->fSampleDown=="" && syh->fSystematic->fHasDownVariation && syh->fHistDown!=nullptr) syh->fHistDown.reset(syh->fHistDown->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]));
+                else                                                                                                    syh->fHistDown.reset(static_cast<TH1*>(sh->fHist->Clone(syh->fHistDown->GetName())));
+            }
+            //
+            // rebin also separate-gamma hists!
+            if(smp->fSeparateGammas){
+                std::shared_ptr<SystematicHist> syh = sh->GetSystematic( "stat_"+smp->fName );
+                if(syh==nullptr) continue;
+                if(syh->fHistUp!=nullptr)   syh->fHistUp  ->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]);
+                if(syh->fHistDown!=nullptr) syh->fHistDown->Rebin(reg->fHistoNBinsRebinPost,"",&reg->fHistoBinsPost[0]);
+            }
+        }
+    }
+
+    // Randomize MC (before add/multiply/scale)
+    if(random){
+        for(auto smp : fSamples){
+            //
+            // eventually skip sample / region combination
+            if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+            //
+            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+            if(sh==nullptr) continue;
+            if(sh->fHist==nullptr) continue;
+            //
+            if(smp->fUseMCStat){
+                TH1* hTmp = sh->fHist.get();
+                for(int i_bin=1;i_bin<=hTmp->GetNbinsX();i_bin++){
+                    hTmp->SetBinContent(i_bin,random->Poisson( hTmp->GetBinContent(i_bin) ));
+                }
+                for(auto& syh : sh->fSyst){
+                    for(int i_ud=0;i_ud<2;i_ud++){
+                        if(i_ud==0) hTmp = syh->fHistUp.get();
+                        else        hTmp = syh->fHistDown.get();
+                        for(int i_bin=1;i_bin<=hTmp->GetNbinsX();i_bin++){
+                            hTmp->SetBinContent(i_bin,random->Poisson( hTmp->GetBinContent(i_bin) ));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 3. Add/Multiply/Scale
+    for(auto smp : fSamples){
+        //
+        // eventually skip sample / region combination
+        if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+        //
+        std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+        if(sh==nullptr) continue;
+        if(sh->fHist==nullptr) continue;
+        int fillcolor = sh->fHist->GetFillColor();
+        int linecolor = sh->fHist->GetLineColor();
+        //
+        // Subtraction / Addition of sample
+        for(auto sample : smp->fSubtractSamples){
+            WriteDebugStatus("TRExFit::CorrectHistograms"," subtracting sample " + sample + " from sample " + smp->fName);
+            std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(sample);
+            if(smph0!=nullptr) sh->Add(smph0.get(),-1);
+            else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+sample+" not found ...");
+        }
+        for(auto sample : smp->fAddSamples){
+            WriteDebugStatus("TRExFit::CorrectHistograms", "adding sample " + sample + " to sample " + smp->fName);
+            std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(sample);
+            if(smph0!=nullptr) sh->Add(smph0.get());
+            else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+sample+" not found ...");
+        }
+        // Division & Multiplication by other samples
+        if(smp->fMultiplyBy!=""){
+            WriteDebugStatus("TRExFit::CorrectHistograms", "multiplying " + smp->fName  + " by sample " + smp->fMultiplyBy);
+            std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fMultiplyBy);
+            if(smph0!=nullptr) sh->Multiply(smph0.get());
+            else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fMultiplyBy+" not found ...");
+        }
+        if(smp->fDivideBy!=""){
+            WriteDebugStatus("TRExFit::CorrectHistograms", "dividing " + smp->fName  + " by sample " + smp->fDivideBy + " from sample " + smp->fName);
+            std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fDivideBy);
+            if(smph0!=nullptr) sh->Divide(smph0.get());
+            else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fDivideBy+" not found ...");
+        }
+        // Norm to sample
+        if(smp->fNormToSample!=""){
+            WriteDebugStatus("TRExFit::CorrectHistograms", "normalizing " + smp->fName  + " to sample " + smp->fNormToSample);
+            std::shared_ptr<SampleHist> smph0 = reg->GetSampleHist(smp->fNormToSample);
+            if(smph0!=nullptr) sh->Scale(smph0->fHist->Integral()/sh->fHist->Integral());
+            else WriteWarningStatus("TRExFit::CorrectHistograms","Sample Hist of sample "+smp->fNormToSample+" not found ...");
+        }
+
+        //
+        // For SampleUp / SampleDown
+        for(auto& syst : smp->fSystematics){
+            //
+            // eventually skip systematic / region combination
+            if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,smp.get()) ) continue;
+            //
+            // get the original syst histograms & reset the syst histograms
+            std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
+            //
+            // if syst defined with SampleUp / SampleDown
+            if( syst->fSampleUp != "" || syst->fSampleDown != "" ){
+                WriteDebugStatus("TRExFit::CorrectHistograms", "SampleUp/SampleDown set for systematic " + syst->fName + ".");
+                bool isDummy = ( syst->fDummyForSamples.size()>0 && Common::FindInStringVector(syst->fDummyForSamples,smp->fName)>=0 );
+                std::unique_ptr<TH1> h_up = nullptr;
+                if(syst->fSampleUp   !="" && !isDummy){
+                    if(reg->GetSampleHist(syst->fSampleUp  )){
+                        h_up.reset(static_cast<TH1*>(reg->GetSampleHist(syst->fSampleUp  )->fHist->Clone("h_tmp_up")));
+                    }
+                }
+                else{
+                    h_up.reset(static_cast<TH1*>(sh->fHist->Clone("h_tmp_up")));
+                }
+                std::unique_ptr<TH1> h_down = nullptr;
+                if(syst->fSampleDown !="" && !isDummy){
+                    if(reg->GetSampleHist(syst->fSampleDown)){
+                        h_down.reset(static_cast<TH1*>(reg->GetSampleHist(syst->fSampleDown)->fHist.get()->Clone("h_tmp_down")));
+                    }
+                }
+                else{
+                    h_down.reset(static_cast<TH1*>(sh->fHist.get()->Clone("h_tmp_down")));
+                }
+                //
+                // if systematic also uses ReferenceSample, produce syst variations according to the refefence sample instead of nominal
+                if(syst->fReferenceSample!=""){
+                    WriteDebugStatus("TRExFit::CorrectHistograms", "ReferenceSample set for a systematic with SampleUp/SampleDown. Building proper systematic variation.");
+                    std::shared_ptr<SampleHist> refSh = reg->GetSampleHist(syst->fReferenceSample);
+                    if(refSh!=nullptr){
+                        if(syst->fSampleUp != ""){
+                            h_up->Divide(refSh->fHist.get());
+                            h_up->Multiply(sh->fHist.get());
+                        }
+                        if(syst->fSampleDown != ""){
+                            h_down->Divide(refSh->fHist.get());
+                            h_down->Multiply(sh->fHist.get());
+                        }
+                    }
+                    else{
+                        WriteWarningStatus("TRExFit::CorrectHistograms","ReferenceSample for systematc " + syst->fName + " set but no corresponding sample found. Ignoring.");
+                    }
+                }
+                syh = sh->AddHistoSyst(syst->fName,syst->fStoredName,h_up.get(),h_down.get());
+                syh->fSystematic = syst;
+            }
+        }
+
+        //
+        // Save to _preSmooth histograms (to be shown in syst plots) at this point
+        sh->fHist_preSmooth.reset(static_cast<TH1*>(sh->fHist->Clone(Form("%s_preSmooth",sh->fHist->GetName()))));
+        sh->fHist_preSmooth->SetDirectory(nullptr);
+        for(auto& syh : sh->fSyst){
+            if(syh!=nullptr){
+                if(syh->fHistUp!=nullptr)   syh->fHistUp_preSmooth.reset(static_cast<TH1*>(syh->fHistUp->Clone(Form("%s_preSmooth",syh->fHistUp->GetName()))));
+                else                        syh->fHistUp_preSmooth.reset(static_cast<TH1*>(sh->fHist_preSmooth->Clone()));
+                syh->fHistUp_preSmooth->SetDirectory(nullptr);
+                if(syh->fHistDown!=nullptr) syh->fHistDown_preSmooth.reset(static_cast<TH1*>(syh->fHistDown->Clone(Form("%s_preSmooth",syh->fHistDown->GetName()))));
+                else                        syh->fHistDown_preSmooth.reset(static_cast<TH1*>(sh->fHist_preSmooth->Clone()));
+                syh->fHistDown_preSmooth->SetDirectory(nullptr);
+            }
+        }
+
+        //
+        // Fix empty bins
+        if(smp->fType!=Sample::DATA && smp->fType!=Sample::SIGNAL){
+            sh->FixEmptyBins(fSuppressNegativeBinWarnings);
+        }
+
+        //
+        // Eventually smooth nominal histogram  (use with caution...)
+        std::unique_ptr<TH1> h_correction = nullptr;
+        bool isFlat = false;
+        if(smp->fSmooth && !reg->fSkipSmoothing){
+            h_correction.reset(static_cast<TH1*>(sh->fHist->Clone( Form("%s_corr",sh->fHist->GetName()) )));
+            std::unique_ptr<TH1> h0(static_cast<TH1*>(sh->fHist->Clone( Form("%s_orig0",sh->fHist->GetName()) )));
+            if (fSmoothOption == HistoTools::TTBARRESONANCE) {
+                isFlat = false;
+                Common::SmoothHistogramTtres( sh->fHist.get() );
+            } else {
+                isFlat = Common::SmoothHistogram( sh->fHist.get() );
+            }
+            h_correction->Divide( h0.get() );
+        }
+
+        //
+        // Systematics
+        for(auto& syst : smp->fSystematics){
+            if(syst==nullptr) continue;
+            //
+            // eventually skip systematic / region combination
+            if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,smp.get()) ) continue;
+            //
+            std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
+            if(syh==nullptr) continue;
+            TH1* hUp   = syh->fHistUp.get();
+            TH1* hDown = syh->fHistDown.get();
+            //
+            // if Overall only, re-create it if smoothing was applied
+            if(syst->fType==Systematic::OVERALL){
+                if(h_correction!=nullptr && smp->fSmooth){
+                    for(int i_bin=1;i_bin<=sh->fHist->GetNbinsX();i_bin++){
+                        hUp  ->SetBinContent(i_bin,sh->fHist->GetBinContent(i_bin)*(1.+syst->fOverallUp));
+                        hDown->SetBinContent(i_bin,sh->fHist->GetBinContent(i_bin)*(1.+syst->fOverallDown));
+                    }
+                }
+                continue;
+            }
+            //
+            // correct according to the sample nominal smoothing
+            if(h_correction!=nullptr && smp->fSmooth){
+                if(hUp!=nullptr  ) Common::SmoothHistogram( hUp  , isFlat );
+                if(hDown!=nullptr) Common::SmoothHistogram( hDown, isFlat );
+            }
+
+            //
+            // Histogram smoothing, Symmetrisation, Massaging...
+            if(!reg->fSkipSmoothing) syh -> fSmoothType = syst -> fSmoothType;
+            else                                syh -> fSmoothType = 0;
+            syh -> fSymmetrisationType = syst -> fSymmetrisationType;
+
+        }  // end syst loop
+        //
+        // Histograms checking
+        for(auto& syst : smp->fSystematics){
+            //
+            // eventually skip systematic / region combination
+            if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,smp.get()) ) continue;
+            if( sh->GetSystematic( syst->fName )==nullptr ) continue;
+            //
+            HistoTools::CheckHistograms( reg->GetSampleHist(smp->fName)->fHist.get() /*nominal*/,
+                                        sh->GetSystematic( syst->fName ).get() /*systematic*/,
+                                        smp->fType!=Sample::SIGNAL/*check bins with content=0*/,
+                                        TRExFitter::HISTOCHECKCRASH /*cause crash if problem*/);
+        }
+
+        // set the fill color
+        sh->fHist->SetFillColor(fillcolor);
+        sh->fHist->SetLineColor(linecolor);
+    } // end sample loop
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::DropSystNormAndShape(Region* reg) const{
+    // drop normalisation part of systematic according to fDropNormIn
+    for(auto& sh : reg->fSampleHists){
+        if(sh->fHist==nullptr) continue;
+        for(auto syst : fSystematics){
+            if(  Common::FindInStringVector(syst->fDropNormIn, reg->fName)>=0
+              || Common::FindInStringVector(syst->fDropNormIn, sh->fSample->fName)>=0
+              || Common::FindInStringVector(syst->fDropNormIn, "all")>=0
+              ){
+                std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
+                if(syh==nullptr) continue;
+                if(sh->fHist->Integral()!=0){
+                    WriteDebugStatus("TRExFit::CorrectHistograms", "  Normalising syst " + syst->fName + " for sample " + sh->fSample->fName);
+                    Common::DropNorm(syh->fHistUp.get(), syh->fHistDown.get(), sh->fHist.get());
+                }
+            }
+        }
+    }
+
+    // drop shape part of systematic according to fDropShapeIn
+    for(auto& sh : reg->fSampleHists){
+        if(sh->fHist==nullptr) continue;
+        for(auto syst : fSystematics){
+            if(  Common::FindInStringVector(syst->fDropShapeIn, reg->fName)>=0
+              || Common::FindInStringVector(syst->fDropShapeIn, sh->fSample->fName)>=0
+              || Common::FindInStringVector(syst->fDropShapeIn, "all")>=0
+              ){
+                std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
+                if(syh==nullptr) continue;
+                WriteDebugStatus("TRExFit::CorrectHistograms", "  Removing shape component of syst " + syst->fName + " for sample " + sh->fSample->fName);
+                Common::DropShape(syh->fHistUp.get(), syh->fHistDown.get(), sh->fHist.get());
+            }
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::KeepNormForSamples(Region* reg) const{
+    //
+    // Artifificially set all systematics not to affect overall normalisation for sample or set of samples
+    // (the form should be KeepNormForSamples: ttlight+ttc+ttb,wjets
+    //
+    for(auto syst : fSystematics){
+        if(syst->fKeepNormForSamples.size()==0) continue;
+        for(unsigned int ii=0;ii<syst->fKeepNormForSamples.size();ii++){
+            std::vector<std::string> subSamples = Common::Vectorize(syst->fKeepNormForSamples[ii],'+');
+            // get nominal yield and syst yields for this sum of samples
+            double yieldNominal = 0.;
+            double yieldUp = 0.;
+            double yieldDown = 0.;
+            for(auto smp : fSamples){
+                if(Common::FindInStringVector(subSamples,smp->fName)<0) continue;
+                std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+                if(sh==nullptr) continue;
+                std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
+                if(syh==nullptr) continue;
+                yieldNominal += sh ->fHist    ->Integral();
+                yieldUp      += syh->fHistUp  ->Integral();
+                yieldDown    += syh->fHistDown->Integral();
+            }
+            // scale each syst variation
+            for(auto smp : fSamples){
+                if(Common::FindInStringVector(subSamples,smp->fName)<0) continue;
+                std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+                if(sh==nullptr) continue;
+                std::shared_ptr<SystematicHist> syh = sh->GetSystematic(syst->fName);
+                if(syh==nullptr) continue;
+                WriteDebugStatus("TRExFit::CorrectHistograms", "  Normalising syst " + syst->fName + " for sample " + smp->fName);
+                WriteDebugStatus("TRExFit::CorrectHistograms", "scaling by " + std::to_string(yieldNominal/yieldUp) + " (up), " + std::to_string(yieldNominal/yieldDown) + " (down)");
+                syh->fHistUp  ->Scale(yieldNominal/yieldUp);
+                syh->fHistDown->Scale(yieldNominal/yieldDown);
+            }
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::PropagateSystFromSample(Region* reg) const{
+    // Propagate all systematics from another sample
+    for(auto smp : fSamples){
+        if(smp->fSystFromSample != ""){
+            // eventually skip sample / region combination
+            if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+            if(sh==nullptr) continue;
+            std::shared_ptr<SampleHist> shReference = reg->GetSampleHist(smp->fSystFromSample);
+            for(auto& syh : shReference->fSyst){
+                std::shared_ptr<Systematic> syst = syh->fSystematic;
+                if(syst->fIsNormOnly){
+                    std::shared_ptr<SystematicHist> syhNew = sh->AddOverallSyst(syst->fName,syst->fStoredName,syst->fOverallUp,syst->fOverallDown);
+                    syhNew->fSystematic = syst;
+                }
+                else{
+                    std::unique_ptr<TH1> hUpNew  (static_cast<TH1*>(syh->fHistUp->Clone()));
+                    std::unique_ptr<TH1> hDownNew(static_cast<TH1*>(syh->fHistDown->Clone()));
+                    hUpNew->Divide(shReference->fHist.get());
+                    hUpNew->Multiply(sh->fHist.get());
+                    hDownNew->Divide(shReference->fHist.get());
+                    hDownNew->Multiply(sh->fHist.get());
+                    std::shared_ptr<SystematicHist> syhNew = sh->AddHistoSyst(syst->fName,syst->fStoredName,hUpNew.get(),hDownNew.get());
+                    syhNew->fSystematic = syst;
+                }
+            }
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+bool TRExFit::RegionsAreIndependent() const{
+    // SampleHist::Add, Multiply and Divide add to the Sample the systematics of the other sample that it does not have
+    for(const auto& reg : fRegions){
+        for(const auto& smp : fSamples){
+            if(!smp->fUseSystematics) continue;
+            std::vector<std::string> others = smp->fSubtractSamples;
+            others.insert(others.end(), smp->fAddSamples.begin(), smp->fAddSamples.end());
+            if(smp->fMultiplyBy!="") others.emplace_back(smp->fMultiplyBy);
+            if(smp->fDivideBy!="")   others.emplace_back(smp->fDivideBy);
+            if(others.empty()) continue;
+            if( !fMembershipIndex.SampleInRegion(smp.get(),reg) ) continue;
+            std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
+            if(sh==nullptr) continue;
+            std::set<std::string> nuisPars;
+            for(const auto& syh : sh->fSyst){
+                if(syh->fSystematic!=nullptr) nuisPars.insert(syh->fSystematic->fNuisanceParameter);
+            }
+            for(const auto& other : others){
+                std::shared_ptr<SampleHist> shOther = reg->GetSampleHist(other);
+                if(shOther==nullptr) continue;
+                for(const auto& syh : shOther->fSyst){
+                    if(syh->fSystematic==nullptr || nuisPars.count(syh->fSystematic->fNuisanceParameter)==0) return false;
+                }
+                // the SampleUp/SampleDown systematics are built in the same pass
+                for(const auto& syst : shOther->fSample->fSystematics){
+                    if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,shOther->fSample) ) continue;
+                    if(nuisPars.count(syst->fNuisanceParameter)==0) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::RunForRegions(const std::function<void(Region*)>& task, const bool parallel) const{
+    const int nThreads = parallel ? std::min(fPostProcessingThreads, static_cast<int>(fRegions.size())) : 1;
+    if(nThreads <= 1){
+        for(auto reg : fRegions){
+            task(reg);
+        }
+        return;
+    }
+
+    ROOT::EnableThreadSafety();
+    // the histograms created in the threads must not be attached to the current directory
+    const bool addDirectory = TH1::AddDirectoryStatus();
+    TH1::AddDirectory(kFALSE);
+    std::atomic<std::size_t> next{0};
+    auto worker = [this,&task,&next](){
+        for(std::size_t i_reg = next++; i_reg < fRegions.size(); i_reg = next++){
+            task(fRegions[i_reg]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(int ithread = 0; ithread < nThreads; ++ithread){
+        threads.emplace_back(worker);
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    TH1::AddDirectory(addDirectory);
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::CloseInputFiles(){
+    //
+    // Close all input files
+    for(auto& it : TRExFitter::TFILEMAP){
+        TDirectory *dir = gDirectory;
+        std::shared_ptr<TFile> f = it.second;
+        if(f) {
+            dir->cd();
+            f->Close();
+        }
+    }
+    TRExFitter::TFILEMAP.clear();
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::MemoryCheckpoint(const std::string& stage){
+    if(!fMemoryMonitor.IsEnabled()) return;
+
+    fMemoryMonitor.Checkpoint(stage, CountHistogramsInMemory());
+
+    if(fMemoryMonitor.BudgetExceeded()){
+        WriteWarningStatus("TRExFit::MemoryCheckpoint", "Memory budget of " + std::to_string(static_cast<int>(fMemoryMonitor.GetBudget())) +
+                                                        " MB exceeded after stage " + stage + ", releasing intermediate histograms");
+        ReleaseIntermediateHistograms();
+        fMemoryMonitor.Checkpoint(stage + "_release", CountHistogramsInMemory());
+    }
+
+    gSystem->mkdir(fName.c_str());
+    fMemoryMonitor.WriteToFile(fName+"/MemoryUsage"+fSuffix+".txt");
+    fMemoryBudgetWarned = false;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::CheckMemoryBudget(const std::string& stage){
+    if(fMemoryMonitor.GetBudget() <= 0 || fMemoryBudgetWarned) return;
+    if(!fMemoryMonitor.BudgetExceeded()) return;
+
+    fMemoryBudgetWarned = true;
+    fMemoryMonitor.Checkpoint(stage, CountHistogramsInMemory());
+    WriteWarningStatus("TRExFit::CheckMemoryBudget", "Memory budget of " + std::to_string(static_cast<int>(fMemoryMonitor.GetBudget())) +
+                                                     " MB exceeded at stage " + stage + ", the intermediate histograms of each region will be released once it is written");
+    WriteWarningStatus("TRExFit::CheckMemoryBudget", "    Consider splitting the job (e.g. with Regions/Samples on the command line) if the step runs out of memory");
+}
+
+//__________________________________________________________________________________
+//
+long int TRExFit::CountHistogramsInMemory() const{
+    long int n = 0;
+    for(const auto& ireg : fRegions){
+        for(const auto& ish : ireg->fSampleHists){
+            if(!ish) continue;
+            n += ish->CountHistograms();
+        }
+    }
+    return n;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::ReleaseIntermediateHistograms(){
+    for(auto& ireg : fRegions){
+        for(auto& ish : ireg->fSampleHists){
+            if(!ish) continue;
+            ish->ReleaseIntermediateHistos();
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::DrawAndSaveAll(std::string opt){
+    bool isPostFit = opt.find("post")!=std::string::npos;
     //
     // Scale sample(s) to data (only pre-fit)
     if(!isPostFit && fScaleSamplesToData.size()>0){
@@ -1937,7 +2218,9 @@ std::shared_ptr<TRExPlot> TRExFit::DrawSummary(std::string opt, std::shared_ptr<
                 for(auto sample : fSamples){
                     // set gamma name
                     if(!sample->fSeparateGammas) continue;
-                    std::string gammaName = Form("shape_stat_%s_%s_bin_%d",sample->fName.c_str(),region->fName.c_str(),i_bin-1);
+                    std::string gammaName = Form("shape_stat_%s_%s_bin_%d",sample->SeparateGammasSample().c_str(),region->fName.c_str(),i_bin-1);
+                    // samples with correlated gammas share them
+                    if(Common::FindInStringVector(npNames,gammaName)>=0) continue;
                     npNames.push_back(gammaName);
                     i_np++;
                     systNames.push_back( gammaName );
@@ -2524,6 +2807,41 @@ void TRExFit::BuildYieldTable(std::string opt, std::string group) const{
         }
     }
     //
+    // sampled post-fit band: one sampler for all the regions, so that the correlations between regions are kept
+    const bool useSampling = isPostFit && fPostFitBandSampling;
+    std::unique_ptr<PostFitBandSampler> sampler(nullptr);
+    std::vector<std::vector<std::size_t> > smpOutputs(fSamples.size());
+    std::vector<std::size_t> totOutputs;
+    if(useSampling){
+        sampler = std::make_unique<PostFitBandSampler>(fFitResults);
+        sampler->SetNDraws(fPostFitBandDraws);
+        sampler->SetSeed(fPostFitBandSeed);
+        sampler->SetNThreads(fPostFitBandThreads);
+        for(int i_bin=1;i_bin<=Nbin;i_bin++){
+            const Region* reg = fRegions[regionVec[i_bin-1]];
+            const std::vector<std::vector<std::size_t> > yieldIdx = reg->AddPostFitYieldsToSampler(fFitResults, sampler.get());
+            std::vector<std::vector<std::size_t> > smpYields(fSamples.size());
+            std::vector<std::size_t> totYields;
+            for(std::size_t i_sh = 0; i_sh < reg->fSampleHists.size(); ++i_sh){
+                if(yieldIdx[i_sh].empty()) continue;
+                const Sample* smp = reg->fSampleHists[i_sh]->fSample;
+                for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
+                    if(fSamples[i_smp]->fName!=smp->fName) continue;
+                    smpYields[idxVec[i_smp]].insert(smpYields[idxVec[i_smp]].end(), yieldIdx[i_sh].begin(), yieldIdx[i_sh].end());
+                    break;
+                }
+                // same samples as in fTot_postFit
+                if(smp->fType==Sample::SIGNAL && !(TRExFitter::SHOWSTACKSIG && TRExFitter::ADDSTACKSIG)) continue;
+                totYields.insert(totYields.end(), yieldIdx[i_sh].begin(), yieldIdx[i_sh].end());
+            }
+            for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
+                smpOutputs[i_smp].emplace_back(sampler->AddOutput(smpYields[i_smp]));
+            }
+            totOutputs.emplace_back(sampler->AddOutput(totYields));
+        }
+        sampler->Run();
+    }
+    //
     // add tot uncertainty on each sample
     int i_np = -1;
     for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
@@ -2531,6 +2849,10 @@ void TRExFit::BuildYieldTable(std::string opt, std::string group) const{
         if(fSamples[i_smp]->fType==Sample::EFT) continue;
         if(idxVec[i_smp]!=i_smp) continue;
         if(fSamples[i_smp]->fType==Sample::DATA) continue;
+        if(useSampling){
+            g_err[i_smp] = sampler->GetBand(h_smp[i_smp].get(), smpOutputs[i_smp]);
+            continue;
+        }
         name = fSamples[i_smp]->fName;
         // build the vectors of variations
         std::vector< std::shared_ptr<TH1> > h_up;
@@ -2783,8 +3105,9 @@ void TRExFit::BuildYieldTable(std::string opt, std::string group) const{
         }
     }
     //
-    if(isPostFit)  g_err_tot = BuildTotError( h_tot.get(), h_up, h_down, npNames, fFitResults->fCorrMatrix.get() );
-    else           g_err_tot = BuildTotError( h_tot.get(), h_up, h_down, npNames );
+    if(useSampling)    g_err_tot = sampler->GetBand( h_tot.get(), totOutputs );
+    else if(isPostFit) g_err_tot = BuildTotError( h_tot.get(), h_up, h_down, npNames, fFitResults->fCorrMatrix.get() );
+    else               g_err_tot = BuildTotError( h_tot.get(), h_up, h_down, npNames );
     //
     if(TRExFitter::SHOWSTACKSIG && TRExFitter::ADDSTACKSIG) out << " | Total | ";
     else                                                    out << " | Tot.Bkg. | ";
@@ -3317,45 +3640,50 @@ void TRExFit::CreateCustomAsimov() const {
             customAsimovList.push_back(isample->fAsimovReplacementFor.first);
         }
     }
-    //
-    // fill a different CustomAsimov data-set for each element in the list
+    if(customAsimovList.empty()) return;
+    std::vector<std::shared_ptr<Sample> > customAsimovSamples;
     for(const auto& customAsimov : customAsimovList){
         WriteDebugStatus("TRExFit::CreateCustomAsimov", "CustomAsimov: " + customAsimov);
-        std::shared_ptr<Sample> ca = GetSample("customAsimov_"+customAsimov);
-        // create a new data sample taking the nominal S and B
-        for(const auto& ireg : fRegions) {
-            // Now we need to clone a histogram, but need to find one that is valid
-            std::shared_ptr<SampleHist> sample_hist = ireg->fData;
-            if (!sample_hist) {
-                // try to clone signal
-                for (const auto& isig : ireg->fSig) {
-                    if (isig != nullptr) {
-                        sample_hist = isig;
-                        break;
-                    }
+        customAsimovSamples.emplace_back(GetSample("customAsimov_"+customAsimov));
+    }
+    //
+    // all the CustomAsimov data-sets are weighted sums of the same sample yields:
+    // the weights are computed first, then the samples are read once per region
+    for(const auto& ireg : fRegions) {
+        // Now we need to clone a histogram, but need to find one that is valid
+        std::shared_ptr<SampleHist> sample_hist = ireg->fData;
+        if (!sample_hist) {
+            // try to clone signal
+            for (const auto& isig : ireg->fSig) {
+                if (isig != nullptr) {
+                    sample_hist = isig;
+                    break;
                 }
             }
-            if (!sample_hist) {
-                // try to clone background
-                for (const auto& ibkg : ireg->fBkg) {
-                    if (ibkg != nullptr) {
-                        sample_hist = ibkg;
-                        break;
-                    }
+        }
+        if (!sample_hist) {
+            // try to clone background
+            for (const auto& ibkg : ireg->fBkg) {
+                if (ibkg != nullptr) {
+                    sample_hist = ibkg;
+                    break;
                 }
             }
+        }
 
-            if (!sample_hist) {
-                WriteErrorStatus("TRExFit::CreateCustomAsimov","Cannot copy a valid sample hist!");
-                exit(EXIT_FAILURE);
-            }
-
-            std::shared_ptr<SampleHist> cash = ireg->SetSampleHist(ca.get(),static_cast<TH1*>(sample_hist->fHist->Clone()));
-            cash->fHist_orig->SetName( Form("%s_orig",cash->fHist->GetName()) ); // fix the name
-            cash->fHist->Scale(0.);
-            //
+        if (!sample_hist) {
+            WriteErrorStatus("TRExFit::CreateCustomAsimov","Cannot copy a valid sample hist!");
+            exit(EXIT_FAILURE);
+        }
+        //
+        // weight of each sample for each CustomAsimov (0 if the sample is not included)
+        std::vector<std::vector<double> > weights(customAsimovList.size(), std::vector<double>(fSamples.size(), 0.));
+        std::vector<bool> used(fSamples.size(), false);
+        for(std::size_t i_ca = 0; i_ca < customAsimovList.size(); ++i_ca){
+            const std::string& customAsimov = customAsimovList[i_ca];
             std::vector<std::string> smpToExclude;
-            for(const auto& isample : fSamples) {
+            for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
+                const auto& isample = fSamples[i_smp];
                 std::shared_ptr<SampleHist> h = ireg->GetSampleHist(isample->fName);
                 if(!h) continue;
                 if(h->fSample->fType==Sample::DATA) continue;
@@ -3374,11 +3702,50 @@ void TRExFit::CreateCustomAsimov() const {
                     }
                 }
                 //
-                cash->fHist->Add(h->fHist.get(),factor);
+                weights[i_ca][i_smp] = factor;
+                used[i_smp] = true;
             }
-            cash->fHist->Sumw2(false);
         }
-    }
+        //
+        // one pass over the samples, filling all the CustomAsimov at once
+        const int nCells = sample_hist->fHist->GetNcells();
+        std::vector<std::vector<double> > yields(customAsimovList.size(), std::vector<double>(nCells, 0.));
+        for(std::size_t i_smp = 0; i_smp < fSamples.size(); ++i_smp) {
+            if(!used[i_smp]) continue;
+            const TH1* h = ireg->GetSampleHist(fSamples[i_smp]->fName)->fHist.get();
+            for(int i_cell = 0; i_cell < nCells; ++i_cell) {
+                const double content = h->GetBinContent(i_cell);
+                if(content == 0) continue;
+                for(std::size_t i_ca = 0; i_ca < customAsimovList.size(); ++i_ca){
+                    yields[i_ca][i_cell] += weights[i_ca][i_smp]*content;
+                }
+            }
+        }
+        //
+        // create a new data sample for each CustomAsimov
+        for(std::size_t i_ca = 0; i_ca < customAsimovList.size(); ++i_ca){
+            std::shared_ptr<SampleHist> cash = ireg->SetSampleHist(customAsimovSamples[i_ca].get(),static_cast<TH1*>(sample_hist->fHist->Clone()));
+            cash->fHist_orig->SetName( Form("%s_orig",cash->fHist->GetName()) ); // fix the name
+            cash->fHist->Reset();
+            for(int i_cell = 0; i_cell < nCells; ++i_cell) {
+                cash->fHist->SetBinContent(i_cell, yields[i_ca][i_cell]);
+            }
+            cash->fHist->Sumw2(false);
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+std::string TRExFit::ObservedDataName(RooWorkspace* ws) const {
+    if(fCustomAsimov == "") return "obsData";
+    const std::string name = "customAsimov_"+fCustomAsimov;
+    if(ws && ws->data(name.c_str())) {
+        WriteDebugStatus("TRExFit::ObservedDataName", "Using the data-set " + name + " as observed data");
+        return name;
+    }
+    WriteWarningStatus("TRExFit::ObservedDataName", "No Custom Asimov " + fCustomAsimov + " in the workspace. Using obsData.");
+    return "obsData";
 }
 
 //__________________________________________________________________________________
@@ -3430,7 +3797,7 @@ void TRExFit::UnfoldingAlternativeAsimov() {
             std::shared_ptr<SampleHist> sampleHist = ireg->GetSampleHist(isample->fName);
             if (!sampleHist) continue;
             if (sampleHist->fSample->fType != Sample::BACKGROUND) continue;
-            if(Common::FindInStringVector(isample->fRegions,ireg->fName) <0) continue;
+            if(!fMembershipIndex.SampleInRegion(isample.get(),ireg)) continue;
             hist->Add(sampleHist->fHist.get());
         }
 
@@ -3467,12 +3834,26 @@ void TRExFit::ToRooStats(bool makeWorkspace, bool exportOnly) const {
         meas.SetLumiRelErr(fLumiErr);
     }
 
+    // with ResponseMatrixPdf, the histograms of the response samples are written next to the workspaces
+    const std::string responseFileName = meas.GetOutputFilePrefix()+"_ResponseMatrix.root";
+    std::vector<ResponseMatrix> responses;
+    if(fUnfoldingResponseMatrixPdf) std::remove(responseFileName.c_str());
+
     for(std::size_t i_ch = 0; i_ch < fRegions.size(); ++i_ch) {
 
         if(fRegions[i_ch]->fRegionType==Region::VALIDATION) continue;
 
         WriteDebugStatus("TRExFit::ToRooStats", "Adding Channel: " + fRegions[i_ch]->fName);
-        const RooStats::HistFactory::Channel chan = OneChannelToRooStats(&meas, i_ch);
+        RooStats::HistFactory::Channel chan = OneChannelToRooStats(&meas, i_ch);
+
+        if(fUnfoldingResponseMatrixPdf) {
+            RooStats::HistFactory::Sample sample;
+            ResponseMatrix response;
+            if(ResponseSampleToRooStats(&meas, i_ch, responseFileName, &sample, &response)) {
+                chan.AddSample(sample);
+                responses.emplace_back(std::move(response));
+            }
+        }
 
         meas.AddChannel(chan);
     }
@@ -3492,6 +3873,59 @@ void TRExFit::ToRooStats(bool makeWorkspace, bool exportOnly) const {
             meas.AddPreprocessFunction(nf->fName,nf->fExpression.first,nf->fExpression.second);
         }
     }
+    // the norm factors of the truth bins are only used by the response-matrix functions, which are added
+    // once the workspaces are built: they are created by a function of them (equal to 1) attached to the response samples
+    if(!responses.empty()){
+        // parameters already created by the functions above
+        std::set<std::string> created;
+        std::vector<std::string> dependents;
+        for(const auto& itemp : fTemplateWeightVec) dependents.emplace_back(itemp.range);
+        for(const auto& nf : fNormFactors){
+            if(nf->fExpression.first=="") continue;
+            created.insert(nf->fName);
+            dependents.emplace_back(nf->fExpression.second);
+        }
+        for(const auto& idep : dependents){
+            int depth = 0;
+            std::string name;
+            for(const char c : idep + ","){
+                if(c=='[') ++depth;
+                if(c==']') --depth;
+                if(depth==0 && c==','){
+                    created.insert(Common::ReplaceString(name.substr(0, name.find('[')), " ", ""));
+                    name.clear();
+                } else {
+                    name += c;
+                }
+            }
+        }
+        std::vector<std::string> names;
+        for(const auto& iresponse : responses){
+            for(const auto& icoef : iresponse.coefficients){
+                for(const auto& inorm : icoef){
+                    if(Common::FindInStringVector(names,inorm)<0) names.emplace_back(inorm);
+                }
+            }
+        }
+        std::string expression = "1";
+        std::string declarations;
+        for(const auto& iname : names){
+            expression += (iname==names.front() ? "+0*(" : "+") + iname;
+            if(!declarations.empty()) declarations += ",";
+            if(created.count(iname)>0){
+                declarations += iname;
+                continue;
+            }
+            auto it = std::find_if(fNormFactors.begin(), fNormFactors.end(), [&iname](const std::shared_ptr<NormFactor>& nf){return nf->fName==iname;});
+            if(it==fNormFactors.end()){
+                WriteErrorStatus("TRExFit::ToRooStats", "Cannot find the norm factor " + iname + " of the response matrices");
+                exit(EXIT_FAILURE);
+            }
+            declarations += iname+"["+std::to_string((*it)->fNominal)+","+std::to_string((*it)->fMin)+","+std::to_string((*it)->fMax)+"]";
+        }
+        if(!names.empty()) expression += ")";
+        meas.AddPreprocessFunction("ResponseMatrixCoefficients", expression, declarations);
+    }
     //
     if(fBootstrap!="" && fBootstrapIdx>=0) {
         meas.PrintXML((fName+"/RooStats/"+fBootstrapSyst+fBootstrapSample+"_BSId"+Form("%d",fBootstrapIdx)+"/").c_str());
@@ -3501,9 +3935,146 @@ void TRExFit::ToRooStats(bool makeWorkspace, bool exportOnly) const {
     meas.CollectHistograms();
     meas.PrintTree();
 
-    if(makeWorkspace) RooStats::HistFactory::MakeModelAndMeasurementFast(meas);
+    if(makeWorkspace){
+        // the fits run by MakeModelAndMeasurementFast when not in export-only mode are not done by the workers
+        bool done = false;
+        if(fWorkspaceWorkers > 1 && exportOnly && meas.GetChannels().size() > 1){
+            done = MakeModelInParallel(meas);
+            if(!done){
+                if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+                WriteWarningStatus("TRExFit::ToRooStats", "One of the workspace workers failed, building the workspaces sequentially");
+                if (TRExFitter::DEBUGLEVEL < 2) std::cout.setstate(std::ios_base::failbit);
+            }
+        }
+        if(!done) {
+            RooStats::HistFactory::MakeModelAndMeasurementFast(meas);
+            CombineAdditionalData(meas);
+        }
+    }
 
     if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+
+    if(makeWorkspace && !responses.empty()) InsertResponseMatrices(meas, responses);
+}
+
+//__________________________________________________________________________________
+//
+bool TRExFit::MakeModelInParallel(RooStats::HistFactory::Measurement& meas) const {
+    std::vector<RooStats::HistFactory::Channel>& channels = meas.GetChannels();
+    const std::size_t nWorkers = std::min(static_cast<std::size_t>(fWorkspaceWorkers), channels.size());
+    const std::string prefix = meas.GetOutputFilePrefix();
+    const std::string measName = meas.GetName();
+    auto channelFileName = [&prefix,&measName](const std::string& chName){
+        return prefix+"_"+chName+"_"+measName+"_model.root";
+    };
+
+    // each worker builds every nWorkers-th channel, the workspaces are written to the same files as by MakeModelAndMeasurementFast
+    const bool success = Common::RunInWorkers(nWorkers, [&](const std::size_t iworker){
+        RooStats::HistFactory::HistoToWorkspaceFactoryFast factory(meas);
+        for (std::size_t i_ch = iworker; i_ch < channels.size(); i_ch += nWorkers) {
+            RooStats::HistFactory::Channel& channel = channels.at(i_ch);
+            if (!channel.CheckHistograms()) return false;
+            const std::string fileName = channelFileName(channel.GetName());
+            std::unique_ptr<RooWorkspace> ws(factory.MakeSingleChannelModel(meas, channel));
+            if (!ws) return false;
+            ws->writeToFile(fileName.c_str());
+
+            // the measurement with only this channel is stored with the workspace
+            RooStats::HistFactory::Measurement measChannel(meas);
+            measChannel.GetChannels().clear();
+            measChannel.GetChannels().push_back(channel);
+            std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(), "UPDATE"));
+            if (!f || f->IsZombie()) return false;
+            measChannel.writeToFile(f.get());
+            f->Close();
+        }
+        return true;
+    });
+    if (!success) return false;
+
+    // combine the single-channel workspaces, in the order of the channels
+    std::vector<std::unique_ptr<TFile> > files;
+    std::vector<RooWorkspace*> workspaces;
+    std::vector<std::string> chNames;
+    for (const auto& channel : channels) {
+        const std::string fileName = channelFileName(channel.GetName());
+        files.emplace_back(TFile::Open(fileName.c_str()));
+        RooWorkspace* ws = files.back() ? static_cast<RooWorkspace*>(files.back()->Get(channel.GetName().c_str())) : nullptr;
+        if (!ws) {
+            for (auto& iws : workspaces) {
+                delete iws;
+            }
+            return false;
+        }
+        workspaces.emplace_back(ws);
+        chNames.emplace_back(channel.GetName());
+    }
+
+    RooStats::HistFactory::HistoToWorkspaceFactoryFast factory(meas);
+    std::unique_ptr<RooWorkspace> ws(factory.MakeCombinedModel(chNames, workspaces));
+    RooStats::HistFactory::HistoToWorkspaceFactoryFast::ConfigureWorkspaceForMeasurement("simPdf", ws.get(), meas);
+    WorkspaceCombiner::AddAdditionalData(ws.get(), chNames, workspaces);
+
+    const std::string combinedFileName = prefix+"_combined_"+measName+"_model.root";
+    ws->writeToFile(combinedFileName.c_str());
+    std::unique_ptr<TFile> combinedFile(TFile::Open(combinedFileName.c_str(), "UPDATE"));
+    meas.writeToFile(combinedFile.get());
+    combinedFile->Close();
+
+    for (auto& iws : workspaces) {
+        delete iws;
+    }
+    for (auto& ifile : files) {
+        ifile->Close();
+    }
+
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::CombineAdditionalData(RooStats::HistFactory::Measurement& meas) const {
+    bool hasAdditionalData = false;
+    for(auto& channel : meas.GetChannels()) {
+        if(!channel.GetAdditionalData().empty()) {
+            hasAdditionalData = true;
+            break;
+        }
+    }
+    if(!hasAdditionalData) return;
+
+    const std::string prefix = meas.GetOutputFilePrefix();
+    const std::string measName = meas.GetName();
+
+    std::vector<std::unique_ptr<TFile> > files;
+    std::vector<std::unique_ptr<RooWorkspace> > channelWorkspaces;
+    std::vector<RooWorkspace*> workspaces;
+    std::vector<std::string> chNames;
+    for(auto& channel : meas.GetChannels()) {
+        const std::string fileName = prefix+"_"+channel.GetName()+"_"+measName+"_model.root";
+        files.emplace_back(TFile::Open(fileName.c_str()));
+        RooWorkspace* ws = files.back() ? dynamic_cast<RooWorkspace*>(files.back()->Get(channel.GetName().c_str())) : nullptr;
+        if(!ws) {
+            if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+            WriteErrorStatus("TRExFit::CombineAdditionalData", "Cannot read the workspace of region " + channel.GetName() + " from " + fileName);
+            exit(EXIT_FAILURE);
+        }
+        channelWorkspaces.emplace_back(ws);
+        workspaces.emplace_back(ws);
+        chNames.emplace_back(channel.GetName());
+    }
+
+    const std::string combinedFileName = prefix+"_combined_"+measName+"_model.root";
+    std::unique_ptr<TFile> combinedFile(TFile::Open(combinedFileName.c_str(), "UPDATE"));
+    std::unique_ptr<RooWorkspace> ws(combinedFile ? dynamic_cast<RooWorkspace*>(combinedFile->Get("combined")) : nullptr);
+    if(!ws) {
+        if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+        WriteErrorStatus("TRExFit::CombineAdditionalData", "Cannot read the combined workspace from " + combinedFileName);
+        exit(EXIT_FAILURE);
+    }
+    WorkspaceCombiner::AddAdditionalData(ws.get(), chNames, workspaces);
+    ws->Write("", TObject::kOverwrite);
+    combinedFile->Close();
 }
 
 //__________________________________________________________________________________
@@ -3543,6 +4114,20 @@ RooStats::HistFactory::Channel TRExFit::OneChannelToRooStats(RooStats::HistFacto
         chan.SetData("", "");
     }
 
+    // all the CustomAsimov data-sets are stored in the workspace as well,
+    // so that the one to fit can be changed with CustomAsimov without recreating the workspace
+    for(const auto& isample : fSamples) {
+        if(isample->fType != Sample::GHOST || isample->fName.find("customAsimov_") != 0) continue;
+        std::shared_ptr<SampleHist> cash = fRegions[i_ch]->GetSampleHist(isample->fName);
+        if(!cash) continue;
+        WriteDebugStatus("TRExFit::OneChannelToRooStats", "  Adding additional data: " + isample->fName);
+        RooStats::HistFactory::Data data;
+        data.SetName(isample->fName);
+        data.SetHistoName(cash->fHistoName+suffix_regularBinning);
+        data.SetInputFile(cash->fFileName);
+        chan.AddAdditionalData(data);
+    }
+
     // fStatErrCons is upper case after config reading if the MCstatThreshold option is used, otherwise it defaults to "Poisson"
     // HistFactory expects the constraint not in all uppercase, but in form "Poisson"/"Gaussian" instead
     if(fStatErrCons=="Poisson" || fStatErrCons=="POISSON") chan.SetStatErrorConfig(fStatErrThres, "Poisson");
@@ -3554,6 +4139,8 @@ RooStats::HistFactory::Channel TRExFit::OneChannelToRooStats(RooStats::HistFacto
         if (h->fSample->fType == Sample::DATA) continue;
         if (h->fSample->fType == Sample::GHOST) continue;
         if (h->fSample->fType == Sample::EFT) continue;
+        // the truth bins are in the response sample
+        if (fUnfoldingResponseMatrixPdf && h->fSample->fIsFolded) continue;
 
         WriteDebugStatus("TRExFit::OneChannelToRooStats", "  Adding Sample: " + fSamples[i_smp]->fName);
         const RooStats::HistFactory::Sample sample = OneSampleToRooStats(meas, h.get(), i_ch, i_smp);
@@ -3580,8 +4167,7 @@ RooStats::HistFactory::Sample TRExFit::OneSampleToRooStats(RooStats::HistFactory
     // norm factors
     for(const auto& inorm : h->fSample->fNormFactors) {
 
-        if (Common::FindInStringVector(inorm->fExclude, fRegions[i_ch]->fName) >= 0) continue;
-        if ((inorm->fRegions.size() > 0) && Common::FindInStringVector(inorm->fRegions, fRegions[i_ch]->fName) < 0) continue;
+        if (!fMembershipIndex.NormFactorInRegion(inorm.get(), fRegions[i_ch])) continue;
 
         WriteDebugStatus("TRExFit::OneSampleToRooStats", "    Adding NormFactor: " + inorm->fName + ", " + std::to_string(inorm->fNominal));
         sample.AddNormFactor(inorm->fName,
@@ -3596,8 +4182,7 @@ RooStats::HistFactory::Sample TRExFit::OneSampleToRooStats(RooStats::HistFactory
 
     // shape factors
     for(const auto& ishape : h->fSample->fShapeFactors) {
-        if (Common::FindInStringVector(ishape->fExclude, fRegions[i_ch]->fName) >= 0) continue;
-        if ((ishape->fRegions.size() > 0) && Common::FindInStringVector(ishape->fRegions, fRegions[i_ch]->fName) < 0) continue;
+        if (!fMembershipIndex.ShapeFactorInRegion(ishape.get(), fRegions[i_ch])) continue;
         
         WriteDebugStatus("TRExFit::OneSampleToRooStats", "    Adding ShapeFactor: " + ishape->fName + ", " + std::to_string(ishape->fNominal));
         sample.AddShapeFactor(ishape->fName);
@@ -3677,6 +4262,307 @@ RooStats::HistFactory::Sample TRExFit::OneSampleToRooStats(RooStats::HistFactory
     return sample;
 }
 
+//__________________________________________________________________________________
+//
+bool TRExFit::ResponseSampleToRooStats(RooStats::HistFactory::Measurement* meas,
+                                       const int i_ch,
+                                       const std::string& fileName,
+                                       RooStats::HistFactory::Sample* sample,
+                                       ResponseMatrix* response) const {
+    static const std::string suffix_regularBinning("_regBin");
+    const Region* reg = fRegions[i_ch];
+
+    // the truth bins of the region
+    std::vector<std::shared_ptr<SampleHist> > folded;
+    for(const auto& isample : fSamples) {
+        if(!isample->fIsFolded) continue;
+        std::shared_ptr<SampleHist> h = reg->GetSampleHist(isample->fName);
+        if(!h) continue;
+        folded.emplace_back(h);
+    }
+    if(folded.empty()) return false;
+
+    const std::string sampleName = reg->fName+"_Truth_response";
+    WriteDebugStatus("TRExFit::ResponseSampleToRooStats", "  Adding Sample: " + sampleName + " (" + std::to_string(folded.size()) + " truth bins)");
+    sample->SetName(sampleName);
+    sample->SetNormalizeByTheory(folded.front()->fSample->fNormalizedByTheory);
+    response->region = reg->fName;
+    response->sample = sampleName;
+
+    const std::size_t nTruth = folded.size();
+    std::size_t nReco = 0;
+    std::unique_ptr<TH1> hSum(nullptr);
+    std::vector<double> weights;
+    bool useMCStat = false;
+    for(std::size_t i_truth = 0; i_truth < nTruth; ++i_truth) {
+        const SampleHist* h = folded[i_truth].get();
+        if(h->fSample->fNormalizedByTheory != folded.front()->fSample->fNormalizedByTheory) {
+            if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+            WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "The truth samples of region " + reg->fName + " need the same NormalizedByTheory with ResponseMatrixPdf");
+            exit(EXIT_FAILURE);
+        }
+        for(const auto& ishape : h->fSample->fShapeFactors) {
+            if (!fMembershipIndex.ShapeFactorInRegion(ishape.get(), reg)) continue;
+            if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+            WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "ShapeFactor " + ishape->fName + " on truth sample " + h->fSample->fName + " is not supported with ResponseMatrixPdf");
+            exit(EXIT_FAILURE);
+        }
+
+        std::unique_ptr<TH1> hNominal = Common::HistFromFile(h->fFileName, h->fHistoName+suffix_regularBinning);
+        if(!hNominal) {
+            if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+            WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "Cannot read the histogram of truth sample " + h->fSample->fName + " in region " + reg->fName);
+            exit(EXIT_FAILURE);
+        }
+        if(i_truth == 0) {
+            nReco = hNominal->GetNbinsX();
+            for(std::size_t i_bin = 1; i_bin <= nReco+1; ++i_bin) {
+                response->edges.emplace_back(hNominal->GetXaxis()->GetBinLowEdge(i_bin));
+            }
+            response->nominal.assign(nReco*nTruth, 0.);
+            hSum.reset(static_cast<TH1*>(hNominal->Clone((sampleName+"_"+reg->fName).c_str())));
+            hSum->SetDirectory(nullptr);
+            hSum->Reset();
+        }
+        for(std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+            response->nominal[i_reco*nTruth+i_truth] = hNominal->GetBinContent(i_reco+1);
+        }
+
+        // norm factors, the histogram of the response sample is the sum of the truth bins at their nominal values
+        std::vector<std::string> coefficients;
+        double weight = 1.;
+        for(const auto& inorm : h->fSample->fNormFactors) {
+            if (!fMembershipIndex.NormFactorInRegion(inorm.get(), reg)) continue;
+            coefficients.emplace_back(inorm->fName);
+            weight *= inorm->fNominal;
+            if (inorm->fConst) meas->AddConstantParam(inorm->fName);
+            if (fStatOnly && fFixNPforStatOnlyFit && Common::FindInStringVector(fPOIs,inorm->fName)<0) {
+                meas->AddConstantParam(inorm->fName);
+            }
+        }
+        response->coefficients.emplace_back(coefficients);
+        weights.emplace_back(weight);
+        hSum->Add(hNominal.get(), weight);
+        if(fUseStatErr && h->fSample->fUseMCStat) useMCStat = true;
+    }
+
+    // systematics, one term per systematic as several systematics of a sample can share a nuisance parameter
+    std::vector<std::string> nps;
+    std::map<std::pair<std::string,int>, std::size_t> termIndex;
+    std::unique_ptr<TH1> hStat(nullptr);
+    bool useGaussianShapeSysConstraint = false;
+    for(std::size_t i_truth = 0; i_truth < nTruth && !fStatOnly; ++i_truth) {
+        const SampleHist* h = folded[i_truth].get();
+        std::map<std::string,int> occurrences;
+        for(const auto& isyst : h->fSyst) {
+            const std::string& np = isyst->fSystematic->fNuisanceParameter;
+            if (isyst->fSystematic->fType==Systematic::SHAPE) {
+                if (np.find("stat_")==std::string::npos) {
+                    if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+                    WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "SHAPE systematic " + isyst->fName + " on truth sample " + h->fSample->fName + " is not supported with ResponseMatrixPdf");
+                    exit(EXIT_FAILURE);
+                }
+                // separate gammas, the absolute MC stat. uncertainties of the truth bins are added in quadrature
+                std::unique_ptr<TH1> hVar = Common::HistFromFile(isyst->fFileNameUp, isyst->fHistoNameUp+"_Var"+suffix_regularBinning);
+                std::unique_ptr<TH1> hNominal = Common::HistFromFile(h->fFileName, h->fHistoName+suffix_regularBinning);
+                if(!hVar || !hNominal) {
+                    if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+                    WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "Cannot read the MC stat. uncertainty of truth sample " + h->fSample->fName + " in region " + reg->fName);
+                    exit(EXIT_FAILURE);
+                }
+                if(!hStat) {
+                    hStat.reset(static_cast<TH1*>(hSum->Clone((sampleName+"_"+reg->fName+"_stat_Var").c_str())));
+                    hStat->SetDirectory(nullptr);
+                    hStat->Reset();
+                }
+                for(std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+                    const double err = hVar->GetBinContent(i_reco+1)*hNominal->GetBinContent(i_reco+1)*weights[i_truth];
+                    hStat->AddBinContent(i_reco+1, err*err);
+                }
+                if(h->fSample->fUseGaussianShapeSysConstraint) useGaussianShapeSysConstraint = true;
+                continue;
+            }
+
+            const bool hasNorm = !isyst->fSystematic->fIsShapeOnly && !isyst->fNormPruned && !isyst->fBadNorm;
+            const bool hasShape = isyst->fIsShape && !isyst->fSystematic->fIsNormOnly && !isyst->fShapePruned && !isyst->fBadShape;
+            if(!hasNorm && !hasShape) continue;
+
+            const std::pair<std::string,int> key(np, occurrences[np]++);
+            auto it = termIndex.find(key);
+            if(it == termIndex.end()) {
+                it = termIndex.emplace(key, response->terms.size()).first;
+                ResponseMatrix::Term term;
+                term.np = np;
+                term.normDown.assign(nTruth, 1.);
+                term.normUp.assign(nTruth, 1.);
+                response->terms.emplace_back(std::move(term));
+                if(Common::FindInStringVector(nps, np)<0) nps.emplace_back(np);
+            }
+            ResponseMatrix::Term& term = response->terms[it->second];
+            if(hasNorm) {
+                term.normDown[i_truth] = 1+isyst->fNormDown;
+                term.normUp[i_truth] = 1+isyst->fNormUp;
+            }
+            if(hasShape) {
+                std::unique_ptr<TH1> hDown = Common::HistFromFile(isyst->fFileNameShapeDown, isyst->fHistoNameShapeDown+suffix_regularBinning);
+                std::unique_ptr<TH1> hUp = Common::HistFromFile(isyst->fFileNameShapeUp, isyst->fHistoNameShapeUp+suffix_regularBinning);
+                if(!hDown || !hUp) {
+                    if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+                    WriteErrorStatus("TRExFit::ResponseSampleToRooStats", "Cannot read the shape of systematic " + isyst->fName + " for truth sample " + h->fSample->fName + " in region " + reg->fName);
+                    exit(EXIT_FAILURE);
+                }
+                // the truth bins without a shape variation keep the nominal response
+                if(term.shapeUp.empty()) {
+                    term.shapeDown = response->nominal;
+                    term.shapeUp = response->nominal;
+                }
+                for(std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+                    term.shapeDown[i_reco*nTruth+i_truth] = hDown->GetBinContent(i_reco+1);
+                    term.shapeUp[i_reco*nTruth+i_truth] = hUp->GetBinContent(i_reco+1);
+                }
+            }
+        }
+    }
+
+    Common::WriteHistToFile(hSum.get(), fileName);
+    sample->SetHistoName(hSum->GetName());
+    sample->SetInputFile(fileName);
+    if(useMCStat) sample->ActivateStatError();
+
+    // the response-matrix function is built from the norm factors: they are created with ResponseMatrixCoefficients (equal to 1)
+    sample->AddNormFactor("ResponseMatrixCoefficients", 1, 0, 2);
+
+    if (fStatOnly) {
+        sample->AddOverallSys( "Dummy",1,1 );
+        return true;
+    }
+
+    // the variations are in the response-matrix function, the samples only create the nuisance parameters and their constraints
+    for(const auto& inp : nps) {
+        WriteDebugStatus("TRExFit::ResponseSampleToRooStats", "    Adding Systematic: " + inp);
+        sample->AddOverallSys(inp, 1, 1);
+    }
+    if(hStat) {
+        for(std::size_t i_reco = 1; i_reco <= nReco; ++i_reco) {
+            const double content = hSum->GetBinContent(i_reco);
+            hStat->SetBinContent(i_reco, content > 0 ? std::sqrt(hStat->GetBinContent(i_reco))/content : 0.);
+        }
+        Common::WriteHistToFile(hStat.get(), fileName);
+        sample->AddShapeSys("shape_stat_"+sampleName+"_"+reg->fName,
+                            useGaussianShapeSysConstraint ? RooStats::HistFactory::Constraint::Gaussian : RooStats::HistFactory::Constraint::Poisson,
+                            hStat->GetName(), fileName, "");
+    }
+
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::InsertResponseMatrices(RooStats::HistFactory::Measurement& meas,
+                                     const std::vector<ResponseMatrix>& responses) const {
+    const std::string prefix = meas.GetOutputFilePrefix();
+    const std::string measName = meas.GetName();
+
+    auto insert = [this](const std::string& fileName, const std::string& wsName, const std::vector<const ResponseMatrix*>& list){
+        WriteInfoStatus("TRExFit::InsertResponseMatrices", "Adding the response-matrix functions to " + fileName);
+        std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(), "UPDATE"));
+        if(!f || f->IsZombie()) {
+            WriteErrorStatus("TRExFit::InsertResponseMatrices", "Cannot open the workspace file " + fileName);
+            exit(EXIT_FAILURE);
+        }
+        std::unique_ptr<RooWorkspace> ws(dynamic_cast<RooWorkspace*>(f->Get(wsName.c_str())));
+        if(!ws) {
+            WriteErrorStatus("TRExFit::InsertResponseMatrices", "Cannot find workspace " + wsName + " in " + fileName);
+            exit(EXIT_FAILURE);
+        }
+        for(const auto& iresponse : list) {
+            if(!InsertResponseMatrix(ws.get(), *iresponse)) {
+                WriteErrorStatus("TRExFit::InsertResponseMatrices", "Cannot add the response-matrix function of region " + iresponse->region + " to " + fileName);
+                exit(EXIT_FAILURE);
+            }
+        }
+        ws->Write("", TObject::kOverwrite);
+        f->Close();
+    };
+
+    std::vector<const ResponseMatrix*> all;
+    for(const auto& iresponse : responses) {
+        insert(prefix+"_"+iresponse.region+"_"+measName+"_model.root", iresponse.region, {&iresponse});
+        all.emplace_back(&iresponse);
+    }
+    insert(prefix+"_combined_"+measName+"_model.root", "combined", all);
+}
+
+//__________________________________________________________________________________
+//
+bool TRExFit::InsertResponseMatrix(RooWorkspace* ws, const ResponseMatrix& response) const {
+    RooRealVar* obs = ws->var(("obs_x_"+response.region).c_str());
+    if(!obs) return false;
+
+    // the nominal histogram of the response sample
+    const std::string prefix = response.sample+"_"+response.region;
+    RooAbsArg* nominal = nullptr;
+    for(RooAbsArg* arg : ws->allFunctions()) {
+        if(!dynamic_cast<RooHistFunc*>(arg)) continue;
+        if(std::string(arg->GetName()).find(prefix) != 0) continue;
+        if(nominal) return false;
+        nominal = arg;
+    }
+    if(!nominal) return false;
+
+    // coefficients of the truth bins
+    RooArgList coefs;
+    std::vector<std::unique_ptr<RooAbsReal> > owned;
+    for(std::size_t i_truth = 0; i_truth < response.coefficients.size(); ++i_truth) {
+        RooArgList factors;
+        for(const auto& iname : response.coefficients[i_truth]) {
+            RooAbsReal* factor = dynamic_cast<RooAbsReal*>(ws->arg(iname.c_str()));
+            if(!factor) {
+                WriteErrorStatus("TRExFit::InsertResponseMatrix", "Cannot find norm factor " + iname + " in the workspace");
+                return false;
+            }
+            factors.add(*factor);
+        }
+        if(factors.getSize() == 1) {
+            coefs.add(*factors.at(0));
+            continue;
+        }
+        const std::string coefName = prefix+"_coefficient_"+std::to_string(i_truth);
+        if(factors.getSize() == 0) {
+            owned.emplace_back(new RooConstVar(coefName.c_str(), coefName.c_str(), 1.));
+        } else {
+            owned.emplace_back(new RooProduct(coefName.c_str(), coefName.c_str(), factors));
+        }
+        coefs.add(*owned.back());
+    }
+
+    const std::string funcName = prefix+"_response";
+    RooResponseMatrixFunc func(funcName.c_str(), funcName.c_str(), *obs, coefs, response.edges, response.nominal);
+    for(const auto& iterm : response.terms) {
+        RooRealVar* alpha = ws->var(("alpha_"+iterm.np).c_str());
+        if(!alpha) {
+            WriteErrorStatus("TRExFit::InsertResponseMatrix", "Cannot find nuisance parameter alpha_" + iterm.np + " in the workspace");
+            return false;
+        }
+        func.AddSystematic(*alpha, iterm.normDown, iterm.normUp, iterm.shapeDown, iterm.shapeUp);
+    }
+    if(ws->import(func, RooFit::RecycleConflictNodes(), RooFit::Silence())) return false;
+    RooAbsArg* imported = ws->function(funcName.c_str());
+    if(!imported) return false;
+
+    // the interpolation of the response sample now uses the function instead of the histogram
+    std::vector<RooAbsArg*> clients;
+    for(RooAbsArg* client : nominal->clients()) clients.emplace_back(client);
+    const std::string attribute = "ORIGNAME:"+std::string(nominal->GetName());
+    imported->setAttribute(attribute.c_str());
+    for(RooAbsArg* client : clients) {
+        client->redirectServers(RooArgSet(*imported), false, true);
+    }
+    imported->setAttribute(attribute.c_str(), false);
+
+    return true;
+}
+
 //__________________________________________________________________________________
 //
 void TRExFit::SystPruning() const {
@@ -4085,7 +4971,7 @@ void TRExFit::Fit(bool isLHscanOnly){
             WriteErrorStatus("TRExFit::Fit", "The workspace (\"combined\") cannot be found in file " + fWorkspaceFileName + ". Please check !");
             return;
         }
-        if(!fFitIsBlind) data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data("obsData")));
+        if(!fFitIsBlind) data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data(ObservedDataName(ws.get()).c_str())));
         else             data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data("asimovData")));
         if(!data){
             WriteErrorStatus("TRExFit::Fit", "Cannot read the data from custom WS. Please check !");
@@ -4343,7 +5229,7 @@ void TRExFit::Fit(bool isLHscanOnly){
                     if(hTot==nullptr) continue;
                     for(int i_bin=1;i_bin<=hTot->GetNbinsX();i_bin++){
                         double statErr = hTot->GetBinError(i_bin)/hTot->GetBinContent(i_bin);
-                        std::string gammaName = "gamma_shape_stat_"+sh->fSample->fName+"_"+reg->fName+"_bin_"+std::to_string(i_bin-1);
+                        std::string gammaName = "gamma_shape_stat_"+sh->fSample->SeparateGammasSample()+"_"+reg->fName+"_bin_"+std::to_string(i_bin-1);
                         npVal = fFitNPValues;
                         npVal[gammaName] = 1+statErr;
                         WriteDebugStatus("TRExFit::Fit","Setting "+gammaName+" to "+std::to_string(1+statErr));
@@ -4664,7 +5550,7 @@ RooDataSet* TRExFit::DumpData( RooWorkspace *ws,  std::map < std::string, int >
     //
     // Getting observed data (in case some regions are unblinded)
     //
-    RooDataSet* realData = static_cast<RooDataSet*>(ws->data("obsData"));
+    RooDataSet* realData = static_cast<RooDataSet*>(ws->data(ObservedDataName(ws).c_str()));
 
     //
     // Set some parameters for the Asimov production
@@ -4692,6 +5578,24 @@ RooDataSet* TRExFit::DumpData( RooWorkspace *ws,  std::map < std::string, int >
         }
     }
 
+    //
+    // Reuse the dataset if it has already been produced for the same model and parameter values
+    //
+    std::string cacheKey = "";
+    if(fAsimovCache){
+        cacheKey = AsimovCacheKey(ws, regionDataType, realData != nullptr);
+        RooDataSet* cachedData = ReadAsimovCache(cacheKey);
+        if(cachedData){
+            ws->loadSnapshot("InitialStateModelGlob");
+            if (!fStatOnly){
+                ws->loadSnapshot("InitialStateModelNuis");
+            }
+            if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+            WriteInfoStatus("TRExFit::DumpData", "Using cached dataset from " + AsimovCacheFileName(cacheKey));
+            return cachedData;
+        }
+    }
+
     //Looping over regions
     std::map<std::string, RooDataSet*> asimovDataMap;
     RooSimultaneous* simPdf = dynamic_cast<RooSimultaneous*>(mc->GetPdf());
@@ -4764,6 +5668,10 @@ RooDataSet* TRExFit::DumpData( RooWorkspace *ws,  std::map < std::string, int >
                                             Import(asimovDataMap),
                                             WeightVar(*weightVar));
 
+    if(fAsimovCache && cacheKey != ""){
+        WriteAsimovCache(cacheKey, asimovData);
+    }
+
     ws->loadSnapshot("InitialStateModelGlob");
     if (!fStatOnly){
         ws->loadSnapshot("InitialStateModelNuis");
@@ -4840,6 +5748,7 @@ std::map < std::string, double > TRExFit::PerformFit( RooWorkspace *ws, RooDataS
     if(fVarNameMinos.size()>0){
         WriteDebugStatus("TRExFit::PerformFit", "Setting the variables to use MINOS with");
         fitTool.UseMinos(fVarNameMinos);
+        fitTool.SetMinosWorkers(fMinosWorkers);
     }
 
     //
@@ -4856,7 +5765,7 @@ std::map < std::string, double > TRExFit::PerformFit( RooWorkspace *ws, RooDataS
         data = inputData;
     } else {
         WriteWarningStatus("TRExFit::PerformFit", "You didn't provide inputData => will use the observed data !");
-        data = static_cast<RooDataSet*>(ws->data("obsData"));
+        data = static_cast<RooDataSet*>(ws->data(ObservedDataName(ws).c_str()));
         if(data==nullptr){
             WriteWarningStatus("TRExFit::PerformFit", "No observedData found => will use the Asimov data !");
             data = static_cast<RooDataSet*>(ws->data("asimovData"));
@@ -5021,20 +5930,8 @@ std::unique_ptr<RooWorkspace> TRExFit::PerformWorkspaceCombination( std::vector
     //
     // Definition of the fit regions
     //
-    std::vector < RooWorkspace* > vec_ws;
+    std::vector < std::string > vec_fileName;
     std::vector < std::string > vec_chName;
-    std::unique_ptr<RooStats::HistFactory::Measurement> measurement(nullptr);
-    //
-    // Take the measurement from the combined workspace, to be sure to have all the systematics (even the ones which are not there in the first region)
-    std::unique_ptr<TFile> rootFileCombined(nullptr);
-    if(fBootstrap!="" && fBootstrapIdx>=0) {
-        rootFileCombined.reset(TFile::Open( (fName+"/RooStats/"+fBootstrapSyst+fBootstrapSample+"_BSId"+Form("%d",fBootstrapIdx)+"/"+fInputName+"_combined_"+fInputName+fSuffix+"_model.root").c_str(),"read"));
-    } else {
-        rootFileCombined.reset(TFile::Open( (fName+"/RooStats/"+fInputName+"_combined_"+fInputName+fSuffix+"_model.root").c_str(),"read"));
-    }
-    if(rootFileCombined) measurement = std::unique_ptr<RooStats::HistFactory::Measurement>(static_cast<RooStats::HistFactory::Measurement*>(rootFileCombined -> Get( (fInputName+fSuffix).c_str())));
-    //
-    std::vector<std::unique_ptr<TFile> > file_vec;
     for(const auto& ireg : fRegions) {
         bool isToFit = false;
         for(unsigned int iRegion = 0; iRegion < regionsToFit.size(); ++iRegion){
@@ -5046,53 +5943,138 @@ std::unique_ptr<RooWorkspace> TRExFit::PerformWorkspaceCombination( std::vector
         if (!isToFit) continue;
         std::string fileName = fName+"/RooStats/"+fInputName+"_"+ireg->fName+"_"+fInputName+fSuffix+"_model.root";
         if(fBootstrap!="" && fBootstrapIdx>=0) fileName = fName+"/RooStats/"+fBootstrapSyst+fBootstrapSample+"_BSId"+Form("%d",fBootstrapIdx)+"/"+fInputName+"_"+ireg->fName+"_"+fInputName+fSuffix+"_model.root";
-        file_vec.emplace_back(std::move(TFile::Open(fileName.c_str())));
-        if (!file_vec.back()) {
-            WriteErrorStatus("TRExFit::PerformWorkspaceCombination", "Input file with the workspace doesnt exist!");
-            exit(EXIT_FAILURE);
-        }
-        RooWorkspace *tmp_ws = static_cast<RooWorkspace*>(file_vec.back()->Get((ireg->fName).c_str()));
-        if(!tmp_ws){
-            WriteErrorStatus("TRExFit::PerformWorkspaceCombination", "The workspace (\"" + ireg->fName + "\") cannot be found in file " + fileName + ". Please check !");
-            return nullptr;
-        }
-        vec_ws.emplace_back(std::move(tmp_ws));
+        vec_fileName.emplace_back(fileName);
         vec_chName.emplace_back(ireg->fName);
-        // if failed to get the measurement from the combined ws, take it from the first region
-        if(!measurement){
-            measurement = std::unique_ptr<RooStats::HistFactory::Measurement>(static_cast<RooStats::HistFactory::Measurement*>(file_vec.back() -> Get( (fInputName+fSuffix).c_str())));
-        }
     }
 
-
     //
-    // Create the HistoToWorkspaceFactoryFast object to perform safely the combination
+    // The single-region workspaces are kept by the combiner, and the combinations are cached on disk
     //
-    if(!measurement){
-        WriteErrorStatus("TRExFit::PerformWorkspaceCombination", "The measurement object has not been retrieved ! Please check.");
-        return nullptr;
+    const std::string combinedFileName = CombinedWorkspaceFileName();
+    if(fCombinationCache){
+        fWorkspaceCombiner.SetCacheFilePrefix(combinedFileName.substr(0, combinedFileName.find_last_of('/')+1)+"CombinationCache/"+fInputName+fSuffix);
+    } else {
+        fWorkspaceCombiner.SetCacheFilePrefix("");
     }
-    if (TRExFitter::DEBUGLEVEL < 2) std::cout.setstate(std::ios_base::failbit);
-    RooStats::HistFactory::HistoToWorkspaceFactoryFast factory(*measurement);
 
-    // Creating the combined model
-    std::unique_ptr<RooWorkspace> ws(factory.MakeCombinedModel( vec_chName, vec_ws ));
+    return fWorkspaceCombiner.Combine(vec_chName, vec_fileName, combinedFileName, fInputName+fSuffix);
+}
 
-    // Configure the workspace
-    RooStats::HistFactory::HistoToWorkspaceFactoryFast::ConfigureWorkspaceForMeasurement( "simPdf", ws.get(), *measurement );
-    if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+//__________________________________________________________________________________
+//
+std::string TRExFit::CombinedWorkspaceFileName() const{
+    if(fBootstrap!="" && fBootstrapIdx>=0) {
+        return fName+"/RooStats/"+fBootstrapSyst+fBootstrapSample+"_BSId"+Form("%d",fBootstrapIdx)+"/"+fInputName+"_combined_"+fInputName+fSuffix+"_model.root";
+    }
+    return fName+"/RooStats/"+fInputName+"_combined_"+fInputName+fSuffix+"_model.root";
+}
 
-    for (auto& iws : vec_ws) {
-        delete iws;
+//__________________________________________________________________________________
+//
+std::string TRExFit::AsimovCacheKey(RooWorkspace* ws, const std::map<std::string, int>& regionDataType, const bool hasRealData) const{
+    //
+    // The combined workspace is rewritten by each "w" step, its modification time
+    // makes sure that the cache is not used with an outdated model
+    //
+    const std::string wsFileName = CombinedWorkspaceFileName();
+    FileStat_t fileStat;
+    if(gSystem->GetPathInfo(wsFileName.c_str(), fileStat) != 0) return "";
+
+    RooStats::ModelConfig *mc = static_cast<RooStats::ModelConfig*>(ws->obj("ModelConfig"));
+    if(!mc) return "";
+    RooSimultaneous* simPdf = dynamic_cast<RooSimultaneous*>(mc->GetPdf());
+    if(!simPdf) return "";
+
+    std::ostringstream key;
+    key << std::setprecision(17);
+    key << "workspace:" << wsFileName << "@" << fileStat.fMtime << ";";
+    key << "binnedLikelihood:" << fBinnedLikelihood << ";";
+    key << "observedData:" << ObservedDataName(ws) << ";";
+
+    // data type actually used for each channel (same logic as in DumpData)
+    std::unique_ptr<TIterator> iter(simPdf->indexCat().typeIterator());
+    RooCatType* tt = nullptr;
+    while( (tt = static_cast<RooCatType*>(iter->Next()))) {
+        int dataType = Region::ASIMOVDATA;
+        auto it_dataType = regionDataType.find(tt->GetName());
+        if(it_dataType != regionDataType.end()) dataType = it_dataType->second;
+        if(dataType == Region::REALDATA && !hasRealData) dataType = Region::ASIMOVDATA;
+        key << "channel:" << tt->GetName() << "=" << dataType << ";";
     }
 
-    for (auto& ifile : file_vec) {
-        ifile->Close();
+    // parameter snapshot: all the variables except observables
+    std::map<std::string, double> values;
+    for(const auto arg : ws->allVars()){
+        const RooRealVar* var = dynamic_cast<const RooRealVar*>(arg);
+        if(!var) continue;
+        if(mc->GetObservables() && mc->GetObservables()->find(var->GetName())) continue;
+        if(std::string(var->GetName()) == "weightVar") continue;
+        values[var->GetName()] = var->getVal();
+    }
+    for(const auto& ivalue : values){
+        key << ivalue.first << "=" << ivalue.second << ";";
+    }
+
+    return key.str();
+}
+
+//__________________________________________________________________________________
+//
+std::string TRExFit::AsimovCacheFileName(const std::string& key) const{
+    const std::string wsFileName = CombinedWorkspaceFileName();
+    const std::string dir = wsFileName.substr(0, wsFileName.find_last_of('/')+1);
+    return dir+"AsimovCache/"+fInputName+fSuffix+"_"+Common::HashString(key)+".root";
+}
+
+//__________________________________________________________________________________
+//
+RooDataSet* TRExFit::ReadAsimovCache(const std::string& key) const{
+    if(key == "") return nullptr;
+    const std::string fileName = AsimovCacheFileName(key);
+    if(gSystem->AccessPathName(fileName.c_str())) return nullptr;
+
+    std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(),"READ"));
+    if(!f || f->IsZombie()) return nullptr;
+    std::unique_ptr<TNamed> storedKey(static_cast<TNamed*>(f->Get("key")));
+    std::unique_ptr<RooDataSet> data(static_cast<RooDataSet*>(f->Get("newasimovData")));
+    f->Close();
+    if(!storedKey || !data) return nullptr;
+    if(key != storedKey->GetTitle()){
+        WriteDebugStatus("TRExFit::ReadAsimovCache", "Hash collision in " + fileName + ", the dataset will be regenerated");
+        return nullptr;
     }
 
-    if (rootFileCombined) rootFileCombined->Close();
+    return new RooDataSet(*data, "newasimovData");
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::WriteAsimovCache(const std::string& key, RooDataSet* data) const{
+    if(key == "" || !data) return;
+    const std::string fileName = AsimovCacheFileName(key);
+    gSystem->mkdir(fileName.substr(0, fileName.find_last_of('/')).c_str(), true);
 
-    return ws;
+    // write to a temporary file first, so that parallel jobs never read a partially written file
+    const std::string tmpName = fileName+Form(".%d.tmp",gSystem->GetPid());
+    {
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(tmpName.c_str(),"RECREATE"));
+        if(!f || f->IsZombie()){
+            WriteWarningStatus("TRExFit::WriteAsimovCache", "Cannot create file " + tmpName + ", the dataset will not be cached");
+            if(dir) dir->cd();
+            return;
+        }
+        TNamed storedKey("key", key.c_str());
+        storedKey.Write();
+        data->Write("newasimovData");
+        f->Close();
+        if(dir) dir->cd();
+    }
+    if(gSystem->Rename(tmpName.c_str(), fileName.c_str()) != 0){
+        gSystem->Unlink(tmpName.c_str());
+        return;
+    }
+    WriteDebugStatus("TRExFit::WriteAsimovCache", "Dataset cached in " + fileName);
 }
 
 //__________________________________________________________________________________
@@ -5380,7 +6362,7 @@ void TRExFit::GetLimit(){
         std::string dataName = "obsData";
         if(fLimitIsBlind) dataName = "asimovData";
         if (fLimitType == ASYMPTOTIC) {
-            runAsymptoticsCLs(fWorkspaceFileName.c_str(), "combined", "ModelConfig", dataName.c_str(), fLimitParamName.c_str(), fLimitParamValue, (fLimitOutputPrefixName+fSuffix).c_str(), (fName+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug);
+            runAsymptoticsCLs(fWorkspaceFileName.c_str(), "combined", "ModelConfig", dataName.c_str(), fLimitParamName.c_str(), fLimitParamValue, (fLimitOutputPrefixName+fSuffix).c_str(), (fName+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug, fLimitAsymptoticWorkers, fLimitAsymptoticWarmStart);
         } else {
             std::unique_ptr<TFile> f(TFile::Open(fWorkspaceFileName.c_str()));
             RooAbsData* data_tmp = static_cast<RooAbsData*>(f->Get(dataName.c_str()));
@@ -5486,7 +6468,7 @@ void TRExFit::GetLimit(){
             ws_forLimit -> Write();
             originalMeasurement -> Write();
             f_clone -> Close();
-            runAsymptoticsCLs(outputName_s.c_str(), "combined", "ModelConfig", "ttHFitterData", fLimitParamName.c_str(), fLimitParamValue, (fLimitOutputPrefixName+fSuffix).c_str(), (fName+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug);
+            runAsymptoticsCLs(outputName_s.c_str(), "combined", "ModelConfig", "ttHFitterData", fLimitParamName.c_str(), fLimitParamValue, (fLimitOutputPrefixName+fSuffix).c_str(), (fName+"/Limits/").c_str(), fLimitIsBlind, fLimitsConfidence, "asimovData_0", fSignalInjection, fSignalInjectionValue, sigDebug, fLimitAsymptoticWorkers, fLimitAsymptoticWarmStart);
         } else {
             RunLimitToys(data.get(), ws_forLimit.get());
         }
@@ -5640,7 +6622,7 @@ void TRExFit::ReadFitResults(const std::string& fileName){
 
     if(fileName.find(".txt")!=std::string::npos)
     {
-        fFitResults->ReadFromTXT(fileName, fBlindedParameters);
+        fFitResults->ReadFromFile(fileName, fBlindedParameters, fBinaryFitResults);
     }
     // make a list of systematics from all samples...
     // ...
@@ -5987,7 +6969,7 @@ void TRExFit::ProduceNPRanking(const std::string& NPnames) {
             WriteErrorStatus("TRExFit::Fit", "Cannot read the custom WS!");
             return;
         }
-        if(!fFitIsBlind) data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data("obsData")));
+        if(!fFitIsBlind) data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data(ObservedDataName(ws.get()).c_str())));
         else             data = std::unique_ptr<RooDataSet>(dynamic_cast<RooDataSet*>(ws->data("asimovData")));
         if (!data) {
             WriteErrorStatus("TRExFit::Fit", "Cannot read the custom data from WS!");
@@ -6315,15 +7297,8 @@ void TRExFit::ComputeBinning(int regIter){
     //Creating histograms to rebin
     TH1D* hsig = nullptr;
     TH1D* hbkg = nullptr;
-    bool nDefSig=true;
-    bool nDefBkg=true;
-    std::string fullSelection;
-    std::string fullMCweight;
-    std::vector<std::string> fullPaths;
     bool bkgReg=false;
-    bool flatBkg=false;
     if(fRegions[regIter]->fRegionType==Region::CONTROL) bkgReg=true;
-    if(bkgReg && fRegions[regIter]->fTransfoDzSig<1e-3) flatBkg=true;
     //
     WriteDebugStatus("TRExFit::ComputeBinning", "Will compute binning with the following options:");
 
@@ -6339,155 +7314,15 @@ void TRExFit::ComputeBinning(int regIter){
     if(bkgReg) WriteDebugStatus("TRExFit::ComputeBinning", " - bkg reg");
     else WriteDebugStatus("TRExFit::ComputeBinning", " - sig reg");
 
-    for(const auto& isample : fSamples) {
-        //
-        // using NTuples
-        if(fInputType==1){
-            if(isample->fType == Sample::DATA) continue;
-            if(isample->fType == Sample::GHOST) continue;
-            if(isample->fType == Sample::EFT) continue;
-            if(Common::FindInStringVector(isample->fRegions,fRegions[regIter]->fName) < 0) continue;
-            //
-            fullSelection = FullSelection(  fRegions[regIter],isample.get());
-            fullMCweight  = FullWeight(     fRegions[regIter],isample.get());
-            fullPaths     = FullNtuplePaths(fRegions[regIter],isample.get());
-            for(unsigned int i_path=0;i_path<fullPaths.size();i_path++){
-                const int tmp_debugLevel=TRExFitter::DEBUGLEVEL;
-                TRExFitter::SetDebugLevel(0);
-                TH1D* htmp = nullptr;
-                htmp = Common::HistFromNtuple( fullPaths[i_path],
-                                    fRegions[regIter]->fVariable, 10000, fRegions[regIter]->fXmin, fRegions[regIter]->fXmax,
-				    fullSelection, fullMCweight, fAddAliases, fDebugNev);
-                TRExFitter::SetDebugLevel(tmp_debugLevel);
-                //
-                // Pre-processing of histograms (rebinning, lumi scaling)
-                if(isample->fType != Sample::DATA && isample->fNormalizedByTheory) htmp -> Scale(fLumi);
-                //
-                if(isample->fLumiScales.size()>i_path) htmp -> Scale(isample->fLumiScales[i_path]);
-                else if(isample->fLumiScales.size()==1) htmp -> Scale(isample->fLumiScales[0]);
-                //
-                // Importing the histogram in TRExFitter
-                if(isample->fType == Sample::SIGNAL){
-                    if(nDefSig){
-                        hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                        nDefSig=false;
-                    }
-                    else hsig->Add(htmp);
-                }
-                else{
-                    if(bkgReg && !flatBkg){
-                        bool usedInSig=false;
-                        for(unsigned int i_bkgs=0; i_bkgs<fRegions[regIter]->fAutoBinBkgsInSig.size(); ++i_bkgs){
-                            if(isample->fName == fRegions[regIter]->fAutoBinBkgsInSig[i_bkgs]){
-                                usedInSig=true;
-                                break;
-                            }
-                        }
-                        if(usedInSig){
-                            WriteDebugStatus("TRExFit::ComputeBinning", "Using " + isample->fName + " as signal");
-                            if(nDefSig){
-                                hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                                nDefSig=false;
-                            }
-                            else hsig->Add(htmp);
-                        }
-                        else{
-                            if(nDefBkg){
-                                hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                                nDefBkg=false;
-                            }
-                            else hbkg->Add(htmp);
-                        }
-                    }
-                    else{
-                        if(nDefBkg){
-                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                            nDefBkg=false;
-                        }
-                        else hbkg->Add(htmp);
-                    }
-                }
-                delete htmp;
-            }
-        }
-        //
-        // Input with hists
-        else if(fInputType == 0){
-            if(isample->fType==Sample::DATA) continue;
-            if(isample->fType==Sample::GHOST) continue;
-            if(isample->fType==Sample::EFT) continue;
-            //
-            fullPaths     = FullHistogramPaths(fRegions[regIter],isample.get());
-            for(unsigned int i_path=0;i_path<fullPaths.size();i_path++){
-                const int tmp_debugLevel=TRExFitter::DEBUGLEVEL;
-                TRExFitter::SetDebugLevel(0);
-                std::unique_ptr<TH1> htmp = Common::HistFromFile( fullPaths[i_path] );
-                if (!htmp) {
-                    WriteErrorStatus("TRExFit::ReadHistograms", "Histo pointer is empty cannot continue running the code");
-                    exit(EXIT_FAILURE);
-                }
-                TRExFitter::SetDebugLevel(tmp_debugLevel);
-                //
-                // Pre-processing of histograms (rebinning, lumi scaling)
-                if(fRegions[regIter]->fHistoBins.size() > 0){
-                    const std::string hname = htmp->GetName();
-                    std::unique_ptr<TH1> tmp_copy(static_cast<TH1*>(htmp->Rebin(fRegions[regIter]->fHistoNBinsRebin, "tmp_copy", &fRegions[regIter]->fHistoBins[0])));
-                    htmp.reset(tmp_copy.release());
-                    htmp->SetName(hname.c_str());
-                    if(TRExFitter::MERGEUNDEROVERFLOW) Common::MergeUnderOverFlow(htmp.get());
-                }
-                else if(fRegions[regIter]->fHistoNBinsRebin != -1) {
-                    htmp->Rebin(fRegions[regIter]->fHistoNBinsRebin);
-                }
-                //
-                if(isample->fType!=Sample::DATA && isample->fNormalizedByTheory) htmp -> Scale(fLumi);
-                //
-                if(isample->fLumiScales.size()>i_path) htmp -> Scale(isample->fLumiScales[i_path]);
-                else if(isample->fLumiScales.size()==1) htmp -> Scale(isample->fLumiScales[0]);
-                //
-                // apply histogram to signal or background
-                if(isample->fType==Sample::SIGNAL){
-                    if(nDefSig){
-                        hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                        nDefSig=false;
-                    }
-                    else hsig->Add(htmp.get());
-                }
-                else{
-                if(bkgReg && !flatBkg){
-                    bool usedInSig=false;
-                    for(unsigned int i_bkgs=0; i_bkgs<fRegions[regIter]->fAutoBinBkgsInSig.size(); ++i_bkgs){
-                        if(isample->fName==fRegions[regIter]->fAutoBinBkgsInSig[i_bkgs]){
-                            usedInSig=true;
-                            break;
-                        }
-                    }
-                    if(usedInSig){
-                        WriteDebugStatus("TRExFit::ComputeBinning", "Using " + isample->fName + " as signal");
-                        if(nDefSig){
-                            hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                            nDefSig=false;
-                        }
-                        else hsig->Add(htmp.get());
-                    }
-                    else{
-                        if(nDefBkg){
-                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                            nDefBkg=false;
-                        }
-                        else hbkg->Add(htmp.get());
-                    }
-                }
-                    else{
-                        if(nDefBkg){
-                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
-                            nDefBkg=false;
-                        }
-                        else hbkg->Add(htmp.get());
-                    }
-                }
-            }
-        }
+    //
+    // with AutoBinningCache, the fine histograms from ntuples are cached, and filled again only if their inputs changed;
+    // without it, the files are only used to pass the histograms filled by the AutoBinningWorkers
+    const std::string key = (fInputType==1 && (fAutoBinningCache || fAutoBinningWorkers > 1)) ? FineHistogramsKey(regIter) : "";
+    if(!ReadFineHistograms(key, hsig, hbkg)){
+        FillFineHistograms(regIter, hsig, hbkg);
+        if(fAutoBinningCache) WriteFineHistograms(key, hsig, hbkg);
+    } else if(!fAutoBinningCache){
+        gSystem->Unlink(FineHistogramsFileName(key).c_str());
     }
     //
     //computing new bins
@@ -6508,6 +7343,19 @@ void TRExFit::ComputeBinning(int regIter){
     bins_vec.push_back(nBins_Vec + 1);
     double nBkg = hbkg -> Integral(1, nBins_Vec );
     double nSig = hsig -> Integral(1, nBins_Vec );
+    //
+    // contents and errors of the fine bins are read once, the bkg integral from the underflow is cumulated
+    std::vector<double> contentBkg(nBins_Vec+1);
+    std::vector<double> contentSig(nBins_Vec+1);
+    std::vector<double> err2BkgBin(nBins_Vec+1);
+    std::vector<double> cumulBkg(nBins_Vec+1);
+    for(int i_bin = 0; i_bin <= nBins_Vec; ++i_bin){
+        contentBkg[i_bin] = hbkg -> GetBinContent(i_bin);
+        contentSig[i_bin] = hsig -> GetBinContent(i_bin);
+        const double errBkg = hbkg -> GetBinError(i_bin);
+        err2BkgBin[i_bin] = errBkg*errBkg;
+        cumulBkg[i_bin] = (i_bin > 0 ? cumulBkg[i_bin-1] : 0.) + contentBkg[i_bin];
+    }
     bool jBreak = false;
     double jTarget = 1e5;
     double jGoal = fRegions[regIter]->fTransfoJpar1;
@@ -6523,14 +7371,14 @@ void TRExFit::ComputeBinning(int regIter){
         double distPrev = 1e10;
         //
         while (!pass && iBin > 0) {
-            double nBkgBin = hbkg -> GetBinContent(iBin);
-            double nSigBin = hsig -> GetBinContent(iBin);
+            double nBkgBin = contentBkg[iBin];
+            double nSigBin = contentSig[iBin];
             sumBkg += nBkgBin;
             sumSig += nSigBin;
             if (nBkgBin > 0 && nSigBin > 0) {
                 sumSigL += nSigBin * std::log1p(nSigBin / nBkgBin);
             }
-            err2Bkg += (hbkg -> GetBinError(iBin))*(hbkg -> GetBinError(iBin));
+            err2Bkg += err2BkgBin[iBin];
             //
             double err2RelBkg = 1;
             if (sumBkg != 0) {
@@ -6566,57 +7414,372 @@ void TRExFit::ComputeBinning(int regIter){
                 if( pass && !jBreak ){
                     if( (sumSig/sumBkg) <  fRegions[regIter]->fTransfoJpar2*(nSig/nBkg) ){
                         jBreak = true;
-                        jTarget = hbkg->Integral(0,iBin)/ fRegions[regIter]->fTransfoJpar3;
+                        jTarget = cumulBkg[iBin]/ fRegions[regIter]->fTransfoJpar3;
+                    }
+                    else{
+                        jGoal = jGoal+1;
+                    }
+                }
+            }
+            else{
+                WriteErrorStatus("TRExFit::ComputeBinning", "transformation method '" + fRegions[regIter]->fBinTransfo + "' unknown, try again!");
+                exit(1);
+            }
+            if (!(pass && dist > distPrev)) {
+                binCount++;
+                iBin--;
+            } // else use previous bin
+            distPrev = dist;
+        }
+        iBin2++;
+        // remove last bin
+        if (iBin == 0 && bins_vec.size() > 1) {
+            if (fRegions[regIter]->fBinTransfo == "TransfoF") {
+                bins_vec.pop_back();
+            }
+            else if (fRegions[regIter]->fBinTransfo == "TransfoD" && bins_vec.size() > fRegions[regIter]->fTransfoDzSig + fRegions[regIter]->fTransfoDzBkg + 0.01) {
+                // remove last bin if Nbin > Zsig + Zbkg
+                // (1% threshold to capture rounding issues)
+                bins_vec.pop_back();
+            }
+        }
+        bins_vec.push_back(iBin + 1);
+    }
+    //
+    //transform bin numbers in histo edges
+    int nBins = bins_vec.size();
+    double *bins = new double[nBins];
+    bins[0] = hbkg->GetBinLowEdge(1);
+    for(unsigned int i=1; i<bins_vec.size()-1; ++i){
+        bins[i] = hbkg->GetBinLowEdge(bins_vec[nBins-i-1]);
+    }
+    bins[nBins-1]=hbkg->GetBinLowEdge( hbkg->GetNbinsX() + 1 );
+    WriteInfoStatus("TRExFit::ComputeBinning", "Your final binning from automatic binning function is:");
+    std::string temp_string = "";
+    for(unsigned int i_bins=0; i_bins<bins_vec.size(); ++i_bins){
+      temp_string+= std::to_string(bins[i_bins]) + " - ";
+    }
+    WriteInfoStatus("TRExFit::ComputeBinning", "  " + temp_string);
+    //
+    delete hsig;
+    delete hbkg;
+    fRegions[regIter]->SetBinning(nBins-1, bins);
+    delete[] bins;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::FillFineHistograms(int regIter, TH1D*& hsig, TH1D*& hbkg){
+    bool nDefSig=true;
+    bool nDefBkg=true;
+    std::string fullSelection;
+    std::string fullMCweight;
+    std::vector<std::string> fullPaths;
+    bool bkgReg=false;
+    bool flatBkg=false;
+    if(fRegions[regIter]->fRegionType==Region::CONTROL) bkgReg=true;
+    if(bkgReg && fRegions[regIter]->fTransfoDzSig<1e-3) flatBkg=true;
+    //
+    for(const auto& isample : fSamples) {
+        //
+        // using NTuples
+        if(fInputType==1){
+            if(isample->fType == Sample::DATA) continue;
+            if(isample->fType == Sample::GHOST) continue;
+            if(isample->fType == Sample::EFT) continue;
+            if(!fMembershipIndex.SampleInRegion(isample.get(),fRegions[regIter])) continue;
+            //
+            fullSelection = FullSelection(  fRegions[regIter],isample.get());
+            fullMCweight  = FullWeight(     fRegions[regIter],isample.get());
+            fullPaths     = FullNtuplePaths(fRegions[regIter],isample.get());
+            for(unsigned int i_path=0;i_path<fullPaths.size();i_path++){
+                const int tmp_debugLevel=TRExFitter::DEBUGLEVEL;
+                TRExFitter::SetDebugLevel(0);
+                TH1D* htmp = nullptr;
+                htmp = Common::HistFromNtuple( fullPaths[i_path],
+                                    fRegions[regIter]->fVariable, 10000, fRegions[regIter]->fXmin, fRegions[regIter]->fXmax,
+				    fullSelection, fullMCweight, fAddAliases, fDebugNev);
+                TRExFitter::SetDebugLevel(tmp_debugLevel);
+                //
+                // Pre-processing of histograms (rebinning, lumi scaling)
+                if(isample->fType != Sample::DATA && isample->fNormalizedByTheory) htmp -> Scale(fLumi);
+                //
+                if(isample->fLumiScales.size()>i_path) htmp -> Scale(isample->fLumiScales[i_path]);
+                else if(isample->fLumiScales.size()==1) htmp -> Scale(isample->fLumiScales[0]);
+                //
+                // Importing the histogram in TRExFitter
+                if(isample->fType == Sample::SIGNAL){
+                    if(nDefSig){
+                        hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                        nDefSig=false;
+                    }
+                    else hsig->Add(htmp);
+                }
+                else{
+                    if(bkgReg && !flatBkg){
+                        bool usedInSig=false;
+                        for(unsigned int i_bkgs=0; i_bkgs<fRegions[regIter]->fAutoBinBkgsInSig.size(); ++i_bkgs){
+                            if(isample->fName == fRegions[regIter]->fAutoBinBkgsInSig[i_bkgs]){
+                                usedInSig=true;
+                                break;
+                            }
+                        }
+                        if(usedInSig){
+                            WriteDebugStatus("TRExFit::ComputeBinning", "Using " + isample->fName + " as signal");
+                            if(nDefSig){
+                                hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                                nDefSig=false;
+                            }
+                            else hsig->Add(htmp);
+                        }
+                        else{
+                            if(nDefBkg){
+                                hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                                nDefBkg=false;
+                            }
+                            else hbkg->Add(htmp);
+                        }
+                    }
+                    else{
+                        if(nDefBkg){
+                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                            nDefBkg=false;
+                        }
+                        else hbkg->Add(htmp);
+                    }
+                }
+                delete htmp;
+            }
+        }
+        //
+        // Input with hists
+        else if(fInputType == 0){
+            if(isample->fType==Sample::DATA) continue;
+            if(isample->fType==Sample::GHOST) continue;
+            if(isample->fType==Sample::EFT) continue;
+            //
+            fullPaths     = FullHistogramPaths(fRegions[regIter],isample.get());
+            for(unsigned int i_path=0;i_path<fullPaths.size();i_path++){
+                const int tmp_debugLevel=TRExFitter::DEBUGLEVEL;
+                TRExFitter::SetDebugLevel(0);
+                std::unique_ptr<TH1> htmp = Common::HistFromFile( fullPaths[i_path] );
+                if (!htmp) {
+                    WriteErrorStatus("TRExFit::ReadHistograms", "Histo pointer is empty cannot continue running the code");
+                    exit(EXIT_FAILURE);
+                }
+                TRExFitter::SetDebugLevel(tmp_debugLevel);
+                //
+                // Pre-processing of histograms (rebinning, lumi scaling)
+                if(fRegions[regIter]->fHistoBins.size() > 0){
+                    const std::string hname = htmp->GetName();
+                    std::unique_ptr<TH1> tmp_copy(static_cast<TH1*>(htmp->Rebin(fRegions[regIter]->fHistoNBinsRebin, "tmp_copy", &fRegions[regIter]->fHistoBins[0])));
+                    htmp.reset(tmp_copy.release());
+                    htmp->SetName(hname.c_str());
+                    if(TRExFitter::MERGEUNDEROVERFLOW) Common::MergeUnderOverFlow(htmp.get());
+                }
+                else if(fRegions[regIter]->fHistoNBinsRebin != -1) {
+                    htmp->Rebin(fRegions[regIter]->fHistoNBinsRebin);
+                }
+                //
+                if(isample->fType!=Sample::DATA && isample->fNormalizedByTheory) htmp -> Scale(fLumi);
+                //
+                if(isample->fLumiScales.size()>i_path) htmp -> Scale(isample->fLumiScales[i_path]);
+                else if(isample->fLumiScales.size()==1) htmp -> Scale(isample->fLumiScales[0]);
+                //
+                // apply histogram to signal or background
+                if(isample->fType==Sample::SIGNAL){
+                    if(nDefSig){
+                        hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                        nDefSig=false;
+                    }
+                    else hsig->Add(htmp.get());
+                }
+                else{
+                if(bkgReg && !flatBkg){
+                    bool usedInSig=false;
+                    for(unsigned int i_bkgs=0; i_bkgs<fRegions[regIter]->fAutoBinBkgsInSig.size(); ++i_bkgs){
+                        if(isample->fName==fRegions[regIter]->fAutoBinBkgsInSig[i_bkgs]){
+                            usedInSig=true;
+                            break;
+                        }
+                    }
+                    if(usedInSig){
+                        WriteDebugStatus("TRExFit::ComputeBinning", "Using " + isample->fName + " as signal");
+                        if(nDefSig){
+                            hsig = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                            nDefSig=false;
+                        }
+                        else hsig->Add(htmp.get());
                     }
                     else{
-                        jGoal = jGoal+1;
+                        if(nDefBkg){
+                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                            nDefBkg=false;
+                        }
+                        else hbkg->Add(htmp.get());
+                    }
+                }
+                    else{
+                        if(nDefBkg){
+                            hbkg = static_cast<TH1D*>(htmp->Clone(Form("h_%s_%s",fRegions[regIter]->fName.c_str(),isample->fName.c_str())));
+                            nDefBkg=false;
+                        }
+                        else hbkg->Add(htmp.get());
                     }
                 }
             }
-            else{
-                WriteErrorStatus("TRExFit::ComputeBinning", "transformation method '" + fRegions[regIter]->fBinTransfo + "' unknown, try again!");
-                exit(1);
-            }
-            if (!(pass && dist > distPrev)) {
-                binCount++;
-                iBin--;
-            } // else use previous bin
-            distPrev = dist;
         }
-        iBin2++;
-        // remove last bin
-        if (iBin == 0 && bins_vec.size() > 1) {
-            if (fRegions[regIter]->fBinTransfo == "TransfoF") {
-                bins_vec.pop_back();
-            }
-            else if (fRegions[regIter]->fBinTransfo == "TransfoD" && bins_vec.size() > fRegions[regIter]->fTransfoDzSig + fRegions[regIter]->fTransfoDzBkg + 0.01) {
-                // remove last bin if Nbin > Zsig + Zbkg
-                // (1% threshold to capture rounding issues)
-                bins_vec.pop_back();
-            }
+    }
+}
+
+//__________________________________________________________________________________
+//
+std::string TRExFit::FineHistogramsKey(int regIter){
+    const Region* reg = fRegions[regIter];
+    std::ostringstream key;
+    key << std::setprecision(17);
+    key << "region:" << reg->fName << ";variable:" << reg->fVariable << ";range:" << reg->fXmin << "," << reg->fXmax << ";";
+    // the region type, TransfoD zSig and AutoBinBkgsInSig decide which samples are used as signal
+    key << "type:" << reg->fRegionType << ";zSig:" << reg->fTransfoDzSig << ";";
+    for(const auto& bkgInSig : reg->fAutoBinBkgsInSig) key << "bkgInSig:" << bkgInSig << ";";
+    key << "lumi:" << fLumi << ";nev:" << fDebugNev << ";mergeUnderOverflow:" << TRExFitter::MERGEUNDEROVERFLOW << ";";
+    for(const auto& alias : fAddAliases) key << "alias:" << alias << ";";
+
+    // input files (and custom functions used by selections and weights, with the headers they include)
+    // with their modification times and sizes
+    auto addFile = [&key](const std::string& fileName){
+        const std::string version = Common::FileVersion(fileName);
+        if(version == "") return false;
+        key << "file:" << fileName << "@" << version << ";";
+        return true;
+    };
+    for(const auto& path : fCustomIncludePaths) key << "includePath:" << path << ";";
+    for(const auto& file : fCustomFunctions){
+        if(!addFile(file)) return "";
+        for(const auto& header : Common::IncludedHeaders(file, fCustomIncludePaths)){
+            if(!addFile(header)) return "";
         }
-        bins_vec.push_back(iBin + 1);
     }
-    //
-    //transform bin numbers in histo edges
-    int nBins = bins_vec.size();
-    double *bins = new double[nBins];
-    bins[0] = hbkg->GetBinLowEdge(1);
-    for(unsigned int i=1; i<bins_vec.size()-1; ++i){
-        bins[i] = hbkg->GetBinLowEdge(bins_vec[nBins-i-1]);
+    for(const auto& line : fCustomFunctionsExecutes) key << "execute:" << line << ";";
+    for(const auto& isample : fSamples) {
+        if(isample->fType == Sample::DATA) continue;
+        if(isample->fType == Sample::GHOST) continue;
+        if(isample->fType == Sample::EFT) continue;
+        if(!fMembershipIndex.SampleInRegion(isample.get(),fRegions[regIter])) continue;
+        key << "sample:" << isample->fName << ":" << isample->fType << ":" << isample->fNormalizedByTheory << ";";
+        for(const auto& scale : isample->fLumiScales) key << "lumiScale:" << scale << ";";
+        key << "selection:" << FullSelection(fRegions[regIter],isample.get()) << ";";
+        key << "weight:" << FullWeight(fRegions[regIter],isample.get()) << ";";
+        for(const auto& path : FullNtuplePaths(fRegions[regIter],isample.get())){
+            key << "ntuple:" << path << ";";
+            // files given with wildcards cannot be checked
+            if(!addFile(path.substr(0,path.find_last_of("/")))) return "";
+        }
+    }
+    return key.str();
+}
+
+//__________________________________________________________________________________
+//
+std::string TRExFit::FineHistogramsFileName(const std::string& key) const{
+    return fName+"/AutoBinning/"+Common::HashString(key)+".root";
+}
+
+//__________________________________________________________________________________
+//
+bool TRExFit::ReadFineHistograms(const std::string& key, TH1D*& hsig, TH1D*& hbkg) const{
+    if(key == "") return false;
+    const std::string fileName = FineHistogramsFileName(key);
+    if(gSystem->AccessPathName(fileName.c_str())) return false;
+
+    TDirectory* dir = gDirectory;
+    std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(),"READ"));
+    if(dir) dir->cd();
+    if(!f || f->IsZombie()) return false;
+    std::unique_ptr<TNamed> storedKey(static_cast<TNamed*>(f->Get("key")));
+    std::unique_ptr<TH1D> sig(static_cast<TH1D*>(f->Get("sig")));
+    std::unique_ptr<TH1D> bkg(static_cast<TH1D*>(f->Get("bkg")));
+    f->Close();
+    if(!storedKey || !sig || !bkg) return false;
+    if(key != storedKey->GetTitle()){
+        WriteDebugStatus("TRExFit::ReadFineHistograms", "Hash collision in " + fileName + ", the histograms will be filled again");
+        return false;
+    }
+    sig->SetDirectory(nullptr);
+    bkg->SetDirectory(nullptr);
+    hsig = sig.release();
+    hbkg = bkg.release();
+    WriteDebugStatus("TRExFit::ReadFineHistograms", "Using the histograms from " + fileName);
+
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::WriteFineHistograms(const std::string& key, const TH1D* hsig, const TH1D* hbkg) const{
+    if(key == "" || !hsig || !hbkg) return;
+    const std::string fileName = FineHistogramsFileName(key);
+    gSystem->mkdir((fName+"/AutoBinning").c_str(), true);
+
+    // write to a temporary file first, so that parallel jobs never read a partially written file
+    const std::string tmpName = fileName+Form(".%d.tmp", gSystem->GetPid());
+    {
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(tmpName.c_str(),"RECREATE"));
+        if(!f || f->IsZombie()){
+            WriteWarningStatus("TRExFit::WriteFineHistograms", "Cannot create file " + tmpName + ", the histograms will not be cached");
+            if(dir) dir->cd();
+            return;
+        }
+        TNamed storedKey("key", key.c_str());
+        storedKey.Write();
+        hsig->Write("sig");
+        hbkg->Write("bkg");
+        f->Close();
+        if(dir) dir->cd();
     }
-    bins[nBins-1]=hbkg->GetBinLowEdge( hbkg->GetNbinsX() + 1 );
-    WriteInfoStatus("TRExFit::ComputeBinning", "Your final binning from automatic binning function is:");
-    std::string temp_string = "";
-    for(unsigned int i_bins=0; i_bins<bins_vec.size(); ++i_bins){
-      temp_string+= std::to_string(bins[i_bins]) + " - ";
+    if(gSystem->Rename(tmpName.c_str(), fileName.c_str()) != 0){
+        gSystem->Unlink(tmpName.c_str());
+    }
+}
+
+//__________________________________________________________________________________
+//
+void TRExFit::FillFineHistogramsInParallel(){
+    if(fInputType != 1 || fAutoBinningWorkers < 2) return;
+
+    // regions with automatic binning whose histograms are not cached yet
+    std::vector<int> regions;
+    std::vector<std::string> keys;
+    for(std::size_t i_ch = 0; i_ch < fRegions.size(); ++i_ch){
+        if(fRegions[i_ch]->fBinTransfo == "") continue;
+        const std::string key = FineHistogramsKey(i_ch);
+        if(key == "") continue;
+        if(!gSystem->AccessPathName(FineHistogramsFileName(key).c_str())) continue;
+        regions.emplace_back(i_ch);
+        keys.emplace_back(key);
+    }
+    if(regions.size() < 2) return;
+
+    const std::size_t nWorkers = std::min(static_cast<std::size_t>(fAutoBinningWorkers), regions.size());
+    WriteInfoStatus("TRExFit::FillFineHistogramsInParallel", "Filling the histograms for the automatic binning of " +
+        std::to_string(regions.size()) + " regions with " + std::to_string(nWorkers) + " workers");
+
+    // each worker fills every nWorkers-th region into the cache, read back by ComputeBinning
+    const bool success = Common::RunInWorkers(nWorkers, [&](const std::size_t iworker){
+        for(std::size_t i_reg = iworker; i_reg < regions.size(); i_reg += nWorkers){
+            TH1D* hsig = nullptr;
+            TH1D* hbkg = nullptr;
+            FillFineHistograms(regions[i_reg], hsig, hbkg);
+            WriteFineHistograms(keys[i_reg], hsig, hbkg);
+            delete hsig;
+            delete hbkg;
+        }
+        return true;
+    });
+    if(!success){
+        WriteWarningStatus("TRExFit::FillFineHistogramsInParallel", "A worker failed, the missing histograms will be filled serially");
     }
-    WriteInfoStatus("TRExFit::ComputeBinning", "  " + temp_string);
-    //
-    delete hsig;
-    delete hbkg;
-    fRegions[regIter]->SetBinning(nBins-1, bins);
-    delete[] bins;
 }
 
 //__________________________________________________________________________________
@@ -7428,7 +8591,13 @@ void TRExFit::RunToys(){
 
         // randomize GlobalObservables using ToyMCSampler
         RooStats::ProfileLikelihoodTestStat ts(*mc.GetPdf());
-        RooStats::ToyMCSampler sampler(ts,fFitToys);
+        std::unique_ptr<RooStats::ToyMCSampler> samplerPtr(nullptr);
+        if (fToysNativeGenerator) {
+            samplerPtr = std::make_unique<BinnedToyMCSampler>(ts,fFitToys);
+        } else {
+            samplerPtr = std::make_unique<RooStats::ToyMCSampler>(ts,fFitToys);
+        }
+        RooStats::ToyMCSampler& sampler = *samplerPtr;
         sampler.SetPdf(*mc.GetPdf());
         sampler.SetObservables(*mc.GetObservables());
         sampler.SetGlobalObservables(*mc.GetGlobalObservables());
@@ -7609,6 +8778,76 @@ void TRExFit::RunToys(){
         out->Close();
 }
 
+//__________________________________________________________________________________
+//
+void TRExFit::RunPosteriorSampling(){
+    WriteInfoStatus("TRExFit::RunPosteriorSampling","");
+    WriteInfoStatus("TRExFit::RunPosteriorSampling","-------------------------------------------");
+    WriteInfoStatus("TRExFit::RunPosteriorSampling","Sampling the posterior with MCMC...");
+    WriteInfoStatus("TRExFit::RunPosteriorSampling","-------------------------------------------");
+
+    std::unique_ptr<TFile> rootFile(nullptr);
+    std::unique_ptr<RooWorkspace> ws(nullptr);
+    std::unique_ptr<RooDataSet> dataOwner(nullptr);
+    RooDataSet* data = nullptr;
+    if(fWorkspaceFileName!=""){
+        rootFile.reset(TFile::Open(fWorkspaceFileName.c_str(),"read"));
+        if (rootFile) ws.reset(dynamic_cast<RooWorkspace*>(rootFile->Get("combined")));
+        if(!ws){
+            WriteErrorStatus("TRExFit::RunPosteriorSampling", "The workspace (\"combined\") cannot be found in file " + fWorkspaceFileName + ". Please check !");
+            return;
+        }
+        data = dynamic_cast<RooDataSet*>(ws->data(fFitIsBlind ? "asimovData" : ObservedDataName(ws.get()).c_str()));
+    } else {
+        if(DoingMixedFitting() && !fFitIsBlind){
+            WriteWarningStatus("TRExFit::RunPosteriorSampling","Mixed data/Asimov fits are not supported, the Asimov regions use FitNPValues");
+        }
+        std::vector < std:: string > regionsToFit = ListRegionsToFit(true);
+        std::map < std::string, int > regionDataType = MapRegionDataTypes(regionsToFit,fFitIsBlind);
+        if (TRExFitter::DEBUGLEVEL < 2) std::cout.setstate(std::ios_base::failbit);
+        ws = PerformWorkspaceCombination( regionsToFit );
+        if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+        if (!ws){
+            WriteErrorStatus("TRExFit::RunPosteriorSampling","Cannot retrieve the workspace, exiting!");
+            exit(EXIT_FAILURE);
+        }
+        std::map<std::string,double> poiValues;
+        for(const auto& poi : fPOIs){
+            if(fFitPOIAsimov.find(poi)!=fFitPOIAsimov.end()){
+                poiValues[poi] = fFitPOIAsimov[poi];
+            }
+        }
+        dataOwner.reset(DumpData( ws.get(), regionDataType, fFitNPValues, poiValues ));
+        data = dataOwner.get();
+    }
+    if(!data){
+        WriteErrorStatus("TRExFit::RunPosteriorSampling", "Cannot read the data. Please check !");
+        return;
+    }
+
+    // the chains start from the best fit and use its uncertainties for the initial proposal
+    std::vector<std::string> varMinosTmp = fVarNameMinos;
+    fVarNameMinos.clear();
+    PerformFit( ws.get(), data, fFitType, false);
+    fVarNameMinos = varMinosTmp;
+
+    MCMCSampler sampler(ws.get(), data);
+    sampler.SetNChains(fMCMCChains);
+    sampler.SetNSteps(fMCMCSteps);
+    sampler.SetNBurnIn(fMCMCBurnIn);
+    sampler.SetSeed(fMCMCSeed);
+    sampler.SetNWorkers(fMCMCWorkers);
+    sampler.SetSummaryParameters(fPOIs);
+    if (!sampler.Run()) {
+        WriteErrorStatus("TRExFit::RunPosteriorSampling", "Posterior sampling failed!");
+        return;
+    }
+
+    gSystem->mkdir((fName+"/Fits/").c_str(),true);
+    sampler.WriteSamples(fName+"/Fits/"+fInputName+fSuffix+"_posterior.root");
+    sampler.WriteSummary(fName+"/Fits/"+fInputName+fSuffix+"_posterior.txt");
+}
+
 //__________________________________________________________________________________
 // Computes the variable string to be used when reading ntuples, for a given region, sample combination
 std::string TRExFit::Variable(Region *reg,Sample *smp){
@@ -8250,15 +9489,13 @@ void TRExFit::DropBins() {
         if (blindedBins.size() == 0) continue;
         for(const auto& smp : fSamples){
             // eventually skip sample / region combination
-            if(Common::FindInStringVector(smp->fRegions,reg->fName)<0) continue;
+            if(!fMembershipIndex.SampleInRegion(smp.get(),reg)) continue;
             std::shared_ptr<SampleHist> sh = reg->GetSampleHist(smp->fName);
             if(!sh) continue;
             Common::DropBins(sh->fHist.get(), blindedBins);
             for(auto& syst : smp->fSystematics) {
                 // eventually skip systematic / region combination
-                if( syst->fRegions.size()>0 && Common::FindInStringVector(syst->fRegions,reg->fName)<0  ) continue;
-                if( syst->fExclude.size()>0 && Common::FindInStringVector(syst->fExclude,reg->fName)>=0 ) continue;
-                if( syst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(syst->fExcludeRegionSample,reg->fName, smp->fName)>=0 ) continue;
+                if( !fMembershipIndex.SystematicInRegion(syst.get(),reg,smp.get()) ) continue;
                 std::shared_ptr<SystematicHist> syh = sh->GetSystematic( syst->fName );
                 if(!syh) continue;
                 Common::DropBins(syh->fHistUp.get(),   blindedBins);
@@ -8277,6 +9514,11 @@ void TRExFit::PrepareUnfolding() {
     gSystem->mkdir(fName.c_str());
     gSystem->mkdir((fName+"/UnfoldingHistograms").c_str());
 
+    // the inputs from the ntuples are written first, then read as the other ones
+    if (fUnfoldingInputsFromNtuples) {
+        BuildUnfoldingInputs();
+    }
+
     // Open the otuput ROOT file
     std::unique_ptr<TFile> outputFile(TFile::Open((fName+"/UnfoldingHistograms/FoldedHistograms.root").c_str(), "RECREATE"));
     if (!outputFile) {
@@ -8320,12 +9562,17 @@ void TRExFit::PrepareUnfolding() {
         }
     }
 
+    // every input matrix/histogram is read only once per region
+    UnfoldingInputCache cache{};
+
     // loop over regions
     for (const auto& ireg : fRegions) {
 
         // only signal regions are processed at this step
         if (ireg->fRegionType != Region::RegionType::SIGNAL) continue;
 
+        cache.Clear();
+
         // loop over all samples
         for (const auto& isample : fUnfoldingSamples) {
 
@@ -8337,7 +9584,7 @@ void TRExFit::PrepareUnfolding() {
             if (isample->GetHasResponse()) {
                 const std::vector<std::string>& fullResponsePaths = FullResponseMatrixPaths(ireg, isample.get());
 
-                std::unique_ptr<TH2> matrix = Common::CombineHistos2DFromFullPaths(fullResponsePaths);
+                std::unique_ptr<TH2> matrix = cache.GetMatrix(fullResponsePaths);
                 if (!matrix) {
                     WriteErrorStatus("TRExFit::PrepareUnfolding", "Cannot read the response matrix!");
                     exit(EXIT_FAILURE);
@@ -8362,7 +9609,7 @@ void TRExFit::PrepareUnfolding() {
                 // need to add acceptance, selection and migration
                 {
                     const std::vector<std::string>& fullMigrationMatrixPaths = FullMigrationMatrixPaths(ireg, isample.get());
-                    std::unique_ptr<TH2> matrix = Common::CombineHistos2DFromFullPaths(fullMigrationMatrixPaths);
+                    std::unique_ptr<TH2> matrix = cache.GetMatrix(fullMigrationMatrixPaths);
                     if (!matrix) {
                         exit(EXIT_FAILURE);
                     }
@@ -8390,7 +9637,7 @@ void TRExFit::PrepareUnfolding() {
                 // add selection eff
                 {
                     const std::vector<std::string>& fullSelectionEffPaths = FullSelectionEffPaths(ireg, isample.get());
-                    std::unique_ptr<TH1> eff = Common::CombineHistosFromFullPaths(fullSelectionEffPaths);
+                    std::unique_ptr<TH1> eff = cache.GetHisto(fullSelectionEffPaths);
                     if (!eff) {
                         exit(EXIT_FAILURE);
                     }
@@ -8406,7 +9653,7 @@ void TRExFit::PrepareUnfolding() {
                 // add acceptance
                 if (fHasAcceptance || isample->GetHasAcceptance() || ireg->fHasAcceptance) {
                     const std::vector<std::string>& fullAcceptancePaths = FullAcceptancePaths(ireg, isample.get());
-                    std::unique_ptr<TH1> acc = Common::CombineHistosFromFullPaths(fullAcceptancePaths);
+                    std::unique_ptr<TH1> acc = cache.GetHisto(fullAcceptancePaths);
                     if (!acc) {
                         exit(EXIT_FAILURE);
                     }
@@ -8459,6 +9706,7 @@ void TRExFit::PrepareUnfolding() {
                      Common::FindInStringVector(isyst->fSamples, isample->GetName()) < 0) continue;
 
                 ProcessUnfoldingSystematics(&manager,
+                                            &cache,
                                             outputFile.get(),
                                             ireg,
                                             isample.get(),
@@ -8468,12 +9716,159 @@ void TRExFit::PrepareUnfolding() {
         }
     }
 
+    WriteDebugStatus("TRExFit::PrepareUnfolding", "Unfolding inputs read: " + std::to_string(cache.GetNReads()) + ", reused: " + std::to_string(cache.GetNHits()));
+
     outputFile->Close();
 }
 
+//__________________________________________________________________________________
+//
+void TRExFit::BuildUnfoldingInputs() const {
+
+    const bool horizontal = (fMatrixOrientation == FoldingManager::MATRIXORIENTATION::TRUTHONHORIZONTALAXIS);
+
+    // histograms to be written, by file
+    std::map<std::string, std::vector<std::pair<std::string, std::unique_ptr<TH1> > > > output;
+
+    // the paths of an input have to point to a single histogram, written only once
+    auto AddOutput = [&output](const std::vector<std::string>& paths, const TH1* h, const std::string& what) {
+        if (paths.size() != 1) {
+            WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "The " + what + " is built from the ntuples but has " + std::to_string(paths.size()) + " paths, only one is allowed");
+            exit(EXIT_FAILURE);
+        }
+        const std::string& path = paths.front();
+        const std::string fileName  = path.substr(0,path.find_last_of(".")+5);
+        const std::string histoName = path.substr(path.find_last_of(".")+6,std::string::npos);
+        if (histoName == "") {
+            WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "No histogram name for the " + what + " in " + fileName);
+            exit(EXIT_FAILURE);
+        }
+        auto& histos = output[fileName];
+        for (const auto& ihisto : histos) {
+            if (ihisto.first == histoName) {
+                WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "The " + what + " would overwrite " + histoName + " in " + fileName + ", please set different names (e.g. with the NameSuff options of the UnfoldingSystematic)");
+                exit(EXIT_FAILURE);
+            }
+        }
+        std::unique_ptr<TH1> copy(static_cast<TH1*>(h->Clone()));
+        copy->SetDirectory(nullptr);
+        histos.emplace_back(histoName, std::move(copy));
+    };
+
+    for (const auto& isample : fUnfoldingSamples) {
+        if (isample->fNtupleFiles.empty()) continue;
+        if (isample->GetHasResponse()) {
+            WriteWarningStatus("TRExFit::BuildUnfoldingInputs", "UnfoldingSample " + isample->GetName() + " uses a response matrix, its ntuples are ignored");
+            continue;
+        }
+
+        UnfoldingInputBuilder builder{};
+        builder.SetNtuples(Common::CreatePathsList(isample->fNtuplePaths, {}, isample->fNtupleFiles, {}, {}, {}),
+                           isample->GetRecoNtupleName(),
+                           isample->GetTruthNtupleName());
+        builder.SetMatchingIndex(fUnfoldingMatchingIndex);
+        builder.SetTruth(fUnfoldingTruthVariable, fUnfoldingTruthBins, fUnfoldingTruthSelection, isample->GetTruthWeight());
+        builder.SetRecoWeight(isample->GetRecoWeight());
+        builder.SetTruthOnHorizontalAxis(horizontal);
+
+        std::vector<const Region*> regions;
+        for (const auto& ireg : fRegions) {
+            if (ireg->fRegionType != Region::RegionType::SIGNAL) continue;
+            if(isample->fRegions[0] != "all" &&
+                Common::FindInStringVector(isample->fRegions, ireg->fName) < 0) continue;
+            if (ireg->fUnfoldingRecoVariable == "") {
+                WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "RecoVariable is not set for region " + ireg->fName + ", needed for UnfoldingSample " + isample->GetName());
+                exit(EXIT_FAILURE);
+            }
+            builder.AddRegion(ireg->fName, ireg->fUnfoldingRecoVariable, ireg->fUnfoldingRecoBins, ireg->fUnfoldingRecoSelection);
+            regions.emplace_back(ireg);
+        }
+        if (regions.empty()) continue;
+
+        // only the weight systematics are built here, the other ones keep their inputs
+        std::vector<std::pair<const UnfoldingSystematic*, bool> > variations;
+        if (isample->GetType() != UnfoldingSample::TYPE::GHOST) {
+            for (const auto& isyst : fUnfoldingSystematics) {
+                if (!isyst) continue;
+                if (isyst->GetName() == "Dummy") continue;
+                if (isyst->GetHasResponse()) continue;
+                if(isyst->fSamples.at(0) != "all" &&
+                     Common::FindInStringVector(isyst->fSamples, isample->GetName()) < 0) continue;
+                if (isyst->fRecoWeightSufUp != "" || isyst->fTruthWeightSufUp != "") {
+                    builder.AddVariation(isyst->GetName()+"_Up", isyst->fRecoWeightSufUp, isyst->fTruthWeightSufUp);
+                    variations.emplace_back(isyst.get(), true);
+                }
+                if (isyst->fRecoWeightSufDown != "" || isyst->fTruthWeightSufDown != "") {
+                    builder.AddVariation(isyst->GetName()+"_Down", isyst->fRecoWeightSufDown, isyst->fTruthWeightSufDown);
+                    variations.emplace_back(isyst.get(), false);
+                }
+            }
+        }
+
+        WriteInfoStatus("TRExFit::BuildUnfoldingInputs", "Building the unfolding inputs of " + isample->GetName() + " for " +
+            std::to_string(regions.size()) + " region(s) and " + std::to_string(variations.size()) + " weight variation(s) ...");
+        if (!builder.Build()) {
+            WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "Cannot build the unfolding inputs of " + isample->GetName());
+            exit(EXIT_FAILURE);
+        }
+
+        for (std::size_t i_reg = 0; i_reg < regions.size(); ++i_reg) {
+            const Region* reg = regions[i_reg];
+            {
+                const UnfoldingInputBuilder::Histograms& histos = builder.GetHistograms(i_reg, 0);
+                AddOutput(FullMigrationMatrixPaths(reg, isample.get()), histos.migration.get(), "migration matrix");
+                AddOutput(FullSelectionEffPaths(reg, isample.get()), histos.selectionEff.get(), "selection efficiency");
+                if (fHasAcceptance || isample->GetHasAcceptance() || reg->fHasAcceptance) {
+                    AddOutput(FullAcceptancePaths(reg, isample.get()), histos.acceptance.get(), "acceptance");
+                }
+            }
+            for (std::size_t i_var = 0; i_var < variations.size(); ++i_var) {
+                const UnfoldingSystematic* syst = variations[i_var].first;
+                const bool isUp = variations[i_var].second;
+                if(syst->fRegions.at(0) != "all" &&
+                     Common::FindInStringVector(syst->fRegions, reg->fName) < 0) continue;
+                const UnfoldingInputBuilder::Histograms& histos = builder.GetHistograms(i_reg, i_var+1);
+                AddOutput(FullMigrationMatrixPaths(reg, isample.get(), syst, isUp), histos.migration.get(), "migration matrix of " + syst->GetName());
+                AddOutput(FullSelectionEffPaths(reg, isample.get(), syst, isUp), histos.selectionEff.get(), "selection efficiency of " + syst->GetName());
+                if (fHasAcceptance || syst->GetHasAcceptance() || reg->fHasAcceptance) {
+                    AddOutput(FullAcceptancePaths(reg, isample.get(), syst, isUp), histos.acceptance.get(), "acceptance of " + syst->GetName());
+                }
+            }
+        }
+    }
+
+    for (auto& ifile : output) {
+        gSystem->mkdir(ifile.first.substr(0, ifile.first.find_last_of('/')).c_str(), true);
+        TDirectory* dir = gDirectory;
+        // other inputs (e.g. of the systematics which are not weights) can be in the same file
+        std::unique_ptr<TFile> f(TFile::Open(ifile.first.c_str(), "UPDATE"));
+        if (!f || f->IsZombie()) {
+            WriteErrorStatus("TRExFit::BuildUnfoldingInputs", "Cannot open the output file " + ifile.first);
+            exit(EXIT_FAILURE);
+        }
+        for (const auto& ihisto : ifile.second) {
+            std::string histoName = ihisto.first;
+            TDirectory* histoDir = f.get();
+            const std::size_t pos = histoName.find_last_of('/');
+            if (pos != std::string::npos) {
+                const std::string dirName = histoName.substr(0, pos);
+                histoName = histoName.substr(pos+1);
+                histoDir = f->GetDirectory(dirName.c_str());
+                if (!histoDir) histoDir = f->mkdir(dirName.c_str());
+            }
+            histoDir->cd();
+            ihisto.second->Write(histoName.c_str(), TObject::kOverwrite);
+        }
+        f->Close();
+        if (dir) dir->cd();
+        WriteInfoStatus("TRExFit::BuildUnfoldingInputs", "    " + std::to_string(ifile.second.size()) + " histogram(s) written to " + ifile.first);
+    }
+}
+
 //__________________________________________________________________________________
 //
 void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
+                                          UnfoldingInputCache* cache,
                                           TFile* file,
                                           const Region* reg,
                                           const UnfoldingSample* sample,
@@ -8493,43 +9888,57 @@ void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
             exit(EXIT_FAILURE);
         }
 
-        std::unique_ptr<TH2> referenceMatrix(nullptr);;
+        std::unique_ptr<TH2> referenceMatrix(nullptr);
         if (syst->GetHasResponse()) {
             const std::vector<std::string>& paths = FullResponseMatrixPaths(reg, it->get());
-            referenceMatrix = Common::CombineHistos2DFromFullPaths(paths);
+            referenceMatrix = cache->GetMatrix(paths);
         } else {
-            FoldingManager mgr{};
-            mgr.SetMatrixOrientation(fMatrixOrientation);
-            {
-                const std::vector<std::string>& paths = FullMigrationMatrixPaths(reg, sample);
-                std::unique_ptr<TH2> matrix = Common::CombineHistos2DFromFullPaths(paths);
-                if (!matrix) {
-                    exit(EXIT_FAILURE);
+            // the reference response only depends on the inputs, calculate it once for all the systematics using the same ones
+            std::vector<std::string> referenceInputs{"reference"};
+            for (const auto& ipaths : {FullMigrationMatrixPaths(reg, sample),
+                                       FullSelectionEffPaths(reg, sample, syst, true),
+                                       FullAcceptancePaths(reg, sample, syst, true)}) {
+                referenceInputs.insert(referenceInputs.end(), ipaths.begin(), ipaths.end());
+            }
+            referenceInputs.emplace_back(std::to_string(fHasAcceptance || syst->GetHasAcceptance() || reg->fHasAcceptance));
+            const std::string referenceKey = UnfoldingInputCache::Key(referenceInputs);
+
+            referenceMatrix = cache->GetStoredMatrix(referenceKey);
+            if (!referenceMatrix) {
+                FoldingManager mgr{};
+                mgr.SetMatrixOrientation(fMatrixOrientation);
+                {
+                    const std::vector<std::string>& paths = FullMigrationMatrixPaths(reg, sample);
+                    std::unique_ptr<TH2> matrix = cache->GetMatrix(paths);
+                    if (!matrix) {
+                        exit(EXIT_FAILURE);
+                    }
+                    UnfoldingTools::NormalizeMatrix(matrix.get(), !horizontal);
+                    mgr.SetMigrationMatrix(matrix.get(), false);
                 }
-                UnfoldingTools::NormalizeMatrix(matrix.get(), !horizontal);
-                mgr.SetMigrationMatrix(matrix.get(), false);
-            }
-            {
-                const std::vector<std::string>& paths = FullSelectionEffPaths(reg, sample, syst, true);
-                std::unique_ptr<TH1> eff = Common::CombineHistosFromFullPaths(paths);
-                if (!eff) {
-                    exit(EXIT_FAILURE);
+                {
+                    const std::vector<std::string>& paths = FullSelectionEffPaths(reg, sample, syst, true);
+                    std::unique_ptr<TH1> eff = cache->GetHisto(paths);
+                    if (!eff) {
+                        exit(EXIT_FAILURE);
+                    }
+
+                    mgr.SetSelectionEfficiency(eff.get());
                 }
 
-                mgr.SetSelectionEfficiency(eff.get());
-            }
+                if (fHasAcceptance || syst->GetHasAcceptance() || reg->fHasAcceptance) {
+                    const std::vector<std::string>& paths = FullAcceptancePaths(reg, sample, syst, true);
+                    std::unique_ptr<TH1> acc = cache->GetHisto(paths);
+                    if (!acc) {
+                        exit(EXIT_FAILURE);
+                    }
 
-            if (fHasAcceptance || syst->GetHasAcceptance() || reg->fHasAcceptance) {
-                const std::vector<std::string>& paths = FullAcceptancePaths(reg, sample, syst, true);
-                std::unique_ptr<TH1> acc = Common::CombineHistosFromFullPaths(paths);
-                if (!acc) {
-                    exit(EXIT_FAILURE);
+                    mgr.SetAcceptance(acc.get());
                 }
-
-                mgr.SetAcceptance(acc.get());
+                mgr.CalculateResponseMatrix(true);
+                referenceMatrix.reset(static_cast<TH2*>(mgr.GetResponseMatrix()->Clone()));
+                cache->StoreMatrix(referenceKey, referenceMatrix.get());
             }
-            mgr.CalculateResponseMatrix(true);
-            referenceMatrix.reset(static_cast<TH2*>(mgr.GetResponseMatrix()->Clone()));
         }
 
         if (!referenceMatrix) {
@@ -8547,7 +9956,7 @@ void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
     auto ProcessOneVariation = [&](const bool isUp) {
         if (syst->GetHasResponse()) {
             const std::vector<std::string>& paths = FullResponseMatrixPaths(reg, sample, syst, isUp);
-            std::unique_ptr<TH2> matrix = Common::CombineHistos2DFromFullPaths(paths);
+            std::unique_ptr<TH2> matrix = cache->GetMatrix(paths);
             if (!matrix) {
                 exit(EXIT_FAILURE);
             }
@@ -8579,7 +9988,7 @@ void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
             {
                 /// migration first
                 const std::vector<std::string>& paths = FullMigrationMatrixPaths(reg, sample, syst, isUp);
-                std::unique_ptr<TH2> matrix = Common::CombineHistos2DFromFullPaths(paths);
+                std::unique_ptr<TH2> matrix = cache->GetMatrix(paths);
                 if (!matrix) {
                     exit(EXIT_FAILURE);
                 }
@@ -8610,7 +10019,7 @@ void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
             // selectio eff now
             {
                 const std::vector<std::string>& paths = FullSelectionEffPaths(reg, sample, syst, isUp);
-                std::unique_ptr<TH1> eff = Common::CombineHistosFromFullPaths(paths);
+                std::unique_ptr<TH1> eff = cache->GetHisto(paths);
                 if (!eff) {
                     exit(EXIT_FAILURE);
                 }
@@ -8626,7 +10035,7 @@ void TRExFit::ProcessUnfoldingSystematics(FoldingManager* manager,
 
             if (fHasAcceptance || syst->GetHasAcceptance() || reg->fHasAcceptance) {
                 const std::vector<std::string>& paths = FullAcceptancePaths(reg, sample, syst, isUp);
-                std::unique_ptr<TH1> acc = Common::CombineHistosFromFullPaths(paths);
+                std::unique_ptr<TH1> acc = cache->GetHisto(paths);
                 if (!acc) {
                     exit(EXIT_FAILURE);
                 }
@@ -9215,14 +10624,12 @@ void TRExFit::PlotMigrationResponse(const TH2* matrix,
 void TRExFit::RunForceShape() {
     for (const auto& ireg : fRegions) {
         for (const auto& ismp : fSamples) {
-            if(Common::FindInStringVector(ismp->fRegions, ireg->fName) < 0) continue;
+            if(!fMembershipIndex.SampleInRegion(ismp.get(),ireg)) continue;
             std::shared_ptr<SampleHist> sh = ireg->GetSampleHist(ismp->fName);
             if(!sh) continue;
             for (const auto& isyst : ismp->fSystematics) {
                 if (isyst->fForceShape == HistoTools::FORCESHAPETYPE::NOSHAPE) continue;
-                if(isyst->fRegions.size()>0 && Common::FindInStringVector(isyst->fRegions,ireg->fName)<0  ) continue;
-                if(isyst->fExclude.size()>0 && Common::FindInStringVector(isyst->fExclude,ireg->fName)>=0 ) continue;
-                if(isyst->fExcludeRegionSample.size()>0 && Common::FindInStringVectorOfVectors(isyst->fExcludeRegionSample, ireg->fName, ismp->fName)>=0 ) continue;
+                if( !fMembershipIndex.SystematicInRegion(isyst.get(),ireg,ismp.get()) ) continue;
                 std::shared_ptr<SystematicHist> syh = sh->GetSystematic(isyst->fName);
                 if(!syh) continue;
 
@@ -9437,6 +10844,8 @@ void TRExFit::RunLimitToys(RooAbsData* data, RooWorkspace* ws) const {
     toys.SetPlot(fLimitPlot);
     toys.SetFile(fLimitFile);
     toys.SetSeed(fLimitToysSeed);
+    toys.SetNWorkers(fLimitToysWorkers);
+    toys.SetNativeGenerator(fToysNativeGenerator);
     toys.SetOutputPath(fName + "/Limits");
    
     RooStats::ModelConfig* mc = dynamic_cast<RooStats::ModelConfig*>(ws->obj("ModelConfig"));
@@ -9522,8 +10931,8 @@ void TRExFit::ProcessEFTInputs(bool overwrite){
             } else {
                 WriteDebugStatus("TRExFit::ProcessEFTInputs", " Overwriting existing EFT plotting an fitting ("+fileName+" already exists)");
             }
-            imap.second->DrawEFTInputs(fRegions);
-            imap.second->FitEFTInputs(fRegions, fileName);
+            if(fDoEFTPlots) imap.second->DrawEFTInputs(fRegions);
+            imap.second->FitEFTInputs(fRegions, fileName, fDoEFTPlots);
         } else {
             WriteDebugStatus("TRExFit::ProcessEFTInputs", " Reading EFT quadratic results from file ("+fileName+" not found)");
             imap.second->ReadEFTFitResults(fRegions, fileName);
@@ -0,0 +1,354 @@
+// Class include
+#include "TRExFitter/UnfoldingInputBuilder.h"
+
+// framework includes
+#include "TRExFitter/StatusLogbook.h"
+
+// ROOT includes
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TTree.h"
+#include "TTreeFormula.h"
+
+// c++ includes
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // compiles an expression, the formula is nullptr for an empty expression
+    bool MakeFormula(std::unique_ptr<TTreeFormula>& formula, const std::string& name, const std::string& expression, TTree* tree) {
+        formula.reset();
+        if (expression == "") return true;
+        formula = std::make_unique<TTreeFormula>(name.c_str(), expression.c_str(), tree);
+        if (formula->GetNdim() == 0) {
+            WriteErrorStatus("UnfoldingInputBuilder::MakeFormula", "Cannot compile the expression " + expression + " for tree " + tree->GetName());
+            return false;
+        }
+        return true;
+    }
+
+    // value for the current entry, 1 for an empty expression
+    double Evaluate(TTreeFormula* formula) {
+        if (!formula) return 1.;
+        formula->GetNdata();
+        return formula->EvalInstance();
+    }
+
+    // integer value of an index, as for TTreeIndex (no loss of precision above 2^53)
+    Long64_t EvaluateIndex(TTreeFormula* formula) {
+        if (!formula) return 0;
+        formula->GetNdata();
+        return formula->EvalInstance64();
+    }
+
+    // bin index starting from 0, -1 outside of the binning
+    int FindBin(const std::vector<double>& bins, const double x) {
+        if (!(x >= bins.front() && x < bins.back())) return -1;
+        return std::upper_bound(bins.begin(), bins.end(), x) - bins.begin() - 1;
+    }
+
+    // fraction of the total passing, with the binomial error for weighted events (as TH1::Divide with option "B")
+    void SetRatio(TH1D* h, const int bin, const double pass, const double pass2, const double total, const double total2) {
+        if (total == 0) {
+            h->SetBinContent(bin, 0);
+            h->SetBinError(bin, 0);
+            return;
+        }
+        const double ratio = pass/total;
+        h->SetBinContent(bin, ratio);
+        h->SetBinError(bin, std::sqrt(std::abs(((1.-2.*ratio)*pass2 + ratio*ratio*total2)/(total*total))));
+    }
+}
+
+//__________________________________________________________________________________
+//
+UnfoldingInputBuilder::UnfoldingInputBuilder() :
+    fRecoTreeName(""),
+    fTruthTreeName(""),
+    fTruthVariable(""),
+    fTruthSelection(""),
+    fTruthWeight(""),
+    fRecoWeight(""),
+    fTruthOnHorizontalAxis(true)
+{
+    AddVariation("nominal", "", "");
+}
+
+//__________________________________________________________________________________
+//
+UnfoldingInputBuilder::~UnfoldingInputBuilder() {
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputBuilder::SetNtuples(const std::vector<std::string>& files,
+                                       const std::string& recoTreeName,
+                                       const std::string& truthTreeName) {
+    fFiles = files;
+    fRecoTreeName = recoTreeName;
+    fTruthTreeName = truthTreeName;
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputBuilder::SetMatchingIndex(const std::vector<std::string>& index) {
+    fMatchingIndex = index;
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputBuilder::SetTruth(const std::string& variable,
+                                     const std::vector<double>& bins,
+                                     const std::string& selection,
+                                     const std::string& weight) {
+    fTruthVariable = variable;
+    fTruthBins = bins;
+    fTruthSelection = selection;
+    fTruthWeight = weight;
+}
+
+//__________________________________________________________________________________
+//
+std::size_t UnfoldingInputBuilder::AddRegion(const std::string& name,
+                                             const std::string& variable,
+                                             const std::vector<double>& bins,
+                                             const std::string& selection) {
+    RecoRegion region;
+    region.name = name;
+    region.variable = variable;
+    region.bins = bins;
+    region.selection = selection;
+    fRegions.emplace_back(std::move(region));
+    return fRegions.size() - 1;
+}
+
+//__________________________________________________________________________________
+//
+std::size_t UnfoldingInputBuilder::AddVariation(const std::string& name,
+                                                const std::string& recoWeightSuf,
+                                                const std::string& truthWeightSuf) {
+    fVariations.push_back({name, recoWeightSuf, truthWeightSuf});
+    return fVariations.size() - 1;
+}
+
+//__________________________________________________________________________________
+//
+bool UnfoldingInputBuilder::Build() {
+    if (fFiles.empty() || fRecoTreeName == "" || fTruthTreeName == "") {
+        WriteErrorStatus("UnfoldingInputBuilder::Build", "The input ntuples are not set");
+        return false;
+    }
+    if (fMatchingIndex.empty() || fMatchingIndex.size() > 2) {
+        WriteErrorStatus("UnfoldingInputBuilder::Build", "The matching index needs one or two expressions");
+        return false;
+    }
+    if (fTruthVariable == "" || fTruthBins.size() < 2) {
+        WriteErrorStatus("UnfoldingInputBuilder::Build", "The truth variable or binning is not set");
+        return false;
+    }
+    for (const auto& iregion : fRegions) {
+        if (iregion.variable == "" || iregion.bins.size() < 2) {
+            WriteErrorStatus("UnfoldingInputBuilder::Build", "The reco variable or binning is not set for region " + iregion.name);
+            return false;
+        }
+    }
+
+    const std::size_t nVar = fVariations.size();
+    const std::size_t nTruth = fTruthBins.size() - 1;
+    fTruth.assign(nVar*nTruth, 0.);
+    fTruth2.assign(nVar*nTruth, 0.);
+    for (auto& iregion : fRegions) {
+        const std::size_t nReco = iregion.bins.size() - 1;
+        iregion.migration.assign(nVar*nTruth*nReco, 0.);
+        iregion.migration2.assign(nVar*nTruth*nReco, 0.);
+        iregion.reco.assign(nVar*nReco, 0.);
+        iregion.reco2.assign(nVar*nReco, 0.);
+    }
+
+    for (const auto& ifile : fFiles) {
+        WriteDebugStatus("UnfoldingInputBuilder::Build", "    Reading " + ifile);
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(ifile.c_str(), "READ"));
+        if (dir) dir->cd();
+        if (!f || f->IsZombie()) {
+            WriteErrorStatus("UnfoldingInputBuilder::Build", "Cannot open file " + ifile);
+            return false;
+        }
+        TTree* truth = dynamic_cast<TTree*>(f->Get(fTruthTreeName.c_str()));
+        TTree* reco = dynamic_cast<TTree*>(f->Get(fRecoTreeName.c_str()));
+        if (!truth || !reco) {
+            WriteErrorStatus("UnfoldingInputBuilder::Build", "Cannot read tree " + (truth ? fRecoTreeName : fTruthTreeName) + " from file " + ifile);
+            return false;
+        }
+        if (!ReadTrees(truth, reco)) return false;
+    }
+
+    MakeHistograms();
+
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+bool UnfoldingInputBuilder::ReadTrees(TTree* truth, TTree* reco) {
+    const std::size_t nVar = fVariations.size();
+    const std::size_t nTruth = fTruthBins.size() - 1;
+
+    // truth events, the bin of every entry is kept for the matching (-1 if not selected)
+    std::vector<int> truthBins(truth->GetEntries(), -1);
+    {
+        std::unique_ptr<TTreeFormula> variable;
+        std::unique_ptr<TTreeFormula> selection;
+        std::unique_ptr<TTreeFormula> weight;
+        if (!MakeFormula(variable, "truthVariable", fTruthVariable, truth)) return false;
+        if (!MakeFormula(selection, "truthSelection", fTruthSelection, truth)) return false;
+        if (!MakeFormula(weight, "truthWeight", fTruthWeight, truth)) return false;
+        std::vector<std::unique_ptr<TTreeFormula> > weightSufs(nVar);
+        for (std::size_t i_var = 0; i_var < nVar; ++i_var) {
+            if (!MakeFormula(weightSufs[i_var], "truthWeight_" + fVariations[i_var].name, fVariations[i_var].truthWeightSuf, truth)) return false;
+        }
+
+        for (Long64_t i = 0; i < static_cast<Long64_t>(truthBins.size()); ++i) {
+            truth->LoadTree(i);
+            if (Evaluate(selection.get()) == 0) continue;
+            const int bin = FindBin(fTruthBins, Evaluate(variable.get()));
+            if (bin < 0) continue;
+            truthBins[i] = bin;
+            const double w = Evaluate(weight.get());
+            for (std::size_t i_var = 0; i_var < nVar; ++i_var) {
+                const double wVar = w*Evaluate(weightSufs[i_var].get());
+                fTruth[i_var*nTruth + bin] += wVar;
+                fTruth2[i_var*nTruth + bin] += wVar*wVar;
+            }
+        }
+    }
+
+    // reco events, matched to the truth events by index
+    if (fMatchingIndex.size() == 1) truth->BuildIndex(fMatchingIndex[0].c_str());
+    else                            truth->BuildIndex(fMatchingIndex[0].c_str(), fMatchingIndex[1].c_str());
+
+    std::unique_ptr<TTreeFormula> indexMajor;
+    std::unique_ptr<TTreeFormula> indexMinor;
+    std::unique_ptr<TTreeFormula> weight;
+    if (!MakeFormula(indexMajor, "indexMajor", fMatchingIndex[0], reco)) return false;
+    if (fMatchingIndex.size() > 1 && !MakeFormula(indexMinor, "indexMinor", fMatchingIndex[1], reco)) return false;
+    if (!MakeFormula(weight, "recoWeight", fRecoWeight, reco)) return false;
+    std::vector<std::unique_ptr<TTreeFormula> > weightSufs(nVar);
+    for (std::size_t i_var = 0; i_var < nVar; ++i_var) {
+        if (!MakeFormula(weightSufs[i_var], "recoWeight_" + fVariations[i_var].name, fVariations[i_var].recoWeightSuf, reco)) return false;
+    }
+    std::vector<std::unique_ptr<TTreeFormula> > variables(fRegions.size());
+    std::vector<std::unique_ptr<TTreeFormula> > selections(fRegions.size());
+    for (std::size_t i_reg = 0; i_reg < fRegions.size(); ++i_reg) {
+        if (!MakeFormula(variables[i_reg], "recoVariable_" + fRegions[i_reg].name, fRegions[i_reg].variable, reco)) return false;
+        if (!MakeFormula(selections[i_reg], "recoSelection_" + fRegions[i_reg].name, fRegions[i_reg].selection, reco)) return false;
+    }
+
+    std::vector<int> recoBins(fRegions.size());
+    std::vector<double> weights(nVar);
+    const Long64_t nEntries = reco->GetEntries();
+    for (Long64_t i = 0; i < nEntries; ++i) {
+        reco->LoadTree(i);
+        bool selected = false;
+        for (std::size_t i_reg = 0; i_reg < fRegions.size(); ++i_reg) {
+            recoBins[i_reg] = -1;
+            if (Evaluate(selections[i_reg].get()) == 0) continue;
+            recoBins[i_reg] = FindBin(fRegions[i_reg].bins, Evaluate(variables[i_reg].get()));
+            if (recoBins[i_reg] >= 0) selected = true;
+        }
+        if (!selected) continue;
+
+        // the weights are evaluated once for all the regions
+        const double w = Evaluate(weight.get());
+        for (std::size_t i_var = 0; i_var < nVar; ++i_var) {
+            weights[i_var] = w*Evaluate(weightSufs[i_var].get());
+        }
+
+        const Long64_t major = EvaluateIndex(indexMajor.get());
+        const Long64_t minor = EvaluateIndex(indexMinor.get());
+        const Long64_t truthEntry = truth->GetEntryNumberWithIndex(major, minor);
+        const int truthBin = truthEntry >= 0 ? truthBins[truthEntry] : -1;
+
+        for (std::size_t i_reg = 0; i_reg < fRegions.size(); ++i_reg) {
+            if (recoBins[i_reg] < 0) continue;
+            RecoRegion& region = fRegions[i_reg];
+            const std::size_t nReco = region.bins.size() - 1;
+            for (std::size_t i_var = 0; i_var < nVar; ++i_var) {
+                const double wVar = weights[i_var];
+                region.reco[i_var*nReco + recoBins[i_reg]] += wVar;
+                region.reco2[i_var*nReco + recoBins[i_reg]] += wVar*wVar;
+                if (truthBin < 0) continue;
+                const std::size_t idx = (i_var*nTruth + truthBin)*nReco + recoBins[i_reg];
+                region.migration[idx] += wVar;
+                region.migration2[idx] += wVar*wVar;
+            }
+        }
+    }
+
+    return true;
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputBuilder::MakeHistograms() {
+    const std::size_t nTruth = fTruthBins.size() - 1;
+
+    fHistograms.clear();
+    fHistograms.resize(fRegions.size());
+    for (std::size_t i_reg = 0; i_reg < fRegions.size(); ++i_reg) {
+        const RecoRegion& region = fRegions[i_reg];
+        const std::size_t nReco = region.bins.size() - 1;
+        for (std::size_t i_var = 0; i_var < fVariations.size(); ++i_var) {
+            const std::string name = region.name + "_" + fVariations[i_var].name;
+            Histograms histos;
+            if (fTruthOnHorizontalAxis) {
+                histos.migration = std::make_unique<TH2D>((name+"_migration").c_str(), "",
+                    nTruth, fTruthBins.data(), nReco, region.bins.data());
+            } else {
+                histos.migration = std::make_unique<TH2D>((name+"_migration").c_str(), "",
+                    nReco, region.bins.data(), nTruth, fTruthBins.data());
+            }
+            histos.selectionEff = std::make_unique<TH1D>((name+"_selectionEff").c_str(), "", nTruth, fTruthBins.data());
+            histos.acceptance = std::make_unique<TH1D>((name+"_acceptance").c_str(), "", nReco, region.bins.data());
+            histos.migration->SetDirectory(nullptr);
+            histos.selectionEff->SetDirectory(nullptr);
+            histos.acceptance->SetDirectory(nullptr);
+
+            std::vector<double> truthMatched(nTruth, 0.);
+            std::vector<double> truthMatched2(nTruth, 0.);
+            std::vector<double> recoMatched(nReco, 0.);
+            std::vector<double> recoMatched2(nReco, 0.);
+            for (std::size_t i_truth = 0; i_truth < nTruth; ++i_truth) {
+                for (std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+                    const std::size_t idx = (i_var*nTruth + i_truth)*nReco + i_reco;
+                    const int binX = fTruthOnHorizontalAxis ? i_truth+1 : i_reco+1;
+                    const int binY = fTruthOnHorizontalAxis ? i_reco+1 : i_truth+1;
+                    histos.migration->SetBinContent(binX, binY, region.migration[idx]);
+                    histos.migration->SetBinError(binX, binY, std::sqrt(region.migration2[idx]));
+                    truthMatched[i_truth] += region.migration[idx];
+                    truthMatched2[i_truth] += region.migration2[idx];
+                    recoMatched[i_reco] += region.migration[idx];
+                    recoMatched2[i_reco] += region.migration2[idx];
+                }
+            }
+            for (std::size_t i_truth = 0; i_truth < nTruth; ++i_truth) {
+                SetRatio(histos.selectionEff.get(), i_truth+1, truthMatched[i_truth], truthMatched2[i_truth],
+                         fTruth[i_var*nTruth + i_truth], fTruth2[i_var*nTruth + i_truth]);
+            }
+            for (std::size_t i_reco = 0; i_reco < nReco; ++i_reco) {
+                SetRatio(histos.acceptance.get(), i_reco+1, recoMatched[i_reco], recoMatched2[i_reco],
+                         region.reco[i_var*nReco + i_reco], region.reco2[i_var*nReco + i_reco]);
+            }
+
+            fHistograms[i_reg].emplace_back(std::move(histos));
+        }
+    }
+}
+
+//__________________________________________________________________________________
+//
+const UnfoldingInputBuilder::Histograms& UnfoldingInputBuilder::GetHistograms(const std::size_t region, const std::size_t variation) const {
+    return fHistograms.at(region).at(variation);
+}
@@ -0,0 +1,97 @@
+// Class include
+#include "TRExFitter/UnfoldingInputCache.h"
+
+// Framework includes
+#include "TRExFitter/Common.h"
+
+// ROOT includes
+#include "TH1.h"
+#include "TH2.h"
+
+//__________________________________________________________________________________
+//
+UnfoldingInputCache::UnfoldingInputCache() :
+    fNReads(0),
+    fNHits(0)
+{
+}
+
+//__________________________________________________________________________________
+//
+UnfoldingInputCache::~UnfoldingInputCache() {
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<TH1> UnfoldingInputCache::GetHisto(const std::vector<std::string>& paths) {
+    const std::string key = Key(paths);
+    auto it = fHistos.find(key);
+    if (it == fHistos.end()) {
+        std::unique_ptr<TH1> h = Common::CombineHistosFromFullPaths(paths);
+        ++fNReads;
+        if (!h) return nullptr;
+        it = fHistos.emplace(key, std::move(h)).first;
+    } else {
+        ++fNHits;
+    }
+
+    std::unique_ptr<TH1> result(static_cast<TH1*>(it->second->Clone()));
+    result->SetDirectory(nullptr);
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<TH2> UnfoldingInputCache::GetMatrix(const std::vector<std::string>& paths) {
+    const std::string key = Key(paths);
+    auto it = fMatrices.find(key);
+    if (it == fMatrices.end()) {
+        std::unique_ptr<TH2> h = Common::CombineHistos2DFromFullPaths(paths);
+        ++fNReads;
+        if (!h) return nullptr;
+        it = fMatrices.emplace(key, std::move(h)).first;
+    } else {
+        ++fNHits;
+    }
+
+    std::unique_ptr<TH2> result(static_cast<TH2*>(it->second->Clone()));
+    result->SetDirectory(nullptr);
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<TH2> UnfoldingInputCache::GetStoredMatrix(const std::string& key) const {
+    auto it = fMatrices.find(key);
+    if (it == fMatrices.end()) return nullptr;
+
+    std::unique_ptr<TH2> result(static_cast<TH2*>(it->second->Clone()));
+    result->SetDirectory(nullptr);
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputCache::StoreMatrix(const std::string& key, const TH2* matrix) {
+    if (!matrix) return;
+    std::unique_ptr<TH2> copy(static_cast<TH2*>(matrix->Clone()));
+    copy->SetDirectory(nullptr);
+    fMatrices[key] = std::move(copy);
+}
+
+//__________________________________________________________________________________
+//
+std::string UnfoldingInputCache::Key(const std::vector<std::string>& paths) {
+    std::string key("");
+    for (const auto& ipath : paths) {
+        key += ipath + "\n";
+    }
+    return key;
+}
+
+//__________________________________________________________________________________
+//
+void UnfoldingInputCache::Clear() {
+    fHistos.clear();
+    fMatrices.clear();
+}
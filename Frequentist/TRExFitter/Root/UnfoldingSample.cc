@@ -12,7 +12,11 @@ UnfoldingSample::UnfoldingSample() :
     fHasResponse(false),
     fHasAcceptance(false),
     fType(UnfoldingSample::TYPE::STANDARD),
-    fGammas(UnfoldingSample::GAMMAS::SEPARATED)
+    fGammas(UnfoldingSample::GAMMAS::SEPARATED),
+    fRecoNtupleName(""),
+    fTruthNtupleName(""),
+    fRecoWeight(""),
+    fTruthWeight("")
 {
 }
 
@@ -8,6 +8,10 @@
 UnfoldingSystematic::UnfoldingSystematic() :
     fCategory(""),
     fSubCategory(""),
+    fRecoWeightSufUp(""),
+    fRecoWeightSufDown(""),
+    fTruthWeightSufUp(""),
+    fTruthWeightSufDown(""),
     fHasUpVariation(false),
     fHasDownVariation(false),
     fSampleSmoothing(false),
@@ -0,0 +1,246 @@
+// Class include
+#include "TRExFitter/WorkspaceCombiner.h"
+
+// framework includes
+#include "TRExFitter/Common.h"
+#include "TRExFitter/StatusLogbook.h"
+
+// ROOT includes
+#include "RooStats/HistFactory/HistoToWorkspaceFactoryFast.h"
+#include "RooStats/HistFactory/Measurement.h"
+#include "RooCategory.h"
+#include "RooDataSet.h"
+#include "RooRealVar.h"
+#include "RooWorkspace.h"
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TNamed.h"
+#include "TSystem.h"
+
+// c++ includes
+#include <iostream>
+#include <sstream>
+
+//__________________________________________________________________________________
+//
+WorkspaceCombiner::WorkspaceCombiner() :
+    fCacheFilePrefix(""),
+    fMeasurement(nullptr),
+    fMeasurementKey("")
+{
+}
+
+//__________________________________________________________________________________
+//
+WorkspaceCombiner::~WorkspaceCombiner() {
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooWorkspace> WorkspaceCombiner::Combine(const std::vector<std::string>& channels,
+                                                         const std::vector<std::string>& files,
+                                                         const std::string& combinedFile,
+                                                         const std::string& measName) {
+    if (channels.empty() || channels.size() != files.size()) {
+        WriteErrorStatus("WorkspaceCombiner::Combine", "No region to combine");
+        return nullptr;
+    }
+
+    // the single-region files are rewritten by each "w" step, the modification times and sizes
+    // make sure that an outdated combination is not used
+    std::ostringstream key;
+    key << "measurement:" << measName << "=" << combinedFile << "@" << Common::FileVersion(combinedFile) << ";";
+    for (std::size_t i_ch = 0; i_ch < channels.size(); ++i_ch) {
+        const std::string version = Common::FileVersion(files[i_ch]);
+        if (version == "") {
+            WriteErrorStatus("WorkspaceCombiner::Combine", "Input file with the workspace doesnt exist: " + files[i_ch]);
+            return nullptr;
+        }
+        key << "channel:" << channels[i_ch] << "=" << files[i_ch] << "@" << version << ";";
+    }
+
+    std::unique_ptr<RooWorkspace> ws = ReadCache(key.str());
+    if (ws) {
+        WriteDebugStatus("WorkspaceCombiner::Combine", "Using cached combination from " + CacheFileName(key.str()));
+        return ws;
+    }
+
+    std::vector<RooWorkspace*> workspaces;
+    for (std::size_t i_ch = 0; i_ch < channels.size(); ++i_ch) {
+        RooWorkspace* chWs = GetChannel(channels[i_ch], files[i_ch]);
+        if (!chWs) return nullptr;
+        workspaces.emplace_back(chWs);
+    }
+
+    // take the measurement from the combined workspace, to be sure to have all the systematics (even the ones which are not there in the first region)
+    RooStats::HistFactory::Measurement* measurement = GetMeasurement(combinedFile, files.front(), measName);
+    if (!measurement) {
+        WriteErrorStatus("WorkspaceCombiner::Combine", "The measurement object has not been retrieved ! Please check.");
+        return nullptr;
+    }
+
+    if (TRExFitter::DEBUGLEVEL < 2) std::cout.setstate(std::ios_base::failbit);
+    // the single-region workspaces are not modified, their pdfs are copied to the combined workspace
+    RooStats::HistFactory::HistoToWorkspaceFactoryFast factory(*measurement);
+    ws.reset(factory.MakeCombinedModel(channels, workspaces));
+    if (ws) {
+        RooStats::HistFactory::HistoToWorkspaceFactoryFast::ConfigureWorkspaceForMeasurement("simPdf", ws.get(), *measurement);
+        AddAdditionalData(ws.get(), channels, workspaces);
+    }
+    if (TRExFitter::DEBUGLEVEL < 2) std::cout.clear();
+    if (!ws) return nullptr;
+
+    WriteCache(key.str(), ws.get());
+
+    return ws;
+}
+
+//__________________________________________________________________________________
+//
+void WorkspaceCombiner::AddAdditionalData(RooWorkspace* combined,
+                                          const std::vector<std::string>& channels,
+                                          const std::vector<RooWorkspace*>& workspaces) {
+    if (!combined || workspaces.empty() || channels.size() != workspaces.size()) return;
+    RooCategory* channelCat = combined->cat("channelCat");
+    if (!channelCat) return;
+
+    for (const auto& idata : workspaces.front()->allData()) {
+        const std::string dataName = idata->GetName();
+        if (dataName == "obsData" || dataName == "asimovData") continue;
+        if (combined->data(dataName.c_str())) continue;
+
+        // same as for obsData in HistoToWorkspaceFactoryFast::MakeCombinedModel
+        std::map<std::string, RooDataSet*> dataMap;
+        RooArgSet obsList;
+        for (std::size_t i_ch = 0; i_ch < channels.size(); ++i_ch) {
+            RooDataSet* data = dynamic_cast<RooDataSet*>(workspaces[i_ch]->data(dataName.c_str()));
+            if (!data || !workspaces[i_ch]->set("observables")) {
+                dataMap.clear();
+                break;
+            }
+            dataMap[channels[i_ch]] = data;
+            obsList.add(*workspaces[i_ch]->set("observables"));
+        }
+        if (dataMap.empty()) {
+            WriteDebugStatus("WorkspaceCombiner::AddAdditionalData", "Data-set " + dataName + " is not in all the regions, not combined");
+            continue;
+        }
+        RooRealVar weightVar("weightVar", "", 1, -1e10, 1e10);
+        obsList.add(weightVar);
+        RooDataSet data(dataName.c_str(), dataName.c_str(), obsList, RooFit::Index(*channelCat), RooFit::Import(dataMap), RooFit::WeightVar("weightVar"));
+        combined->import(data);
+    }
+}
+
+//__________________________________________________________________________________
+//
+RooWorkspace* WorkspaceCombiner::GetChannel(const std::string& name, const std::string& fileName) {
+    const std::string version = Common::FileVersion(fileName);
+    auto it = fChannels.find(fileName);
+    if (it != fChannels.end()) {
+        if (it->second.version == version) return it->second.ws.get();
+        fChannels.erase(it);
+    }
+
+    Channel channel;
+    channel.version = version;
+    channel.file.reset(TFile::Open(fileName.c_str()));
+    if (!channel.file) {
+        WriteErrorStatus("WorkspaceCombiner::GetChannel", "Input file with the workspace doesnt exist!");
+        return nullptr;
+    }
+    channel.ws.reset(static_cast<RooWorkspace*>(channel.file->Get(name.c_str())));
+    if (!channel.ws) {
+        WriteErrorStatus("WorkspaceCombiner::GetChannel", "The workspace (\"" + name + "\") cannot be found in file " + fileName + ". Please check !");
+        return nullptr;
+    }
+    RooWorkspace* ws = channel.ws.get();
+    fChannels.emplace(fileName, std::move(channel));
+
+    return ws;
+}
+
+//__________________________________________________________________________________
+//
+RooStats::HistFactory::Measurement* WorkspaceCombiner::GetMeasurement(const std::string& combinedFile,
+                                                                      const std::string& channelFile,
+                                                                      const std::string& measName) {
+    const std::string key = measName + "=" + combinedFile + "@" + Common::FileVersion(combinedFile) + ";" +
+                            channelFile + "@" + Common::FileVersion(channelFile);
+    if (fMeasurement && key == fMeasurementKey) return fMeasurement.get();
+
+    fMeasurement.reset();
+    fMeasurementKey = key;
+    std::unique_ptr<TFile> f(TFile::Open(combinedFile.c_str(), "READ"));
+    if (f) {
+        fMeasurement.reset(static_cast<RooStats::HistFactory::Measurement*>(f->Get(measName.c_str())));
+        f->Close();
+    }
+    // if failed to get the measurement from the combined ws, take it from the first region
+    if (!fMeasurement) {
+        f.reset(TFile::Open(channelFile.c_str(), "READ"));
+        if (f) {
+            fMeasurement.reset(static_cast<RooStats::HistFactory::Measurement*>(f->Get(measName.c_str())));
+            f->Close();
+        }
+    }
+
+    return fMeasurement.get();
+}
+
+//__________________________________________________________________________________
+//
+std::string WorkspaceCombiner::CacheFileName(const std::string& key) const {
+    return fCacheFilePrefix+"_"+Common::HashString(key)+".root";
+}
+
+//__________________________________________________________________________________
+//
+std::unique_ptr<RooWorkspace> WorkspaceCombiner::ReadCache(const std::string& key) const {
+    if (fCacheFilePrefix == "") return nullptr;
+    const std::string fileName = CacheFileName(key);
+    if (gSystem->AccessPathName(fileName.c_str())) return nullptr;
+
+    std::unique_ptr<TFile> f(TFile::Open(fileName.c_str(), "READ"));
+    if (!f || f->IsZombie()) return nullptr;
+    std::unique_ptr<TNamed> storedKey(static_cast<TNamed*>(f->Get("key")));
+    std::unique_ptr<RooWorkspace> ws(static_cast<RooWorkspace*>(f->Get("combined")));
+    f->Close();
+    if (!storedKey || !ws) return nullptr;
+    if (key != storedKey->GetTitle()) {
+        WriteDebugStatus("WorkspaceCombiner::ReadCache", "Hash collision in " + fileName + ", the combination will be redone");
+        return nullptr;
+    }
+
+    return ws;
+}
+
+//__________________________________________________________________________________
+//
+void WorkspaceCombiner::WriteCache(const std::string& key, RooWorkspace* ws) const {
+    if (fCacheFilePrefix == "" || !ws) return;
+    const std::string fileName = CacheFileName(key);
+    gSystem->mkdir(fileName.substr(0, fileName.find_last_of('/')).c_str(), true);
+
+    // write to a temporary file first, so that parallel jobs never read a partially written file
+    const std::string tmpName = fileName+Form(".%d.tmp", gSystem->GetPid());
+    {
+        TDirectory* dir = gDirectory;
+        std::unique_ptr<TFile> f(TFile::Open(tmpName.c_str(), "RECREATE"));
+        if (!f || f->IsZombie()) {
+            WriteWarningStatus("WorkspaceCombiner::WriteCache", "Cannot create file " + tmpName + ", the combination will not be cached");
+            if (dir) dir->cd();
+            return;
+        }
+        TNamed storedKey("key", key.c_str());
+        storedKey.Write();
+        ws->Write("combined");
+        f->Close();
+        if (dir) dir->cd();
+    }
+    if (gSystem->Rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        gSystem->Unlink(tmpName.c_str());
+        return;
+    }
+    WriteDebugStatus("WorkspaceCombiner::WriteCache", "Combination cached in " + fileName);
+}
@@ -0,0 +1,124 @@
+#ifndef BINNEDTOYMCSAMPLER_H
+#define BINNEDTOYMCSAMPLER_H
+
+#include "RooStats/ToyMCSampler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class RooAbsData;
+class RooAbsPdf;
+class RooAbsReal;
+class RooArgSet;
+class RooCategory;
+class RooRealVar;
+class RooSimultaneous;
+
+/**
+  * \class BinnedToyMCSampler
+  * \brief Toy generator for binned HistFactory models
+  * The toys are Poisson draws of the expected yields in each bin, the global observables
+  * are drawn directly from their Gaussian/Poisson constraints.
+  * The expected yields are evaluated only when the parameters change, so generating many toys
+  * at one parameter point costs only the random draws.
+  * Models that are not supported (non-simultaneous, non-extended or multi-dimensional channels)
+  * are generated by the standard ToyMCSampler.
+  */
+class BinnedToyMCSampler : public RooStats::ToyMCSampler {
+public:
+    /**
+      * The constructor
+      * @param Test statistic
+      * @param Number of toys
+      */
+    explicit BinnedToyMCSampler(RooStats::TestStatistic& ts, const int ntoys);
+
+    /**
+      * The destructor
+      */
+    ~BinnedToyMCSampler() = default;
+
+    /**
+      * Deleted constructors and assignment operators
+      */
+    BinnedToyMCSampler(const BinnedToyMCSampler& s) = delete;
+    BinnedToyMCSampler(BinnedToyMCSampler&& s) = delete;
+    BinnedToyMCSampler& operator=(const BinnedToyMCSampler& s) = delete;
+    BinnedToyMCSampler& operator=(BinnedToyMCSampler&& s) = delete;
+
+    using RooStats::ToyMCSampler::GenerateToyData;
+
+    /**
+      * Generate one toy dataset, randomise the global observables
+      * @param The parameter values used for the generation
+      * @param Weight of the toy
+      * @param The pdf to generate from
+      * @return The toy dataset, owned by the caller
+      */
+    RooAbsData* GenerateToyData(RooArgSet& paramPoint, double& weight, RooAbsPdf& pdf) const override;
+
+    /**
+      * @return Number of times the expected yields were evaluated
+      */
+    inline long int GetNYieldEvaluations() const {return fNYieldEvaluations;}
+
+private:
+    struct Channel {
+        std::string label;
+        RooAbsPdf* pdf;
+        RooRealVar* obs;
+        std::unique_ptr<RooArgSet> obsSet;
+        std::vector<double> yields;
+    };
+
+    enum class ConstraintType {
+        GAUSSIAN,
+        POISSON,
+        OTHER
+    };
+
+    struct Constraint {
+        RooRealVar* glob;
+        ConstraintType type;
+        RooAbsPdf* pdf;
+        RooAbsReal* mean;
+        RooAbsReal* sigma;
+    };
+
+    /**
+      * Helper function to read the channels and the constraint terms of the model
+      * @param The pdf to generate from
+      * @return True if the model can be generated natively
+      */
+    bool SetupModel(RooAbsPdf& pdf) const;
+
+    /**
+      * Helper function to draw the global observables from their constraints
+      */
+    void DrawGlobalObservables() const;
+
+    /**
+      * Helper function to evaluate the expected yields, only if the parameters changed
+      */
+    void UpdateYields() const;
+
+    /**
+      * Helper function to create the dataset from Poisson draws of the expected yields
+      * @return The toy dataset
+      */
+    std::unique_ptr<RooAbsData> GenerateBinnedData() const;
+
+    // everything below is built lazily from the pdf passed by the calculator
+    mutable const RooAbsPdf* fInitialisedPdf;
+    mutable bool fSupported;
+    mutable RooSimultaneous* fSimPdf;
+    mutable RooCategory* fChannelCat;
+    mutable std::vector<Channel> fChannels;
+    mutable std::vector<Constraint> fConstraints;
+    mutable std::vector<RooAbsReal*> fParameters;
+    mutable std::vector<double> fParameterValues;
+    mutable long int fNYieldEvaluations;
+};
+
+#endif
@@ -10,6 +10,7 @@
 #include "TF1.h"
 
 /// c++ stuff
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -20,6 +21,7 @@
 class FitResults;
 class Region;
 class TFile;
+class TFormula;
 class TGraphAsymmErrors;
 class TH1;
 class TH2;
@@ -51,6 +53,7 @@ namespace TRExFitter{
     extern bool NORATIO; // flag to hide ratio pad
     extern double CORRELATIONTHRESHOLD;
     extern bool MERGEUNDEROVERFLOW;
+    extern std::string NTUPLESKIMCACHEDIR; // directory of the skimmed ntuples, empty to always read the full ntuples
     extern std::map< std::string,std::string > SYSTMAP;
     extern std::map< std::string,std::string > SYSTTEX;
     extern std::map< std::string,std::string > NPMAP;
@@ -356,6 +359,22 @@ std::vector<double> CalculateExpression(const NormFactor* nf,
                                         const bool isPostFit,
                                         const SampleHist* sh,
                                         FitResults* fitRes);
+
+/**
+  * A helper function to get a compiled formula
+  * The formulas are compiled only once and cached by formula string
+  * @param Formula, with the parameters written as x[i]
+  * @return Compiled formula, owned by the cache
+  */
+TFormula* GetCompiledFormula(const std::string& formula);
+
+/**
+  * A helper function to evaluate a compiled formula for several parameter sets
+  * @param Compiled formula
+  * @param Parameter sets
+  * @return Formula value for each parameter set
+  */
+std::vector<double> EvaluateFormula(TFormula* formula, const std::vector<std::vector<double> >& params);
 /**
     * A helper function to scale samples (signal) to nominakl SFs
     * @param SampleHist
@@ -363,6 +382,43 @@ std::vector<double> CalculateExpression(const NormFactor* nf,
     */
 void ScaleNominal(const SampleHist* const sig, TH1* hist);
 
+/**
+    * A helper function to get a hash of a string that is stable between runs (64-bit FNV-1a)
+    * Used to name cache files
+    * @param string to hash
+    * @return hash as a hexadecimal string
+    */
+std::string HashString(const std::string& s);
+
+/**
+    * A helper function to get the version of a file, used in the keys of cache files
+    * The modification time has a nanosecond resolution (FileStat_t only has a 1-second resolution,
+    * too coarse for a file rewritten by the next step)
+    * @param file name
+    * @return modification time and size, empty if the file does not exist
+    */
+std::string FileVersion(const std::string& fileName);
+
+/**
+    * A helper function to find the headers included by a file, recursively
+    * They are looked for next to the including file and in the include paths, the other ones (e.g. ROOT headers) are skipped
+    * @param file name
+    * @param include paths
+    * @return paths of the headers
+    */
+std::vector<std::string> IncludedHeaders(const std::string& file, const std::vector<std::string>& includePaths);
+
+/**
+    * A helper function to run work in parallel worker processes
+    * RooFit is not thread safe, so each worker is a forked process that works on its own copy of the
+    * memory; the results have to be passed back through files. A worker fails if its function returns
+    * false or throws.
+    * @param Number of workers
+    * @param Function run by each worker, with the index of the worker (0 to number of workers - 1)
+    * @return true if all the workers were started and succeeded
+    */
+bool RunInWorkers(const std::size_t nWorkers, const std::function<bool(const std::size_t)>& work);
+
 }
 
 #endif
@@ -2,9 +2,11 @@
 #define CORRELATIONMATRIX_H
 
 /// c++ includes
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 
 class CorrelationMatrix {
 
@@ -26,6 +28,15 @@ public:
     void SetAtlasLabel(const std::string& l){fAtlasLabel = l;}
     double GetCorrelation(const std::string& p0, const std::string& p1);
 
+    /**
+      * Use a dense matrix stored outside of this object (e.g. in a memory-mapped file) instead of fMatrix
+      * The matrix is copied into fMatrix only if it gets modified
+      * @param Pointer to the row-major matrix, in the order of the added NPs
+      * @param Size of the matrix
+      * @param Object owning the memory, kept alive together with the matrix
+      */
+    void SetExternalMatrix(const double* data, const std::size_t size, const std::shared_ptr<const void>& owner);
+
     /**
       * Function to draw correlation matrix
       * @param Paths to the output file
@@ -47,6 +58,16 @@ public:
     std::vector<std::vector<double> > fMatrix;
     std::string fOutFolder;
     std::string fAtlasLabel;
+
+private:
+    /**
+      * Helper function to copy the external matrix into fMatrix
+      */
+    void CopyExternalMatrix();
+
+    const double* fExternalMatrix;
+    std::size_t fExternalSize;
+    std::shared_ptr<const void> fExternalOwner;
 };
 
 #endif
@@ -36,7 +36,15 @@ public:
 
     void Print() const;
     void DrawEFTInputs(std::vector < Region* > Regions) const;
-    void FitEFTInputs(std::vector < Region* > Regions, const std::string& fileName);
+
+    /**
+      * Fit the quadratic EFT dependence of all bins of all regions
+      * The fits are closed-form weighted least squares, run in parallel for many bins
+      * @param Regions
+      * @param Path to the text file with the fit results
+      * @param Flag to draw the fits
+      */
+    void FitEFTInputs(std::vector < Region* > Regions, const std::string& fileName, const bool drawFits);
     void ApplyMuFactExpressions(std::vector < Region* > Regions,
                                 std::vector < std::shared_ptr<NormFactor> > &NormFactors);
     void ReadEFTFitResults(std::vector < Region* > Regions, const std::string& fileName);
@@ -45,6 +53,41 @@ public:
     std::string fTitle;
     std::map<std::string,std::vector<std::string> > fRefMap;
     std::map<std::string,std::unique_ptr<EFTExtrap> > fExtrapMap;
+
+private:
+
+    /**
+      * The inputs and the result of the quadratic fit of one bin
+      */
+    struct EFTBinFit {
+        const Region* region;
+        std::string fitName;
+        std::string SMRef;
+        int bin;
+        std::string NFname;
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> y_err;
+        bool isEmpty;
+        bool isFitted;
+        double p0;
+        double p1;
+        double p2;
+    };
+
+    /**
+      * Helper function to fit a range of bins, runs in a thread
+      * @param All the bins
+      * @param First bin
+      * @param Last bin (not included)
+      */
+    static void FitQuadratics(std::vector<EFTBinFit>* fits, const std::size_t first, const std::size_t last);
+
+    /**
+      * Helper function to draw the quadratic fits
+      * @param All the bins
+      */
+    void DrawEFTFits(const std::vector<EFTBinFit>& fits) const;
 };
 
 #endif
@@ -31,6 +31,53 @@ public:
     double GetNuisParErrUp(const std::string& p);
     double GetNuisParErrDown(const std::string& p);
     void ReadFromTXT(const std::string& fileName, const std::vector<std::string>& blinded);
+
+    /**
+      * Function to read the fit results, optionally using the binary file written next to the text file
+      * when it is not older than the text file, and the text file otherwise
+      * @param Path to the text file
+      * @param List of blinded parameters
+      * @param Flag to use the binary file
+      */
+    void ReadFromFile(const std::string& fileName, const std::vector<std::string>& blinded, const bool useBinary);
+
+    /**
+      * Function to read the fit results from the binary format
+      * The file is memory mapped, the correlation matrix is used in place and only paged in when accessed
+      * @param Path to the binary file
+      * @param List of blinded parameters, their values are not printed
+      * @return True if the file could be read
+      */
+    bool ReadFromBinary(const std::string& fileName, const std::vector<std::string>& blinded);
+
+    /**
+      * Function to write the fit results in the binary format
+      * The values of the blinded parameters are stored with Common::DoubleToPseudoHex, as in the text file
+      * @param Path to the binary file
+      * @param Names of the parameters
+      * @param Fitted values
+      * @param Up errors
+      * @param Down errors
+      * @param Dense row-major correlation matrix, in the order of the parameters
+      * @param NLL value
+      * @param List of blinded parameters
+      * @return True if the file could be written
+      */
+    static bool WriteBinary(const std::string& fileName,
+                            const std::vector<std::string>& names,
+                            const std::vector<double>& values,
+                            const std::vector<double>& up,
+                            const std::vector<double>& down,
+                            const std::vector<double>& corr,
+                            const double nll,
+                            const std::vector<std::string>& blinded);
+
+    /**
+      * @param Path to the text file
+      * @return Path to the corresponding binary file
+      */
+    static std::string GetBinaryFileName(const std::string& fileName);
+
     void DrawNPPulls(const std::string &path, const std::string &category, const std::vector < std::shared_ptr<NormFactor> > &normFactors, const std::vector<std::string>& blinded) const;
     void DrawNormFactors(const std::string &path, const std::vector < std::shared_ptr<NormFactor> > &normFactor, const std::vector<std::string>& blinded ) const;
     void DrawGammaPulls(const std::string &path, const std::vector<std::string>& blinded ) const;
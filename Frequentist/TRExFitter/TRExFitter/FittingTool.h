@@ -18,6 +18,7 @@
 
 /// Forward declaration
 class RooFitResult;
+class RooMinimizer;
 class TString;
 class RooAbsPdf;
 class RooAbsData;
@@ -63,6 +64,8 @@ public:
 
     inline void UseMinos(const std::vector<std::string>& minosvar){ m_useMinos = true; m_varMinos = minosvar; }
 
+    inline void SetMinosWorkers(const int workers){ m_minosWorkers = workers; }
+
     inline void SetExternalConstraints(const RooArgSet* externalConstraints = 0){ m_externalConstraints = externalConstraints; }
 
     inline void SetStrategy(const int strategy){m_strategy = strategy;}
@@ -116,11 +119,21 @@ private:
     void PrintMinuitHelp() const;
     
     std::vector<RooRealVar*> GetVectorPOI(const RooStats::ModelConfig* model) const;
+
+    /**
+      * Run MINOS for the parameters in parallel worker processes, all starting from the minimum
+      * found by the minimizer. The asymmetric errors are set on the parameters.
+      * @param The minimizer at the minimum
+      * @param The parameters for MINOS
+      * @return True if the errors were computed, false if MINOS needs to be run in the usual way
+      */
+    bool RunParallelMinos(RooMinimizer* minim, const RooArgSet& params) const;
     
     int m_CPU;
     std::vector<std::pair<std::string, double> > m_valPOIs;
     bool m_useMinos;
     std::vector<std::string> m_varMinos;
+    int m_minosWorkers;
     bool m_constPOI;
     std::unique_ptr<RooFitResult> m_fitResult;
     bool m_noGammas;
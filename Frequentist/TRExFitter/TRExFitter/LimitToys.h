@@ -1,12 +1,17 @@
 #ifndef LIMITTOYS_H
 #define LIMITTOYS_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 class RooAbsData;
 namespace RooStats{
+    class FrequentistCalculator;
+    class ToyMCSampler;
     class ModelConfig;
     class HypoTestInverterResult;
+    class ProfileLikelihoodTestStat;
 }
 
 class LimitToys {
@@ -34,6 +39,10 @@ public:
 
     inline void SetSeed(const int seed){ fToysSeed = seed;}
 
+    inline void SetNWorkers(const int n){fNWorkers = n;}
+
+    inline void SetNativeGenerator(const bool flag){fNativeGenerator = flag;}
+
     inline void SetPlot(const bool flag){fPlot = flag;}
     
     inline void SetFile(const bool flag){fFile = flag;}
@@ -45,6 +54,14 @@ public:
                  RooStats::ModelConfig* mcB) const;
 
 private:
+    /// One batch of toys evaluated at a single scan point
+    struct ScanTask {
+        double x;
+        int nSplusB;
+        int nB;
+        int seed;
+    };
+
     int fNtoysSplusB;
     int fNtoysB;
     float fLimit;
@@ -55,6 +72,56 @@ private:
     bool fPlot;
     bool fFile;
     std::string fOutputPath;
+    int fNWorkers;
+    bool fNativeGenerator;
+
+    /**
+      * Helper function to create the toy sampler used by the calculator
+      * @param The test statistic
+      * @return The toy sampler
+      */
+    std::unique_ptr<RooStats::ToyMCSampler> CreateSampler(RooStats::ProfileLikelihoodTestStat* plr) const;
+
+    /**
+      * Helper function to set up the test statistic and the toy sampler of the calculator
+      * @param The calculator
+      * @param The test statistic
+      * @param ModelConfig for S+B
+      */
+    void ConfigureCalculator(RooStats::FrequentistCalculator* calc,
+                             RooStats::ProfileLikelihoodTestStat* plr,
+                             RooStats::ModelConfig* mcSplusb) const;
+
+    /**
+      * Helper function to split the scan into batches of toys
+      * Each batch has its own seed derived from fToysSeed
+      * @return The list of tasks, ordered in the scan variable
+      */
+    std::vector<ScanTask> MakeScanTasks() const;
+
+    /**
+      * Helper function to run a list of tasks with a single inverter
+      * @param Data
+      * @param ModelConfig for S+B
+      * @param ModelConfig for B only
+      * @param The list of tasks to be processed
+      * @return The (partial) inverter result
+      */
+    std::unique_ptr<RooStats::HypoTestInverterResult> RunTasks(RooAbsData* data,
+                                                               RooStats::ModelConfig* mcSplusb,
+                                                               RooStats::ModelConfig* mcB,
+                                                               const std::vector<ScanTask>& tasks) const;
+
+    /**
+      * Helper function to run the scan in parallel local worker processes and merge the partial results
+      * @param Data
+      * @param ModelConfig for S+B
+      * @param ModelConfig for B only
+      * @return The merged inverter result, nullptr if one of the workers failed
+      */
+    std::unique_ptr<RooStats::HypoTestInverterResult> RunParallel(RooAbsData* data,
+                                                                  RooStats::ModelConfig* mcSplusb,
+                                                                  RooStats::ModelConfig* mcB) const;
 
     void RootOutput(RooStats::HypoTestInverterResult* result) const;
 };
@@ -0,0 +1,137 @@
+#ifndef MCMCSAMPLER_H
+#define MCMCSAMPLER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class RooAbsReal;
+class RooDataSet;
+class RooRealVar;
+class RooWorkspace;
+
+/**
+  * \class MCMCSampler
+  * \brief Adaptive Metropolis sampling of the posterior defined by the workspace likelihood
+  * The target is exp(-NLL) of the combined workspace, including the constraint terms and
+  * the external (regularisation) constraints, with flat priors within the parameter ranges.
+  * All floating parameters are sampled, so the nuisance parameters are marginalised.
+  * Several independent chains are run, optionally in parallel worker processes.
+  */
+class MCMCSampler {
+public:
+
+    /**
+      * A struct holding the posterior summary of one parameter
+      */
+    struct Summary {
+        std::string name;
+        double mean;
+        double sigma;
+        double median;
+        double low68;
+        double high68;
+        double low95;
+        double high95;
+        double rhat;
+    };
+
+    /**
+      * The constructor
+      * @param Workspace with the ModelConfig, the parameters should be at the best-fit values
+      * @param Dataset to sample the posterior for
+      */
+    explicit MCMCSampler(RooWorkspace* ws, RooDataSet* data);
+
+    /**
+      * The destructor
+      */
+    ~MCMCSampler() = default;
+
+    /**
+      * Deleted constructors and assignment operators
+      */
+    MCMCSampler(const MCMCSampler& s) = delete;
+    MCMCSampler(MCMCSampler&& s) = delete;
+    MCMCSampler& operator=(const MCMCSampler& s) = delete;
+    MCMCSampler& operator=(MCMCSampler&& s) = delete;
+
+    inline void SetNChains(const int n){fNChains = n;}
+    inline void SetNSteps(const int n){fNSteps = n;}
+    inline void SetNBurnIn(const int n){fNBurnIn = n;}
+    inline void SetSeed(const int seed){fSeed = seed;}
+    inline void SetNWorkers(const int n){fNWorkers = n;}
+    inline void SetSummaryParameters(const std::vector<std::string>& names){fSummaryNames = names;}
+
+    /**
+      * Run all chains
+      * @return True if all chains succeeded
+      */
+    bool Run();
+
+    /**
+      * @return Posterior summaries of the parameters set with SetSummaryParameters
+      */
+    std::vector<Summary> GetSummaries() const;
+
+    /**
+      * Write the samples in a TTree with one branch per parameter
+      * @param Path to the output ROOT file
+      */
+    void WriteSamples(const std::string& fileName) const;
+
+    /**
+      * Write the posterior summaries in a text file
+      * @param Path to the output text file
+      */
+    void WriteSummary(const std::string& fileName) const;
+
+private:
+
+    /**
+      * Helper function to build the NLL of the model
+      * @return The NLL
+      */
+    std::unique_ptr<RooAbsReal> CreateNLL() const;
+
+    /**
+      * Helper function to run one chain
+      * @param NLL to use
+      * @param Index of the chain
+      * @param Samples, filled with fNSteps x number of parameters values
+      * @param NLL values of the samples
+      * @return Acceptance rate after burn-in
+      */
+    double RunChain(RooAbsReal* nll, const int ichain, std::vector<float>& samples, std::vector<float>& nllValues) const;
+
+    /**
+      * Helper function to run the chains in forked worker processes
+      * @return True if all chains succeeded
+      */
+    bool RunParallel();
+
+    /**
+      * Helper function to update the Cholesky factor of the proposal covariance
+      * @param Proposal covariance (lower triangle, row major)
+      * @param Scale factor
+      * @param Cholesky factor (lower triangle, row major), unchanged if the decomposition fails
+      */
+    void UpdateProposal(const std::vector<double>& cov, const double scale, std::vector<double>& chol) const;
+
+    RooWorkspace* fWs;
+    RooDataSet* fData;
+    int fNChains;
+    int fNSteps;
+    int fNBurnIn;
+    int fSeed;
+    int fNWorkers;
+    std::vector<std::string> fSummaryNames;
+    std::vector<RooRealVar*> fParameters;
+    std::vector<double> fStart;
+    std::vector<double> fWidth;
+    std::vector<std::vector<float> > fSamples;
+    std::vector<std::vector<float> > fNLLValues;
+    std::vector<double> fAcceptance;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef MEMBERSHIPINDEX_H
+#define MEMBERSHIPINDEX_H
+
+/// c++ includes
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Forward class declaration
+class NormFactor;
+class Region;
+class Sample;
+class ShapeFactor;
+class Systematic;
+
+/**
+  * \class PatternList
+  * \brief Compiled version of a list of names with wildcards, as used by Common::FindInStringVector
+  * Names without wildcards are looked up in a hash table, the others are split at the '*' once
+  */
+class PatternList {
+public:
+
+    /**
+      * The constructor
+      * @param The names, possibly with '*' and '?' wildcards
+      */
+    explicit PatternList(const std::vector<std::string>& patterns);
+
+    /**
+      * Same as Common::FindInStringVector on the list
+      * @param The string to look for
+      * @return Index of the first matching pattern, -1 if none matches
+      */
+    int Find(const std::string& s) const;
+
+    inline bool Empty() const {return fPatterns.empty();}
+
+private:
+
+    /**
+      * A pattern with wildcards, split at the '*'
+      */
+    struct Glob {
+        int index;
+        bool hasStar;
+        std::vector<std::string> parts;
+
+        bool Match(const std::string& s) const;
+    };
+
+    std::vector<std::string> fPatterns;
+    std::unordered_map<std::string, int> fExact;
+    std::vector<Glob> fGlobs;
+};
+
+/**
+  * \class MembershipIndex
+  * \brief Precomputed applicability of the samples, systematics, norm and shape factors to the regions
+  * The Regions/Exclude/ExcludeRegionSample lists are resolved once, after the config is read,
+  * so that the loops over regions, samples and systematics do not match strings.
+  * Objects that were not known when the index was built are evaluated directly.
+  * Lists modified after the index is built are not seen by it, so they have to be set before.
+  */
+class MembershipIndex {
+public:
+
+    explicit MembershipIndex() = default;
+    ~MembershipIndex() = default;
+
+    MembershipIndex(const MembershipIndex& m) = delete;
+    MembershipIndex(MembershipIndex&& m) = delete;
+    MembershipIndex& operator=(const MembershipIndex& m) = delete;
+    MembershipIndex& operator=(MembershipIndex&& m) = delete;
+
+    /**
+      * Build the index, the systematics, norm and shape factors of the samples are included
+      * @param Regions
+      * @param Samples
+      * @param Systematics
+      * @param Norm factors
+      * @param Shape factors
+      */
+    void Build(const std::vector<Region*>& regions,
+               const std::vector<std::shared_ptr<Sample> >& samples,
+               const std::vector<std::shared_ptr<Systematic> >& systematics,
+               const std::vector<std::shared_ptr<NormFactor> >& normFactors,
+               const std::vector<std::shared_ptr<ShapeFactor> >& shapeFactors);
+
+    /**
+      * @return True if the region is in the Regions of the sample
+      */
+    bool SampleInRegion(const Sample* smp, const Region* reg) const;
+
+    /**
+      * @return True if the systematic applies to the sample in the region (Regions, Exclude and ExcludeRegionSample)
+      */
+    bool SystematicInRegion(const Systematic* syst, const Region* reg, const Sample* smp) const;
+
+    /**
+      * @return True if the norm factor applies to the region (Regions and Exclude)
+      */
+    bool NormFactorInRegion(const NormFactor* nf, const Region* reg) const;
+
+    /**
+      * @return True if the shape factor applies to the region (Regions and Exclude)
+      */
+    bool ShapeFactorInRegion(const ShapeFactor* sf, const Region* reg) const;
+
+private:
+
+    /**
+      * Helper function to resolve the Regions and Exclude lists of an object for all regions
+      * @param Regions of the object, empty for all regions
+      * @param Regions to exclude
+      * @return One flag per region
+      */
+    std::vector<bool> ResolveRegions(const std::vector<std::string>& regions, const std::vector<std::string>& exclude) const;
+
+    std::vector<std::string> fRegionNames;
+    std::vector<std::string> fSampleNames;
+    std::unordered_map<const Region*, std::size_t> fRegionIdx;
+    std::unordered_map<const Sample*, std::size_t> fSampleIdx;
+    std::unordered_map<const Sample*, std::vector<bool> > fSamples;
+    std::unordered_map<const Systematic*, std::vector<bool> > fSystematics;
+    // region x sample flags, only for the systematics with ExcludeRegionSample
+    std::unordered_map<const Systematic*, std::vector<bool> > fSystematicsExcluded;
+    std::unordered_map<const NormFactor*, std::vector<bool> > fNormFactors;
+    std::unordered_map<const ShapeFactor*, std::vector<bool> > fShapeFactors;
+};
+
+#endif
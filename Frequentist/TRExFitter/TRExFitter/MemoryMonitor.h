@@ -0,0 +1,78 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+/// c++ includes
+#include <string>
+#include <vector>
+
+class MemoryMonitor {
+public:
+
+    struct Record {
+        std::string stage;
+        double resident;  // MB
+        double peak;      // MB
+        long int objects; // live ROOT objects, -1 if not available
+        long int histos;  // histograms held by the framework, -1 if not available
+        std::size_t files;// files in TRExFitter::TFILEMAP
+    };
+
+    explicit MemoryMonitor();
+    ~MemoryMonitor();
+
+    MemoryMonitor(const MemoryMonitor& m) = delete;
+    MemoryMonitor(MemoryMonitor&& m) = delete;
+    MemoryMonitor& operator=(const MemoryMonitor& m) = delete;
+    MemoryMonitor& operator=(MemoryMonitor&& m) = delete;
+
+    inline void SetEnabled(const bool flag){fEnabled = flag;}
+    inline void SetBudget(const double budget){fBudget = budget;}
+    inline bool IsEnabled() const {return fEnabled || fBudget > 0;}
+    inline double GetBudget() const {return fBudget;}
+    inline const std::vector<Record>& GetRecords() const {return fRecords;}
+
+    /**
+      * Resident memory of the current process
+      * @return resident memory in MB
+      */
+    static double GetResidentMemory();
+
+    /**
+      * Peak resident memory of the current process
+      * @return peak resident memory in MB
+      */
+    static double GetPeakMemory();
+
+    /**
+      * Number of live ROOT objects (needs TObject::SetObjectStat(true))
+      * @return number of objects, -1 if the object statistics is not enabled
+      */
+    static long int GetROOTObjectCount();
+
+    /**
+      * Stores and prints the memory usage at the end of a stage
+      * @param name of the stage
+      * @param number of histograms held by the framework (-1 if unknown)
+      * @return the stored record
+      */
+    const Record& Checkpoint(const std::string& stage, const long int histos = -1);
+
+    /**
+      * Checks if the current resident memory is above the budget
+      * @return true if a budget is set and exceeded
+      */
+    bool BudgetExceeded() const;
+
+    /**
+      * Writes the table of all the stored records
+      * @param name of the output file
+      */
+    void WriteToFile(const std::string& fileName) const;
+
+private:
+    bool fEnabled;
+    double fBudget;
+    std::vector<Record> fRecords;
+};
+
+#endif
@@ -157,6 +157,7 @@ public:
     std::string fSignalTitle;
 
     std::string fFitResultsFile;
+    bool fBinaryFitResults;
     std::string fLimitsFile;
     std::vector<std::string> fLimitsFiles;
     std::string fBonlySuffix;
@@ -190,6 +191,8 @@ public:
     double fLimitParamValue;
     std::string fLimitOutputPrefixName;
     double fLimitsConfidence;
+    int fLimitAsymptoticWorkers;
+    bool fLimitAsymptoticWarmStart;
 
     //
     // Significance parameters
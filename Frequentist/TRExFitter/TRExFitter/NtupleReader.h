@@ -1,6 +1,8 @@
 #ifndef NTUPLEREADER_H_
 #define NTUPLEREADER_H_
 
+#include <string>
+
 class TRExFit;
 
 /**
@@ -46,6 +48,13 @@ class NtupleReader {
           * @param regIter Index of a region
           */   
         void DefineVariable(int regIter);
+
+        /**
+          * A helper function to compile and load a file with custom functions,
+          * the library is kept in the cache directory and reused if the code did not change
+          * @param file Name of the .C file
+          */
+        void LoadCustomFunctions(const std::string& file) const;
 };
 
 #endif
@@ -0,0 +1,42 @@
+#ifndef NTUPLESKIMCACHE_H
+#define NTUPLESKIMCACHE_H
+
+/// c++ includes
+#include <string>
+#include <vector>
+
+/// Forward class declaration
+class TChain;
+
+/**
+  * \namespace NtupleSkimCache
+  * \brief Local copies of the input ntuples with only the events passing a selection and the branches
+  * used by the expressions drawn from them.
+  * A skim is identified by the ntuple (files and tree name), the selection and the aliases, and stores the
+  * names, modification times and sizes of the input files: it is rebuilt when one of them changes, or when
+  * a branch that it does not contain is needed (the new skim then contains the branches of both).
+  */
+namespace NtupleSkimCache {
+
+    /**
+      * Draws an expression from the skim of an ntuple, building the skim if needed
+      * Same as TTree::Draw(drawVariable, "(weight)*(selection)", "goff") on the full ntuple
+      * @param Directory of the skims
+      * @param The ntuple, with the aliases set
+      * @param The ntuple as given to TChain::Add (files and tree name)
+      * @param Expression to draw (as for TTree::Draw)
+      * @param Selection
+      * @param Weight
+      * @param Aliases (as "alias:formula")
+      * @return false if the skim cannot be used, and the full ntuple has to be read
+      */
+    bool Draw(const std::string& cacheDir,
+              TChain* chain,
+              const std::string& ntuple,
+              const std::string& drawVariable,
+              const std::string& selection,
+              const std::string& weight,
+              const std::vector<std::string>& aliases);
+}
+
+#endif
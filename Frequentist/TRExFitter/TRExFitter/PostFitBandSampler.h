@@ -0,0 +1,155 @@
+#ifndef POSTFITBANDSAMPLER_H
+#define POSTFITBANDSAMPLER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class FitResults;
+class TGraphAsymmErrors;
+class TH1;
+
+/**
+  * \class PostFitBandSampler
+  * \brief Post-fit uncertainty band from random draws of the fitted parameters
+  * The parameters are drawn from a multivariate normal distribution with the post-fit correlations,
+  * using the asymmetric post-fit errors on each side of the best-fit value.
+  * For each draw the yields are re-evaluated with the same interpolation used for the post-fit plots,
+  * so the band keeps the asymmetric and non-linear effects that the linear propagation neglects.
+  * The band is given by the central 68% interval of the drawn predictions.
+  */
+class PostFitBandSampler {
+public:
+
+    /**
+      * Effect of one parameter on a yield
+      */
+    struct Term {
+        std::size_t par;
+        double up;
+        double down;
+    };
+
+    /**
+      * A yield (one sample in one bin) described as in Region::GetMultFactors
+      */
+    struct Yield {
+        double postFit; // yield at the best-fit values
+        double preFit; // pre-fit nominal yield
+        int intCodeOverall;
+        int intCodeShape;
+        std::vector<Term> overall; // relative up/down variations
+        std::vector<Term> shape; // absolute up/down yields
+        std::vector<std::size_t> scale; // multiplicative parameters (norm factors, gammas)
+    };
+
+    /**
+      * The constructor
+      * @param Fit results with the post-fit values and the correlation matrix
+      */
+    explicit PostFitBandSampler(FitResults* fitRes);
+
+    /**
+      * The destructor
+      */
+    ~PostFitBandSampler() = default;
+
+    /**
+      * Deleted constructors and assignment operators
+      */
+    PostFitBandSampler(const PostFitBandSampler& s) = delete;
+    PostFitBandSampler(PostFitBandSampler&& s) = delete;
+    PostFitBandSampler& operator=(const PostFitBandSampler& s) = delete;
+    PostFitBandSampler& operator=(PostFitBandSampler&& s) = delete;
+
+    inline void SetNDraws(const int n){fNDraws = n;}
+    inline void SetSeed(const int seed){fSeed = seed;}
+    inline void SetNThreads(const int n){fNThreads = n;}
+
+    /**
+      * Register a parameter to be sampled
+      * @param Name of the parameter
+      * @return Index of the parameter, -1 if the parameter is not in the fit results (kept fixed)
+      */
+    int AddParameter(const std::string& name);
+
+    /**
+      * @param Index of the parameter
+      * @return Best-fit value of the parameter
+      */
+    inline double GetParameterValue(const std::size_t i) const {return fValues.at(i);}
+
+    /**
+      * Add a yield to be evaluated for each draw
+      * @param The yield
+      * @return Index of the yield
+      */
+    std::size_t AddYield(const Yield& yield);
+
+    /**
+      * Add an output quantity, i.e. a sum of yields, for which the band is computed
+      * @param Indices of the yields
+      * @return Index of the output
+      */
+    std::size_t AddOutput(const std::vector<std::size_t>& yields);
+
+    /**
+      * Draw the parameters and compute the quantiles of all outputs
+      */
+    void Run();
+
+    /**
+      * Build the band around the nominal histogram
+      * The sampled deviations from the best-fit prediction are added in quadrature
+      * to the bin errors of the nominal histogram (MC stat. uncertainty)
+      * @param Nominal histogram
+      * @param Index of the output for each bin of the histogram
+      * @return The band
+      */
+    std::unique_ptr<TGraphAsymmErrors> GetBand(const TH1* const h_nominal, const std::vector<std::size_t>& outputs) const;
+
+private:
+
+    /**
+      * Helper function to evaluate a yield
+      * @param The yield
+      * @param Parameter values
+      * @return The yield value
+      */
+    double EvaluateYield(const Yield& yield, const std::vector<double>& pars) const;
+
+    /**
+      * Helper function to compute the Cholesky factor of the correlation matrix of the parameters
+      * @return Cholesky factor (lower triangle, row major)
+      */
+    std::vector<double> GetCholesky() const;
+
+    /**
+      * Helper function to evaluate a range of draws, runs in a thread
+      * @param Cholesky factor of the correlation matrix
+      * @param First draw
+      * @param Last draw (not included)
+      * @param Output values, number of draws x number of outputs
+      */
+    void RunDraws(const std::vector<double>& chol, const int first, const int last, std::vector<double>* values) const;
+
+    FitResults* fFitRes;
+    int fNDraws;
+    int fSeed;
+    int fNThreads;
+    std::vector<std::string> fParNames;
+    std::unordered_map<std::string, std::size_t> fParIdx;
+    std::vector<double> fValues;
+    std::vector<double> fErrUp;
+    std::vector<double> fErrDown;
+    std::vector<Yield> fYields;
+    std::vector<double> fMultNominal;
+    std::vector<std::vector<std::size_t> > fOutputs;
+    std::vector<double> fCentral;
+    std::vector<double> fLow;
+    std::vector<double> fHigh;
+};
+
+#endif
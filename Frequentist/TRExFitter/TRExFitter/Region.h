@@ -14,6 +14,7 @@
 
 /// Forwards class declaration
 class FitResults;
+class PostFitBandSampler;
 class Sample;
 class Systematic;
 class TH1;
@@ -67,6 +68,15 @@ public:
                            const bool isUp = true) const;
 
     void BuildPostFitErrorHist(FitResults *fitRes, const std::vector<std::string>& morph_names);
+
+    /**
+      * Add the post-fit yields of the samples to the band sampler
+      * Morphing and expression norm factors are kept at their post-fit values
+      * @param Fit results
+      * @param The sampler
+      * @return Indices of the yields in the sampler, per sample and bin (empty for skipped samples)
+      */
+    std::vector<std::vector<std::size_t> > AddPostFitYieldsToSampler(FitResults* fitRes, PostFitBandSampler* sampler) const;
     std::shared_ptr<TRExPlot> DrawPostFit(FitResults* fitRes,
                                           std::ofstream& pullTex,
                                           const std::vector<std::string>& morph_names,
@@ -280,6 +290,10 @@ public:
     double fChi2prob;
 
     bool fUseGammaPulls;
+    bool fPostFitBandSampling;
+    int fPostFitBandDraws;
+    int fPostFitBandSeed;
+    int fPostFitBandThreads;
 
     std::vector<double> fXaxisRange;
 
@@ -298,6 +312,9 @@ public:
     int fNumberUnfoldingRecoBins;
     bool fNormalizeMigrationMatrix;
     bool fHasAcceptance;
+    std::string fUnfoldingRecoVariable;
+    std::vector<double> fUnfoldingRecoBins;
+    std::string fUnfoldingRecoSelection;
 
     std::string fFolder;
     bool fHEPDataFormat;
@@ -0,0 +1,132 @@
+#ifndef ROORESPONSEMATRIXFUNC_H
+#define ROORESPONSEMATRIXFUNC_H
+
+/// ROOT includes
+#include "RooAbsReal.h"
+#include "RooListProxy.h"
+#include "RooRealProxy.h"
+
+/// c++ includes
+#include <list>
+#include <vector>
+
+/// Forward class declaration
+class RooAbsRealLValue;
+class RooArgList;
+class RooArgSet;
+
+/**
+  * \class RooResponseMatrixFunc
+  * \brief Expected reco-level yields of an unfolding region, as the response matrix times the truth-bin parameters
+  * The value in reco bin r is sum_t c_t * N_t(alpha) * max(0, M_rt(alpha)), where c_t is the coefficient
+  * (product of the norm factors) of truth bin t, M_rt the folded response matrix with the shape variations
+  * interpolated as by PiecewiseInterpolation (code 4) and N_t the normalisation variations interpolated
+  * as by FlexibleInterpVar (code 4), so that it is the sum of the HistFactory samples of the truth bins.
+  * Only the terms of the parameters which changed since the previous evaluation are recomputed,
+  * the cost of a likelihood evaluation scales with reco bins x truth bins instead of reco bins x truth bins x systematics.
+  * It replaces the nominal histogram of the single response sample of the region in the workspace.
+  */
+class RooResponseMatrixFunc : public RooAbsReal {
+public:
+
+    RooResponseMatrixFunc();
+
+    /**
+      * @param Name
+      * @param Title
+      * @param The observable of the region
+      * @param Coefficients of the truth bins
+      * @param Bin edges of the observable (reco bins + 1)
+      * @param Nominal folded response matrix, reco bin r and truth bin t at index r*(number of truth bins)+t
+      */
+    RooResponseMatrixFunc(const char* name,
+                          const char* title,
+                          RooAbsRealLValue& obs,
+                          const RooArgList& coefs,
+                          const std::vector<double>& edges,
+                          const std::vector<double>& nominal);
+
+    RooResponseMatrixFunc(const RooResponseMatrixFunc& other, const char* name = nullptr);
+
+    virtual ~RooResponseMatrixFunc() = default;
+
+    virtual TObject* clone(const char* newname) const override {return new RooResponseMatrixFunc(*this, newname);}
+
+    /**
+      * Adds the variations of a nuisance parameter
+      * @param The nuisance parameter
+      * @param Down normalisation factors of the truth bins (1 = no effect)
+      * @param Up normalisation factors of the truth bins (1 = no effect)
+      * @param Down folded response matrix (same layout as the nominal one), empty if there is no shape variation
+      * @param Up folded response matrix (same layout as the nominal one), empty if there is no shape variation
+      */
+    void AddSystematic(RooAbsReal& param,
+                       const std::vector<double>& normDown,
+                       const std::vector<double>& normUp,
+                       const std::vector<double>& shapeDown,
+                       const std::vector<double>& shapeUp);
+
+    /**
+      * @return Number of reco bins
+      */
+    inline std::size_t NRecoBins() const {return fEdges.size() - 1;}
+
+    /**
+      * @return Number of truth bins
+      */
+    inline std::size_t NTruthBins() const {return fCoefs.getSize();}
+
+    virtual Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars, const char* rangeName = nullptr) const override;
+    virtual Double_t analyticalIntegral(Int_t code, const char* rangeName = nullptr) const override;
+
+    virtual std::list<Double_t>* binBoundaries(RooAbsRealLValue& obs, Double_t xlo, Double_t xhi) const override;
+    virtual std::list<Double_t>* plotSamplingHint(RooAbsRealLValue& obs, Double_t xlo, Double_t xhi) const override;
+    virtual Bool_t isBinnedDistribution(const RooArgSet& /*obs*/) const override {return kTRUE;}
+
+protected:
+
+    virtual Double_t evaluate() const override;
+
+private:
+
+    /**
+      * Helper function to bring the cached reco-bin yields to the current parameter values
+      */
+    void UpdateCache() const;
+
+    /**
+      * Helper function to recompute the folded response matrix with all the shape variations
+      */
+    void ComputeShapes() const;
+
+    RooRealProxy fObs;
+    RooListProxy fCoefs;
+    RooListProxy fParams;
+
+    std::vector<double> fEdges;
+    std::vector<double> fNominal;
+
+    // normalisation variations, the truth bins affected by parameter i are in [fNormOffset[i], fNormOffset[i+1])
+    std::vector<int> fNormOffset;
+    std::vector<int> fNormBin;
+    std::vector<double> fNormDown;
+    std::vector<double> fNormUp;
+
+    // shape variations (up - nominal and nominal - down), the matrix elements affected by parameter i are in [fShapeOffset[i], fShapeOffset[i+1])
+    std::vector<int> fShapeOffset;
+    std::vector<int> fShapeCell;
+    std::vector<double> fShapeDown;
+    std::vector<double> fShapeUp;
+
+    mutable bool fCacheValid; //!
+    mutable int fCacheUpdates; //! incremental updates since the last full computation of the shapes
+    mutable std::vector<double> fCacheParams; //!
+    mutable std::vector<double> fCacheCoefs; //!
+    mutable std::vector<double> fCacheShapes; //!
+    mutable std::vector<double> fCacheNorms; //!
+    mutable std::vector<double> fCacheValues; //!
+
+    ClassDefOverride(RooResponseMatrixFunc, 1)
+};
+
+#endif
@@ -68,6 +68,12 @@ public:
     bool HasSystematic(const std::string& name) const;
     bool HasNuisanceParameter(const std::string& name) const;
 
+    /**
+      * @return Sample name used in the names of the separate gammas of this sample (shape_stat_<sample>_<region>),
+      * the one of CorrelateGammasWithSample if it is set
+      */
+    const std::string& SeparateGammasSample() const;
+
     // -------
     // Members
     // -------
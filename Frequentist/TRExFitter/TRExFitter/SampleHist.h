@@ -109,6 +109,18 @@ public:
 
     std::vector<double> GetDataScales() const;
 
+    /**
+      * Counts the histograms currently held in memory (nominal and systematics)
+      * @return number of histograms
+      */
+    long int CountHistograms() const;
+
+    /**
+      * Releases the intermediate histograms that are not needed after the histogram writing step
+      * (pre-smoothing and regular-binning copies)
+      */
+    void ReleaseIntermediateHistos();
+
     std::string fName;
     Sample *fSample;
     std::unique_ptr<TH1> fHist;
@@ -4,8 +4,11 @@
 /// Framework includes
 #include "TRExFitter/Common.h"
 #include "TRExFitter/HistoTools.h"
+#include "TRExFitter/MembershipIndex.h"
+#include "TRExFitter/MemoryMonitor.h"
 #include "TRExFitter/Systematic.h"
 #include "TRExFitter/TRExPlot.h"
+#include "TRExFitter/WorkspaceCombiner.h"
 
 // Unfolding includes
 #include "UnfoldingCode/UnfoldingCode/FoldingManager.h"
@@ -19,6 +22,7 @@
 #include "RooStats/HistFactory/Measurement.h"
 
 /// c++ includes
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -38,6 +42,8 @@ class ShapeFactor;
 class TGraphAsymmErrors;
 class TruthSample;
 class TFile;
+class TRandom;
+class UnfoldingInputCache;
 class UnfoldingSample;
 class UnfoldingSystematic;
 
@@ -87,6 +93,28 @@ public:
         double value;
     };
 
+    /**
+      * Inputs of the response-matrix function of a region (ResponseMatrixPdf)
+      */
+    struct ResponseMatrix{
+        /**
+          * Variations of a nuisance parameter (one per systematic of the truth-bin samples)
+          */
+        struct Term{
+            std::string np;
+            std::vector<double> normDown; // per truth bin
+            std::vector<double> normUp;
+            std::vector<double> shapeDown; // same layout as the nominal matrix, empty without shape variation
+            std::vector<double> shapeUp;
+        };
+        std::string region;
+        std::string sample;
+        std::vector<double> edges;
+        std::vector<std::vector<std::string> > coefficients; // norm factors of each truth bin
+        std::vector<double> nominal; // reco bin r and truth bin t at r*(number of truth bins)+t
+        std::vector<Term> terms;
+    };
+
     TRExFit(std::string name="MyMeasurement");
     ~TRExFit();
 
@@ -108,6 +136,12 @@ public:
     std::shared_ptr<Systematic> NewSystematic(const std::string& name);
     Region* NewRegion(const std::string& name);
 
+    /**
+      * Function to resolve once which samples, systematics, norm and shape factors apply to which region
+      * To be called after all of them are configured
+      */
+    void BuildMembershipIndex();
+
     // ntuple stuff
     void AddNtuplePath(const std::string& path);
     void SetMCweight(const std::string& weight);
@@ -115,6 +149,53 @@ public:
     void SetNtupleName(const std::string& name);
     void SetNtupleFile(const std::string& name);
     void ComputeBinning(int regIter);
+
+    /**
+      * Fills the fine (10000 bins) signal and background histograms used by the automatic binning
+      * @param Region index
+      * @param Signal histogram (created)
+      * @param Background histogram (created)
+      */
+    void FillFineHistograms(int regIter, TH1D*& hsig, TH1D*& hbkg);
+
+    /**
+      * Builds the key identifying the fine histograms of a region filled from ntuples: variable, selections,
+      * weights, custom functions and input files with their modification times
+      * @param Region index
+      * @return the key, empty if the histograms cannot be cached
+      */
+    std::string FineHistogramsKey(int regIter);
+
+    /**
+      * Name of the cache file of the fine histograms for a given key
+      * @param key
+      * @return file name
+      */
+    std::string FineHistogramsFileName(const std::string& key) const;
+
+    /**
+      * Reads the fine histograms from the cache
+      * @param key
+      * @param Signal histogram (created)
+      * @param Background histogram (created)
+      * @return true if the histograms were cached
+      */
+    bool ReadFineHistograms(const std::string& key, TH1D*& hsig, TH1D*& hbkg) const;
+
+    /**
+      * Stores the fine histograms in the cache
+      * @param key
+      * @param Signal histogram
+      * @param Background histogram
+      */
+    void WriteFineHistograms(const std::string& key, const TH1D* hsig, const TH1D* hbkg) const;
+
+    /**
+      * Fills the fine histograms of all the regions with automatic binning in AutoBinningWorkers
+      * forked processes, they are then read from the cache files by ComputeBinning (and removed without AutoBinningCache)
+      */
+    void FillFineHistogramsInParallel();
+
     void DefineVariable(int regIter);
 
     // histogram stuff
@@ -127,13 +208,103 @@ public:
     void CreateRootFiles();
     void WriteHistos(bool reWriteOrig=true) const;
 
+    /**
+      * Writes the histograms of one region
+      * @param index of the region
+      * @param flag to write the original histograms as well
+      */
+    void WriteRegionHistos(const std::size_t i_ch, const bool reWriteOrig) const;
+
+    /**
+      * Writes the histograms and draws the systematic plots (if requested); with a memory budget this is done
+      * one region at a time, and the intermediate histograms of a region are released as soon as the region is
+      * written and plotted if the budget is exceeded
+      * @param flag to write the original histograms as well
+      */
+    void WriteHistosAndSystPlots(bool reWriteOrig=true);
+
     void DrawSystPlots() const;
     void DrawSystPlotsSumSamples() const;
 
+    /**
+      * Draws the combined plot of the systematic effects on data for one region
+      * @param region
+      * @param data histogram, kept from the previous region if the region has no data
+      */
+    void DrawRegionSystPlotsSumSamples(const Region* reg, std::unique_ptr<TH1>& h_dataCopy) const;
+
     // read from ..
     void CloseInputFiles();
     void CorrectHistograms();
 
+    /**
+      * Helper function for the first pass of CorrectHistograms on a region:
+      * reset to the "_orig" histograms, rebinning, combination of samples, SampleUp/SampleDown systematics,
+      * nominal smoothing and checks
+      * @param pointer to the Region
+      * @param generator for RandomizeMC, seeded by the caller (nullptr to keep the MC as it is)
+      */
+    void CorrectRegionHistograms(Region* reg, TRandom* random);
+
+    /**
+      * Helper function to drop the normalisation or shape part of the systematics (DropNormIn, DropShapeIn) in a region
+      * @param pointer to the Region
+      */
+    void DropSystNormAndShape(Region* reg) const;
+
+    /**
+      * Helper function to keep the normalisation of the sums of samples given in KeepNormForSamples in a region
+      * @param pointer to the Region
+      */
+    void KeepNormForSamples(Region* reg) const;
+
+    /**
+      * Helper function to propagate the systematics of the samples given in SystFromSample in a region
+      * @param pointer to the Region
+      */
+    void PropagateSystFromSample(Region* reg) const;
+
+    /**
+      * Helper function to check that the first pass of CorrectHistograms can be run on the regions in any order,
+      * i.e. that combining samples does not add systematics to the (shared) samples
+      * @return true if the regions can be processed in parallel
+      */
+    bool RegionsAreIndependent() const;
+
+    /**
+      * Helper function to run a task on all regions, with PostProcessingThreads threads
+      * @param the task, called once per region
+      * @param if false, the regions are processed one at a time in the config order
+      */
+    void RunForRegions(const std::function<void(Region*)>& task, const bool parallel) const;
+
+    /**
+      * Records the memory usage at the end of a processing stage and, if the memory budget
+      * is exceeded, releases the intermediate histograms
+      * @param name of the stage
+      */
+    void MemoryCheckpoint(const std::string& stage);
+
+    /**
+      * Checks the memory budget during a step (e.g. after each region) and records the memory usage
+      * the first time it is exceeded; the intermediate histograms of a region are then released by
+      * WriteHistosAndSystPlots, as soon as the region is written and plotted
+      * @param name of the stage
+      */
+    void CheckMemoryBudget(const std::string& stage);
+
+    /**
+      * Counts the histograms held in memory by all the regions
+      * @return number of histograms
+      */
+    long int CountHistogramsInMemory() const;
+
+    /**
+      * Releases the intermediate histograms (pre-smoothing and regular-binning copies)
+      * that are not needed after the histograms have been written
+      */
+    void ReleaseIntermediateHistograms();
+
     void DrawAndSaveAll(std::string opt="");
 
     // separation plots
@@ -152,6 +323,14 @@ public:
 
     void CreateCustomAsimov() const;
 
+    /**
+      * Name of the data-set of the workspace used as observed data: the one of CustomAsimov
+      * if it is stored in the workspace, obsData otherwise
+      * @param The workspace
+      * @return Name of the data-set
+      */
+    std::string ObservedDataName(RooWorkspace* ws) const;
+
     /**
       * Runs code that replaces asimov data with custom asimov for unfolding
       */
@@ -167,6 +346,56 @@ public:
                                                       const int i_ch,
                                                       const int i_smp) const;
 
+    /**
+      * Same as MakeModelAndMeasurementFast in export-only mode, with the single-channel workspaces
+      * built by WorkspaceWorkers forked processes and combined afterwards
+      * @param the measurement, with the histograms collected
+      * @return false if a worker failed (nothing is combined in this case)
+      */
+    bool MakeModelInParallel(RooStats::HistFactory::Measurement& meas) const;
+
+    /**
+      * Adds the additional data-sets (CustomAsimov) of the single-channel workspaces to the combined
+      * workspace written by MakeModelAndMeasurementFast, which only combines obsData
+      * @param the measurement
+      */
+    void CombineAdditionalData(RooStats::HistFactory::Measurement& meas) const;
+
+    /**
+      * Builds the response sample which replaces the truth-bin samples of a region with ResponseMatrixPdf:
+      * its histogram (sum of the folded truth-bin histograms) is written to a file, and it carries the constraint
+      * terms of the nuisance parameters and the norm factors of the truth bins, its nominal histogram is then
+      * replaced by the response-matrix function in the workspaces by InsertResponseMatrices
+      * @param the measurement
+      * @param region index
+      * @param file the histograms of the response sample are written to
+      * @param the sample to fill
+      * @param the response matrix to fill
+      * @return false if the region has no truth-bin sample
+      */
+    bool ResponseSampleToRooStats(RooStats::HistFactory::Measurement* meas,
+                                  const int i_ch,
+                                  const std::string& fileName,
+                                  RooStats::HistFactory::Sample* sample,
+                                  ResponseMatrix* response) const;
+
+    /**
+      * Replaces the nominal histograms of the response samples by the response-matrix functions
+      * in the single-region and combined workspaces written for the measurement
+      * @param the measurement
+      * @param the response matrices of the regions
+      */
+    void InsertResponseMatrices(RooStats::HistFactory::Measurement& meas,
+                                const std::vector<ResponseMatrix>& responses) const;
+
+    /**
+      * Replaces the nominal histogram of the response sample of a region by the response-matrix function
+      * @param the workspace (single-region or combined)
+      * @param the response matrix of the region
+      * @return false if the region or one of the parameters is not in the workspace
+      */
+    bool InsertResponseMatrix(RooWorkspace* ws, const ResponseMatrix& response) const;
+
     void SystPruning() const;
     void DrawPruningPlot() const;
 
@@ -182,8 +411,52 @@ public:
     void Fit(bool isLHscanOnly);
     RooDataSet* DumpData( RooWorkspace *ws, std::map < std::string, int > &regionDataType, std::map < std::string, double > &npValues, std::map < std::string, double > &poiValues);
     std::map < std::string, double > PerformFit( RooWorkspace *ws, RooDataSet* inputData, FitType fitType=SPLUSB, bool save=false);
+
+    /**
+      * Combines the single-region workspaces of a list of regions, reusing the ones already read
+      * and the combinations cached by previous calls or steps (CombinationCache)
+      * @param names of the regions
+      * @return the combined workspace, nullptr if it cannot be built
+      */
     std::unique_ptr<RooWorkspace> PerformWorkspaceCombination( std::vector < std::string > &regionsToFit ) const;
 
+    /**
+      * Name of the file with the combined workspace (takes into account bootstrap)
+      * @return file name
+      */
+    std::string CombinedWorkspaceFileName() const;
+
+    /**
+      * Builds the key identifying a dataset produced by DumpData: combined workspace file and its
+      * modification time, data type of each channel and values of all the parameters of the workspace
+      * @param workspace (with the parameters already set to the values used for the generation)
+      * @param data type per region
+      * @param flag if observed data is available in the workspace
+      * @return the key, empty if the dataset cannot be cached
+      */
+    std::string AsimovCacheKey(RooWorkspace* ws, const std::map<std::string, int>& regionDataType, const bool hasRealData) const;
+
+    /**
+      * Name of the cache file for a given key
+      * @param key
+      * @return file name
+      */
+    std::string AsimovCacheFileName(const std::string& key) const;
+
+    /**
+      * Reads a dataset from the Asimov cache
+      * @param key
+      * @return the dataset (owned by the caller), nullptr if not cached
+      */
+    RooDataSet* ReadAsimovCache(const std::string& key) const;
+
+    /**
+      * Stores a dataset in the Asimov cache
+      * @param key
+      * @param dataset
+      */
+    void WriteAsimovCache(const std::string& key, RooDataSet* data) const;
+
     void PlotFittedNP();
     void PlotCorrelationMatrix();
     void PlotUnfoldedData() const;
@@ -279,6 +552,11 @@ public:
      */
     void RunToys();
 
+    /**
+     * Function to sample the posterior of the fit parameters with MCMC, the NPs are marginalised
+     */
+    void RunPosteriorSampling();
+
     /**
      * Helper function to compute the variable string to be used when reading ntuples, for a given region, sample combination
      * @param pointer to the Region
@@ -439,9 +717,17 @@ public:
       */
     void PrepareUnfolding();
 
+    /**
+      * A helper function to build the migration matrices, selection efficiencies and acceptances
+      * of the UnfoldingSamples with ntuples, for the nominal and the weight systematics, reading
+      * every ntuple once. The histograms are written where the unfolding preparation reads them.
+      */
+    void BuildUnfoldingInputs() const;
+
     /**
       * A helper function to fold systematic distributions needed for unfolding
       * @param Folding manager
+      * @param Cache of the input matrices/histograms
       * @param output file
       * @param Region
       * @param UnfoldingSample
@@ -449,6 +735,7 @@ public:
       * @param Nominal migration matrix
       */
     void ProcessUnfoldingSystematics(FoldingManager* manager,
+                                     UnfoldingInputCache* cache,
                                      TFile* file,
                                      const Region* reg,
                                      const UnfoldingSample* sample,
@@ -550,6 +837,14 @@ public:
     double fStatErrThres;
     std::string fStatErrCons;
     bool fUseGammaPulls;
+    bool fPostFitBandSampling;
+    int fPostFitBandDraws;
+    int fPostFitBandSeed;
+    int fPostFitBandThreads;
+    int fPostProcessingThreads;
+    int fWorkspaceWorkers;
+    int fAutoBinningWorkers;
+    bool fAutoBinningCache;
 
     double fLumi;
     double fLumiScale;
@@ -639,6 +934,7 @@ public:
     bool fDoTables;
     bool fDoSignalRegionsPlot;
     bool fDoPieChartPlot;
+    bool fDoEFTPlots;
 
     std::string fGroupedImpactCategory;
 
@@ -653,6 +949,8 @@ public:
     std::map< std::string, double > fFitFixedNPs;
     std::string fFitNPValuesFromFitResults;
     bool fInjectGlobalObservables;
+    bool fAsimovCache;
+    bool fCombinationCache;
     std::map< std::string, double > fFitPOIAsimov;
     bool fFitIsBlind;
     bool fUseRnd;
@@ -685,6 +983,8 @@ public:
     double fLimitParamValue;
     std::string fLimitOutputPrefixName;
     double fLimitsConfidence;
+    int fLimitAsymptoticWorkers;
+    bool fLimitAsymptoticWarmStart;
 
     //
     // Significance parameters
@@ -720,6 +1020,7 @@ public:
     std::vector<std::string> fCustomFunctions;
     std::vector<std::string> fCustomIncludePaths;
     std::vector<std::string> fCustomFunctionsExecutes;
+    std::string fCustomFunctionsCacheDir;
 
     std::vector<std::string> fMorphParams;
     std::vector<std::pair<double,std::string> > fTemplatePair;
@@ -796,6 +1097,7 @@ public:
     int fDebugNev;
     
     int fCPU;
+    int fMinosWorkers;
 
     std::vector< std::string > fSeparationPlot;
     FoldingManager::MATRIXORIENTATION fMatrixOrientation;
@@ -853,6 +1155,12 @@ public:
     bool fValidationPruning;
     bool fUnfoldNormXSec;
     int fUnfoldNormXSecBinN;
+    bool fUnfoldingResponseMatrixPdf;
+    bool fUnfoldingInputsFromNtuples;
+    std::string fUnfoldingTruthVariable;
+    std::vector<double> fUnfoldingTruthBins;
+    std::string fUnfoldingTruthSelection;
+    std::vector<std::string> fUnfoldingMatchingIndex;
     bool fUsePOISinRanking;
     bool fUseHesseBeforeMigrad;
     bool fUseNllInLHscan;
@@ -862,10 +1170,22 @@ public:
     double fLimitToysScanMin;
     double fLimitToysScanMax;
     int fToysSeed;
+    bool fToysNativeGenerator;
+    int fMCMCChains;
+    int fMCMCSteps;
+    int fMCMCBurnIn;
+    int fMCMCSeed;
+    int fMCMCWorkers;
     int fLimitToysSeed;
+    int fLimitToysWorkers;
     bool fLimitPlot;
     bool fLimitFile;
     bool fDataWeighted;
+    bool fBinaryFitResults;
+    MemoryMonitor fMemoryMonitor;
+    bool fMemoryBudgetWarned;
+    MembershipIndex fMembershipIndex;
+    mutable WorkspaceCombiner fWorkspaceCombiner;
 };
 
 #endif
@@ -0,0 +1,171 @@
+#ifndef UNFOLDINGINPUTBUILDER_H
+#define UNFOLDINGINPUTBUILDER_H
+
+/// c++ includes
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Forward class declaration
+class TH1D;
+class TH2D;
+class TTree;
+
+/**
+  * \class UnfoldingInputBuilder
+  * \brief Migration matrices, selection efficiencies and acceptances of one unfolding sample built from its ntuples
+  * The truth and the reco trees are read once per input file: the reco events are matched to the truth events of the
+  * same file by index (e.g. run and event number), and the histograms of all the regions are filled for the nominal
+  * weights and for all the weight variations at the same time.
+  * The migration matrix contains the events passing both the truth and the reco selection, the selection efficiency
+  * (per truth bin) is the fraction of the truth events which pass the reco selection, and the acceptance (per reco bin)
+  * is the fraction of the reco events which pass the truth selection.
+  */
+class UnfoldingInputBuilder {
+public:
+
+    /**
+      * The histograms of one region for one variation
+      */
+    struct Histograms {
+        std::unique_ptr<TH2D> migration;
+        std::unique_ptr<TH1D> selectionEff;
+        std::unique_ptr<TH1D> acceptance;
+    };
+
+    explicit UnfoldingInputBuilder();
+    ~UnfoldingInputBuilder();
+
+    UnfoldingInputBuilder(const UnfoldingInputBuilder& b) = delete;
+    UnfoldingInputBuilder(UnfoldingInputBuilder&& b) = delete;
+    UnfoldingInputBuilder& operator=(const UnfoldingInputBuilder& b) = delete;
+    UnfoldingInputBuilder& operator=(UnfoldingInputBuilder&& b) = delete;
+
+    /**
+      * @param Input files, each containing both trees
+      * @param Name of the reco tree
+      * @param Name of the truth tree
+      */
+    void SetNtuples(const std::vector<std::string>& files,
+                    const std::string& recoTreeName,
+                    const std::string& truthTreeName);
+
+    /**
+      * @param Expressions used to match the reco and the truth events (major and optional minor, as for TTree::BuildIndex)
+      */
+    void SetMatchingIndex(const std::vector<std::string>& index);
+
+    /**
+      * @param Truth variable
+      * @param Truth bin edges
+      * @param Truth selection
+      * @param Truth weight
+      */
+    void SetTruth(const std::string& variable,
+                  const std::vector<double>& bins,
+                  const std::string& selection,
+                  const std::string& weight);
+
+    /**
+      * @param Reco weight, common to all the regions
+      */
+    inline void SetRecoWeight(const std::string& weight){fRecoWeight = weight;}
+
+    /**
+      * @param Flag to put the truth on the horizontal axis of the migration matrix
+      */
+    inline void SetTruthOnHorizontalAxis(const bool flag){fTruthOnHorizontalAxis = flag;}
+
+    /**
+      * Adds a region
+      * @param Name of the region
+      * @param Reco variable
+      * @param Reco bin edges
+      * @param Reco selection
+      * @return index of the region
+      */
+    std::size_t AddRegion(const std::string& name,
+                          const std::string& variable,
+                          const std::vector<double>& bins,
+                          const std::string& selection);
+
+    /**
+      * Adds a weight variation, the nominal (index 0) is added by the constructor
+      * @param Name of the variation
+      * @param Factor applied to the reco weight, empty for none
+      * @param Factor applied to the truth weight, empty for none
+      * @return index of the variation
+      */
+    std::size_t AddVariation(const std::string& name,
+                             const std::string& recoWeightSuf,
+                             const std::string& truthWeightSuf);
+
+    /**
+      * Reads the ntuples and fills the histograms of all the regions and variations
+      * @return false if an input cannot be read
+      */
+    bool Build();
+
+    /**
+      * @param Index of the region
+      * @param Index of the variation
+      * @return The histograms, owned by the builder
+      */
+    const Histograms& GetHistograms(const std::size_t region, const std::size_t variation) const;
+
+private:
+
+    /**
+      * A region, with its sums of weights for all the variations
+      */
+    struct RecoRegion {
+        std::string name;
+        std::string variable;
+        std::vector<double> bins;
+        std::string selection;
+        std::vector<double> migration; // [variation][truth bin][reco bin]
+        std::vector<double> migration2;
+        std::vector<double> reco; // [variation][reco bin]
+        std::vector<double> reco2;
+    };
+
+    /**
+      * A weight variation
+      */
+    struct Variation {
+        std::string name;
+        std::string recoWeightSuf;
+        std::string truthWeightSuf;
+    };
+
+    /**
+      * Reads the trees of one file
+      * @param Truth tree
+      * @param Reco tree
+      * @return false if the formulas cannot be compiled
+      */
+    bool ReadTrees(TTree* truth, TTree* reco);
+
+    /**
+      * Creates the histograms from the sums of weights
+      */
+    void MakeHistograms();
+
+    std::vector<std::string> fFiles;
+    std::string fRecoTreeName;
+    std::string fTruthTreeName;
+    std::vector<std::string> fMatchingIndex;
+    std::string fTruthVariable;
+    std::vector<double> fTruthBins;
+    std::string fTruthSelection;
+    std::string fTruthWeight;
+    std::string fRecoWeight;
+    bool fTruthOnHorizontalAxis;
+    std::vector<RecoRegion> fRegions;
+    std::vector<Variation> fVariations;
+    std::vector<double> fTruth; // [variation][truth bin]
+    std::vector<double> fTruth2;
+    std::vector<std::vector<Histograms> > fHistograms; // [region][variation]
+};
+
+#endif
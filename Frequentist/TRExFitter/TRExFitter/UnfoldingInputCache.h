@@ -0,0 +1,80 @@
+#ifndef UNFOLDINGINPUTCACHE_H
+#define UNFOLDINGINPUTCACHE_H
+
+/// c++ includes
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Forward class declaration
+class TH1;
+class TH2;
+
+/**
+  * Keeps the response/migration matrices and the efficiency/acceptance histograms
+  * read during the unfolding preparation of a region, so that the inputs used more than once
+  * (e.g. as reference by many systematics) are read only once from the files.
+  * The inputs are kept until Clear() is called at the end of the region
+  */
+class UnfoldingInputCache {
+public:
+    explicit UnfoldingInputCache();
+    ~UnfoldingInputCache();
+
+    UnfoldingInputCache(const UnfoldingInputCache& c) = delete;
+    UnfoldingInputCache(UnfoldingInputCache&& c) = delete;
+    UnfoldingInputCache& operator=(const UnfoldingInputCache& c) = delete;
+    UnfoldingInputCache& operator=(UnfoldingInputCache&& c) = delete;
+
+    /**
+      * Returns the sum of the histograms from the paths, read from the files on the first request only
+      * @param full paths
+      * @return a copy of the histogram that can be modified, nullptr if it cannot be read
+      */
+    std::unique_ptr<TH1> GetHisto(const std::vector<std::string>& paths);
+
+    /**
+      * Returns the sum of the 2D histograms from the paths, read from the files on the first request only
+      * @param full paths
+      * @return a copy of the matrix that can be modified, nullptr if it cannot be read
+      */
+    std::unique_ptr<TH2> GetMatrix(const std::vector<std::string>& paths);
+
+    /**
+      * Returns a matrix stored with StoreMatrix
+      * @param key
+      * @return a copy of the matrix, nullptr if not stored
+      */
+    std::unique_ptr<TH2> GetStoredMatrix(const std::string& key) const;
+
+    /**
+      * Stores a copy of a derived matrix (e.g. a response calculated from other inputs)
+      * @param key
+      * @param matrix
+      */
+    void StoreMatrix(const std::string& key, const TH2* matrix);
+
+    /**
+      * Builds a key from a list of paths
+      * @param paths
+      * @return key
+      */
+    static std::string Key(const std::vector<std::string>& paths);
+
+    /**
+      * Removes all the stored histograms
+      */
+    void Clear();
+
+    inline std::size_t GetNReads() const {return fNReads;}
+    inline std::size_t GetNHits() const {return fNHits;}
+
+private:
+    std::map<std::string, std::unique_ptr<TH1> > fHistos;
+    std::map<std::string, std::unique_ptr<TH2> > fMatrices;
+    std::size_t fNReads;
+    std::size_t fNHits;
+};
+
+#endif
@@ -47,6 +47,14 @@ public:
     inline TYPE GetType() const {return fType;}
     inline void SetGammas(const GAMMAS gammas){fGammas = gammas;}
     inline GAMMAS GetGammas() const {return fGammas;}
+    inline void SetRecoNtupleName(const std::string& s) {fRecoNtupleName = s;}
+    inline const std::string& GetRecoNtupleName() const {return fRecoNtupleName;}
+    inline void SetTruthNtupleName(const std::string& s) {fTruthNtupleName = s;}
+    inline const std::string& GetTruthNtupleName() const {return fTruthNtupleName;}
+    inline void SetRecoWeight(const std::string& s) {fRecoWeight = s;}
+    inline const std::string& GetRecoWeight() const {return fRecoWeight;}
+    inline void SetTruthWeight(const std::string& s) {fTruthWeight = s;}
+    inline const std::string& GetTruthWeight() const {return fTruthWeight;}
 
     std::vector<std::shared_ptr<Sample> > ConvertToSample(const Region* reg,
                                                           const int bins,
@@ -79,6 +87,9 @@ public:
     std::vector<std::string> fMigrationFileSuffs;
     std::vector<std::string> fMigrationNameSuffs;
     std::vector<std::string> fMigrationPathSuffs;
+
+    std::vector<std::string> fNtupleFiles;
+    std::vector<std::string> fNtuplePaths;
     
     std::vector<std::string> fRegions;
     std::map<int,std::vector<std::string>> fSubSampleRegions;
@@ -92,6 +103,10 @@ private:
     bool fHasAcceptance;
     TYPE fType;
     GAMMAS fGammas;
+    std::string fRecoNtupleName;
+    std::string fTruthNtupleName;
+    std::string fRecoWeight;
+    std::string fTruthWeight;
 };
 
 #endif
@@ -97,6 +97,10 @@ public:
     std::vector<std::string> fMigrationNameSuffsDown;
     std::vector<std::string> fMigrationFileSuffsUp;
     std::vector<std::string> fMigrationFileSuffsDown;
+    std::string fRecoWeightSufUp;
+    std::string fRecoWeightSufDown;
+    std::string fTruthWeightSufUp;
+    std::string fTruthWeightSufDown;
 
     bool fHasUpVariation;
     bool fHasDownVariation;
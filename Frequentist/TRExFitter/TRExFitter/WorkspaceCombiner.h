@@ -0,0 +1,126 @@
+#ifndef WORKSPACECOMBINER_H
+#define WORKSPACECOMBINER_H
+
+/// c++ includes
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Forward class declaration
+class RooWorkspace;
+class TFile;
+
+namespace RooStats {
+    namespace HistFactory {
+        class Measurement;
+    }
+}
+
+/**
+  * \class WorkspaceCombiner
+  * \brief Combination of single-region workspaces into the workspace of a subset of the regions
+  * The single-region workspaces are read once and kept in memory, so that combinations of different
+  * subsets of the regions (e.g. the regions with real data for mixed fits, then all the regions)
+  * only build the simultaneous pdf.
+  * If a cache file prefix is set, the combined workspaces are also stored on disk, keyed on the regions
+  * and the modification times (nanosecond resolution) and sizes of their files, and reused by the following steps.
+  */
+class WorkspaceCombiner {
+public:
+
+    explicit WorkspaceCombiner();
+    ~WorkspaceCombiner();
+
+    WorkspaceCombiner(const WorkspaceCombiner& c) = delete;
+    WorkspaceCombiner(WorkspaceCombiner&& c) = delete;
+    WorkspaceCombiner& operator=(const WorkspaceCombiner& c) = delete;
+    WorkspaceCombiner& operator=(WorkspaceCombiner&& c) = delete;
+
+    /**
+      * @param Prefix of the files of the disk cache (including the directory), empty to disable it
+      */
+    inline void SetCacheFilePrefix(const std::string& prefix){fCacheFilePrefix = prefix;}
+
+    /**
+      * Build the combined workspace of a list of regions
+      * @param Names of the regions (= names of the single-region workspaces), in the order of the combination
+      * @param Files with the single-region workspaces
+      * @param File with the combined workspace of all regions, the measurement is taken from it if possible
+      * @param Name of the measurement
+      * @return The combined workspace, nullptr if it cannot be built
+      */
+    std::unique_ptr<RooWorkspace> Combine(const std::vector<std::string>& channels,
+                                          const std::vector<std::string>& files,
+                                          const std::string& combinedFile,
+                                          const std::string& measName);
+
+    /**
+      * Combine the additional data-sets of the single-region workspaces (other than obsData and asimovData)
+      * that are in all the regions and not yet in the combined workspace
+      * @param The combined workspace
+      * @param Names of the regions
+      * @param The single-region workspaces
+      */
+    static void AddAdditionalData(RooWorkspace* combined,
+                                  const std::vector<std::string>& channels,
+                                  const std::vector<RooWorkspace*>& workspaces);
+
+private:
+
+    /**
+      * A single-region workspace read from its file
+      */
+    struct Channel {
+        std::string version; // modification time and size of the file
+        std::unique_ptr<TFile> file;
+        std::unique_ptr<RooWorkspace> ws;
+    };
+
+    /**
+      * Helper function to get a single-region workspace, read again if the file changed
+      * @param Name of the workspace
+      * @param File name
+      * @return The workspace (owned by the combiner), nullptr if it cannot be read
+      */
+    RooWorkspace* GetChannel(const std::string& name, const std::string& fileName);
+
+    /**
+      * Helper function to get the measurement, from the combined file or else from the first region file
+      * @param File with the combined workspace
+      * @param File with the first single-region workspace
+      * @param Name of the measurement
+      * @return The measurement (owned by the combiner), nullptr if not found
+      */
+    RooStats::HistFactory::Measurement* GetMeasurement(const std::string& combinedFile,
+                                                       const std::string& channelFile,
+                                                       const std::string& measName);
+
+    /**
+      * Name of the cache file for a given key
+      * @param key
+      * @return file name
+      */
+    std::string CacheFileName(const std::string& key) const;
+
+    /**
+      * Reads a combined workspace from the disk cache
+      * @param key
+      * @return the workspace, nullptr if not cached
+      */
+    std::unique_ptr<RooWorkspace> ReadCache(const std::string& key) const;
+
+    /**
+      * Stores a combined workspace in the disk cache
+      * @param key
+      * @param workspace
+      */
+    void WriteCache(const std::string& key, RooWorkspace* ws) const;
+
+    std::string fCacheFilePrefix;
+    std::map<std::string, Channel> fChannels; // by file name
+    std::unique_ptr<RooStats::HistFactory::Measurement> fMeasurement;
+    std::string fMeasurementKey;
+};
+
+#endif
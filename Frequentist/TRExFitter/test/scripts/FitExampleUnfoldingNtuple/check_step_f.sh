@@ -0,0 +1,3 @@
+#!/bin/bash
+# the inputs built from the ntuples have to give the same results as the expected inputs from CreateUnfoldingNtuples.C
+diff -w FitExampleUnfoldingNtuple/Fits/FitExampleUnfoldingNtuple.txt FitExampleUnfoldingNtupleHist/Fits/FitExampleUnfoldingNtupleHist.txt && diff -w FitExampleUnfoldingNtuple/Fits/UnfoldedResults.txt FitExampleUnfoldingNtupleHist/Fits/UnfoldedResults.txt
@@ -0,0 +1,3 @@
+#!/bin/bash
+# the workspace built by the workers has to give the same fit result as the sequential one
+diff -w FitExampleWorkspaceWorkers/Fits/FitExampleWorkspaceWorkers.txt test/reference/FitExample/Fits/FitExample.txt
@@ -0,0 +1,3 @@
+#!/bin/bash
+# the workspace built by the workers has to give the same pruning as the sequential one
+diff FitExampleWorkspaceWorkers/PruningText.txt test/reference/FitExample/PruningText.txt
@@ -135,6 +135,26 @@ for step in u h w f; do
   rm -f LOG_UNFOLDING_$step
 done
 
+mkdir -p test/logs/FitExampleWorkspaceWorkers
+for step in h w f; do
+  echo "==> WorkspaceWorkers $step step ongoing"
+  ./build/bin/trex-fitter $step test/configs/FitExampleWorkspaceWorkers.config >& LOG_WORKERS_$step
+  cat LOG_WORKERS_$step | grep -v "TRExFitter" >& test/logs/FitExampleWorkspaceWorkers/LOG_WORKERS_$step
+  rm -f LOG_WORKERS_$step
+done
+
+mkdir -p test/logs/FitExampleUnfoldingNtuple
+root -l -b -q test/scripts/FitExampleUnfoldingNtuple/CreateUnfoldingNtuples.C
+for step in u h w f; do
+  echo "==> Unfolding from ntuples $step step ongoing"
+  ./build/bin/trex-fitter $step test/configs/FitExampleUnfoldingNtuple.config >& LOG_UNFOLDING_NTUPLE_$step
+  cat LOG_UNFOLDING_NTUPLE_$step | grep -v "TRExFitter" >& test/logs/FitExampleUnfoldingNtuple/LOG_UNFOLDING_NTUPLE_$step
+  rm -f LOG_UNFOLDING_NTUPLE_$step
+  ./build/bin/trex-fitter $step test/configs/FitExampleUnfoldingNtupleHist.config >& LOG_UNFOLDING_NTUPLE_HIST_$step
+  cat LOG_UNFOLDING_NTUPLE_HIST_$step | grep -v "TRExFitter" >& test/logs/FitExampleUnfoldingNtuple/LOG_UNFOLDING_NTUPLE_HIST_$step
+  rm -f LOG_UNFOLDING_NTUPLE_HIST_$step
+done
+
 ##
 ## Making a git status and asks if the files have to be added
 ##
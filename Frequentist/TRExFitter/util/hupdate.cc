@@ -1,130 +1,325 @@
-// The scripts behave exactly as "hadd -f", with the notable difference 
+// The scripts behave exactly as "hadd -f", with the notable difference
 // that it will not add identical TH1, keeping just one copy of them
 // So if calling
-//     hupdate targetfile file1 file2
+//     hupdate [-j N] targetfile file1 file2
 // with
 //     file1 containing two TH1:   h1 h2
 //     file2 containing two TH1:   h2 h3
-// targetfile will contain:        h1 h2 h3, 
+// targetfile will contain:        h1 h2 h3,
 // with h2 taken only from file1 (not added to its copy in file2)
-// The script is not (yet) iterating over subdirectories, not needed for its purposes
+// Subdirectories are merged recursively, with the same rule applied to the objects they contain.
+// The objects are copied as raw (compressed) key payloads, without being deserialised,
+// and the payloads are read from the source files by N threads (default: number of cores).
+// Trees cannot be copied this way (their baskets are not in the key) and are fast-cloned instead.
+// The target file is read back at the end to check the copied keys.
 //
 // author: Giancarlo Panizzo giancarlo.panizzo@cern.ch
 //         (adapted from hadd)
-#include <stdio.h>
-#include <string.h>
-#include "TChain.h"
+#include "TClass.h"
+#include "TDirectory.h"
 #include "TFile.h"
-#include "TH1.h"
-#include "TTree.h"
 #include "TKey.h"
-#include "Riostream.h"
+#include "TList.h"
+#include "TROOT.h"
+#include "TStreamerInfo.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// maximum size of the payloads read ahead of the writer
+constexpr std::size_t MAXBUFFEREDBYTES = 512*1024*1024;
+
+// an object to be copied to the target file
+struct Entry {
+    std::string path; // full path in the source file
+    std::string name;
+    std::string title;
+    std::string className;
+    Int_t objlen;
+    Int_t keylen;
+    Int_t nbytes;
+    Long64_t seekKey;
+    bool isTree;
+    TDirectory* target;
+};
+
+struct Source {
+    std::string fileName;
+    std::unique_ptr<TFile> file;
+    std::vector<Entry> entries;
+    // payloads read ahead by the reading threads, in the order of the entries
+    std::deque<std::vector<char> > payloads;
+};
+
+// synchronisation between the reading threads and the writer
+struct ReadState {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t buffered = 0;
+    std::size_t current = 0; // source being written
+    bool stop = false; // set by the writer on failure
+    std::atomic<std::size_t> next{0}; // next source to read
+};
+
+// key built from the raw payload of a key of another file
+class RawKey : public TKey {
+public:
+    RawKey(const Entry& entry, const std::vector<char>& payload, TDirectory* motherDir) : TKey(motherDir) {
+        SetName(entry.name.c_str());
+        SetTitle(entry.title.c_str());
+        fClassName = entry.className;
+        // as for the keys built by ROOT, past 2 GB the key uses 64-bit seek fields, which changes its size
+        if (GetFile() && GetFile()->GetEND() > TFile::kStartBigFile) fVersion += 1000;
+        fKeylen = Sizeof();
+        fObjlen = entry.objlen;
+        const Int_t nbytes = payload.size();
+        // room for the key header, the payload, and the marker written by Create when filling a gap
+        fBuffer = new char[fKeylen + nbytes + sizeof(Int_t)];
+        std::memcpy(fBuffer + fKeylen, payload.data(), nbytes);
+        Create(nbytes);
+        fCycle = fMotherDir->AppendKey(this);
+    }
+};
+
+// list the objects to copy from a source directory, first one wins
+void ListKeys(TDirectory* dir, const std::string& path, TDirectory* target, std::set<std::string>& seen, Source& source){
+    std::set<std::string> names;
+    TIter nextkey( dir->GetListOfKeys() );
+    TKey* key;
+    while ( (key = static_cast<TKey*>(nextkey())) ) {
+        const std::string name = key->GetName();
+        // keep only the highest cycle number for each key (listed first)
+        if (!names.insert(name).second) continue;
+        const std::string fullPath = path.empty() ? name : path + "/" + name;
+        TClass* cl = TClass::GetClass(key->GetClassName());
+        if (cl && cl->InheritsFrom(TDirectory::Class())) {
+            TDirectory* targetDir = target->GetDirectory(name.c_str());
+            if (!targetDir) targetDir = target->mkdir(name.c_str(), key->GetTitle());
+            TDirectory* subdir = dir->GetDirectory(name.c_str());
+            if (subdir) ListKeys(subdir, fullPath, targetDir, seen, source);
+            continue;
+        }
+        //FIXME: no check if the objects are actually different, just look at the name ...
+        if (!seen.insert(fullPath).second) continue;
+        const bool isTree = cl && cl->InheritsFrom(TTree::Class());
+        source.entries.push_back({fullPath, name, key->GetTitle(), key->GetClassName(),
+                                  key->GetObjlen(), key->GetKeylen(), key->GetNbytes(), key->GetSeekKey(), isTree, target});
+    }
+}
+
+// make sure the target file describes the classes of the copied payloads
+void CopyStreamerInfos(TFile* source, TFile* target){
+    std::unique_ptr<TList> infos(source->GetStreamerInfoList());
+    if (!infos) return;
+    TIter next(infos.get());
+    TObject* obj;
+    while ( (obj = next()) ) {
+        if (obj->IsA() != TStreamerInfo::Class()) continue;
+        TStreamerInfo* oldInfo = static_cast<TStreamerInfo*>(obj);
+        TClass* cl = TClass::GetClass(oldInfo->GetName());
+        TVirtualStreamerInfo* info = nullptr;
+        if (cl && (!cl->IsLoaded() || cl->GetNew())) {
+            info = cl->GetStreamerInfo(oldInfo->GetClassVersion());
+            if (oldInfo->GetClassVersion() == 1) {
+                TVirtualStreamerInfo* matchInfo = cl->FindStreamerInfo(oldInfo->GetCheckSum());
+                if (matchInfo) info = matchInfo;
+            }
+        }
+        if (!info) info = oldInfo;
+        info->ForceWriteInfo(target);
+    }
+}
+
+// read the target file back and check that every copied key is found with its name, class and size,
+// and that the last object written (the furthest in the file) can be read
+bool VerifyTarget(const std::string& fileName, const std::vector<Source>& sources){
+    std::unique_ptr<TFile> file(TFile::Open(fileName.c_str(), "READ"));
+    if (!file || file->IsZombie()) {
+        std::cout << "Cannot open the target file " << fileName << " to check it" << std::endl;
+        return false;
+    }
+    TKey* last = nullptr;
+    for (const Source& source : sources) {
+        for (const Entry& entry : source.entries) {
+            if (entry.isTree) continue;
+            const std::size_t pos = entry.path.rfind('/');
+            TDirectory* dir = (pos == std::string::npos) ? file.get() : file->GetDirectory(entry.path.substr(0, pos).c_str());
+            TKey* key = dir ? dir->GetKey(entry.name.c_str()) : nullptr;
+            if (!key || entry.className != key->GetClassName() || key->GetObjlen() != entry.objlen ||
+                key->GetNbytes() - key->GetKeylen() != entry.nbytes - entry.keylen ||
+                key->GetSeekKey() + key->GetNbytes() > file->GetEND()) {
+                std::cout << "The object " << entry.path << " is not correctly stored in the target file" << std::endl;
+                return false;
+            }
+            if (!last || key->GetSeekKey() > last->GetSeekKey()) last = key;
+        }
+    }
+    if (last) {
+        std::unique_ptr<TObject> obj(last->ReadObj());
+        if (!obj) {
+            std::cout << "Cannot read back " << last->GetName() << " from the target file" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-void MergeRootfile( TDirectory *target, TList *sourcelist );
+// read the payloads of the sources, in order, without getting too far ahead of the writer
+void ReadPayloads(std::vector<Source>* sources, ReadState* state){
+    for (std::size_t isource = state->next++; isource < sources->size(); isource = state->next++) {
+        Source& source = sources->at(isource);
+        std::unique_ptr<TFile> file(TFile::Open(source.fileName.c_str(), "READ"));
+        const bool isOpen = file && !file->IsZombie();
+        for (const Entry& entry : source.entries) {
+            if (entry.isTree) continue;
+            const std::size_t size = entry.nbytes - entry.keylen;
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->cond.wait(lock, [&]{ return state->stop || isource == state->current || state->buffered < MAXBUFFEREDBYTES; });
+                if (state->stop) return;
+                state->buffered += size;
+            }
+            std::vector<char> payload(size);
+            // an empty payload tells the writer that the read failed
+            if (!isOpen || file->ReadBuffer(payload.data(), entry.seekKey + entry.keylen, static_cast<Int_t>(size))) payload.clear();
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                source.payloads.emplace_back(std::move(payload));
+            }
+            state->cond.notify_all();
+        }
+    }
+}
+
+}
 
 // main function
 // -------------------------------------------------------
 // -------------------------------------------------------
-TList *FileList;
-TFile *Target;
-TFile*whichfile;
-
 int main(int argc, char **argv){
-   
+
    std::cout << "Creating target mergin histograms from source files. Histograms not summed if have the same name: only the first one is kept." << std::endl;
-   
-   std::cout << "Target file:\t" << argv[1] << std::endl;
-   
-   Target = new TFile( argv[1], "RECREATE" );
-   FileList = new TList();
-   
-   TDirectory *dir = gDirectory;
-      
-   if (argc<3) {
+
+   int nThreads = std::thread::hardware_concurrency();
+   int iarg = 1;
+   if (argc > 2 && std::string(argv[1]) == "-j") {
+      nThreads = std::atoi(argv[2]);
+      iarg = 3;
+   }
+   if (argc-iarg < 2) {
       std::cout << "Too few arguments ..." <<std::endl    ;
+      std::cout << "Usage: hupdate [-j N] targetfile file1 file2 ..." << std::endl;
       return -1;
    }
-  
-   for (int i=2; i<argc; i++){
-      std::cout << "Source file("<< i-1<<"):\t" << argv[i] <<std::endl;
-      whichfile=new TFile(argv[i]);
-      FileList->Add( whichfile );
-      dir->cd();
-   }
 
-  // call the function
-  MergeRootfile( Target, FileList );
+   ROOT::EnableThreadSafety();
 
-  Target->Close();
-  
-  return 0;
-}
+   std::cout << "Target file:\t" << argv[iarg] << std::endl;
+   std::unique_ptr<TFile> target(TFile::Open( argv[iarg], "RECREATE" ));
+   if (!target || target->IsZombie()) {
+      std::cout << "Cannot create the target file" << std::endl;
+      return -1;
+   }
 
+   // collect the objects to copy, this only reads the directories of the sources
+   std::vector<Source> sources(argc-iarg-1);
+   std::set<std::string> seen;
+   for (int i=iarg+1; i<argc; i++){
+      std::cout << "Source file("<< i-iarg<<"):\t" << argv[i] <<std::endl;
+      Source& source = sources.at(i-iarg-1);
+      source.fileName = argv[i];
+      source.file.reset(TFile::Open(argv[i], "READ"));
+      if (!source.file || source.file->IsZombie()) {
+         std::cout << "Cannot open the source file " << argv[i] << std::endl;
+         return -1;
+      }
+      ListKeys(source.file.get(), "", target.get(), seen, source);
+      CopyStreamerInfos(source.file.get(), target.get());
+   }
 
-void MergeRootfile( TDirectory *target, TList *sourcelist ) {
-   TString path( (char*)strstr( target->GetPath(), ":" ) );
-   path.Remove( 0, 2 );
-
-   TList *ListAllKeys=new TList();  // This is supposed to keep track of all different objects in all files...
- 
-   // take next file:
-   TIter nextsource_iter( sourcelist );
-//    TDirectory *current_sourcedir = gDirectory;
-
-   //gain time, do not add the objects in the list in memory
-   Bool_t status = TH1::AddDirectoryStatus();
-   TH1::AddDirectory(kFALSE);
-
-   TFile *next_source; 
-   while ( (next_source = (TFile*)nextsource_iter() ) ) {//  start cycle over files
-      next_source->cd( path );
-      // loop over all keys in this directory (meaning of the directory of the first file! This is the point in which this script starts to be different from hadd)
-      TChain *globChain = 0;
-      TIter nextkey( next_source->GetListOfKeys() );
-      TKey *key, *oldkey=0;
-      while ( (key = (TKey*)nextkey())) {
-        //keep only the highest cycle number for each key
-         if (oldkey && !strcmp(oldkey->GetName(),key->GetName())) continue; 
-	   // ok, this key is the only one in -this- file. 
-           // Then check if it was already present in other files.
-   	   TIter nextkeyAllFiles(ListAllKeys);
-	   Bool_t skipkey=kFALSE;
-	   TKey* keyGlobal;
-           while ( (keyGlobal = (TKey*)nextkeyAllFiles()) ) if ( !strcmp(keyGlobal->GetName(),key->GetName())) skipkey=kTRUE; //FIXME: no check if the histograms are actually different, just look at the name ...
-	   if (skipkey) continue;
-   	   // we have a new key, in this and previous files: save it
-	   ListAllKeys->Add(key);
-         // read object from this source file
-         next_source->cd( path );
-         TObject *obj = key->ReadObj();
-         if ( obj->IsA()->InheritsFrom( TH1::Class() ) ) {
-            // descendant of TH1 -> merge it
-            //      cout << "Merging histogram " << obj->GetName() << endl;
-//             TH1 *h1 = (TH1*)obj;
-            // loop over all source files and add the content of the
-            // correspondant histogram to the one pointed to by "h1"
-         } else {
-            // object is of no type that we know or can handle
-            std::cout << "Unimplemented or unknown object type, name: "
-            << obj->GetName() << " title: " << obj->GetTitle() << std::endl;
+   // read the payloads in parallel, write them in order
+   ReadState state;
+   std::vector<std::thread> threads;
+   const std::size_t nReaders = std::max(1, std::min(nThreads, static_cast<int>(sources.size())));
+   for (std::size_t ithread = 0; ithread < nReaders; ++ithread) {
+      threads.emplace_back(ReadPayloads, &sources, &state);
+   }
+
+   bool success = true;
+   std::size_t nCopied = 0;
+   for (std::size_t isource = 0; isource < sources.size() && success; ++isource) {
+      Source& source = sources.at(isource);
+      {
+         std::lock_guard<std::mutex> lock(state.mutex);
+         state.current = isource;
+      }
+      state.cond.notify_all();
+      for (const Entry& entry : source.entries) {
+         if (entry.isTree) {
+            TTree* tree = static_cast<TTree*>(source.file->Get(entry.path.c_str()));
+            entry.target->cd();
+            TTree* clone = tree ? tree->CloneTree(-1, "fast") : nullptr;
+            if (!clone) {
+               std::cout << "Cannot copy the tree " << entry.path << " from " << source.fileName << std::endl;
+               success = false;
+               break;
+            }
+            clone->Write(entry.name.c_str());
+            delete clone;
+            ++nCopied;
+            continue;
+         }
+         std::vector<char> payload;
+         {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.cond.wait(lock, [&]{ return !source.payloads.empty(); });
+            payload = std::move(source.payloads.front());
+            source.payloads.pop_front();
+            state.buffered -= entry.nbytes - entry.keylen;
          }
-         // now write the merged histogram (which is "in" obj) to the target file
-         // note that this will just store obj in the current directory level,
-         // which is not persistent until the complete directory itself is stored
-         // by "target->Write()" below
-         if ( obj ) {
-            target->cd();
-            //!!if the object is a tree, it is stored in globChain...
-            if(obj->IsA()->InheritsFrom( TTree::Class() ))
-               globChain->Merge(target->GetFile(),0,"keep");
-            else
-               obj->Write( key->GetName() );
+         state.cond.notify_all();
+         if (payload.empty()) {
+            std::cout << "Cannot read " << entry.path << " from " << source.fileName << std::endl;
+            success = false;
+            break;
          }
-         oldkey=key;
-      } // while ( ( TKey *key = (TKey*)nextkey() ) )
-   } // while ( ( next_source = (TFile*)nextsource_iter() ) )
+         RawKey* key = new RawKey(entry, payload, entry.target); // owned by the target directory
+         key->WriteFile(key->GetCycle());
+         ++nCopied;
+      }
+   }
+
+   if (!success) {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      state.stop = true;
+   }
+   state.cond.notify_all();
+   for (auto& thread : threads) {
+      thread.join();
+   }
+   if (!success) return -1;
+
    // save modifications to target file
-   target->SaveSelf(kTRUE);
-   TH1::AddDirectory(status);
-   std::cout << "Done." << std::endl;   
-} 
+   target->Close();
+
+   if (!VerifyTarget(argv[iarg], sources)) return -1;
+
+   std::cout << "Copied " << nCopied << " objects." << std::endl;
+   std::cout << "Done." << std::endl;
+
+   return 0;
+}
@@ -0,0 +1,665 @@
+// Synthetic-workload benchmark for trex-fitter.
+//
+// The executable generates a synthetic set of inputs (histograms or ntuples)
+// of tunable size, writes a matching config file and then runs each of the
+// requested trex-fitter steps as a separate process, measuring the wall time,
+// the CPU time and the peak resident memory (RSS) of every step.
+// The inputs are generated with a fixed seed and each step can be repeated
+// several times (the median time is reported), so that the results of two
+// runs are directly comparable.
+//
+// Usage:
+//     trex-benchmark <steps> [options]
+// e.g.
+//     trex-benchmark hwfrp "Regions=10:Bins=20:Samples=5:Systematics=50"
+//     trex-benchmark nwf "Mode=NTUP:Events=1000000:Reference=Benchmark/Benchmark.txt"
+//
+// Each character of <steps> is run as a separate trex-fitter call (with "u"
+// prepended automatically for unfolding setups).
+// The options use the same syntax as the trex-fitter command line options:
+//     Mode         HIST or NTUP (default HIST)
+//     Regions      number of regions (default 4)
+//     Bins         number of (reco) bins per region (default 10)
+//     Samples      number of background samples (default 3)
+//     Systematics  number of shape systematics (default 10)
+//     TruthBins    number of truth bins, if > 0 an unfolding setup is generated (default 0)
+//     Events       number of ntuple events per sample, only for NTUP (default 100000)
+//     Repeat       number of repetitions of each step (default 1)
+//     Seed         seed used for the input generation (default 1234)
+//     Dir          working directory (default "Benchmark")
+//     Executable   trex-fitter executable (default "trex-fitter")
+//     Reference    results file of a previous run to compare to
+//     Tolerance    relative increase of time or memory reported as regression (default 0.2)
+//
+// The results are written to <Dir>/Benchmark.txt, the logs of the single
+// steps are stored in <Dir>/Logs/. If a reference is provided and any step
+// regressed by more than the tolerance, the exit code is 2.
+
+// ROOT includes
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TRandom3.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+// c++ includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Workload {
+    std::string mode = "HIST";
+    int regions = 4;
+    int bins = 10;
+    int samples = 3;
+    int systematics = 10;
+    int truthBins = 0;
+    long int events = 100000;
+    int repeat = 1;
+    unsigned int seed = 1234;
+    std::string dir = "Benchmark";
+    std::string executable = "trex-fitter";
+    std::string reference = "";
+    double tolerance = 0.2;
+
+    bool IsNtuple() const {return mode == "NTUP";}
+    bool IsUnfolding() const {return truthBins > 0;}
+
+    std::string Summary() const {
+        std::ostringstream s;
+        s << "Mode=" << mode << " Regions=" << regions << " Bins=" << bins
+          << " Samples=" << samples << " Systematics=" << systematics
+          << " TruthBins=" << truthBins;
+        if (IsNtuple()) s << " Events=" << events;
+        s << " Seed=" << seed;
+        return s.str();
+    }
+};
+
+struct StepResult {
+    std::string step;
+    double wall = 0.;
+    double user = 0.;
+    double sys = 0.;
+    double maxRSS = 0.; // in MB
+    int status = 0;
+};
+
+//__________________________________________________________________________________
+//
+std::vector<std::string> Split(const std::string& s, const char c) {
+    std::vector<std::string> result;
+    std::istringstream stream(s);
+    std::string item;
+    while (std::getline(stream, item, c)) {
+        if (!item.empty()) result.emplace_back(item);
+    }
+    return result;
+}
+
+//__________________________________________________________________________________
+//
+bool ReadOptions(const std::string& options, Workload& w) {
+    for (const auto& iopt : Split(options, ':')) {
+        const std::vector<std::string>& pair = Split(iopt, '=');
+        if (pair.size() != 2) {
+            std::cerr << "trex-benchmark: cannot read option \"" << iopt << "\"" << std::endl;
+            return false;
+        }
+        const std::string& key = pair.at(0);
+        const std::string& value = pair.at(1);
+        if      (key == "Mode")        w.mode = value;
+        else if (key == "Regions")     w.regions = std::stoi(value);
+        else if (key == "Bins")        w.bins = std::stoi(value);
+        else if (key == "Samples")     w.samples = std::stoi(value);
+        else if (key == "Systematics") w.systematics = std::stoi(value);
+        else if (key == "TruthBins")   w.truthBins = std::stoi(value);
+        else if (key == "Events")      w.events = std::stol(value);
+        else if (key == "Repeat")      w.repeat = std::stoi(value);
+        else if (key == "Seed")        w.seed = std::stoul(value);
+        else if (key == "Dir")         w.dir = value;
+        else if (key == "Executable")  w.executable = value;
+        else if (key == "Reference")   w.reference = value;
+        else if (key == "Tolerance")   w.tolerance = std::stod(value);
+        else {
+            std::cerr << "trex-benchmark: unknown option \"" << key << "\"" << std::endl;
+            return false;
+        }
+    }
+    std::transform(w.mode.begin(), w.mode.end(), w.mode.begin(), ::toupper);
+    if (w.mode != "HIST" && w.mode != "NTUP") {
+        std::cerr << "trex-benchmark: Mode has to be HIST or NTUP" << std::endl;
+        return false;
+    }
+    if (w.regions < 1 || w.bins < 2 || w.samples < 1 || w.systematics < 0 || w.repeat < 1) {
+        std::cerr << "trex-benchmark: invalid workload size" << std::endl;
+        return false;
+    }
+    if (w.IsUnfolding() && (w.truthBins < 2 || w.truthBins > 100 || w.bins > 100)) {
+        std::cerr << "trex-benchmark: the number of truth and reco bins has to be between 2 and 100 for unfolding" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//__________________________________________________________________________________
+// Expected (unnormalised) shape of a sample in a given bin of a region
+double Shape(const int isample, const int ireg, const double x) {
+    if (isample < 0) { // signal
+        const double mean = 0.5 + 0.3*std::sin(ireg);
+        return 10.*std::exp(-0.5*(x-mean)*(x-mean)/0.01);
+    }
+    const double slope = 1. + 0.5*isample + 0.1*ireg;
+    return 100.*std::exp(-slope*x)/(1.+isample);
+}
+
+//__________________________________________________________________________________
+// Relative (linear in x) effect of a systematic on a sample/region
+double SystEffect(const int isyst, const int isample, const int ireg, const double x, const bool isUp) {
+    const double norm  = 0.02 + 0.01*((isyst + isample + ireg) % 5);
+    const double slope = 0.05*(((isyst*7 + isample*3 + ireg) % 11) - 5)/5.;
+    const double effect = norm + slope*(x - 0.5);
+    return isUp ? 1. + effect : 1. - 0.9*effect;
+}
+
+//__________________________________________________________________________________
+//
+std::string SampleName(const int isample) {
+    return isample < 0 ? "Signal" : "Bkg" + std::to_string(isample);
+}
+
+//__________________________________________________________________________________
+//
+void FillHisto(TH1D* h, const int isample, const int ireg, const int isyst, const bool isUp) {
+    for (int ibin = 1; ibin <= h->GetNbinsX(); ++ibin) {
+        const double x = h->GetBinCenter(ibin);
+        double content = Shape(isample, ireg, x)*h->GetBinWidth(ibin);
+        if (isyst >= 0) content *= SystEffect(isyst, isample, ireg, x, isUp);
+        h->SetBinContent(ibin, content);
+        h->SetBinError(ibin, 0.05*content);
+    }
+}
+
+//__________________________________________________________________________________
+//
+void GenerateHistograms(const Workload& w, const std::string& inputDir, TRandom3& rnd) {
+    const int firstSample = w.IsUnfolding() ? 0 : -1;
+    for (int isample = firstSample; isample < w.samples; ++isample) {
+        std::unique_ptr<TFile> f(TFile::Open((inputDir + "/" + SampleName(isample) + ".root").c_str(), "RECREATE"));
+        for (int ireg = 0; ireg < w.regions; ++ireg) {
+            const std::string name = "Region" + std::to_string(ireg);
+            TH1D h(name.c_str(), name.c_str(), w.bins, 0., 1.);
+            FillHisto(&h, isample, ireg, -1, true);
+            h.Write();
+            for (int isyst = 0; isyst < w.systematics; ++isyst) {
+                for (const bool isUp : {true, false}) {
+                    const std::string systName = name + "_Syst" + std::to_string(isyst) + (isUp ? "_Up" : "_Down");
+                    TH1D hSyst(systName.c_str(), systName.c_str(), w.bins, 0., 1.);
+                    FillHisto(&hSyst, isample, ireg, isyst, isUp);
+                    hSyst.Write();
+                }
+            }
+        }
+        f->Close();
+    }
+
+    // pseudo-data from the nominal prediction
+    std::unique_ptr<TFile> f(TFile::Open((inputDir + "/Data.root").c_str(), "RECREATE"));
+    for (int ireg = 0; ireg < w.regions; ++ireg) {
+        const std::string name = "Region" + std::to_string(ireg);
+        TH1D h(name.c_str(), name.c_str(), w.bins, 0., 1.);
+        for (int ibin = 1; ibin <= w.bins; ++ibin) {
+            const double x = h.GetBinCenter(ibin);
+            double expected = 0;
+            for (int isample = -1; isample < w.samples; ++isample) {
+                expected += Shape(isample, ireg, x)*h.GetBinWidth(ibin);
+            }
+            h.SetBinContent(ibin, rnd.Poisson(expected));
+        }
+        h.Write();
+    }
+    f->Close();
+}
+
+//__________________________________________________________________________________
+//
+void GenerateNtuples(const Workload& w, const std::string& inputDir, TRandom3& rnd) {
+    // the shapes are sampled by accept-reject, the weights carry the normalisation
+    const int firstSample = w.IsUnfolding() ? 0 : -1;
+    for (int isample = firstSample - 1; isample < w.samples; ++isample) {
+        const bool isData = (isample == firstSample - 1);
+        const std::string name = isData ? "Data" : SampleName(isample);
+        std::unique_ptr<TFile> f(TFile::Open((inputDir + "/" + name + ".root").c_str(), "RECREATE"));
+        TTree tree("events", "events");
+        float x;
+        int region;
+        float weight;
+        std::vector<float> systWeights(2*w.systematics, 1.);
+        tree.Branch("x", &x, "x/F");
+        tree.Branch("region", &region, "region/I");
+        tree.Branch("weight", &weight, "weight/F");
+        if (!isData) {
+            for (int isyst = 0; isyst < w.systematics; ++isyst) {
+                const std::string up = "weight_Syst" + std::to_string(isyst) + "_Up";
+                const std::string down = "weight_Syst" + std::to_string(isyst) + "_Down";
+                tree.Branch(up.c_str(), &systWeights.at(2*isyst), (up + "/F").c_str());
+                tree.Branch(down.c_str(), &systWeights.at(2*isyst+1), (down + "/F").c_str());
+            }
+        }
+
+        const long int eventsPerRegion = std::max(1L, w.events/w.regions);
+        for (region = 0; region < w.regions; ++region) {
+            // maximum of the shape on a fine grid for the accept-reject
+            double max = 0;
+            for (int i = 0; i <= 1000; ++i) {
+                for (int is = isData ? -1 : isample; is <= (isData ? w.samples-1 : isample); ++is) {
+                    max = std::max(max, Shape(is, region, i/1000.));
+                }
+            }
+            double integral = 0;
+            for (int is = isData ? -1 : isample; is <= (isData ? w.samples-1 : isample); ++is) {
+                for (int i = 0; i < 1000; ++i) integral += Shape(is, region, (i+0.5)/1000.)/1000.;
+            }
+            const long int nEvents = isData ? rnd.Poisson(integral) : eventsPerRegion;
+            weight = isData ? 1. : integral/eventsPerRegion;
+            for (long int iev = 0; iev < nEvents; ++iev) {
+                double density = 0;
+                do {
+                    x = rnd.Uniform();
+                    density = 0;
+                    for (int is = isData ? -1 : isample; is <= (isData ? w.samples-1 : isample); ++is) {
+                        density += Shape(is, region, x);
+                    }
+                } while (rnd.Uniform(max*(isData ? w.samples+1 : 1)) > density);
+                if (!isData) {
+                    for (int isyst = 0; isyst < w.systematics; ++isyst) {
+                        systWeights.at(2*isyst)   = SystEffect(isyst, isample, region, x, true);
+                        systWeights.at(2*isyst+1) = SystEffect(isyst, isample, region, x, false);
+                    }
+                }
+                tree.Fill();
+            }
+        }
+        tree.Write();
+        f->Close();
+    }
+}
+
+//__________________________________________________________________________________
+// Migration matrices (truth on the vertical axis), selection efficiencies and truth distribution
+void GenerateUnfoldingInputs(const Workload& w, const std::string& inputDir) {
+    auto FillMigration = [&w](TH2D* h, const int ireg, const int isyst, const bool isUp) {
+        const double resolution = 0.08*(1. + 0.1*ireg)*(isyst < 0 ? 1. : SystEffect(isyst, 0, ireg, 0.5, isUp));
+        for (int itruth = 1; itruth <= w.truthBins; ++itruth) {
+            const double truth = h->GetYaxis()->GetBinCenter(itruth);
+            for (int ireco = 1; ireco <= w.bins; ++ireco) {
+                const double reco = h->GetXaxis()->GetBinCenter(ireco);
+                h->SetBinContent(ireco, itruth, 1000.*std::exp(-0.5*(reco-truth)*(reco-truth)/(resolution*resolution)));
+            }
+        }
+    };
+    auto FillEfficiency = [&w](TH1D* h, const int ireg, const int isyst, const bool isUp) {
+        for (int ibin = 1; ibin <= w.truthBins; ++ibin) {
+            const double x = h->GetBinCenter(ibin);
+            double eff = 0.3 + 0.2*x/(1.+ireg);
+            if (isyst >= 0) eff *= SystEffect(isyst, 0, ireg, x, isUp);
+            h->SetBinContent(ibin, std::min(eff, 1.));
+        }
+    };
+
+    for (int ireg = 0; ireg < w.regions; ++ireg) {
+        const std::string name = "Unfolding_Region" + std::to_string(ireg);
+        std::unique_ptr<TFile> f(TFile::Open((inputDir + "/" + name + ".root").c_str(), "RECREATE"));
+        for (int isyst = -1; isyst < w.systematics; ++isyst) {
+            for (const bool isUp : {true, false}) {
+                if (isyst < 0 && !isUp) continue;
+                const std::string suffix = isyst < 0 ? "" : "_Syst" + std::to_string(isyst) + (isUp ? "_Up" : "_Down");
+                TH2D migration(("migration" + suffix).c_str(), "", w.bins, 0., 1., w.truthBins, 0., 1.);
+                FillMigration(&migration, ireg, isyst, isUp);
+                migration.Write();
+                TH1D efficiency(("efficiency" + suffix).c_str(), "", w.truthBins, 0., 1.);
+                FillEfficiency(&efficiency, ireg, isyst, isUp);
+                efficiency.Write();
+            }
+        }
+        f->Close();
+    }
+
+    std::unique_ptr<TFile> f(TFile::Open((inputDir + "/Truth.root").c_str(), "RECREATE"));
+    TH1D truth("truth", "truth", w.truthBins, 0., 1.);
+    for (int ibin = 1; ibin <= w.truthBins; ++ibin) {
+        truth.SetBinContent(ibin, 100.*Shape(-1, 0, truth.GetBinCenter(ibin))*truth.GetBinWidth(ibin) + 10.);
+    }
+    truth.Write();
+    f->Close();
+}
+
+//__________________________________________________________________________________
+//
+void WriteConfig(const Workload& w, const std::string& fileName) {
+    std::ofstream out(fileName);
+    const bool ntup = w.IsNtuple();
+
+    out << "Job: \"Benchmark\"\n";
+    out << "  Label: \"Benchmark\"\n";
+    out << "  ReadFrom: " << w.mode << "\n";
+    if (ntup) {
+        out << "  NtuplePaths: \"Inputs\"\n";
+        out << "  NtupleName: \"events\"\n";
+        out << "  MCweight: \"weight\"\n";
+    } else {
+        out << "  HistoPath: \"Inputs\"\n";
+    }
+    if (w.IsUnfolding()) {
+        out << "  MigrationPath: \"Inputs\"\n";
+        out << "  SelectionEffPath: \"Inputs\"\n";
+    } else {
+        out << "  POI: \"mu\"\n";
+    }
+    out << "  DebugLevel: 0\n";
+    out << "  SystControlPlots: FALSE\n";
+    out << "  MCstatThreshold: 0.01\n";
+    out << "  ImageFormat: png\n";
+    out << "  RankingMaxNP: 10\n\n";
+
+    out << "Fit: \"Fit\"\n";
+    out << "  FitType: " << (w.IsUnfolding() ? "UNFOLDING" : "SPLUSB") << "\n";
+    out << "  FitRegion: CRSR\n";
+    out << "  FitBlind: TRUE\n\n";
+
+    out << "Limit: \"Limit\"\n";
+    out << "  LimitType: ASYMPTOTIC\n";
+    out << "  LimitBlind: TRUE\n\n";
+
+    if (w.IsUnfolding()) {
+        out << "Unfolding: \"Unfolding\"\n";
+        out << "  MatrixOrientation: TRUTHONVERTICAL\n";
+        out << "  TruthDistributionPath: \"Inputs\"\n";
+        out << "  TruthDistributionFile: \"Truth\"\n";
+        out << "  TruthDistributionName: \"truth\"\n";
+        out << "  NumberOfTruthBins: " << w.truthBins << "\n";
+        out << "  NominalTruthSample: \"Truth\"\n\n";
+
+        out << "TruthSample: \"Truth\"\n";
+        out << "  Title: \"Truth\"\n";
+        out << "  TruthDistributionName: \"truth\"\n\n";
+    }
+
+    for (int ireg = 0; ireg < w.regions; ++ireg) {
+        const std::string name = "Region" + std::to_string(ireg);
+        out << "Region: \"" << name << "\"\n";
+        out << "  Type: SIGNAL\n";
+        if (ntup) {
+            out << "  Variable: \"x\"," << w.bins << ",0,1\n";
+            out << "  Selection: \"region==" << ireg << "\"\n";
+        } else {
+            out << "  HistoName: \"" << name << "\"\n";
+        }
+        if (w.IsUnfolding()) {
+            out << "  NumberOfRecoBins: " << w.bins << "\n";
+            out << "  MigrationFile: \"Unfolding_" << name << "\"\n";
+            out << "  SelectionEffFile: \"Unfolding_" << name << "\"\n";
+        }
+        out << "  Label: \"" << name << "\"\n\n";
+    }
+
+    out << "Sample: \"Data\"\n";
+    out << "  Type: DATA\n";
+    out << (ntup ? "  NtupleFile: \"Data\"\n\n" : "  HistoFile: \"Data\"\n\n");
+
+    std::string mcSamples;
+    if (w.IsUnfolding()) {
+        out << "UnfoldingSample: \"Signal\"\n";
+        out << "  Title: \"Signal\"\n";
+        out << "  MigrationName: \"migration\"\n";
+        out << "  SelectionEffName: \"efficiency\"\n\n";
+    } else {
+        out << "Sample: \"Signal\"\n";
+        out << "  Type: SIGNAL\n";
+        out << "  NormFactor: \"mu\",1,-10,10\n";
+        out << (ntup ? "  NtupleFile: \"Signal\"\n\n" : "  HistoFile: \"Signal\"\n\n");
+        mcSamples = "Signal";
+    }
+    for (int isample = 0; isample < w.samples; ++isample) {
+        const std::string name = SampleName(isample);
+        out << "Sample: \"" << name << "\"\n";
+        out << "  Type: BACKGROUND\n";
+        out << "  FillColor: " << (400 + 10*isample) << "\n";
+        out << (ntup ? "  NtupleFile: \"" : "  HistoFile: \"") << name << "\"\n\n";
+        if (!mcSamples.empty()) mcSamples += ",";
+        mcSamples += name;
+
+        out << "Systematic: \"Norm_" << name << "\"\n";
+        out << "  Type: OVERALL\n";
+        out << "  OverallUp: 0.1\n";
+        out << "  OverallDown: -0.1\n";
+        out << "  Samples: " << name << "\n\n";
+    }
+
+    for (int isyst = 0; isyst < w.systematics; ++isyst) {
+        const std::string name = "Syst" + std::to_string(isyst);
+        out << "Systematic: \"" << name << "\"\n";
+        out << "  Type: HISTO\n";
+        out << "  Samples: " << mcSamples << "\n";
+        out << "  Symmetrisation: TWOSIDED\n";
+        if (ntup) {
+            out << "  WeightSufUp: \"weight_" << name << "_Up\"\n";
+            out << "  WeightSufDown: \"weight_" << name << "_Down\"\n\n";
+        } else {
+            out << "  HistoNameSufUp: \"_" << name << "_Up\"\n";
+            out << "  HistoNameSufDown: \"_" << name << "_Down\"\n\n";
+        }
+        if (w.IsUnfolding()) {
+            out << "UnfoldingSystematic: \"" << name << "\"\n";
+            out << "  NuisanceParameter: \"" << name << "\"\n";
+            out << "  Type: HISTO\n";
+            out << "  Samples: \"Signal\"\n";
+            out << "  Symmetrisation: TWOSIDED\n";
+            out << "  MigrationNameUp: \"migration_" << name << "_Up\"\n";
+            out << "  MigrationNameDown: \"migration_" << name << "_Down\"\n";
+            out << "  SelectionEffNameUp: \"efficiency_" << name << "_Up\"\n";
+            out << "  SelectionEffNameDown: \"efficiency_" << name << "_Down\"\n\n";
+        }
+    }
+}
+
+//__________________________________________________________________________________
+// Runs one trex-fitter step in a child process and measures its resources
+StepResult RunStep(const Workload& w, const std::string& step, const std::string& logName) {
+    StepResult result;
+    result.step = step;
+
+    const auto start = std::chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "trex-benchmark: fork failed" << std::endl;
+        result.status = -1;
+        return result;
+    }
+    if (pid == 0) {
+        if (chdir(w.dir.c_str()) != 0) _exit(127);
+        const int fd = open(logName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execlp(w.executable.c_str(), w.executable.c_str(), step.c_str(), "Benchmark.config", static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    const auto end = std::chrono::steady_clock::now();
+
+    result.wall = std::chrono::duration<double>(end - start).count();
+    result.user = usage.ru_utime.tv_sec + 1e-6*usage.ru_utime.tv_usec;
+    result.sys  = usage.ru_stime.tv_sec + 1e-6*usage.ru_stime.tv_usec;
+#ifdef __APPLE__
+    result.maxRSS = usage.ru_maxrss/(1024.*1024.); // bytes
+#else
+    result.maxRSS = usage.ru_maxrss/1024.; // kilobytes
+#endif
+    result.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return result;
+}
+
+//__________________________________________________________________________________
+// Median time and maximum memory over the repetitions of one step
+StepResult Combine(const std::vector<StepResult>& results) {
+    auto Median = [](std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        const std::size_t n = v.size();
+        return (n % 2 == 1) ? v.at(n/2) : 0.5*(v.at(n/2-1) + v.at(n/2));
+    };
+    StepResult combined = results.front();
+    std::vector<double> wall, user, sys;
+    for (const auto& ires : results) {
+        wall.emplace_back(ires.wall);
+        user.emplace_back(ires.user);
+        sys.emplace_back(ires.sys);
+        combined.maxRSS = std::max(combined.maxRSS, ires.maxRSS);
+        if (ires.status != 0) combined.status = ires.status;
+    }
+    combined.wall = Median(wall);
+    combined.user = Median(user);
+    combined.sys  = Median(sys);
+    return combined;
+}
+
+//__________________________________________________________________________________
+//
+std::map<std::string, StepResult> ReadReference(const std::string& fileName, std::string& summary) {
+    std::map<std::string, StepResult> result;
+    std::ifstream in(fileName);
+    if (!in.good()) {
+        std::cerr << "trex-benchmark: cannot open reference file " << fileName << std::endl;
+        return result;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        if (line.front() == '#') {
+            if (line.find("Mode=") != std::string::npos) summary = line.substr(line.find("Mode="));
+            continue;
+        }
+        std::istringstream s(line);
+        StepResult res;
+        s >> res.step >> res.wall >> res.user >> res.sys >> res.maxRSS >> res.status;
+        result[res.step] = res;
+    }
+    return result;
+}
+
+} // namespace
+
+// main function
+// -------------------------------------------------------
+// -------------------------------------------------------
+int main(int argc, char **argv){
+
+    if (argc < 2) {
+        std::cerr << "Usage: trex-benchmark <steps> [options]" << std::endl;
+        return 1;
+    }
+
+    Workload w;
+    const std::string steps = argv[1];
+    if (argc > 2 && !ReadOptions(argv[2], w)) return 1;
+
+    std::vector<std::string> stepList;
+    if (w.IsUnfolding() && steps.find('u') == std::string::npos) stepList.emplace_back("u");
+    for (const char c : steps) stepList.emplace_back(1, c);
+
+    std::cout << "trex-benchmark: " << w.Summary() << std::endl;
+
+    // generate the inputs
+    const std::string inputDir = w.dir + "/Inputs";
+    gSystem->mkdir(inputDir.c_str(), true);
+    gSystem->mkdir((w.dir + "/Logs").c_str(), true);
+    {
+        TRandom3 rnd(w.seed);
+        std::cout << "trex-benchmark: generating inputs in " << inputDir << std::endl;
+        if (w.IsNtuple()) GenerateNtuples(w, inputDir, rnd);
+        else              GenerateHistograms(w, inputDir, rnd);
+        if (w.IsUnfolding()) GenerateUnfoldingInputs(w, inputDir);
+        WriteConfig(w, w.dir + "/Benchmark.config");
+    }
+
+    // run the steps
+    std::vector<StepResult> results;
+    for (const auto& istep : stepList) {
+        std::vector<StepResult> repetitions;
+        for (int irep = 0; irep < w.repeat; ++irep) {
+            const std::string logName = "Logs/LOG_" + istep + "_" + std::to_string(irep);
+            repetitions.emplace_back(RunStep(w, istep, logName));
+            const StepResult& res = repetitions.back();
+            std::cout << "trex-benchmark: step " << istep << " (" << irep+1 << "/" << w.repeat << "): "
+                      << std::fixed << std::setprecision(2) << res.wall << " s, "
+                      << res.maxRSS << " MB" << std::endl;
+            if (res.status != 0) {
+                std::cerr << "trex-benchmark: step " << istep << " failed with status " << res.status
+                          << ", see " << w.dir << "/" << logName << std::endl;
+            }
+        }
+        results.emplace_back(Combine(repetitions));
+    }
+
+    // write the results
+    const std::string outName = w.dir + "/Benchmark.txt";
+    std::ofstream out(outName);
+    out << "# trex-benchmark results, repetitions: " << w.repeat << "\n";
+    out << "# " << w.Summary() << "\n";
+    out << "# step  wall[s]  user[s]  sys[s]  maxRSS[MB]  status\n";
+    for (const auto& ires : results) {
+        out << ires.step << " " << std::fixed << std::setprecision(3) << ires.wall << " " << ires.user << " "
+            << ires.sys << " " << ires.maxRSS << " " << ires.status << "\n";
+    }
+    out.close();
+    std::cout << "trex-benchmark: results written to " << outName << std::endl;
+
+    // compare to the reference
+    bool regression = false;
+    if (!w.reference.empty()) {
+        std::string refSummary;
+        const std::map<std::string, StepResult>& reference = ReadReference(w.reference, refSummary);
+        if (refSummary != w.Summary()) {
+            std::cerr << "trex-benchmark: WARNING reference was produced with a different workload: " << refSummary << std::endl;
+        }
+        for (const auto& ires : results) {
+            auto it = reference.find(ires.step);
+            if (it == reference.end()) continue;
+            const StepResult& ref = it->second;
+            const double timeRatio = ref.wall > 0 ? ires.wall/ref.wall : 1.;
+            const double memRatio = ref.maxRSS > 0 ? ires.maxRSS/ref.maxRSS : 1.;
+            const bool bad = timeRatio > 1. + w.tolerance || memRatio > 1. + w.tolerance;
+            std::cout << "trex-benchmark: step " << ires.step << " time ratio " << std::setprecision(2) << timeRatio
+                      << ", memory ratio " << memRatio << (bad ? "  <-- REGRESSION" : "") << std::endl;
+            regression |= bad;
+        }
+    }
+
+    for (const auto& ires : results) {
+        if (ires.status != 0) return 1;
+    }
+    return regression ? 2 : 0;
+}
@@ -92,6 +92,7 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
     const bool groupedImpact      = opt.find("i") != std::string::npos;
     const bool doLHscan           = opt.find("x") != std::string::npos;
     const bool prepareUnfolding   = opt.find("u") != std::string::npos;
+    const bool doPosterior        = opt.find("c") != std::string::npos;
 
     const bool pruning = (createWorkspace || drawPreFit || drawPostFit); // ...
 
@@ -233,6 +234,7 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
             return;
         }
         myFit->PrepareUnfolding();
+        myFit->MemoryCheckpoint("u");
     }
 
     // Free the memeory
@@ -250,10 +252,9 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->MergeSystematics();
         myFit->CreateCustomAsimov();
         myFit->UnfoldingAlternativeAsimov();
-        myFit->WriteHistos();
-        if(TRExFitter::SYSTCONTROLPLOTS) myFit->DrawSystPlots();
-        if(TRExFitter::SYSTDATAPLOT)     myFit->DrawSystPlotsSumSamples();
+        myFit->WriteHistosAndSystPlots();
         myFit->CloseInputFiles();
+        myFit->MemoryCheckpoint("h");
     }
     else if(readNtuples){
         std::cout << "Reading ntuples..." << std::endl;
@@ -268,9 +269,8 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->MergeSystematics();
         myFit->CreateCustomAsimov();
         myFit->UnfoldingAlternativeAsimov();
-        myFit->WriteHistos();
-        if(TRExFitter::SYSTCONTROLPLOTS) myFit->DrawSystPlots();
-        if(TRExFitter::SYSTDATAPLOT)     myFit->DrawSystPlotsSumSamples();
+        myFit->WriteHistosAndSystPlots();
+        myFit->MemoryCheckpoint("n");
     }
     else{
         if(drawPreFit || drawPostFit || createWorkspace || drawSeparation || rebinAndSmooth || doEFTInputs || groupedImpact) {
@@ -290,9 +290,8 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->CombineSpecialSystematics();
         myFit->CreateCustomAsimov();
         myFit->UnfoldingAlternativeAsimov();
-        myFit->WriteHistos(false);
-        if(TRExFitter::SYSTCONTROLPLOTS) myFit->DrawSystPlots();
-        if(TRExFitter::SYSTDATAPLOT)     myFit->DrawSystPlotsSumSamples();
+        myFit->WriteHistosAndSystPlots(false);
+        myFit->MemoryCheckpoint("b");
     }
 
     
@@ -328,6 +327,7 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->ProcessEFTInputs();
         myFit->ToRooStats(true,true);
         myFit->CloseInputFiles();
+        myFit->MemoryCheckpoint("w");
     }
 
     if(doFit){
@@ -336,25 +336,35 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->PlotFittedNP();
         myFit->PlotCorrelationMatrix();
         myFit->PlotUnfoldedData();
+        myFit->MemoryCheckpoint("f");
     }
     if (doLHscan){
         std::cout << "Running LH scan only..." << std::endl;
         myFit->Fit(true);
+        myFit->MemoryCheckpoint("x");
+    }
+    if (doPosterior){
+        std::cout << "Sampling the posterior..." << std::endl;
+        myFit->RunPosteriorSampling();
+        myFit->MemoryCheckpoint("c");
     }
     if(doRanking){
         std::cout << "Doing ranking..." << std::endl;
         if(myFit->fRankingOnly!="plot")  myFit->ProduceNPRanking( myFit->fRankingOnly );
         if(myFit->fRankingOnly=="all" || myFit->fRankingOnly=="plot")  myFit->PlotNPRankingManager();
+        myFit->MemoryCheckpoint("r");
     }
 
     if(doLimit){
         std::cout << "Extracting limit..." << std::endl;
         myFit->GetLimit();
+        myFit->MemoryCheckpoint("l");
     }
 
     if(doSignificance){
         std::cout << "Extracting significance..." << std::endl;
         myFit->GetSignificance();
+        myFit->MemoryCheckpoint("s");
     }
 
     if(groupedImpact){
@@ -362,6 +372,7 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         myFit->fDoGroupedSystImpactTable = true;
         if(myFit->fGroupedImpactCategory!="combine") myFit->Fit(false);
         else                                         myFit->BuildGroupedImpactTable();
+        myFit->MemoryCheckpoint("i");
     }
 
     std::shared_ptr<TRExPlot> prefit_plot = nullptr;
@@ -419,6 +430,7 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
         }
         if(myFit->fDoSignalRegionsPlot) myFit->DrawSignalRegionsPlot(nCols,nRows);
         if(myFit->fDoPieChartPlot)      myFit->DrawPieChartPlot("pre",nCols,nRows);
+        myFit->MemoryCheckpoint("d");
     }
 
     if(drawPostFit){
@@ -451,11 +463,13 @@ void FitExample(std::string opt="h",std::string configFile="config/myFit.config"
             if(nCols*nRows < myFit->fRegions.size()) nRows++;
         }
         if(myFit->fDoPieChartPlot) myFit->DrawPieChartPlot("post",nCols,nRows);
+        myFit->MemoryCheckpoint("p");
     }
 
     if(drawSeparation){
         std::cout << "Drawing separation plots..." << std::endl;
         myFit->DrawAndSaveSeparationPlots();
+        myFit->MemoryCheckpoint("a");
     }
 
     if(drawPreFit || drawPostFit || createWorkspace || drawSeparation || rebinAndSmooth) myFit->CloseInputFiles();